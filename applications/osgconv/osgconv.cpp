@@ -502,6 +502,14 @@ static void usage( const char *prog, const char *msg )
                             <<"                         Example: --simplify .5" << std::endl
                             <<"                                 will produce a 50% reduced model." << std::endl
                             << std::endl;
+    osg::notify(osg::NOTICE)<<"    --simplify-method m - Method used by --simplify, either edge or quadric." << std::endl
+                            <<"                         edge is the original serial edge collapse, quadric" << std::endl
+                            <<"                         collapses vertices in parallel over a spatial grid" << std::endl
+                            <<"                         and is much faster on large models." << std::endl
+                            << std::endl;
+    osg::notify(osg::NOTICE)<<"    --simplify-partition-size n - Maximum number of triangles in each grid" << std::endl
+                            <<"                         cell of the quadric method, default 65536." << std::endl
+                            << std::endl;
     osg::notify(osg::NOTICE)<<"    -s scale           - Scale size of model.  Scale argument must be the \n"
                               "                         following :\n"
                               "\n"
@@ -702,6 +710,21 @@ int main( int argc, char **argv )
         do_simplify = true;
     }
 
+    osgUtil::Simplifier::Method simplifyMethod = osgUtil::Simplifier::EDGE_COLLAPSE;
+    while ( arguments.read( "--simplify-method",str ) )
+    {
+        if (str=="edge") simplifyMethod = osgUtil::Simplifier::EDGE_COLLAPSE;
+        else if (str=="quadric") simplifyMethod = osgUtil::Simplifier::QUADRIC_COLLAPSE;
+        else
+        {
+            usage( argv[0], "Simplify method must be edge or quadric." );
+            return 1;
+        }
+    }
+
+    unsigned int simplifyPartitionSize = 65536;
+    while ( arguments.read( "--simplify-partition-size",simplifyPartitionSize ) ) {}
+
     while (arguments.read("-t",str))
     {
         osg::Vec3 trans(0,0,0);
@@ -851,6 +874,8 @@ int main( int argc, char **argv )
             simple.setSmoothing( smooth );
             osg::notify( osg::ALWAYS ) << " smoothing: " << smooth << std::endl;
             simple.setSampleRatio( simplifyPercent );
+            simple.setMethod( simplifyMethod );
+            simple.setMaximumNumTrianglesPerPartition( simplifyPartitionSize );
             root->accept( simple );
         }
 
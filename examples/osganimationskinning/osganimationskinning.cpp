@@ -21,6 +21,9 @@
 #include <osgDB/WriteFile>
 #include <osgUtil/SmoothingVisitor>
 #include <osg/io_utils>
+#include <osg/Timer>
+#include <osg/TaskScheduler>
+#include <osgUtil/UpdateVisitor>
 
 #include <osgAnimation/Bone>
 #include <osgAnimation/Skeleton>
@@ -75,7 +78,6 @@ osgAnimation::RigGeometry* createTesselatedBox(int nsplit, float size)
     for (int i = 0; i < nsplit; i++)
     {
         float x = -1.0f + static_cast<float>(i) * step;
-        std::cout << x << std::endl;
         vertices->push_back (osg::Vec3 ( x, s, s));
         vertices->push_back (osg::Vec3 ( x, -s, s));
         vertices->push_back (osg::Vec3 ( x, -s, -s));
@@ -154,10 +156,84 @@ void initVertexMap(osgAnimation::Bone* b0,
 }
 
 
+// Skin numCharacters boxes of numSplits sections, blended between two bones, over numFrames update traversals without a viewer.
+int runSkinningBenchmark(unsigned int numCharacters, unsigned int numSplits, unsigned int numFrames)
+{
+    osg::ref_ptr<osgAnimation::Skeleton> skelroot = new osgAnimation::Skeleton;
+    osg::ref_ptr<osgAnimation::Bone> root = new osgAnimation::Bone;
+    root->setName("root");
+    osg::ref_ptr<osgAnimation::Bone> arm = new osgAnimation::Bone;
+    arm->setName("arm");
+    arm->setInvBindMatrixInSkeletonSpace(osg::Matrix::inverse(osg::Matrix::translate(1.0,0.0,0.0)));
+    root->addChild(arm.get());
+    skelroot->addChild(root.get());
+
+    unsigned int numVertices = 0;
+    for(unsigned int c=0; c<numCharacters; ++c)
+    {
+        osgAnimation::RigGeometry* geom = createTesselatedBox(numSplits, 4.0f);
+        osgUtil::SmoothingVisitor::smooth(*geom->getSourceGeometry());
+
+        // weights quantized to 1/64 steps along the box, as exported skinned meshes typically share a limited set of bone weightings.
+        osg::Vec3Array* array = dynamic_cast<osg::Vec3Array*>(geom->getSourceGeometry()->getVertexArray());
+        osgAnimation::VertexInfluenceMap* vim = new osgAnimation::VertexInfluenceMap;
+        (*vim)[root->getName()].setName(root->getName());
+        (*vim)[arm->getName()].setName(arm->getName());
+        for (unsigned int i = 0; i < array->size(); i++)
+        {
+            float w = osg::clampBetween(floorf(((*array)[i].x()+1.0f)*16.0f)/64.0f, 0.0f, 1.0f);
+            if (w<1.0f) (*vim)[root->getName()].push_back(osgAnimation::VertexIndexWeight(i,1.0f-w));
+            if (w>0.0f) (*vim)[arm->getName()].push_back(osgAnimation::VertexIndexWeight(i,w));
+        }
+        geom->setInfluenceMap(vim);
+        numVertices += array->size();
+
+        osg::Geode* geode = new osg::Geode;
+        geode->addDrawable(geom);
+        skelroot->addChild(geode);
+    }
+
+    osg::ref_ptr<osgUtil::UpdateVisitor> updateVisitor = new osgUtil::UpdateVisitor;
+    osg::ref_ptr<osg::FrameStamp> frameStamp = new osg::FrameStamp;
+    updateVisitor->setFrameStamp(frameStamp.get());
+
+    // the first traversals prepare the rigs and bind them to the skeleton.
+    for(unsigned int frame=0; frame<2; ++frame)
+    {
+        frameStamp->setFrameNumber(frame);
+        skelroot->accept(*updateVisitor);
+    }
+
+    osg::Timer_t start = osg::Timer::instance()->tick();
+    for(unsigned int frame=0; frame<numFrames; ++frame)
+    {
+        arm->setMatrixInSkeletonSpace(osg::Matrix::rotate(osg::PI_2*static_cast<float>(frame)/static_cast<float>(numFrames), osg::Vec3(0.0f,0.0f,1.0f))*
+                                      osg::Matrix::translate(1.0,0.0,0.0));
+        frameStamp->setFrameNumber(frame+2);
+        skelroot->accept(*updateVisitor);
+    }
+    double time = osg::Timer::instance()->delta_m(start, osg::Timer::instance()->tick());
+
+    std::cout<<"Skinned "<<numCharacters<<" characters, "<<numVertices<<" vertices, using "<<osg::TaskScheduler::instance()->getNumThreads()<<" task threads"<<std::endl;
+    std::cout<<"    "<<time/static_cast<double>(numFrames)<<"ms per frame, "<<(time*1e6)/(static_cast<double>(numFrames)*numVertices)<<"ns per vertex"<<std::endl;
+    return 0;
+}
 
 int main (int argc, char* argv[])
 {
     osg::ArgumentParser arguments(&argc, argv);
+
+    unsigned int numCharacters = 0;
+    if (arguments.read("--benchmark", numCharacters))
+    {
+        unsigned int numSplits = 1000;
+        unsigned int numFrames = 100;
+        while(arguments.read("--splits", numSplits)) {}
+        while(arguments.read("--frames", numFrames)) {}
+        osg::DisplaySettings::instance()->readCommandLine(arguments);
+        return runSkinningBenchmark(numCharacters, numSplits, numFrames);
+    }
+
     osgViewer::Viewer viewer(arguments);
 
     viewer.setCameraManipulator(new osgGA::TrackballManipulator());
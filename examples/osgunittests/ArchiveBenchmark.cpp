@@ -0,0 +1,269 @@
+/* OpenSceneGraph example, osgunittests.
+*
+*  Permission is hereby granted, free of charge, to any person obtaining a copy
+*  of this software and associated documentation files (the "Software"), to deal
+*  in the Software without restriction, including without limitation the rights
+*  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+*  copies of the Software, and to permit persons to whom the Software is
+*  furnished to do so, subject to the following conditions:
+*
+*  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+*  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+*  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+*  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+*  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+*  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+*  THE SOFTWARE.
+*/
+
+#include "ArchiveBenchmark.h"
+
+#include <osg/Geode>
+#include <osg/Geometry>
+#include <osg/Timer>
+#include <osgDB/Archive>
+#include <osgDB/Registry>
+
+#include <OpenThreads/Atomic>
+#include <OpenThreads/Barrier>
+#include <OpenThreads/Thread>
+
+#include <stdio.h>
+#include <fstream>
+#include <sstream>
+#include <iostream>
+
+static const unsigned int s_numMembers = 256;
+static const unsigned int s_numReadsPerThread = 256;
+
+static std::string memberName(unsigned int i)
+{
+    std::ostringstream str;
+    str<<"tile_"<<i<<".osgb";
+    return str.str();
+}
+
+// a tile sized geometry, with the member index recorded in its name so that reads can be checked.
+static osg::Node* createTile(unsigned int index)
+{
+    const unsigned int numColumns = 32;
+    osg::Vec3Array* vertices = new osg::Vec3Array;
+    osg::Vec3Array* normals = new osg::Vec3Array;
+    for(unsigned int r=0; r<numColumns; ++r)
+    {
+        for(unsigned int c=0; c<numColumns; ++c)
+        {
+            vertices->push_back(osg::Vec3(float(c), float(r), float((c*7+r*13+index)%17)));
+            normals->push_back(osg::Vec3(0.0f, 0.0f, 1.0f));
+        }
+    }
+
+    osg::DrawElementsUShort* triangles = new osg::DrawElementsUShort(GL_TRIANGLES);
+    for(unsigned int r=0; r+1<numColumns; ++r)
+    {
+        for(unsigned int c=0; c+1<numColumns; ++c)
+        {
+            unsigned int i = r*numColumns+c;
+            triangles->push_back(i); triangles->push_back(i+1); triangles->push_back(i+numColumns+1);
+            triangles->push_back(i); triangles->push_back(i+numColumns+1); triangles->push_back(i+numColumns);
+        }
+    }
+
+    osg::Geometry* geometry = new osg::Geometry;
+    geometry->setVertexArray(vertices);
+    geometry->setNormalArray(normals, osg::Array::BIND_PER_VERTEX);
+    geometry->addPrimitiveSet(triangles);
+
+    osg::Geode* geode = new osg::Geode;
+    geode->setName(memberName(index));
+    geode->addDrawable(geometry);
+    return geode;
+}
+
+// reads random members of a shared archive, as DatabasePager threads reading tiles do.
+class ArchiveReadThread : public OpenThreads::Thread
+{
+public:
+
+    ArchiveReadThread(osgDB::Archive* archive, OpenThreads::Barrier* barrier, unsigned int seed, OpenThreads::Atomic& numFailed):
+        _archive(archive),
+        _barrier(barrier),
+        _seed(seed),
+        _numFailed(numFailed) {}
+
+    virtual void run()
+    {
+        _barrier->block();
+
+        for(unsigned int i=0; i<s_numReadsPerThread; ++i)
+        {
+            _seed = _seed*1664525u + 1013904223u;
+            std::string name = memberName((_seed>>8)%s_numMembers);
+
+            osgDB::ReaderWriter::ReadResult result = _archive->readNode(name);
+            if (!result.getNode() || result.getNode()->getName()!=name) ++_numFailed;
+        }
+
+        _barrier->block();
+    }
+
+    osgDB::Archive*         _archive;
+    OpenThreads::Barrier*   _barrier;
+    unsigned int            _seed;
+    OpenThreads::Atomic&    _numFailed;
+};
+
+static void readArchive(const char* name, const std::string& filename, const std::string& optionString, unsigned int numThreads)
+{
+    // the Registry caches opened archives by filename, so drop any earlier opening of the file.
+    osgDB::Registry::instance()->removeFromArchiveCache(filename);
+
+    osg::ref_ptr<osgDB::Options> options = new osgDB::Options(optionString);
+    osg::ref_ptr<osgDB::Archive> archive = osgDB::openArchive(filename, osgDB::ReaderWriter::READ, 4096, options.get());
+    if (!archive)
+    {
+        std::cout<<"    "<<name<<" unable to open "<<filename<<std::endl;
+        return;
+    }
+
+    OpenThreads::Atomic numFailed;
+    OpenThreads::Barrier barrier(numThreads+1);
+
+    std::vector<ArchiveReadThread*> threads;
+    for(unsigned int i=0; i<numThreads; ++i)
+    {
+        threads.push_back(new ArchiveReadThread(archive.get(), &barrier, i*7919+1, numFailed));
+        threads.back()->start();
+    }
+
+    barrier.block();
+    osg::Timer_t start = osg::Timer::instance()->tick();
+    barrier.block();
+    double readTime = osg::Timer::instance()->delta_m(start, osg::Timer::instance()->tick());
+
+    for(unsigned int i=0; i<numThreads; ++i)
+    {
+        threads[i]->join();
+        delete threads[i];
+    }
+
+    unsigned int numReads = numThreads*s_numReadsPerThread;
+    std::cout<<"    "<<name<<" "<<readTime<<"ms, "<<double(numReads)*1000.0/readTime<<" reads/s, "<<static_cast<unsigned int>(numFailed)<<" failed"<<std::endl;
+}
+
+void runArchiveBenchmark(unsigned int numThreads)
+{
+    std::string filename("osgunittests_benchmark.osga");
+
+    {
+        osg::ref_ptr<osgDB::Archive> archive = osgDB::openArchive(filename, osgDB::ReaderWriter::CREATE);
+        if (!archive)
+        {
+            std::cout<<"Unable to create "<<filename<<std::endl;
+            return;
+        }
+
+        for(unsigned int i=0; i<s_numMembers; ++i)
+        {
+            osg::ref_ptr<osg::Node> tile = createTile(i);
+            archive->writeNode(*tile, memberName(i));
+        }
+        archive->close();
+    }
+
+    std::cout<<"Archive of "<<s_numMembers<<" tiles, "<<numThreads<<" threads each reading "<<s_numReadsPerThread<<" random tiles"<<std::endl;
+
+    readArchive("locked file stream", filename, "NoMemoryMapping", numThreads);
+    readArchive("memory mapped     ", filename, "", numThreads);
+
+    osgDB::Registry::instance()->removeFromArchiveCache(filename);
+    remove(filename.c_str());
+}
+
+static unsigned int crc32(const std::string& data)
+{
+    unsigned int crc = 0xffffffffu;
+    for(std::string::const_iterator itr = data.begin(); itr != data.end(); ++itr)
+    {
+        crc ^= static_cast<unsigned char>(*itr);
+        for(unsigned int k=0; k<8; ++k) crc = (crc>>1) ^ (0xedb88320u & (0u-(crc&1u)));
+    }
+    return ~crc;
+}
+
+static void writeShort(std::ostream& out, unsigned int value)
+{
+    out.put(static_cast<char>(value&0xff));
+    out.put(static_cast<char>((value>>8)&0xff));
+}
+
+static void writeLong(std::ostream& out, unsigned int value)
+{
+    writeShort(out, value&0xffff);
+    writeShort(out, value>>16);
+}
+
+// write the tiles to a .zip with the members stored uncompressed, as there's no zip writer in osgDB to do this.
+static bool writeZipArchive(const std::string& filename)
+{
+    osgDB::ReaderWriter* rw = osgDB::Registry::instance()->getReaderWriterForExtension("osgb");
+    if (!rw) return false;
+
+    std::ofstream fout(filename.c_str(), std::ios::out | std::ios::binary);
+    if (!fout) return false;
+
+    std::ostringstream centralDirectory;
+    for(unsigned int i=0; i<s_numMembers; ++i)
+    {
+        osg::ref_ptr<osg::Node> tile = createTile(i);
+        std::ostringstream data;
+        rw->writeNode(*tile, data);
+
+        std::string name = memberName(i);
+        std::string bytes = data.str();
+        unsigned int crc = crc32(bytes);
+        unsigned int offset = static_cast<unsigned int>(fout.tellp());
+
+        writeLong(fout, 0x04034b50); writeShort(fout, 10); writeShort(fout, 0); writeShort(fout, 0);
+        writeLong(fout, 0); writeLong(fout, crc); writeLong(fout, bytes.size()); writeLong(fout, bytes.size());
+        writeShort(fout, name.size()); writeShort(fout, 0);
+        fout<<name<<bytes;
+
+        writeLong(centralDirectory, 0x02014b50); writeShort(centralDirectory, 10); writeShort(centralDirectory, 10);
+        writeShort(centralDirectory, 0); writeShort(centralDirectory, 0); writeLong(centralDirectory, 0);
+        writeLong(centralDirectory, crc); writeLong(centralDirectory, bytes.size()); writeLong(centralDirectory, bytes.size());
+        writeShort(centralDirectory, name.size()); writeShort(centralDirectory, 0); writeShort(centralDirectory, 0);
+        writeShort(centralDirectory, 0); writeShort(centralDirectory, 0); writeLong(centralDirectory, 0);
+        writeLong(centralDirectory, offset);
+        centralDirectory<<name;
+    }
+
+    std::string directory = centralDirectory.str();
+    unsigned int directoryOffset = static_cast<unsigned int>(fout.tellp());
+    fout<<directory;
+
+    writeLong(fout, 0x06054b50); writeShort(fout, 0); writeShort(fout, 0);
+    writeShort(fout, s_numMembers); writeShort(fout, s_numMembers);
+    writeLong(fout, directory.size()); writeLong(fout, directoryOffset); writeShort(fout, 0);
+
+    return fout.good();
+}
+
+void runZipArchiveBenchmark(unsigned int numThreads)
+{
+    std::string filename("osgunittests_benchmark.zip");
+
+    if (!writeZipArchive(filename))
+    {
+        std::cout<<"Unable to create "<<filename<<std::endl;
+        return;
+    }
+
+    std::cout<<"Zip archive of "<<s_numMembers<<" stored tiles, "<<numThreads<<" threads each reading "<<s_numReadsPerThread<<" random tiles"<<std::endl;
+
+    readArchive("file handles  ", filename, "NoMemoryMapping", numThreads);
+    readArchive("memory mapped ", filename, "", numThreads);
+
+    osgDB::Registry::instance()->removeFromArchiveCache(filename);
+    remove(filename.c_str());
+}
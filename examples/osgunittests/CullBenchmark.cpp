@@ -0,0 +1,153 @@
+/* OpenSceneGraph example, osgunittests.
+*
+*  Permission is hereby granted, free of charge, to any person obtaining a copy
+*  of this software and associated documentation files (the "Software"), to deal
+*  in the Software without restriction, including without limitation the rights
+*  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+*  copies of the Software, and to permit persons to whom the Software is
+*  furnished to do so, subject to the following conditions:
+*
+*  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+*  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+*  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+*  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+*  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+*  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+*  THE SOFTWARE.
+*/
+
+#include "CullBenchmark.h"
+
+#include <osg/Geode>
+#include <osg/Geometry>
+#include <osg/Sequence>
+#include <osg/Switch>
+#include <osg/FrameStamp>
+#include <osg/Timer>
+#include <osgUtil/SceneView>
+#include <osgUtil/StateGraph>
+
+#include <iostream>
+
+// Group subclass that selects the child to traverse in traverse(), as osgFX::Effect and osgShadow::ShadowedScene do.
+class FirstChildGroup : public osg::Group
+{
+public:
+    virtual void traverse(osg::NodeVisitor& nv)
+    {
+        if (getNumChildren()>0) getChild(0)->accept(nv);
+    }
+};
+
+static osg::Geode* createQuad(unsigned int i)
+{
+    float x = float(i%8);
+    float y = float(i/8);
+
+    osg::ref_ptr<osg::Vec3Array> vertices = new osg::Vec3Array;
+    vertices->push_back(osg::Vec3(x, y, 0.0f));
+    vertices->push_back(osg::Vec3(x+0.9f, y, 0.0f));
+    vertices->push_back(osg::Vec3(x+0.9f, y+0.9f, 0.0f));
+    vertices->push_back(osg::Vec3(x, y+0.9f, 0.0f));
+
+    osg::ref_ptr<osg::Geometry> geometry = new osg::Geometry;
+    geometry->setVertexArray(vertices.get());
+    geometry->addPrimitiveSet(new osg::DrawArrays(GL_QUADS, 0, 4));
+
+    osg::Geode* geode = new osg::Geode;
+    geode->addDrawable(geometry.get());
+    return geode;
+}
+
+static void collectDrawables(const osgUtil::StateGraph* sg, std::vector<const osg::Drawable*>& drawables)
+{
+    for(osgUtil::StateGraph::LeafList::const_iterator itr = sg->_leaves.begin();
+        itr != sg->_leaves.end();
+        ++itr)
+    {
+        drawables.push_back((*itr)->getDrawable());
+    }
+
+    for(osgUtil::StateGraph::ChildList::const_iterator itr = sg->_children.begin();
+        itr != sg->_children.end();
+        ++itr)
+    {
+        collectDrawables(itr->second.get(), drawables);
+    }
+}
+
+// cull root from above with numCullThreads, returning the drawables recorded and the time per cull.
+static double cullScene(osg::Node* root, unsigned int numCullThreads, std::vector<const osg::Drawable*>& drawables)
+{
+    osg::ref_ptr<osgUtil::SceneView> sceneView = new osgUtil::SceneView;
+    sceneView->setDefaults();
+    sceneView->setNumCullThreads(numCullThreads);
+    sceneView->setSceneData(root);
+    sceneView->setViewport(0, 0, 1024, 1024);
+    sceneView->setProjectionMatrixAsPerspective(60.0, 1.0, 1.0, 1000.0);
+    sceneView->setViewMatrixAsLookAt(osg::Vec3d(4.0, 4.0, 10.0), osg::Vec3d(4.0, 4.0, 0.0), osg::Vec3d(0.0, 1.0, 0.0));
+
+    osg::ref_ptr<osg::FrameStamp> frameStamp = new osg::FrameStamp;
+    sceneView->setFrameStamp(frameStamp.get());
+
+    const unsigned int numFrames = 10;
+    osg::Timer_t start = osg::Timer::instance()->tick();
+    for(unsigned int i=0; i<numFrames; ++i)
+    {
+        frameStamp->setFrameNumber(i);
+        sceneView->cull();
+    }
+    double cullTime = osg::Timer::instance()->delta_m(start, osg::Timer::instance()->tick())/double(numFrames);
+
+    drawables.clear();
+    collectDrawables(sceneView->getStateGraph(), drawables);
+
+    sceneView->setSceneData(0);
+    return cullTime;
+}
+
+static bool testRoot(const char* name, osg::Group* group, unsigned int numCullThreads, unsigned int expectedNumDrawables)
+{
+    osg::ref_ptr<osg::Group> root = group;
+
+    const unsigned int numChildren = 64;
+    for(unsigned int i=0; i<numChildren; ++i)
+    {
+        root->addChild(createQuad(i));
+    }
+
+    std::vector<const osg::Drawable*> serialDrawables;
+    double serialTime = cullScene(root.get(), 1, serialDrawables);
+
+    std::vector<const osg::Drawable*> parallelDrawables;
+    double parallelTime = cullScene(root.get(), numCullThreads, parallelDrawables);
+
+    bool passed = serialDrawables==parallelDrawables && serialDrawables.size()==expectedNumDrawables;
+
+    std::cout<<(passed ? "pass" : "fail")<<"    "<<name<<" root: "<<serialDrawables.size()<<" drawables culled serially in "<<serialTime<<"ms, "
+             <<parallelDrawables.size()<<" on "<<numCullThreads<<" threads in "<<parallelTime<<"ms, expected "<<expectedNumDrawables<<std::endl;
+    return passed;
+}
+
+void runCullTest(unsigned int numCullThreads)
+{
+    testRoot("Group", new osg::Group, numCullThreads, 64);
+
+    // Group subclasses that pick the children to traverse must not have all their children culled in parallel.
+    osg::ref_ptr<osg::Sequence> sequence = new osg::Sequence;
+    sequence->setValue(5);
+    testRoot("Sequence", sequence.get(), numCullThreads, 1);
+
+    osg::ref_ptr<osg::Switch> switchNode = new osg::Switch;
+    switchNode->setNewChildDefaultValue(false);
+    testRoot("Switch", switchNode.get(), numCullThreads, 0);
+
+    testRoot("traverse() override", new FirstChildGroup, numCullThreads, 1);
+
+    // a child added twice could be culled by two threads at once, so the root is culled serially.
+    osg::ref_ptr<osg::Group> sharedChildGroup = new osg::Group;
+    osg::ref_ptr<osg::Geode> sharedChild = createQuad(64);
+    sharedChildGroup->addChild(sharedChild.get());
+    sharedChildGroup->addChild(sharedChild.get());
+    testRoot("shared child", sharedChildGroup.get(), numCullThreads, 66);
+}
@@ -0,0 +1,228 @@
+/* OpenSceneGraph example, osgunittests.
+*
+*  Permission is hereby granted, free of charge, to any person obtaining a copy
+*  of this software and associated documentation files (the "Software"), to deal
+*  in the Software without restriction, including without limitation the rights
+*  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+*  copies of the Software, and to permit persons to whom the Software is
+*  furnished to do so, subject to the following conditions:
+*
+*  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+*  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+*  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+*  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+*  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+*  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+*  THE SOFTWARE.
+*/
+
+#include "DatabasePagerQueue.h"
+
+#include <osg/Timer>
+#include <osgDB/DatabasePager>
+
+#include <stdlib.h>
+#include <iostream>
+#include <set>
+
+// DatabasePager subclass used to gain access to the protected RequestQueue and DatabaseRequest.
+class QueueBenchmarkPager : public osgDB::DatabasePager
+{
+public:
+
+    QueueBenchmarkPager() {}
+
+    void run(unsigned int numRequests)
+    {
+        osg::Timer timer;
+
+        unsigned int frameNumber = 10;
+        _frameNumber.exchange(frameNumber);
+
+        osg::ref_ptr<RequestQueue> queue = new RequestQueue(this);
+
+        typedef std::vector< osg::ref_ptr<DatabaseRequest> > Requests;
+        Requests requests;
+        requests.reserve(numRequests);
+
+        srand(1);
+        for(unsigned int i=0; i<numRequests; ++i)
+        {
+            osg::ref_ptr<DatabaseRequest> dr = new DatabaseRequest;
+            dr->_valid = true;
+            // a quarter of the requests are stale so have to be pruned on the way through the queue.
+            dr->_frameNumberLastRequest = (i%4==0) ? frameNumber-5 : frameNumber;
+            dr->_timestampLastRequest = double(dr->_frameNumberLastRequest)/60.0;
+            dr->_priorityLastRequest = float(rand())/float(RAND_MAX);
+            requests.push_back(dr);
+        }
+
+        osg::Timer_t startTick = timer.tick();
+
+        for(Requests::iterator itr = requests.begin(); itr != requests.end(); ++itr)
+        {
+            queue->add(itr->get());
+        }
+
+        osg::Timer_t addTick = timer.tick();
+
+        // emulate the cull traversal re-requesting half the tiles with a new priority.
+        for(unsigned int i=1; i<numRequests; i+=2)
+        {
+            DatabaseRequest* dr = requests[i].get();
+            dr->_priorityLastRequest = float(rand())/float(RAND_MAX);
+            queue->updatePriority(dr);
+        }
+
+        osg::Timer_t updateTick = timer.tick();
+
+        // drop our references so that pruned requests behave as they would inside the pager.
+        requests.clear();
+
+        unsigned int numTaken = 0;
+        float previousPriority = 2.0f;
+        bool ordered = true;
+        for(;;)
+        {
+            osg::ref_ptr<DatabaseRequest> dr;
+            queue->takeFirst(dr);
+            if (!dr) break;
+
+            if (dr->_priorityLastRequest>previousPriority) ordered = false;
+            previousPriority = dr->_priorityLastRequest;
+            ++numTaken;
+        }
+
+        osg::Timer_t endTick = timer.tick();
+
+        std::cout<<"RequestQueue with "<<numRequests<<" requests"<<std::endl;
+        std::cout<<"    add()            "<<timer.delta_m(startTick, addTick)<<"ms"<<std::endl;
+        std::cout<<"    updatePriority() "<<timer.delta_m(addTick, updateTick)<<"ms"<<std::endl;
+        std::cout<<"    takeFirst()      "<<timer.delta_m(updateTick, endTick)<<"ms, "<<numTaken<<" current requests taken, "<<(ordered ? "in priority order" : "ERROR not in priority order")<<std::endl;
+    }
+
+    osg::ref_ptr<DatabaseRequest> createRequest(float priority)
+    {
+        osg::ref_ptr<DatabaseRequest> dr = new DatabaseRequest;
+        dr->_valid = true;
+        dr->_frameNumberLastRequest = _frameNumber;
+        dr->_timestampLastRequest = 1.0;
+        dr->_priorityLastRequest = priority;
+        return dr;
+    }
+
+    // swap a RequestList into a queue and back out again, expecting it handed back highest priority first.
+    void runSwapTest()
+    {
+        _frameNumber.exchange(10);
+
+        osg::ref_ptr<RequestQueue> queue = new RequestQueue(this);
+
+        RequestQueue::RequestList requestList;
+        for(unsigned int i=0; i<100; ++i)
+        {
+            requestList.push_back(createRequest(float((i*37)%100)));
+        }
+
+        queue->swap(requestList);
+        bool passed = requestList.empty() && queue->size()==100;
+
+        RequestQueue::RequestList takenList;
+        queue->swap(takenList);
+        passed = passed && queue->empty() && takenList.size()==100;
+
+        float previousPriority = 1000.0f;
+        for(RequestQueue::RequestList::iterator itr = takenList.begin(); itr != takenList.end(); ++itr)
+        {
+            if ((*itr)->_priorityLastRequest>previousPriority || (*itr)->_requestQueue) passed = false;
+            previousPriority = (*itr)->_priorityLastRequest;
+        }
+
+        std::cout<<(passed ? "pass" : "fail")<<"    RequestQueue::swap() of "<<takenList.size()<<" requests handed back highest priority first"<<std::endl;
+    }
+
+    // set up local file request queues for threads that aren't started, so the queue selection and stealing can be checked directly.
+    void runWorkStealingTest()
+    {
+        _frameNumber.exchange(10);
+        setWorkStealing(true);
+
+        const unsigned int numThreads = 4;
+        std::vector< osg::ref_ptr<DatabaseThread> > threads;
+        for(unsigned int i=0; i<numThreads; ++i)
+        {
+            threads.push_back(new DatabaseThread(this, DatabaseThread::HANDLE_NON_HTTP, "test"));
+            assignLocalFileRequestQueue(threads.back().get());
+        }
+
+        // sibling tiles, requested through the same parent, go to the same thread's queue, different parents spread over the threads.
+        const unsigned int numParents = 64;
+        std::vector< osg::ref_ptr<osg::Group> > parents;
+        std::vector< osg::ref_ptr<ReadQueue> > parentQueues;
+        std::set<ReadQueue*> queuesUsed;
+        bool siblingsShareQueue = true;
+        for(unsigned int i=0; i<numParents; ++i)
+        {
+            osg::ref_ptr<osg::Group> parent = new osg::Group;
+            osg::ref_ptr<osg::Node> child0 = new osg::Node;
+            osg::ref_ptr<osg::Node> child1 = new osg::Node;
+
+            osg::NodePath path0; path0.push_back(parent.get()); path0.push_back(child0.get());
+            osg::NodePath path1; path1.push_back(parent.get()); path1.push_back(child1.get());
+
+            osg::ref_ptr<ReadQueue> queue = selectFileRequestQueue(path0);
+            if (selectFileRequestQueue(path1)!=queue) siblingsShareQueue = false;
+
+            parents.push_back(parent);
+            parentQueues.push_back(queue);
+            queuesUsed.insert(queue.get());
+        }
+
+        bool affinityPassed = siblingsShareQueue && queuesUsed.size()>1;
+        std::cout<<(affinityPassed ? "pass" : "fail")<<"    work stealing affinity, "<<numParents<<" parents spread over "<<queuesUsed.size()<<" of "<<numThreads
+                 <<" local queues, siblings "<<(siblingsShareQueue ? "share" : "ERROR don't share")<<" a queue"<<std::endl;
+
+        // a thread takes from its own queue first, then steals from the other threads' queues.
+        osg::ref_ptr<LocalFileRequestQueues> localQueues = getLocalFileRequestQueues();
+        osg::ref_ptr<DatabaseRequest> ownRequest = createRequest(0.0f);
+        osg::ref_ptr<DatabaseRequest> otherRequest = createRequest(1.0f);
+        localQueues->_queues[0]->add(ownRequest.get());
+        localQueues->_queues[2]->add(otherRequest.get());
+
+        osg::ref_ptr<DatabaseRequest> first, second, third;
+        takeFirstLocalFileRequest(0, first);
+        takeFirstLocalFileRequest(0, second);
+        takeFirstLocalFileRequest(0, third);
+
+        bool stealingPassed = first==ownRequest && second==otherRequest && !third;
+        std::cout<<(stealingPassed ? "pass" : "fail")<<"    work stealing, thread takes its own request "<<(first==ownRequest ? "first" : "ERROR not first")
+                 <<", then "<<(second==otherRequest ? "steals" : "ERROR doesn't steal")<<" another thread's request"<<std::endl;
+
+        // queues selected before further threads replace the list of local queues remain valid.
+        osg::ref_ptr<ReadQueue> selectedQueue = parentQueues.front();
+        parentQueues.clear();
+        localQueues = 0;
+        threads.push_back(new DatabaseThread(this, DatabaseThread::HANDLE_NON_HTTP, "test"));
+        assignLocalFileRequestQueue(threads.back().get());
+
+        osg::ref_ptr<DatabaseRequest> request = createRequest(0.5f);
+        selectedQueue->add(request.get());
+        bool replacedPassed = selectedQueue->size()==1 && getLocalFileRequestQueues()->_queues.size()==numThreads+1;
+        selectedQueue->clear();
+        std::cout<<(replacedPassed ? "pass" : "fail")<<"    selected queue still usable after the local queues are replaced"<<std::endl;
+    }
+
+protected:
+
+    virtual ~QueueBenchmarkPager() {}
+};
+
+void runDatabasePagerQueueBenchmark(unsigned int numRequests)
+{
+    osg::ref_ptr<QueueBenchmarkPager> pager = new QueueBenchmarkPager;
+    pager->run(numRequests);
+    pager->runSwapTest();
+
+    osg::ref_ptr<QueueBenchmarkPager> stealingPager = new QueueBenchmarkPager;
+    stealingPager->runWorkStealingTest();
+}
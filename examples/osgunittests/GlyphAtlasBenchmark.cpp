@@ -0,0 +1,202 @@
+/* OpenSceneGraph example, osgunittests.
+*
+*  Permission is hereby granted, free of charge, to any person obtaining a copy
+*  of this software and associated documentation files (the "Software"), to deal
+*  in the Software without restriction, including without limitation the rights
+*  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+*  copies of the Software, and to permit persons to whom the Software is
+*  furnished to do so, subject to the following conditions:
+*
+*  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+*  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+*  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+*  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+*  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+*  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+*  THE SOFTWARE.
+*/
+
+#include "GlyphAtlasBenchmark.h"
+
+#include <osg/Timer>
+#include <osgText/Font>
+#include <osgText/GlyphAtlas>
+#include <osgText/Text>
+
+#include <iostream>
+#include <list>
+#include <math.h>
+
+// font generating a ring for every charcode at any resolution, standing in for a large CJK font without needing a font file.
+class RingFontImplementation : public osgText::Font::FontImplementation
+{
+    public:
+
+        RingFontImplementation(unsigned int seed):
+            _seed(seed) {}
+
+        virtual std::string getFileName() const { return std::string(); }
+
+        virtual bool supportsMultipleFontResolutions() const { return true; }
+
+        virtual osgText::Glyph* getGlyph(const osgText::FontResolution& fontRes, unsigned int charcode)
+        {
+            unsigned int width = fontRes.first;
+            unsigned int height = fontRes.second;
+
+            osg::ref_ptr<osgText::Glyph> glyph = new osgText::Glyph(_facade, charcode);
+            glyph->allocateImage(width, height, 1, GL_ALPHA, GL_UNSIGNED_BYTE);
+            glyph->setInternalTextureFormat(GL_ALPHA);
+
+            unsigned int hash = (charcode*2654435761u) ^ _seed;
+            float cx = float(width)*(0.3f+0.4f*float(hash%17)/16.0f);
+            float cy = float(height)*(0.3f+0.4f*float((hash>>8)%17)/16.0f);
+            float outer = float(height)*(0.2f+0.2f*float((hash>>16)%9)/8.0f);
+            float inner = outer*0.5f;
+
+            unsigned char* data = glyph->data();
+            for(unsigned int r=0; r<height; ++r)
+            {
+                for(unsigned int c=0; c<width; ++c)
+                {
+                    float dx = float(c)-cx, dy = float(r)-cy;
+                    float d = sqrtf(dx*dx+dy*dy);
+                    *(data++) = (d<=outer && d>=inner) ? 255 : 0;
+                }
+            }
+
+            float coord_scale = 1.0f/float(height);
+            glyph->setWidth(float(width)*coord_scale);
+            glyph->setHeight(float(height)*coord_scale);
+            glyph->setHorizontalBearing(osg::Vec2(0.0f, 0.0f));
+            glyph->setHorizontalAdvance(float(width)*coord_scale);
+            glyph->setVerticalBearing(osg::Vec2(0.5f, 1.0f));
+            glyph->setVerticalAdvance(float(height)*coord_scale);
+            glyph->setFontResolution(fontRes);
+
+            return glyph.release();
+        }
+
+        virtual osgText::Glyph3D* getGlyph3D(const osgText::FontResolution&, unsigned int) { return 0; }
+
+        virtual osg::Vec2 getKerning(const osgText::FontResolution&, unsigned int, unsigned int, osgText::KerningType) { return osg::Vec2(0.0f, 0.0f); }
+
+        virtual bool hasVertical() const { return false; }
+
+    protected:
+
+        unsigned int _seed;
+};
+
+typedef std::vector< osg::ref_ptr<osgText::Font> > Fonts;
+
+// show a rolling window of labels, each of 8 glyphs from the first numGlyphs charcodes of the CJK range, cycling through the fonts,
+// returning the time spent laying out the labels.
+static double showLabels(Fonts& fonts, unsigned int numGlyphs, unsigned int numLabels, double& maxLabelTime)
+{
+    const unsigned int numVisibleLabels = 64;
+    const unsigned int numCharsPerLabel = 8;
+
+    std::list< osg::ref_ptr<osgText::Text> > visibleLabels;
+
+    double totalTime = 0.0;
+    maxLabelTime = 0.0;
+
+    unsigned int seed = 1;
+    for(unsigned int l=0; l<numLabels; ++l)
+    {
+        osgText::String str;
+        for(unsigned int c=0; c<numCharsPerLabel; ++c)
+        {
+            // favour the lower charcodes, as text favours common characters.
+            seed = seed*1103515245u+12345u;
+            unsigned int r = (seed>>8)%1024;
+            str.push_back(0x4E00 + (r*r*numGlyphs)/(1024*1024));
+        }
+
+        osg::Timer_t start = osg::Timer::instance()->tick();
+
+        osg::ref_ptr<osgText::Text> text = new osgText::Text;
+        text->setShaderTechnique(osgText::SIGNED_DISTANCE_FIELD);
+        text->setFont(fonts[l%fonts.size()].get());
+        text->setFontResolution(32, 32);
+        text->setText(str);
+
+        double labelTime = osg::Timer::instance()->delta_m(start, osg::Timer::instance()->tick());
+        totalTime += labelTime;
+        if (labelTime>maxLabelTime) maxLabelTime = labelTime;
+
+        visibleLabels.push_back(text);
+        if (visibleLabels.size()>numVisibleLabels) visibleLabels.pop_front();
+    }
+
+    return totalTime;
+}
+
+static Fonts createFonts(unsigned int numFonts, osgText::GlyphAtlas* atlas)
+{
+    Fonts fonts;
+    for(unsigned int i=0; i<numFonts; ++i)
+    {
+        osg::ref_ptr<osgText::Font> font = new osgText::Font(new RingFontImplementation(i*7919));
+        font->setGlyphAtlas(atlas);
+        fonts.push_back(font);
+    }
+    return fonts;
+}
+
+void runGlyphAtlasBenchmark(unsigned int numGlyphs)
+{
+    const unsigned int numFonts = 3;
+    const unsigned int numLabels = 2000;
+
+    {
+        Fonts fonts = createFonts(numFonts, 0);
+
+        double maxLabelTime = 0.0;
+        double layoutTime = showLabels(fonts, numGlyphs, numLabels, maxLabelTime);
+
+        unsigned int numTextures = 0;
+        std::size_t textureMemory = 0;
+        for(Fonts::iterator itr = fonts.begin(); itr != fonts.end(); ++itr)
+        {
+            osgText::Font::GlyphTextureList& textures = (*itr)->getGlyphTextureList();
+            for(osgText::Font::GlyphTextureList::iterator titr = textures.begin(); titr != textures.end(); ++titr)
+            {
+                ++numTextures;
+                if ((*titr)->getImage()) textureMemory += (*titr)->getImage()->getTotalSizeInBytes();
+            }
+        }
+
+        std::cout<<"  per font textures: "<<numLabels<<" labels laid out in "<<layoutTime<<"ms, slowest "<<maxLabelTime<<"ms, "
+                 <<numTextures<<" textures, "<<textureMemory/1024<<"KB"<<std::endl;
+    }
+
+    for(unsigned int background=0; background<2; ++background)
+    {
+        osg::ref_ptr<osgText::GlyphAtlas> atlas = new osgText::GlyphAtlas;
+        atlas->setComputeInBackground(background!=0);
+
+        Fonts fonts = createFonts(numFonts, atlas.get());
+
+        double maxLabelTime = 0.0;
+        double layoutTime = showLabels(fonts, numGlyphs, numLabels, maxLabelTime);
+
+        osg::Timer_t start = osg::Timer::instance()->tick();
+        atlas->waitForPendingGlyphs();
+        double waitTime = osg::Timer::instance()->delta_m(start, osg::Timer::instance()->tick());
+
+        osgText::GlyphAtlas::Statistics stats;
+        atlas->getStatistics(stats);
+
+        std::cout<<"  shared atlas, "<<(background ? "background" : "foreground")<<" fields on "<<osg::TaskScheduler::instance()->getNumThreads()<<" worker threads: "
+                 <<numLabels<<" labels laid out in "<<layoutTime<<"ms, slowest "<<maxLabelTime<<"ms, then waited "<<waitTime<<"ms"<<std::endl;
+        std::cout<<"    "<<stats.numTextures<<" textures, "<<stats.textureMemory/1024<<"KB, "<<stats.numGlyphs<<" glyphs, occupancy "<<stats.getOccupancy()
+                 <<", "<<stats.numGlyphRequests<<" requests, "<<stats.numGlyphMisses<<" misses, miss ratio "<<stats.getMissRatio()
+                 <<", "<<stats.numEvictions<<" evictions, "<<stats.numAllocationFailures<<" allocation failures"<<std::endl;
+
+        fonts.clear();
+        atlas->getStatistics(stats);
+        std::cout<<"    after deleting the fonts: "<<stats.numGlyphs<<" glyphs, occupancy "<<stats.getOccupancy()<<std::endl;
+    }
+}
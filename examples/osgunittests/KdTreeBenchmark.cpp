@@ -0,0 +1,201 @@
+/* OpenSceneGraph example, osgunittests.
+*
+*  Permission is hereby granted, free of charge, to any person obtaining a copy
+*  of this software and associated documentation files (the "Software"), to deal
+*  in the Software without restriction, including without limitation the rights
+*  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+*  copies of the Software, and to permit persons to whom the Software is
+*  furnished to do so, subject to the following conditions:
+*
+*  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+*  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+*  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+*  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+*  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+*  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+*  THE SOFTWARE.
+*/
+
+#include "KdTreeBenchmark.h"
+
+#include <osg/Geometry>
+#include <osg/KdTree>
+#include <osg/Timer>
+#include <osgUtil/IntersectionVisitor>
+#include <osgUtil/LineSegmentIntersector>
+
+#include <math.h>
+#include <stdlib.h>
+#include <iostream>
+
+// create a bumpy terrain like grid with roughly the requested number of triangles.
+static osg::Geometry* createTerrainGeometry(unsigned int numTriangles)
+{
+    unsigned int numColumns = static_cast<unsigned int>(sqrt(double(numTriangles)/2.0)) + 1;
+    if (numColumns<2) numColumns = 2;
+    unsigned int numRows = numColumns;
+
+    osg::ref_ptr<osg::Vec3Array> vertices = new osg::Vec3Array;
+    vertices->reserve(numColumns*numRows);
+    for(unsigned int r=0; r<numRows; ++r)
+    {
+        for(unsigned int c=0; c<numColumns; ++c)
+        {
+            float x = float(c)/float(numColumns-1);
+            float y = float(r)/float(numRows-1);
+            float z = 0.05f*sinf(x*20.0f)*cosf(y*15.0f) + 0.02f*float(rand())/float(RAND_MAX);
+            vertices->push_back(osg::Vec3(x, y, z));
+        }
+    }
+
+    osg::ref_ptr<osg::DrawElementsUInt> elements = new osg::DrawElementsUInt(GL_TRIANGLES);
+    elements->reserve((numColumns-1)*(numRows-1)*6);
+    for(unsigned int r=0; r<numRows-1; ++r)
+    {
+        for(unsigned int c=0; c<numColumns-1; ++c)
+        {
+            unsigned int i = r*numColumns+c;
+            elements->push_back(i); elements->push_back(i+1); elements->push_back(i+numColumns);
+            elements->push_back(i+1); elements->push_back(i+numColumns+1); elements->push_back(i+numColumns);
+        }
+    }
+
+    osg::Geometry* geometry = new osg::Geometry;
+    geometry->setVertexArray(vertices.get());
+    geometry->addPrimitiveSet(elements.get());
+    return geometry;
+}
+
+static double buildKdTree(osg::Geometry* geometry, osg::KdTree::BuildOptions& options, osg::ref_ptr<osg::KdTree>& kdTree)
+{
+    osg::Timer_t startTick = osg::Timer::instance()->tick();
+    kdTree = new osg::KdTree;
+    kdTree->build(options, geometry);
+    return osg::Timer::instance()->delta_m(startTick, osg::Timer::instance()->tick());
+}
+
+typedef std::vector< std::pair<double, unsigned int> > HitList;
+
+static void collectHits(osgUtil::LineSegmentIntersector* intersector, HitList& hits)
+{
+    osgUtil::LineSegmentIntersector::Intersections& intersections = intersector->getIntersections();
+    for(osgUtil::LineSegmentIntersector::Intersections::iterator itr = intersections.begin();
+        itr != intersections.end();
+        ++itr)
+    {
+        hits.push_back(std::pair<double, unsigned int>(itr->ratio, itr->primitiveIndex));
+    }
+}
+
+static double runQueries(osg::Geometry* geometry, osg::KdTree* kdTree, const std::vector<osg::Vec3>& segments, std::vector<HitList>& hits)
+{
+    geometry->setShape(kdTree);
+
+    hits.clear();
+    hits.resize(segments.size()/2);
+
+    osg::Timer_t startTick = osg::Timer::instance()->tick();
+    for(unsigned int i=0; i+1<segments.size(); i+=2)
+    {
+        osg::ref_ptr<osgUtil::LineSegmentIntersector> intersector = new osgUtil::LineSegmentIntersector(segments[i], segments[i+1]);
+        osgUtil::IntersectionVisitor iv(intersector.get());
+        geometry->accept(iv);
+        collectHits(intersector.get(), hits[i/2]);
+    }
+    return osg::Timer::instance()->delta_m(startTick, osg::Timer::instance()->tick());
+}
+
+// run the same queries through IntersectorGroups so the segments are traversed through the KdTree as packets.
+static double runBatchQueries(osg::Geometry* geometry, osg::KdTree* kdTree, const std::vector<osg::Vec3>& segments, unsigned int batchSize, unsigned int numThreads, std::vector<HitList>& hits)
+{
+    geometry->setShape(kdTree);
+
+    hits.clear();
+    hits.resize(segments.size()/2);
+
+    osg::Timer_t startTick = osg::Timer::instance()->tick();
+    for(unsigned int first=0; first+1<segments.size(); first+=batchSize*2)
+    {
+        osg::ref_ptr<osgUtil::IntersectorGroup> group = new osgUtil::IntersectorGroup;
+        for(unsigned int i=first; i+1<segments.size() && i<first+batchSize*2; i+=2)
+        {
+            group->addIntersector(new osgUtil::LineSegmentIntersector(segments[i], segments[i+1]));
+        }
+
+        osgUtil::IntersectionVisitor iv(group.get());
+        iv.setNumThreads(numThreads);
+        iv.computeIntersections(*geometry);
+
+        osgUtil::IntersectorGroup::Intersectors& intersectors = group->getIntersectors();
+        for(unsigned int i=0; i<intersectors.size(); ++i)
+        {
+            collectHits(static_cast<osgUtil::LineSegmentIntersector*>(intersectors[i].get()), hits[first/2+i]);
+        }
+    }
+    return osg::Timer::instance()->delta_m(startTick, osg::Timer::instance()->tick());
+}
+
+static unsigned int countHits(const std::vector<HitList>& hits)
+{
+    unsigned int numHits = 0;
+    for(unsigned int i=0; i<hits.size(); ++i) numHits += hits[i].size();
+    return numHits;
+}
+
+void runKdTreeBenchmark(unsigned int numTriangles)
+{
+    srand(1);
+
+    osg::ref_ptr<osg::Geometry> geometry = createTerrainGeometry(numTriangles);
+
+    // a mix of vertical and oblique segments across the terrain.
+    unsigned int numQueries = 100000;
+    std::vector<osg::Vec3> segments;
+    segments.reserve(numQueries*2);
+    for(unsigned int i=0; i<numQueries; ++i)
+    {
+        osg::Vec3 start(float(rand())/float(RAND_MAX), float(rand())/float(RAND_MAX), 1.0f);
+        osg::Vec3 end = start - osg::Vec3(0.0f, 0.0f, 2.0f);
+        if (i%2) end += osg::Vec3(float(rand())/float(RAND_MAX)-0.5f, float(rand())/float(RAND_MAX)-0.5f, 0.0f);
+        segments.push_back(start);
+        segments.push_back(end);
+    }
+
+    osg::KdTree::BuildOptions midpointOptions;
+
+    osg::KdTree::BuildOptions sahOptions;
+    sahOptions._splitMethod = osg::KdTree::BuildOptions::SAH_SPLIT;
+
+    osg::KdTree::BuildOptions sahThreadedOptions = sahOptions;
+    sahThreadedOptions._numThreads = 4;
+
+    struct Run { const char* name; osg::KdTree::BuildOptions* options; };
+    Run runs[] = { { "midpoint", &midpointOptions }, { "SAH", &sahOptions }, { "SAH 4 threads", &sahThreadedOptions } };
+
+    std::cout<<"KdTree benchmark, "<<numTriangles<<" triangles, "<<numQueries<<" line segment queries"<<std::endl;
+
+    for(unsigned int r=0; r<sizeof(runs)/sizeof(Run); ++r)
+    {
+        osg::ref_ptr<osg::KdTree> kdTree;
+        double buildTime = buildKdTree(geometry.get(), *runs[r].options, kdTree);
+
+        std::vector<HitList> hits;
+        double queryTime = runQueries(geometry.get(), kdTree.get(), segments, hits);
+
+        std::cout<<"  "<<runs[r].name<<": build "<<buildTime<<"ms, "<<kdTree->getNodes().size()<<" nodes, queries "<<queryTime<<"ms ("
+                 <<double(numQueries)/(queryTime*0.001)<<" per second), "<<countHits(hits)<<" hits"<<std::endl;
+
+        struct Batch { unsigned int batchSize; unsigned int numThreads; };
+        Batch batches[] = { { 64, 1 }, { numQueries, 1 }, { numQueries, 4 } };
+
+        for(unsigned int b=0; b<sizeof(batches)/sizeof(Batch); ++b)
+        {
+            std::vector<HitList> batchHits;
+            double batchQueryTime = runBatchQueries(geometry.get(), kdTree.get(), segments, batches[b].batchSize, batches[b].numThreads, batchHits);
+
+            std::cout<<"  "<<runs[r].name<<": batches of "<<batches[b].batchSize<<" on "<<batches[b].numThreads<<" threads "<<batchQueryTime<<"ms ("
+                     <<double(numQueries)/(batchQueryTime*0.001)<<" per second), "<<countHits(batchHits)<<" hits, "
+                     <<(batchHits==hits ? "identical" : "DIFFERENT")<<" to the single segment queries"<<std::endl;
+        }
+    }
+}
@@ -0,0 +1,161 @@
+/* OpenSceneGraph example, osgunittests.
+*
+*  Permission is hereby granted, free of charge, to any person obtaining a copy
+*  of this software and associated documentation files (the "Software"), to deal
+*  in the Software without restriction, including without limitation the rights
+*  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+*  copies of the Software, and to permit persons to whom the Software is
+*  furnished to do so, subject to the following conditions:
+*
+*  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+*  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+*  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+*  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+*  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+*  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+*  THE SOFTWARE.
+*/
+
+#include "OBJReaderBenchmark.h"
+
+#include <osg/Geode>
+#include <osg/Geometry>
+#include <osg/NodeVisitor>
+#include <osg/Timer>
+#include <osg/TriangleIndexFunctor>
+#include <osgDB/ReadFile>
+
+#include <math.h>
+#include <stdio.h>
+#include <iostream>
+
+// write a wavy grid of quads with texcoords and normals, split across two groups and materials as photogrammetry exports are,
+// returning the size of the file or -1 if it couldn't be written.
+static long writeGridOBJ(const std::string& filename, const std::string& materialFilename, unsigned int numTriangles)
+{
+    FILE* file = fopen(materialFilename.c_str(), "w");
+    if (!file) return -1;
+    fprintf(file, "newmtl first\nKd 0.8 0.6 0.4\n\nnewmtl second\nKd 0.4 0.6 0.8\n");
+    fclose(file);
+
+    file = fopen(filename.c_str(), "w");
+    if (!file) return -1;
+
+    unsigned int numColumns = static_cast<unsigned int>(sqrt(double(numTriangles)/2.0));
+    if (numColumns<2) numColumns = 2;
+    unsigned int numRows = numColumns;
+
+    fprintf(file, "# osgunittests OBJ reader benchmark\nmtllib %s\n", materialFilename.c_str());
+    for(unsigned int r=0; r<=numRows; ++r)
+    {
+        for(unsigned int c=0; c<=numColumns; ++c)
+        {
+            double x = double(c)/double(numColumns);
+            double y = double(r)/double(numRows);
+            double z = 0.02*sin(x*40.0)*cos(y*30.0);
+            fprintf(file, "v %.6f %.6f %.6f\n", x*100.0, y*100.0, z*100.0);
+            fprintf(file, "vt %.6f %.6f\n", x, y);
+            fprintf(file, "vn %.6f %.6f %.6f\n", -0.8*cos(x*40.0)*cos(y*30.0), 0.6*sin(x*40.0)*sin(y*30.0), 1.0);
+        }
+    }
+
+    for(unsigned int r=0; r<numRows; ++r)
+    {
+        if (r==0) fprintf(file, "g lower\nusemtl first\n");
+        if (r==numRows/2) fprintf(file, "g upper\nusemtl second\n");
+
+        for(unsigned int c=0; c<numColumns; ++c)
+        {
+            unsigned int i0 = 1 + r*(numColumns+1) + c;
+            unsigned int i1 = i0+1;
+            unsigned int i2 = i1+numColumns+1;
+            unsigned int i3 = i0+numColumns+1;
+            fprintf(file, "f %u/%u/%u %u/%u/%u %u/%u/%u %u/%u/%u\n", i0,i0,i0, i1,i1,i1, i2,i2,i2, i3,i3,i3);
+        }
+    }
+
+    long size = ftell(file);
+    fclose(file);
+    return size;
+}
+
+struct CountGeometry : public osg::NodeVisitor
+{
+    struct CountTriangles
+    {
+        CountTriangles(): _numTriangles(0) {}
+        void operator() (unsigned int, unsigned int, unsigned int) { ++_numTriangles; }
+        unsigned int _numTriangles;
+    };
+
+    CountGeometry():
+        osg::NodeVisitor(osg::NodeVisitor::TRAVERSE_ALL_CHILDREN),
+        _numGeometries(0),
+        _numVertices(0),
+        _numTriangles(0) {}
+
+    void apply(osg::Geode& geode)
+    {
+        for(unsigned int i=0; i<geode.getNumDrawables(); ++i)
+        {
+            osg::Geometry* geometry = geode.getDrawable(i)->asGeometry();
+            if (!geometry || !geometry->getVertexArray()) continue;
+
+            osg::TriangleIndexFunctor<CountTriangles> counter;
+            geometry->accept(counter);
+
+            ++_numGeometries;
+            _numVertices += geometry->getVertexArray()->getNumElements();
+            _numTriangles += counter._numTriangles;
+        }
+    }
+
+    unsigned int _numGeometries;
+    unsigned int _numVertices;
+    unsigned int _numTriangles;
+};
+
+static void readOBJ(const char* name, const std::string& filename, const std::string& optionString)
+{
+    osg::ref_ptr<osgDB::Options> options = new osgDB::Options(optionString);
+
+    osg::Timer_t start = osg::Timer::instance()->tick();
+    osg::ref_ptr<osg::Node> node = osgDB::readRefNodeFile(filename, options.get());
+    double readTime = osg::Timer::instance()->delta_m(start, osg::Timer::instance()->tick());
+
+    if (!node)
+    {
+        std::cout<<"    "<<name<<" failed to read "<<filename<<std::endl;
+        return;
+    }
+
+    CountGeometry counter;
+    node->accept(counter);
+
+    std::cout<<"    "<<name<<" "<<readTime<<"ms, "<<counter._numGeometries<<" geometries, "
+             <<counter._numVertices<<" vertices, "<<counter._numTriangles<<" triangles, bound radius "<<node->getBound().radius()<<std::endl;
+}
+
+void runOBJReaderBenchmark(unsigned int numTriangles)
+{
+    std::string filename("osgunittests_benchmark.obj");
+    std::string materialFilename("osgunittests_benchmark.mtl");
+    long size = writeGridOBJ(filename, materialFilename, numTriangles);
+    if (size<0)
+    {
+        std::cout<<"Unable to write "<<filename<<std::endl;
+        return;
+    }
+
+    std::cout<<"OBJ reader on a grid of "<<numTriangles<<" triangles, "<<size/1024<<"kb"<<std::endl;
+
+    // without tessellation and tri stripping, so that the times are those of parsing and building the geometry.
+    readOBJ("stream reader, no post processing  ", filename, "noTesselateLargePolygons noTriStripPolygons");
+    readOBJ("parallel reader, no post processing", filename, "noTesselateLargePolygons noTriStripPolygons parallelRead");
+
+    readOBJ("stream reader                      ", filename, "");
+    readOBJ("parallel reader                    ", filename, "parallelRead");
+
+    remove(filename.c_str());
+    remove(materialFilename.c_str());
+}
@@ -0,0 +1,198 @@
+/* OpenSceneGraph example, osgunittests.
+*
+*  Permission is hereby granted, free of charge, to any person obtaining a copy
+*  of this software and associated documentation files (the "Software"), to deal
+*  in the Software without restriction, including without limitation the rights
+*  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+*  copies of the Software, and to permit persons to whom the Software is
+*  furnished to do so, subject to the following conditions:
+*
+*  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+*  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+*  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+*  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+*  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+*  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+*  THE SOFTWARE.
+*/
+
+#include "OperationQueueBenchmark.h"
+
+#include <osg/OperationThread>
+#include <osg/Timer>
+
+#include <OpenThreads/Thread>
+
+#include <iostream>
+#include <vector>
+
+// operation recording which producer posted it and in what order, so the consumer can check the per producer ordering.
+class CountOperation : public osg::Operation
+{
+public:
+
+    CountOperation(unsigned int producer, unsigned int sequence, OpenThreads::Atomic& count):
+        osg::Operation("count", false),
+        _producer(producer),
+        _sequence(sequence),
+        _count(count) {}
+
+    virtual void operator () (osg::Object*) { ++_count; }
+
+    unsigned int            _producer;
+    unsigned int            _sequence;
+    OpenThreads::Atomic&    _count;
+};
+
+class KeepOperation : public osg::Operation
+{
+public:
+
+    KeepOperation(OpenThreads::Atomic& count):
+        osg::Operation("keep", true),
+        _count(count) {}
+
+    virtual void operator () (osg::Object*) { ++_count; }
+
+    OpenThreads::Atomic&    _count;
+};
+
+class ProducerThread : public OpenThreads::Thread
+{
+public:
+
+    ProducerThread(osg::OperationQueue* queue, unsigned int producer, unsigned int numOperations, OpenThreads::Atomic& count):
+        _queue(queue),
+        _producer(producer),
+        _numOperations(numOperations),
+        _count(count) {}
+
+    virtual void run()
+    {
+        // create the operations up front so the timing is of the queue rather than the allocator.
+        std::vector< osg::ref_ptr<osg::Operation> > operations;
+        operations.reserve(_numOperations);
+        for(unsigned int i=0; i<_numOperations; ++i)
+        {
+            operations.push_back(new CountOperation(_producer, i, _count));
+        }
+
+        for(unsigned int i=0; i<_numOperations; ++i)
+        {
+            _queue->add(operations[i].get());
+        }
+    }
+
+    osg::OperationQueue*    _queue;
+    unsigned int            _producer;
+    unsigned int            _numOperations;
+    OpenThreads::Atomic&    _count;
+};
+
+// post numOperations from numProducers threads, then take and run them on the calling thread, returning the time taken by each phase.
+static void runProducers(osg::OperationQueue* queue, unsigned int numProducers, unsigned int numOperations, double& addTime, double& runTime, bool& ordered)
+{
+    OpenThreads::Atomic count;
+    unsigned int numPerProducer = numOperations/numProducers;
+    unsigned int total = numPerProducer*numProducers;
+
+    std::vector<unsigned int> nextSequence(numProducers, 0);
+    ordered = true;
+
+    std::vector<ProducerThread*> producers;
+    for(unsigned int i=0; i<numProducers; ++i)
+    {
+        producers.push_back(new ProducerThread(queue, i, numPerProducer, count));
+    }
+
+    osg::Timer_t startTick = osg::Timer::instance()->tick();
+
+    for(unsigned int i=0; i<numProducers; ++i)
+    {
+        producers[i]->start();
+    }
+
+    for(unsigned int i=0; i<numProducers; ++i)
+    {
+        producers[i]->join();
+        delete producers[i];
+    }
+
+    osg::Timer_t addTick = osg::Timer::instance()->tick();
+
+    unsigned int numTaken = 0;
+    while(osg::ref_ptr<osg::Operation> operation = queue->getNextOperation())
+    {
+        CountOperation* co = dynamic_cast<CountOperation*>(operation.get());
+        if (co)
+        {
+            if (co->_sequence!=nextSequence[co->_producer]) ordered = false;
+            nextSequence[co->_producer] = co->_sequence+1;
+            ++numTaken;
+        }
+
+        (*operation)(0);
+    }
+
+    osg::Timer_t runTick = osg::Timer::instance()->tick();
+
+    if (numTaken!=total || static_cast<unsigned int>(count)!=total) ordered = false;
+
+    addTime = osg::Timer::instance()->delta_m(startTick, addTick);
+    runTime = osg::Timer::instance()->delta_m(addTick, runTick);
+}
+
+// check that kept operations are rerun, run in order with the rest, and can be removed by name.
+static bool testKeepAndRemove(osg::OperationQueue* queue)
+{
+    OpenThreads::Atomic count;
+    OpenThreads::Atomic keepCount;
+
+    osg::ref_ptr<osg::Operation> keep = new KeepOperation(keepCount);
+    queue->add(new CountOperation(0, 0, count));
+    queue->add(keep.get());
+    queue->add(new CountOperation(0, 1, count));
+
+    bool passed = true;
+
+    // first pass runs all three, the second just the kept operation.
+    queue->runOperations();
+    passed = passed && static_cast<unsigned int>(count)==2 && static_cast<unsigned int>(keepCount)==1;
+
+    queue->runOperations();
+    passed = passed && static_cast<unsigned int>(keepCount)==2 && queue->getNumOperationsInQueue()==1;
+
+    queue->add(new CountOperation(0, 2, count));
+    osg::ref_ptr<osg::Operation> first = queue->getNextOperation();
+    osg::ref_ptr<osg::Operation> second = queue->getNextOperation();
+    passed = passed && first==keep && second.valid() && second->getName()=="count";
+
+    queue->add(new CountOperation(0, 3, count));
+    queue->remove("keep");
+    queue->remove("count");
+    passed = passed && queue->empty() && !queue->getNextOperation();
+
+    return passed;
+}
+
+void runOperationQueueBenchmark(unsigned int numOperations)
+{
+    const unsigned int numProducers = 4;
+
+    for(unsigned int i=0; i<3; ++i)
+    {
+        // default list queue, lock free queue large enough for all the operations, and one small enough to exercise the fallback to the list.
+        unsigned int lockFreeSize = (i==0) ? 0 : (i==1 ? numOperations : 64);
+        osg::ref_ptr<osg::OperationQueue> queue = (lockFreeSize>0) ? new osg::OperationQueue(lockFreeSize) : new osg::OperationQueue;
+
+        bool keepPassed = testKeepAndRemove(queue.get());
+
+        double addTime, runTime;
+        bool ordered = false;
+        runProducers(queue.get(), numProducers, numOperations, addTime, runTime, ordered);
+
+        std::cout<<"OperationQueue lock free size "<<lockFreeSize<<" : "<<numProducers<<" producers adding "<<numOperations<<" operations "
+                 <<addTime<<"ms, taking and running "<<runTime<<"ms, ordered "<<(ordered ? "passed" : "FAILED")
+                 <<", keep and remove "<<(keepPassed ? "passed" : "FAILED")<<std::endl;
+    }
+}
@@ -0,0 +1,186 @@
+/* OpenSceneGraph example, osgunittests.
+*
+*  Permission is hereby granted, free of charge, to any person obtaining a copy
+*  of this software and associated documentation files (the "Software"), to deal
+*  in the Software without restriction, including without limitation the rights
+*  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+*  copies of the Software, and to permit persons to whom the Software is
+*  furnished to do so, subject to the following conditions:
+*
+*  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+*  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+*  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+*  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+*  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+*  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+*  THE SOFTWARE.
+*/
+
+#include "ParticleBenchmark.h"
+
+#include <osg/NodeVisitor>
+#include <osg/Timer>
+#include <osgParticle/AccelOperator>
+#include <osgParticle/AngularAccelOperator>
+#include <osgParticle/AngularDampingOperator>
+#include <osgParticle/DampingOperator>
+#include <osgParticle/ExplosionOperator>
+#include <osgParticle/FluidFrictionOperator>
+#include <osgParticle/ForceOperator>
+#include <osgParticle/ModularProgram>
+#include <osgParticle/OrbitOperator>
+#include <osgParticle/ParticleSystem>
+
+#include <stdlib.h>
+#include <string.h>
+#include <iostream>
+
+// ModularProgram whose operators can be run without an update traversal.
+class TestProgram : public osgParticle::ModularProgram
+{
+public:
+    TestProgram(osgParticle::ParticleSystem* ps)
+    {
+        setParticleSystem(ps);
+        setReferenceFrame(ABSOLUTE_RF);
+    }
+
+    // run the operators as the update traversal does, over arrays where the operators support them.
+    void run(double dt) { execute(dt); }
+
+    // run each operator over the Particle objects, as ModularProgram did before it gathered arrays.
+    void runOnParticles(double dt)
+    {
+        for(int i=0; i<numOperators(); ++i)
+        {
+            getOperator(i)->beginOperate(this);
+            getOperator(i)->operateParticles(getParticleSystem(), dt);
+            getOperator(i)->endOperate();
+        }
+    }
+};
+
+// operator without an array kernel, so the arrays have to be written back before and gathered again after it.
+class SpinOperator : public osgParticle::Operator
+{
+public:
+    SpinOperator() {}
+    SpinOperator(const SpinOperator& copy, const osg::CopyOp& copyop = osg::CopyOp::SHALLOW_COPY): osgParticle::Operator(copy, copyop) {}
+
+    META_Object(osgParticle, SpinOperator);
+
+    virtual void operate(osgParticle::Particle* P, double dt)
+    {
+        const osg::Vec3& v = P->getVelocity();
+        P->setVelocity(osg::Vec3(v.x()-v.y()*dt, v.y()+v.x()*dt, v.z()));
+    }
+};
+
+static osgParticle::ParticleSystem* createParticleSystem(unsigned int numParticles)
+{
+    srand(1);
+
+    osgParticle::ParticleSystem* ps = new osgParticle::ParticleSystem;
+    for(unsigned int i=0; i<numParticles; ++i)
+    {
+        osgParticle::Particle* P = ps->createParticle(0);
+        P->setPosition(osg::Vec3(float(rand()%2000)*0.01f-10.0f, float(rand()%2000)*0.01f-10.0f, float(rand()%2000)*0.01f));
+        P->setVelocity(osg::Vec3(float(rand()%200)*0.01f-1.0f, float(rand()%200)*0.01f-1.0f, float(rand()%200)*0.01f));
+        P->setAngularVelocity(osg::Vec3(float(rand()%200)*0.01f, 0.0f, float(rand()%200)*0.01f));
+        P->setRadius(0.05f+float(rand()%100)*0.001f);
+        P->setMass(0.01f+float(rand()%100)*0.001f);
+
+        // some dead particles among the alive ones.
+        if (i%7==3) P->kill();
+    }
+
+    osg::NodeVisitor nv;
+    ps->update(0.0, nv);
+
+    return ps;
+}
+
+static void addOperators(osgParticle::ModularProgram* program, bool spin)
+{
+    osgParticle::AccelOperator* accel = new osgParticle::AccelOperator;
+    accel->setToGravity();
+    program->addOperator(accel);
+
+    osgParticle::ForceOperator* force = new osgParticle::ForceOperator;
+    force->setForce(osg::Vec3(0.01f, 0.0f, 0.0f));
+    program->addOperator(force);
+
+    program->addOperator(new osgParticle::FluidFrictionOperator);
+
+    if (spin) program->addOperator(new SpinOperator);
+
+    osgParticle::DampingOperator* damping = new osgParticle::DampingOperator;
+    damping->setDamping(0.9f);
+    damping->setCutoff(0.0f, 4.0f);
+    program->addOperator(damping);
+
+    osgParticle::AngularAccelOperator* angularAccel = new osgParticle::AngularAccelOperator;
+    angularAccel->setAngularAcceleration(osg::Vec3(0.0f, 0.5f, 0.0f));
+    program->addOperator(angularAccel);
+
+    osgParticle::AngularDampingOperator* angularDamping = new osgParticle::AngularDampingOperator;
+    angularDamping->setDamping(0.8f);
+    program->addOperator(angularDamping);
+
+    osgParticle::OrbitOperator* orbit = new osgParticle::OrbitOperator;
+    orbit->setMagnitude(0.5f);
+    orbit->setMaxRadius(8.0f);
+    program->addOperator(orbit);
+
+    osgParticle::ExplosionOperator* explosion = new osgParticle::ExplosionOperator;
+    explosion->setRadius(5.0f);
+    program->addOperator(explosion);
+}
+
+static bool sameParticles(osgParticle::ParticleSystem* lhs, osgParticle::ParticleSystem* rhs)
+{
+    if (lhs->numParticles()!=rhs->numParticles()) return false;
+    for(int i=0; i<lhs->numParticles(); ++i)
+    {
+        const osgParticle::Particle* l = lhs->getParticle(i);
+        const osgParticle::Particle* r = rhs->getParticle(i);
+        if (memcmp(l->getVelocity().ptr(), r->getVelocity().ptr(), sizeof(osg::Vec3))!=0 ||
+            memcmp(l->getAngularVelocity().ptr(), r->getAngularVelocity().ptr(), sizeof(osg::Vec3))!=0) return false;
+    }
+    return true;
+}
+
+static bool runOperators(const char* name, unsigned int numParticles, bool spin)
+{
+    osg::ref_ptr<osgParticle::ParticleSystem> arrayPS = createParticleSystem(numParticles);
+    osg::ref_ptr<osgParticle::ParticleSystem> particlePS = createParticleSystem(numParticles);
+
+    osg::ref_ptr<TestProgram> arrayProgram = new TestProgram(arrayPS.get());
+    addOperators(arrayProgram.get(), spin);
+
+    osg::ref_ptr<TestProgram> particleProgram = new TestProgram(particlePS.get());
+    addOperators(particleProgram.get(), spin);
+
+    const unsigned int numFrames = 10;
+    const double dt = 0.016;
+
+    osg::Timer_t start = osg::Timer::instance()->tick();
+    for(unsigned int i=0; i<numFrames; ++i) particleProgram->runOnParticles(dt);
+    double particleTime = osg::Timer::instance()->delta_m(start, osg::Timer::instance()->tick())/double(numFrames);
+
+    start = osg::Timer::instance()->tick();
+    for(unsigned int i=0; i<numFrames; ++i) arrayProgram->run(dt);
+    double arrayTime = osg::Timer::instance()->delta_m(start, osg::Timer::instance()->tick())/double(numFrames);
+
+    bool passed = sameParticles(arrayPS.get(), particlePS.get());
+
+    std::cout<<(passed ? "pass" : "fail")<<"    "<<name<<": "<<numParticles<<" particles, "<<arrayProgram->numOperators()<<" operators, "
+             <<particleTime<<"ms per frame on particles, "<<arrayTime<<"ms on arrays"<<std::endl;
+    return passed;
+}
+
+void runParticleBenchmark(unsigned int numParticles)
+{
+    runOperators("built-in operators", numParticles, false);
+    runOperators("with an operator on particles", numParticles, true);
+}
@@ -0,0 +1,157 @@
+/* OpenSceneGraph example, osgunittests.
+*
+*  Permission is hereby granted, free of charge, to any person obtaining a copy
+*  of this software and associated documentation files (the "Software"), to deal
+*  in the Software without restriction, including without limitation the rights
+*  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+*  copies of the Software, and to permit persons to whom the Software is
+*  furnished to do so, subject to the following conditions:
+*
+*  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+*  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+*  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+*  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+*  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+*  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+*  THE SOFTWARE.
+*/
+
+#include "RenderBinBenchmark.h"
+
+#include <osg/Geometry>
+#include <osg/Program>
+#include <osg/Texture2D>
+#include <osg/Timer>
+#include <osgUtil/RenderBin>
+#include <osgUtil/StateGraph>
+
+#include <stdlib.h>
+#include <algorithm>
+#include <iostream>
+#include <vector>
+
+struct ReferenceFrontToBackSortFunctor
+{
+    bool operator() (const osgUtil::RenderLeaf* lhs,const osgUtil::RenderLeaf* rhs) const { return lhs->_depth<rhs->_depth; }
+};
+
+struct ReferenceBackToFrontSortFunctor
+{
+    bool operator() (const osgUtil::RenderLeaf* lhs,const osgUtil::RenderLeaf* rhs) const { return rhs->_depth<lhs->_depth; }
+};
+
+static void fillRenderBin(osgUtil::RenderBin* bin, std::vector< osg::ref_ptr<osgUtil::StateGraph> >& stateGraphs)
+{
+    bin->reset();
+    for(std::vector< osg::ref_ptr<osgUtil::StateGraph> >::iterator itr = stateGraphs.begin(); itr != stateGraphs.end(); ++itr)
+    {
+        bin->addStateGraph(itr->get());
+    }
+}
+
+// time the RenderBin sort in the given mode and check the resulting depth order against std::sort with the original comparator.
+template<class Comparator>
+static void runDepthSort(const char* name, osgUtil::RenderBin::SortMode mode, const Comparator& comparator, osgUtil::RenderBin* bin,
+                         std::vector< osg::ref_ptr<osgUtil::StateGraph> >& stateGraphs, const std::vector<osgUtil::RenderLeaf*>& allLeaves)
+{
+    const unsigned int numRuns = 10;
+
+    std::vector<osgUtil::RenderLeaf*> reference;
+    osg::Timer_t start = osg::Timer::instance()->tick();
+    for(unsigned int run=0; run<numRuns; ++run)
+    {
+        reference = allLeaves;
+        std::sort(reference.begin(), reference.end(), comparator);
+    }
+    double referenceTime = osg::Timer::instance()->delta_m(start, osg::Timer::instance()->tick())/double(numRuns);
+
+    bin->setSortMode(mode);
+    double sortTime = 0.0;
+    for(unsigned int run=0; run<numRuns; ++run)
+    {
+        fillRenderBin(bin, stateGraphs);
+        start = osg::Timer::instance()->tick();
+        bin->sort();
+        sortTime += osg::Timer::instance()->delta_m(start, osg::Timer::instance()->tick());
+    }
+    sortTime /= double(numRuns);
+
+    const osgUtil::RenderBin::RenderLeafList& sorted = bin->getRenderLeafList();
+    bool matches = sorted.size()==reference.size();
+    for(unsigned int i=0; matches && i<sorted.size(); ++i)
+    {
+        matches = sorted[i]->_depth==reference[i]->_depth;
+    }
+
+    std::cout<<"  "<<name<<": std::sort "<<referenceTime<<"ms, RenderBin::sort() "<<sortTime<<"ms, "
+             <<(matches ? "same depth order" : "DEPTH ORDER DIFFERS")<<std::endl;
+}
+
+void runRenderBinBenchmark(unsigned int numLeaves)
+{
+    srand(1);
+
+    osg::ref_ptr<osg::Geometry> geometry = new osg::Geometry;
+    osg::ref_ptr<osg::RefMatrix> projection = new osg::RefMatrix;
+    osg::ref_ptr<osg::RefMatrix> modelview = new osg::RefMatrix;
+
+    std::vector< osg::ref_ptr<osg::Program> > programs;
+    for(unsigned int i=0; i<4; ++i) programs.push_back(new osg::Program);
+
+    std::vector< osg::ref_ptr<osg::Texture2D> > textures;
+    for(unsigned int i=0; i<16; ++i) textures.push_back(new osg::Texture2D);
+
+    // a StateGraph per program/texture combination, with leaves at random depths spread across them.
+    osg::ref_ptr<osgUtil::StateGraph> root = new osgUtil::StateGraph;
+    std::vector< osg::ref_ptr<osgUtil::StateGraph> > stateGraphs;
+    for(unsigned int p=0; p<programs.size(); ++p)
+    {
+        osg::ref_ptr<osg::StateSet> programStateSet = new osg::StateSet;
+        programStateSet->setAttribute(programs[p].get());
+        osgUtil::StateGraph* programGraph = root->find_or_insert(programStateSet.get());
+
+        for(unsigned int t=0; t<textures.size(); ++t)
+        {
+            osg::ref_ptr<osg::StateSet> textureStateSet = new osg::StateSet;
+            textureStateSet->setTextureAttribute(0, textures[t].get());
+            stateGraphs.push_back(programGraph->find_or_insert(textureStateSet.get()));
+        }
+    }
+
+    std::vector< osg::ref_ptr<osgUtil::RenderLeaf> > leaves;
+    std::vector<osgUtil::RenderLeaf*> allLeaves;
+    for(unsigned int i=0; i<numLeaves; ++i)
+    {
+        float depth = 1.0f + 1000.0f*float(rand())/float(RAND_MAX);
+        osgUtil::RenderLeaf* leaf = new osgUtil::RenderLeaf(geometry.get(), projection.get(), modelview.get(), depth, i);
+        leaves.push_back(leaf);
+        stateGraphs[rand()%stateGraphs.size()]->addLeaf(leaf);
+    }
+    for(unsigned int i=0; i<stateGraphs.size(); ++i)
+    {
+        for(unsigned int l=0; l<stateGraphs[i]->_leaves.size(); ++l) allLeaves.push_back(stateGraphs[i]->_leaves[l].get());
+    }
+
+    osg::ref_ptr<osgUtil::RenderBin> bin = new osgUtil::RenderBin;
+
+    std::cout<<"  "<<numLeaves<<" RenderLeaves in "<<stateGraphs.size()<<" StateGraphs"<<std::endl;
+    runDepthSort("SORT_FRONT_TO_BACK", osgUtil::RenderBin::SORT_FRONT_TO_BACK, ReferenceFrontToBackSortFunctor(), bin.get(), stateGraphs, allLeaves);
+    runDepthSort("SORT_BACK_TO_FRONT", osgUtil::RenderBin::SORT_BACK_TO_FRONT, ReferenceBackToFrontSortFunctor(), bin.get(), stateGraphs, allLeaves);
+
+    // the packed key sort groups by program then texture, count the state changes the draw would see.
+    bin->setSortMode(osgUtil::RenderBin::SORT_BY_PROGRAM_TEXTURE_DEPTH);
+    fillRenderBin(bin.get(), stateGraphs);
+    osg::Timer_t start = osg::Timer::instance()->tick();
+    bin->sort();
+    double sortTime = osg::Timer::instance()->delta_m(start, osg::Timer::instance()->tick());
+
+    const osgUtil::RenderBin::RenderLeafList& sorted = bin->getRenderLeafList();
+    unsigned int numStateChanges = 0;
+    for(unsigned int i=1; i<sorted.size(); ++i)
+    {
+        if (sorted[i]->_parent!=sorted[i-1]->_parent) ++numStateChanges;
+    }
+    std::cout<<"  SORT_BY_PROGRAM_TEXTURE_DEPTH: RenderBin::sort() "<<sortTime<<"ms, "<<numStateChanges<<" StateGraph changes across "<<sorted.size()<<" leaves"<<std::endl;
+
+    for(unsigned int i=0; i<stateGraphs.size(); ++i) stateGraphs[i]->_leaves.clear();
+}
@@ -0,0 +1,138 @@
+/* OpenSceneGraph example, osgunittests.
+*
+*  Permission is hereby granted, free of charge, to any person obtaining a copy
+*  of this software and associated documentation files (the "Software"), to deal
+*  in the Software without restriction, including without limitation the rights
+*  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+*  copies of the Software, and to permit persons to whom the Software is
+*  furnished to do so, subject to the following conditions:
+*
+*  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+*  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+*  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+*  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+*  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+*  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+*  THE SOFTWARE.
+*/
+
+#include "SimplifierBenchmark.h"
+
+#include <osg/Geometry>
+#include <osg/Timer>
+#include <osg/TriangleIndexFunctor>
+#include <osgUtil/Simplifier>
+
+#include <math.h>
+#include <iostream>
+
+// radius of the bumpy sphere in the direction of unit vector d.
+static double bumpyRadius(const osg::Vec3d& d)
+{
+    return 1.0 + 0.05*sin(7.0*atan2(d.y(), d.x()))*sin(5.0*acos(osg::clampBetween(d.z(), -1.0, 1.0)));
+}
+
+// latitude/longitude tessellated bumpy sphere, with the poles and the longitude seam shared so that the mesh is closed.
+static osg::Geometry* createBumpySphere(unsigned int numTriangles)
+{
+    unsigned int numRows = static_cast<unsigned int>(sqrt(double(numTriangles)/4.0));
+    if (numRows<4) numRows = 4;
+    unsigned int numColumns = numRows*2;
+
+    osg::Vec3Array* vertices = new osg::Vec3Array;
+    vertices->push_back(osg::Vec3(0.0f, 0.0f, bumpyRadius(osg::Vec3d(0.0, 0.0, 1.0))));
+    for(unsigned int r=1; r<numRows; ++r)
+    {
+        double phi = osg::PI*double(r)/double(numRows);
+        for(unsigned int c=0; c<numColumns; ++c)
+        {
+            double theta = 2.0*osg::PI*double(c)/double(numColumns);
+            osg::Vec3d d(sin(phi)*cos(theta), sin(phi)*sin(theta), cos(phi));
+            vertices->push_back(d*bumpyRadius(d));
+        }
+    }
+    vertices->push_back(osg::Vec3(0.0f, 0.0f, -bumpyRadius(osg::Vec3d(0.0, 0.0, -1.0))));
+    unsigned int south = vertices->size()-1;
+
+    osg::DrawElementsUInt* triangles = new osg::DrawElementsUInt(GL_TRIANGLES);
+    for(unsigned int c=0; c<numColumns; ++c)
+    {
+        unsigned int cn = (c+1)%numColumns;
+        triangles->push_back(0); triangles->push_back(1+c); triangles->push_back(1+cn);
+
+        unsigned int last = 1+(numRows-2)*numColumns;
+        triangles->push_back(last+c); triangles->push_back(south); triangles->push_back(last+cn);
+    }
+    for(unsigned int r=0; r+2<numRows; ++r)
+    {
+        unsigned int row = 1+r*numColumns;
+        unsigned int nextRow = row+numColumns;
+        for(unsigned int c=0; c<numColumns; ++c)
+        {
+            unsigned int cn = (c+1)%numColumns;
+            triangles->push_back(row+c); triangles->push_back(nextRow+c); triangles->push_back(nextRow+cn);
+            triangles->push_back(row+c); triangles->push_back(nextRow+cn); triangles->push_back(row+cn);
+        }
+    }
+
+    osg::Geometry* geometry = new osg::Geometry;
+    geometry->setVertexArray(vertices);
+    geometry->addPrimitiveSet(triangles);
+    return geometry;
+}
+
+struct MeasureSurfaceError
+{
+    const osg::Vec3Array*   _vertices;
+    unsigned int            _numTriangles;
+    double                  _totalError;
+    double                  _maximumError;
+
+    MeasureSurfaceError(): _vertices(0), _numTriangles(0), _totalError(0.0), _maximumError(0.0) {}
+
+    void operator() (unsigned int p1, unsigned int p2, unsigned int p3)
+    {
+        osg::Vec3d centre = (osg::Vec3d((*_vertices)[p1]) + osg::Vec3d((*_vertices)[p2]) + osg::Vec3d((*_vertices)[p3]))/3.0;
+        double length = centre.length();
+        double error = fabs(length-bumpyRadius(centre/length));
+        _totalError += error;
+        _maximumError = osg::maximum(_maximumError, error);
+        ++_numTriangles;
+    }
+};
+
+static void runSimplifier(const char* name, osgUtil::Simplifier::Method method, unsigned int numTriangles, float sampleRatio)
+{
+    osg::ref_ptr<osg::Geometry> geometry = createBumpySphere(numTriangles);
+
+    osgUtil::Simplifier simplifier(sampleRatio);
+    simplifier.setMethod(method);
+    simplifier.setSmoothing(false);
+    simplifier.setDoTriStrip(false);
+
+    osg::Timer_t start = osg::Timer::instance()->tick();
+    simplifier.simplify(*geometry);
+    osg::Timer_t end = osg::Timer::instance()->tick();
+
+    osg::TriangleIndexFunctor<MeasureSurfaceError> measure;
+    measure._vertices = static_cast<const osg::Vec3Array*>(geometry->getVertexArray());
+    geometry->accept(measure);
+
+    std::cout<<name<<" ratio "<<sampleRatio<<" : "<<osg::Timer::instance()->delta_m(start, end)<<"ms, "
+             <<measure._numTriangles<<" triangles, surface error of triangle centres mean "
+             <<(measure._numTriangles>0 ? measure._totalError/double(measure._numTriangles) : 0.0)
+             <<" maximum "<<measure._maximumError<<std::endl;
+}
+
+void runSimplifierBenchmark(unsigned int numTriangles)
+{
+    std::cout<<"Bumpy sphere of about "<<numTriangles<<" triangles"<<std::endl;
+
+    const float ratios[] = { 0.5f, 0.1f, 0.01f };
+    for(unsigned int i=0; i<3; ++i)
+    {
+        // the point and edge set based collapse takes minutes on large meshes, so is only compared on smaller ones.
+        if (numTriangles<=200000) runSimplifier("EDGE_COLLAPSE   ", osgUtil::Simplifier::EDGE_COLLAPSE, numTriangles, ratios[i]);
+        runSimplifier("QUADRIC_COLLAPSE", osgUtil::Simplifier::QUADRIC_COLLAPSE, numTriangles, ratios[i]);
+    }
+}
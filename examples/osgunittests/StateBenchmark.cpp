@@ -0,0 +1,219 @@
+/* OpenSceneGraph example, osgunittests.
+*
+*  Permission is hereby granted, free of charge, to any person obtaining a copy
+*  of this software and associated documentation files (the "Software"), to deal
+*  in the Software without restriction, including without limitation the rights
+*  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+*  copies of the Software, and to permit persons to whom the Software is
+*  furnished to do so, subject to the following conditions:
+*
+*  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+*  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+*  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+*  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+*  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+*  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+*  THE SOFTWARE.
+*/
+
+#include "StateBenchmark.h"
+
+#include <osg/State>
+#include <osg/StateSet>
+#include <osg/Timer>
+
+#include <stdlib.h>
+#include <iostream>
+#include <vector>
+
+// attribute that records how often it is applied without making any OpenGL calls, so State can be driven headlessly.
+class CountingAttribute : public osg::StateAttribute
+{
+    public:
+
+        CountingAttribute(Type type=osg::StateAttribute::MATERIAL, unsigned int member=0, bool textureAttribute=false):
+            _type(type),
+            _member(member),
+            _textureAttribute(textureAttribute) {}
+
+        CountingAttribute(const CountingAttribute& ca, const osg::CopyOp& copyop=osg::CopyOp::SHALLOW_COPY):
+            osg::StateAttribute(ca, copyop),
+            _type(ca._type),
+            _member(ca._member),
+            _textureAttribute(ca._textureAttribute) {}
+
+        virtual osg::Object* cloneType() const { return new CountingAttribute(_type, _member, _textureAttribute); }
+        virtual osg::Object* clone(const osg::CopyOp& copyop) const { return new CountingAttribute(*this, copyop); }
+        virtual bool isSameKindAs(const osg::Object* obj) const { return dynamic_cast<const CountingAttribute*>(obj)!=NULL; }
+        virtual const char* libraryName() const { return "osgunittests"; }
+        virtual const char* className() const { return "CountingAttribute"; }
+
+        virtual Type getType() const { return _type; }
+        virtual unsigned int getMember() const { return _member; }
+        virtual bool isTextureAttribute() const { return _textureAttribute; }
+
+        virtual int compare(const osg::StateAttribute& sa) const
+        {
+            if (this<&sa) return -1;
+            if (this>&sa) return 1;
+            return 0;
+        }
+
+        virtual void apply(osg::State&) const { ++s_numApplies; }
+
+        static unsigned int s_numApplies;
+
+    protected:
+
+        Type            _type;
+        unsigned int    _member;
+        bool            _textureAttribute;
+};
+
+unsigned int CountingAttribute::s_numApplies = 0;
+
+static const GLenum s_modes[] =
+{
+    GL_LIGHTING, GL_BLEND, GL_CULL_FACE, GL_DEPTH_TEST, GL_ALPHA_TEST, GL_NORMALIZE, GL_POLYGON_OFFSET_FILL,
+    GL_LIGHT0, GL_LIGHT1, GL_LIGHT2, GL_LIGHT3, GL_FOG, GL_LINE_SMOOTH, GL_POINT_SMOOTH, GL_STENCIL_TEST,
+    GL_SCISSOR_TEST, GL_LIGHT4, GL_RESCALE_NORMAL, GL_DITHER, GL_COLOR_LOGIC_OP
+};
+static const unsigned int s_numModes = sizeof(s_modes)/sizeof(GLenum);
+
+static const osg::StateAttribute::Type s_types[] =
+{
+    osg::StateAttribute::MATERIAL, osg::StateAttribute::BLENDFUNC, osg::StateAttribute::CULLFACE, osg::StateAttribute::DEPTH,
+    osg::StateAttribute::ALPHAFUNC, osg::StateAttribute::POLYGONOFFSET, osg::StateAttribute::POLYGONMODE, osg::StateAttribute::FRONTFACE,
+    osg::StateAttribute::LINEWIDTH, osg::StateAttribute::POINT, osg::StateAttribute::FOG, osg::StateAttribute::STENCIL
+};
+static const unsigned int s_numTypes = sizeof(s_types)/sizeof(osg::StateAttribute::Type);
+
+// build a StateSet with a random subset of the modes, attributes, light members and texture attributes.
+static osg::StateSet* createStateSet(const std::vector< osg::ref_ptr<osg::StateAttribute> >& attributes, const std::vector< osg::ref_ptr<osg::StateAttribute> >& textures)
+{
+    osg::ref_ptr<osg::StateSet> stateset = new osg::StateSet;
+
+    for(unsigned int i=0; i<s_numModes; ++i)
+    {
+        if (rand()%3==0) stateset->setMode(s_modes[i], (rand()%2==0) ? osg::StateAttribute::ON : osg::StateAttribute::OFF);
+    }
+
+    for(unsigned int i=0; i<s_numTypes; ++i)
+    {
+        if (rand()%3==0) stateset->setAttribute(attributes[(rand()%4)*s_numTypes+i].get());
+    }
+
+    for(unsigned int member=0; member<4; ++member)
+    {
+        if (rand()%4==0) stateset->setAttribute(new CountingAttribute(osg::StateAttribute::LIGHT, member));
+    }
+
+    for(unsigned int unit=0; unit<2; ++unit)
+    {
+        if (rand()%2==0) stateset->setTextureAttribute(unit, textures[rand()%textures.size()].get());
+    }
+
+    return stateset.release();
+}
+
+void runStateBenchmark(unsigned int numStateSets)
+{
+    srand(1);
+
+    osg::ref_ptr<osg::State> state = new osg::State;
+    state->setCheckForGLErrors(osg::State::NEVER_CHECK_GL_ERRORS);
+    state->setShaderCompositionEnabled(false);
+
+    // disable the modes so State tracks them without calling glEnable/glDisable.
+    for(unsigned int i=0; i<s_numModes; ++i)
+    {
+        state->setModeValidity(s_modes[i], false);
+    }
+
+    std::vector< osg::ref_ptr<osg::StateAttribute> > attributes;
+    for(unsigned int variant=0; variant<4; ++variant)
+    {
+        for(unsigned int i=0; i<s_numTypes; ++i)
+        {
+            attributes.push_back(new CountingAttribute(s_types[i]));
+        }
+    }
+
+    std::vector< osg::ref_ptr<osg::StateAttribute> > textures;
+    for(unsigned int i=0; i<8; ++i)
+    {
+        textures.push_back(new CountingAttribute(osg::StateAttribute::TEXTURE, 0, true));
+    }
+
+    std::vector< osg::ref_ptr<osg::StateSet> > statesets;
+    for(unsigned int i=0; i<numStateSets; ++i)
+    {
+        statesets.push_back(createStateSet(attributes, textures));
+    }
+
+    osg::ref_ptr<osg::StateSet> rootStateSet = createStateSet(attributes, textures);
+
+    std::vector<unsigned int> sequence;
+    for(unsigned int i=0; i<numStateSets*4; ++i)
+    {
+        sequence.push_back(rand()%numStateSets);
+    }
+
+    const unsigned int numFrames = 20;
+
+    // mimic RenderLeaf::render(), pushing the parent StateSet then applying the leaf StateSet.
+    CountingAttribute::s_numApplies = 0;
+    osg::Timer_t start = osg::Timer::instance()->tick();
+    for(unsigned int frame=0; frame<numFrames; ++frame)
+    {
+        state->pushStateSet(rootStateSet.get());
+        for(std::vector<unsigned int>::iterator itr = sequence.begin(); itr != sequence.end(); ++itr)
+        {
+            state->apply(statesets[*itr].get());
+        }
+        state->popStateSet();
+        state->apply();
+    }
+    double applyTime = osg::Timer::instance()->delta_s(start, osg::Timer::instance()->tick());
+    unsigned int numApplies = CountingAttribute::s_numApplies;
+
+    // mimic StateGraph traversal, pushing and popping each StateSet.
+    start = osg::Timer::instance()->tick();
+    for(unsigned int frame=0; frame<numFrames; ++frame)
+    {
+        for(std::vector<unsigned int>::iterator itr = sequence.begin(); itr != sequence.end(); ++itr)
+        {
+            state->pushStateSet(statesets[*itr].get());
+            state->apply();
+            state->popStateSet();
+        }
+    }
+    double pushPopTime = osg::Timer::instance()->delta_s(start, osg::Timer::instance()->tick());
+
+    // push and pop the StateSets against a State that has registered many more modes than each StateSet uses.
+    const unsigned int numExtraModes = 500;
+    for(unsigned int i=0; i<numExtraModes; ++i)
+    {
+        state->setModeValidity(static_cast<GLenum>(0x10000+i*7), false);
+    }
+
+    start = osg::Timer::instance()->tick();
+    for(unsigned int frame=0; frame<numFrames; ++frame)
+    {
+        for(std::vector<unsigned int>::iterator itr = sequence.begin(); itr != sequence.end(); ++itr)
+        {
+            state->pushStateSet(statesets[*itr].get());
+            state->popStateSet();
+        }
+    }
+    double manyModesTime = osg::Timer::instance()->delta_s(start, osg::Timer::instance()->tick());
+    state->popAllStateSets();
+
+    unsigned int numCalls = numFrames*static_cast<unsigned int>(sequence.size());
+    std::cout<<"  "<<numStateSets<<" StateSets, "<<numCalls<<" State::apply(StateSet*) calls in "<<applyTime*1000.0<<"ms, "
+             <<double(numCalls)/applyTime<<" per second, "<<numApplies<<" attribute applies"<<std::endl;
+    std::cout<<"  "<<numCalls<<" pushStateSet/apply/popStateSet calls in "<<pushPopTime*1000.0<<"ms, "
+             <<double(numCalls)/pushPopTime<<" per second"<<std::endl;
+    std::cout<<"  "<<numCalls<<" pushStateSet/popStateSet calls with "<<numExtraModes<<" further modes registered in "<<manyModesTime*1000.0<<"ms, "
+             <<double(numCalls)/manyModesTime<<" per second"<<std::endl;
+}
@@ -0,0 +1,217 @@
+/* OpenSceneGraph example, osgunittests.
+*
+*  Permission is hereby granted, free of charge, to any person obtaining a copy
+*  of this software and associated documentation files (the "Software"), to deal
+*  in the Software without restriction, including without limitation the rights
+*  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+*  copies of the Software, and to permit persons to whom the Software is
+*  furnished to do so, subject to the following conditions:
+*
+*  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+*  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+*  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+*  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+*  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+*  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+*  THE SOFTWARE.
+*/
+
+#include "TaskSchedulerBenchmark.h"
+
+#include <osg/TaskScheduler>
+#include <osg/Timer>
+
+#include <OpenThreads/Thread>
+
+#include <iostream>
+#include <set>
+#include <vector>
+
+// counts the number of times each index is visited, so overlapping or missing subranges show up as counts other than one.
+struct CountIndices
+{
+    CountIndices(OpenThreads::Atomic* counts): _counts(counts) {}
+
+    void operator() (unsigned int first, unsigned int last)
+    {
+        for(unsigned int i=first; i<last; ++i) ++_counts[i];
+    }
+
+    OpenThreads::Atomic* _counts;
+};
+
+static bool testParallelFor(osg::TaskScheduler* scheduler, unsigned int numElements, unsigned int grainSize)
+{
+    OpenThreads::Atomic* counts = new OpenThreads::Atomic[numElements];
+
+    CountIndices countIndices(counts);
+    osg::Timer_t start = osg::Timer::instance()->tick();
+    scheduler->parallelFor(0, numElements, countIndices, grainSize);
+    double time = osg::Timer::instance()->delta_m(start, osg::Timer::instance()->tick());
+
+    unsigned int numWrong = 0;
+    for(unsigned int i=0; i<numElements; ++i)
+    {
+        if (static_cast<unsigned int>(counts[i])!=1) ++numWrong;
+    }
+    delete [] counts;
+
+    bool passed = numWrong==0;
+    std::cout<<(passed ? "pass" : "fail")<<"    parallelFor over "<<numElements<<" indices with grain size "<<grainSize<<" in "<<time<<"ms, "
+             <<numWrong<<" indices not visited exactly once"<<std::endl;
+    return passed;
+}
+
+// spawns numChildren tasks that each spawn their own children down to depth, waiting on its own group before returning.
+class NestedTask : public osg::TaskScheduler::Task
+{
+public:
+    NestedTask(osg::TaskScheduler* scheduler, unsigned int numChildren, unsigned int depth, OpenThreads::Atomic& numLeaves):
+        _scheduler(scheduler),
+        _numChildren(numChildren),
+        _depth(depth),
+        _numLeaves(numLeaves) {}
+
+    virtual void run()
+    {
+        if (_depth==0)
+        {
+            ++_numLeaves;
+            return;
+        }
+
+        osg::ref_ptr<osg::TaskScheduler::TaskGroup> group = new osg::TaskScheduler::TaskGroup;
+        for(unsigned int i=0; i<_numChildren; ++i)
+        {
+            _scheduler->run(group.get(), new NestedTask(_scheduler, _numChildren, _depth-1, _numLeaves));
+        }
+        _scheduler->wait(group.get());
+    }
+
+protected:
+    osg::TaskScheduler*     _scheduler;
+    unsigned int            _numChildren;
+    unsigned int            _depth;
+    OpenThreads::Atomic&    _numLeaves;
+};
+
+static bool testNestedWait(osg::TaskScheduler* scheduler, unsigned int numChildren, unsigned int depth)
+{
+    OpenThreads::Atomic numLeaves;
+
+    osg::Timer_t start = osg::Timer::instance()->tick();
+    osg::ref_ptr<osg::TaskScheduler::TaskGroup> group = new osg::TaskScheduler::TaskGroup;
+    scheduler->run(group.get(), new NestedTask(scheduler, numChildren, depth, numLeaves));
+    scheduler->wait(group.get());
+    double time = osg::Timer::instance()->delta_m(start, osg::Timer::instance()->tick());
+
+    unsigned int expectedNumLeaves = 1;
+    for(unsigned int i=0; i<depth; ++i) expectedNumLeaves *= numChildren;
+
+    bool passed = static_cast<unsigned int>(numLeaves)==expectedNumLeaves;
+    std::cout<<(passed ? "pass" : "fail")<<"    nested TaskGroup wait, "<<numChildren<<" children to depth "<<depth<<" in "<<time<<"ms, "
+             <<static_cast<unsigned int>(numLeaves)<<" leaf tasks run, expected "<<expectedNumLeaves<<std::endl;
+    return passed;
+}
+
+// records the thread that ran it, sleeping briefly so that the thread which queued it is kept busy and idle workers have to steal.
+class RecordThreadTask : public osg::TaskScheduler::Task
+{
+public:
+    RecordThreadTask(OpenThreads::Thread** thread, OpenThreads::Atomic& numRun):
+        _thread(thread),
+        _numRun(numRun) {}
+
+    virtual void run()
+    {
+        *_thread = OpenThreads::Thread::CurrentThread();
+        ++_numRun;
+        OpenThreads::Thread::microSleep(200);
+    }
+
+protected:
+    OpenThreads::Thread**   _thread;
+    OpenThreads::Atomic&    _numRun;
+};
+
+// queues all the tasks on the worker running it, leaving the other workers to steal them from its queue.
+class SpawnTask : public osg::TaskScheduler::Task
+{
+public:
+    SpawnTask(osg::TaskScheduler* scheduler, std::vector<OpenThreads::Thread*>& threads, OpenThreads::Atomic& numRun, OpenThreads::Thread*& spawnThread):
+        _scheduler(scheduler),
+        _threads(threads),
+        _numRun(numRun),
+        _spawnThread(spawnThread) {}
+
+    virtual void run()
+    {
+        _spawnThread = OpenThreads::Thread::CurrentThread();
+
+        osg::ref_ptr<osg::TaskScheduler::TaskGroup> group = new osg::TaskScheduler::TaskGroup;
+        for(unsigned int i=0; i<_threads.size(); ++i)
+        {
+            _scheduler->run(group.get(), new RecordThreadTask(&_threads[i], _numRun));
+        }
+        _scheduler->wait(group.get());
+    }
+
+protected:
+    osg::TaskScheduler*                 _scheduler;
+    std::vector<OpenThreads::Thread*>&  _threads;
+    OpenThreads::Atomic&                _numRun;
+    OpenThreads::Thread*&               _spawnThread;
+};
+
+static bool testStealing(osg::TaskScheduler* scheduler, unsigned int numTasks)
+{
+    std::vector<OpenThreads::Thread*> threads(numTasks, (OpenThreads::Thread*)0);
+    OpenThreads::Atomic numRun;
+    OpenThreads::Thread* spawnThread = 0;
+
+    // load the scheduler from outside the pool at the same time, through the shared queue.
+    std::vector<OpenThreads::Thread*> sharedThreads(numTasks, (OpenThreads::Thread*)0);
+    OpenThreads::Atomic numSharedRun;
+
+    osg::Timer_t start = osg::Timer::instance()->tick();
+    osg::ref_ptr<osg::TaskScheduler::TaskGroup> group = new osg::TaskScheduler::TaskGroup;
+    scheduler->run(group.get(), new SpawnTask(scheduler, threads, numRun, spawnThread));
+    for(unsigned int i=0; i<numTasks; ++i)
+    {
+        scheduler->run(group.get(), new RecordThreadTask(&sharedThreads[i], numSharedRun));
+    }
+    scheduler->wait(group.get());
+    double time = osg::Timer::instance()->delta_m(start, osg::Timer::instance()->tick());
+
+    std::set<OpenThreads::Thread*> threadsUsed;
+    unsigned int numStolen = 0;
+    for(unsigned int i=0; i<numTasks; ++i)
+    {
+        threadsUsed.insert(threads[i]);
+        if (threads[i]!=spawnThread) ++numStolen;
+    }
+
+    // with worker threads the spawning task runs on a worker, so its tasks can only reach another thread by being stolen.
+    bool allRun = static_cast<unsigned int>(numRun)==numTasks && static_cast<unsigned int>(numSharedRun)==numTasks;
+    bool passed = allRun && (scheduler->getNumThreads()<2 || numStolen>0);
+    std::cout<<(passed ? "pass" : "fail")<<"    stealing under load, "<<static_cast<unsigned int>(numRun)<<" + "<<static_cast<unsigned int>(numSharedRun)
+             <<" of "<<numTasks<<" + "<<numTasks<<" tasks run in "<<time<<"ms, "<<numStolen<<" stolen from the spawning thread, "
+             <<threadsUsed.size()<<" threads used"<<std::endl;
+    return passed;
+}
+
+void runTaskSchedulerTest(unsigned int numThreads)
+{
+    osg::ref_ptr<osg::TaskScheduler> scheduler = new osg::TaskScheduler(numThreads);
+
+    testParallelFor(scheduler.get(), 1000003, 1);
+    testParallelFor(scheduler.get(), 1000003, 4096);
+    testParallelFor(scheduler.get(), 17, 1);
+
+    testNestedWait(scheduler.get(), 4, 7);
+    testNestedWait(scheduler.get(), 64, 2);
+
+    testStealing(scheduler.get(), 1000);
+
+    scheduler->stop();
+}
@@ -0,0 +1,211 @@
+/* OpenSceneGraph example, osgunittests.
+*
+*  Permission is hereby granted, free of charge, to any person obtaining a copy
+*  of this software and associated documentation files (the "Software"), to deal
+*  in the Software without restriction, including without limitation the rights
+*  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+*  copies of the Software, and to permit persons to whom the Software is
+*  furnished to do so, subject to the following conditions:
+*
+*  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+*  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+*  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+*  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+*  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+*  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+*  THE SOFTWARE.
+*/
+
+#include "TerrainBenchmark.h"
+
+#include <osg/FrameStamp>
+#include <osg/Timer>
+#include <osgTerrain/DisplacementMappingTechnique>
+#include <osgTerrain/Terrain>
+#include <osgUtil/SceneView>
+#include <osgUtil/StateGraph>
+
+#include <stdlib.h>
+#include <iostream>
+
+static osgTerrain::TerrainTile* createTile(unsigned int x, unsigned int y, unsigned int numVertices, unsigned int imageSize)
+{
+    osg::ref_ptr<osgTerrain::Locator> locator = new osgTerrain::Locator;
+    locator->setCoordinateSystemType(osgTerrain::Locator::PROJECTED);
+    locator->setTransformAsExtents(double(x), double(y), double(x+1), double(y+1));
+
+    osg::ref_ptr<osg::HeightField> hf = new osg::HeightField;
+    hf->allocate(numVertices, numVertices);
+    for(unsigned int r=0; r<numVertices; ++r)
+    {
+        for(unsigned int c=0; c<numVertices; ++c)
+        {
+            hf->setHeight(c, r, 0.05f*float(rand())/float(RAND_MAX));
+        }
+    }
+
+    osg::ref_ptr<osgTerrain::HeightFieldLayer> hfl = new osgTerrain::HeightFieldLayer(hf.get());
+    hfl->setLocator(locator.get());
+
+    osg::ref_ptr<osg::Image> image = new osg::Image;
+    image->allocateImage(imageSize, imageSize, 1, GL_RGB, GL_UNSIGNED_BYTE);
+    image->setInternalTextureFormat(GL_RGB);
+    unsigned char* data = image->data();
+    for(unsigned int i=0; i<imageSize*imageSize*3; ++i) data[i] = static_cast<unsigned char>(rand());
+
+    osg::ref_ptr<osgTerrain::ImageLayer> imageLayer = new osgTerrain::ImageLayer(image.get());
+    imageLayer->setLocator(locator.get());
+
+    osgTerrain::TerrainTile* tile = new osgTerrain::TerrainTile;
+    tile->setElevationLayer(hfl.get());
+    tile->setColorLayer(0, imageLayer.get());
+    return tile;
+}
+
+static unsigned int countRenderLeaves(const osgUtil::StateGraph* sg)
+{
+    unsigned int numLeaves = static_cast<unsigned int>(sg->_leaves.size());
+    for(osgUtil::StateGraph::ChildList::const_iterator itr = sg->_children.begin();
+        itr != sg->_children.end();
+        ++itr)
+    {
+        numLeaves += countRenderLeaves(itr->second.get());
+    }
+    return numLeaves;
+}
+
+// cull a grid of DisplacementMappingTechnique tiles, all sharing one GeometryKey, from above and report the render leaves
+// recorded, each a draw call, and the GeometryPool statistics.
+static bool runTerrainCull(unsigned int numTilesPerSide, bool useInstancedTiles, unsigned int& numLeaves)
+{
+    const unsigned int numTiles = numTilesPerSide*numTilesPerSide;
+
+    srand(1);
+
+    osg::ref_ptr<osgTerrain::Terrain> terrain = new osgTerrain::Terrain;
+    terrain->setTerrainTechniquePrototype(new osgTerrain::DisplacementMappingTechnique);
+    terrain->getGeometryPool()->setUseInstancedTiles(useInstancedTiles);
+
+    for(unsigned int y=0; y<numTilesPerSide; ++y)
+    {
+        for(unsigned int x=0; x<numTilesPerSide; ++x)
+        {
+            terrain->addChild(createTile(x, y, 17, 32));
+        }
+    }
+
+    osg::ref_ptr<osgUtil::SceneView> sceneView = new osgUtil::SceneView;
+    sceneView->setDefaults();
+    sceneView->setSceneData(terrain.get());
+    sceneView->setViewport(0, 0, 1024, 1024);
+    sceneView->setProjectionMatrixAsPerspective(60.0, 1.0, 1.0, 1000.0);
+
+    double half = double(numTilesPerSide)*0.5;
+    sceneView->setViewMatrixAsLookAt(osg::Vec3d(half, half, double(numTilesPerSide)), osg::Vec3d(half, half, 0.0), osg::Vec3d(0.0, 1.0, 0.0));
+
+    osg::ref_ptr<osg::FrameStamp> frameStamp = new osg::FrameStamp;
+    sceneView->setFrameStamp(frameStamp.get());
+
+    // the first cull initializes the tiles.
+    osg::Timer_t start = osg::Timer::instance()->tick();
+    sceneView->cull();
+    double initTime = osg::Timer::instance()->delta_m(start, osg::Timer::instance()->tick());
+
+    const unsigned int numFrames = 20;
+    start = osg::Timer::instance()->tick();
+    for(unsigned int i=1; i<=numFrames; ++i)
+    {
+        frameStamp->setFrameNumber(i);
+        sceneView->cull();
+    }
+    double cullTime = osg::Timer::instance()->delta_m(start, osg::Timer::instance()->tick())/double(numFrames);
+
+    numLeaves = countRenderLeaves(sceneView->getStateGraph());
+
+    osgTerrain::GeometryPool::Statistics stats;
+    terrain->getGeometryPool()->getStatistics(stats);
+
+    // all the tiles are in view and share a single geometry.
+    bool passed = stats.requestsPerKey.size()==1;
+
+    std::cout<<"  "<<(useInstancedTiles ? "instanced" : "per tile")<<": init "<<initTime<<"ms, cull "<<cullTime<<"ms, "<<numLeaves<<" draw calls"<<std::endl;
+    std::cout<<"    geometry: "<<stats.numGeometryRequests<<" requests, "<<stats.numGeometriesCreated<<" created, reuse ratio "<<stats.getGeometryReuseRatio()
+             <<", "<<stats.numGeometriesInUse<<"/"<<stats.numGeometries<<" in use, "<<stats.geometryMemory<<" bytes"<<std::endl;
+
+    for(osgTerrain::GeometryPool::Statistics::KeyCounts::iterator itr = stats.requestsPerKey.begin();
+        itr != stats.requestsPerKey.end();
+        ++itr)
+    {
+        std::cout<<"    key sx="<<itr->first.sx<<" sy="<<itr->first.sy<<" y="<<itr->first.y<<" nx="<<itr->first.nx<<" ny="<<itr->first.ny
+                 <<": "<<itr->second<<" requests, "<<stats.tilesPerKey[itr->first]<<" tiles"<<std::endl;
+    }
+
+    if (useInstancedTiles)
+    {
+        // the texture arrays fill in turn, each pair of height field and colour arrays making a batch of at most
+        // 32 tiles per instanced draw call.
+        const unsigned int numLayersPerArray = terrain->getGeometryPool()->getNumTextureArrayLayers();
+        const unsigned int maxTilesPerDraw = 32;
+        unsigned int expectedNumBatches = 0;
+        unsigned int expectedNumDrawCalls = 0;
+        for(unsigned int remaining=numTiles; remaining>0;)
+        {
+            unsigned int numBatchTiles = osg::minimum(remaining, numLayersPerArray);
+            ++expectedNumBatches;
+            expectedNumDrawCalls += (numBatchTiles+maxTilesPerDraw-1)/maxTilesPerDraw;
+            remaining -= numBatchTiles;
+        }
+
+        passed = passed && stats.numInstancedTiles==numTiles && stats.numNonInstancedTiles==0 &&
+                 stats.numBatches==expectedNumBatches && stats.numBatchedTiles==numTiles && stats.numBatchDrawCalls==expectedNumDrawCalls &&
+                 numLeaves==stats.numBatches;
+
+        std::cout<<"    tiles: "<<stats.numInstancedTiles<<" instanced, "<<stats.numNonInstancedTiles<<" not instanced"<<std::endl;
+        std::cout<<"    texture arrays: "<<stats.numTextureArrays<<", "<<stats.numTextureArrayLayersUsed<<"/"<<stats.numTextureArrayLayers<<" layers used, "
+                 <<stats.textureArrayMemory<<" bytes"<<std::endl;
+        std::cout<<"    batches: "<<stats.numBatches<<" holding "<<stats.numBatchedTiles<<" tiles, "<<stats.numBatchDrawCalls<<" instanced draw calls, expected "
+                 <<expectedNumBatches<<" batches, "<<expectedNumDrawCalls<<" draw calls"<<std::endl;
+    }
+    else
+    {
+        passed = passed && numLeaves==numTiles;
+    }
+
+    sceneView->setSceneData(0);
+    terrain = 0;
+
+    if (useInstancedTiles)
+    {
+        // deleting the tiles returns their layers to the texture arrays.
+        osg::ref_ptr<osgTerrain::GeometryPool> pool = new osgTerrain::GeometryPool;
+        pool->setUseInstancedTiles(true);
+        {
+            osg::ref_ptr<osgTerrain::TerrainTile> tile = createTile(0, 0, 17, 32);
+            osg::ref_ptr<osg::MatrixTransform> subgraph = pool->getTileSubgraph(tile.get());
+        }
+        osg::ref_ptr<osgTerrain::TerrainTile> tile = createTile(1, 0, 17, 32);
+        osg::ref_ptr<osg::MatrixTransform> subgraph = pool->getTileSubgraph(tile.get());
+
+        pool->getStatistics(stats);
+
+        bool reused = stats.numTextureArrayLayersUsed>0 && stats.numTextureArrayLayersReused==stats.numTextureArrayLayersUsed;
+        passed = passed && reused;
+
+        std::cout<<(reused ? "pass" : "fail")<<"    layer reuse: "<<stats.numTextureArrayLayersUsed<<"/"<<stats.numTextureArrayLayers<<" layers used, "
+                 <<stats.numTextureArrayLayersReused<<" reused"<<std::endl;
+    }
+
+    std::cout<<(passed ? "pass" : "fail")<<"    "<<(useInstancedTiles ? "instanced" : "per tile")<<" terrain cull of "<<numTiles<<" tiles"<<std::endl;
+    return passed;
+}
+
+void runTerrainBenchmark(unsigned int numTilesPerSide)
+{
+    unsigned int numTileLeaves = 0;
+    runTerrainCull(numTilesPerSide, false, numTileLeaves);
+
+    unsigned int numBatchLeaves = 0;
+    runTerrainCull(numTilesPerSide, true, numBatchLeaves);
+
+    std::cout<<"  "<<numTilesPerSide*numTilesPerSide<<" tiles recorded as "<<numTileLeaves<<" render leaves per tile, "<<numBatchLeaves<<" instanced"<<std::endl;
+}
@@ -30,6 +30,19 @@
 #include "UnitTestFramework.h"
 #include "performance.h"
 #include "MultiThreadRead.h"
+#include "DatabasePagerQueue.h"
+#include "KdTreeBenchmark.h"
+#include "StateBenchmark.h"
+#include "RenderBinBenchmark.h"
+#include "OperationQueueBenchmark.h"
+#include "SimplifierBenchmark.h"
+#include "OBJReaderBenchmark.h"
+#include "ArchiveBenchmark.h"
+#include "TerrainBenchmark.h"
+#include "GlyphAtlasBenchmark.h"
+#include "ParticleBenchmark.h"
+#include "CullBenchmark.h"
+#include "TaskSchedulerBenchmark.h"
 
 #include <iostream>
 
@@ -572,6 +585,20 @@ int main( int argc, char** argv )
     arguments.getApplicationUsage()->addCommandLineOption("matrix","Display qualified tests.");
     arguments.getApplicationUsage()->addCommandLineOption("performance","Display qualified tests.");
     arguments.getApplicationUsage()->addCommandLineOption("read-threads <numthreads>","Run multi-thread reading test.");
+    arguments.getApplicationUsage()->addCommandLineOption("pager-queue <numrequests>","Run DatabasePager request queue benchmark, swap test and work stealing affinity and stealing tests.");
+    arguments.getApplicationUsage()->addCommandLineOption("kdtree <numtriangles>","Run KdTree build, single and batched line segment intersection benchmark.");
+    arguments.getApplicationUsage()->addCommandLineOption("state <numstatesets>","Run headless osg::State::apply(StateSet*) benchmark.");
+    arguments.getApplicationUsage()->addCommandLineOption("renderbin <numleaves>","Run osgUtil::RenderBin depth and packed key sort benchmark.");
+    arguments.getApplicationUsage()->addCommandLineOption("operation-queue <numoperations>","Run osg::OperationQueue list and lock free queue stress test and benchmark.");
+    arguments.getApplicationUsage()->addCommandLineOption("simplifier <numtriangles>","Run osgUtil::Simplifier edge collapse and quadric collapse benchmark on a generated mesh.");
+    arguments.getApplicationUsage()->addCommandLineOption("obj <numtriangles>","Run OBJ plugin stream reader and parallel reader benchmark on a generated file.");
+    arguments.getApplicationUsage()->addCommandLineOption("osga <numthreads>","Run benchmark of threads reading random members of a generated .osga archive.");
+    arguments.getApplicationUsage()->addCommandLineOption("zip <numthreads>","Run benchmark of threads reading random members of a generated .zip archive.");
+    arguments.getApplicationUsage()->addCommandLineOption("terrain <numtilesperside>","Run osgTerrain cull benchmark of per tile and instanced DisplacementMappingTechnique tiles.");
+    arguments.getApplicationUsage()->addCommandLineOption("glyphatlas <numglyphs>","Run osgText benchmark of per font glyph textures against a shared GlyphAtlas with eviction and background signed distance fields.");
+    arguments.getApplicationUsage()->addCommandLineOption("cull <numthreads>","Run osgUtil::CullVisitor test comparing serial and parallel cull of Group, Sequence, Switch and traverse() overriding roots.");
+    arguments.getApplicationUsage()->addCommandLineOption("particles <numparticles>","Run osgParticle test comparing ModularProgram operators run over particle arrays and over Particle objects.");
+    arguments.getApplicationUsage()->addCommandLineOption("taskscheduler <numthreads>","Run osg::TaskScheduler stress test of parallelFor coverage, nested TaskGroup waits and work stealing under load.");
 
 
     if (arguments.argc()<=1)
@@ -598,6 +625,48 @@ int main( int argc, char** argv )
     int numReadThreads = 0;
     while (arguments.read("read-threads", numReadThreads)) {}
 
+    unsigned int numPagerQueueRequests = 0;
+    while (arguments.read("pager-queue", numPagerQueueRequests)) {}
+
+    unsigned int numKdTreeTriangles = 0;
+    while (arguments.read("kdtree", numKdTreeTriangles)) {}
+
+    unsigned int numStateSets = 0;
+    while (arguments.read("state", numStateSets)) {}
+
+    unsigned int numRenderLeaves = 0;
+    while (arguments.read("renderbin", numRenderLeaves)) {}
+
+    unsigned int numQueueOperations = 0;
+    while (arguments.read("operation-queue", numQueueOperations)) {}
+
+    unsigned int numSimplifierTriangles = 0;
+    while (arguments.read("simplifier", numSimplifierTriangles)) {}
+
+    unsigned int numOBJTriangles = 0;
+    while (arguments.read("obj", numOBJTriangles)) {}
+
+    unsigned int numArchiveThreads = 0;
+    while (arguments.read("osga", numArchiveThreads)) {}
+
+    unsigned int numZipArchiveThreads = 0;
+    while (arguments.read("zip", numZipArchiveThreads)) {}
+
+    unsigned int numTerrainTilesPerSide = 0;
+    while (arguments.read("terrain", numTerrainTilesPerSide)) {}
+
+    unsigned int numAtlasGlyphs = 0;
+    while (arguments.read("glyphatlas", numAtlasGlyphs)) {}
+
+    unsigned int numCullThreads = 0;
+    while (arguments.read("cull", numCullThreads)) {}
+
+    unsigned int numParticles = 0;
+    while (arguments.read("particles", numParticles)) {}
+
+    unsigned int numTaskSchedulerThreads = 0;
+    while (arguments.read("taskscheduler", numTaskSchedulerThreads)) {}
+
     bool printPolytopeTest = false;
     while (arguments.read("polytope")) printPolytopeTest = true;
 
@@ -680,6 +749,104 @@ int main( int argc, char** argv )
         runPerformanceTests();
     }
 
+    if (numPagerQueueRequests>0)
+    {
+        std::cout<<"**** DatabasePager request queue benchmark  ******"<<std::endl;
+
+        runDatabasePagerQueueBenchmark(numPagerQueueRequests);
+    }
+
+    if (numKdTreeTriangles>0)
+    {
+        std::cout<<"**** KdTree benchmark  ******"<<std::endl;
+
+        runKdTreeBenchmark(numKdTreeTriangles);
+    }
+
+    if (numStateSets>0)
+    {
+        std::cout<<"**** State benchmark  ******"<<std::endl;
+
+        runStateBenchmark(numStateSets);
+    }
+
+    if (numRenderLeaves>0)
+    {
+        std::cout<<"**** RenderBin sort benchmark  ******"<<std::endl;
+
+        runRenderBinBenchmark(numRenderLeaves);
+    }
+
+    if (numQueueOperations>0)
+    {
+        std::cout<<"**** OperationQueue benchmark  ******"<<std::endl;
+
+        runOperationQueueBenchmark(numQueueOperations);
+    }
+
+    if (numSimplifierTriangles>0)
+    {
+        std::cout<<"**** Simplifier benchmark  ******"<<std::endl;
+
+        runSimplifierBenchmark(numSimplifierTriangles);
+    }
+
+    if (numOBJTriangles>0)
+    {
+        std::cout<<"**** OBJ reader benchmark  ******"<<std::endl;
+
+        runOBJReaderBenchmark(numOBJTriangles);
+    }
+
+    if (numArchiveThreads>0)
+    {
+        std::cout<<"**** Archive benchmark  ******"<<std::endl;
+
+        runArchiveBenchmark(numArchiveThreads);
+    }
+
+    if (numZipArchiveThreads>0)
+    {
+        std::cout<<"**** Zip archive benchmark  ******"<<std::endl;
+
+        runZipArchiveBenchmark(numZipArchiveThreads);
+    }
+
+    if (numTerrainTilesPerSide>0)
+    {
+        std::cout<<"**** Terrain benchmark  ******"<<std::endl;
+
+        runTerrainBenchmark(numTerrainTilesPerSide);
+    }
+
+    if (numAtlasGlyphs>0)
+    {
+        std::cout<<"**** Glyph atlas benchmark  ******"<<std::endl;
+
+        runGlyphAtlasBenchmark(numAtlasGlyphs);
+    }
+
+    if (numCullThreads>0)
+    {
+        std::cout<<"**** Parallel cull test  ******"<<std::endl;
+
+        runCullTest(numCullThreads);
+    }
+
+    if (numParticles>0)
+    {
+        std::cout<<"**** Particle operator test  ******"<<std::endl;
+
+        runParticleBenchmark(numParticles);
+    }
+
+    if (numTaskSchedulerThreads>0)
+    {
+        std::cout<<"**** Task scheduler stress test  ******"<<std::endl;
+
+        runTaskSchedulerTest(numTaskSchedulerThreads);
+    }
+
     if (numReadThreads>0)
     {
         runMultiThreadReadTests(numReadThreads, arguments);
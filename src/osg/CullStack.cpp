@@ -24,6 +24,7 @@ CullStack::CullStack()
     _bbCornerNear = 0;
     _bbCornerFar = 7;
     _currentReuseMatrixIndex=0;
+    _numMatrixAllocations=0;
     _identity = new RefMatrix();
 
     _index_modelviewCullingStack = 0;
@@ -39,6 +40,7 @@ CullStack::CullStack(const CullStack& cs):
     _bbCornerNear = 0;
     _bbCornerFar = 7;
     _currentReuseMatrixIndex=0;
+    _numMatrixAllocations=0;
     _identity = new RefMatrix();
 
     _index_modelviewCullingStack = 0;
@@ -86,6 +88,7 @@ void CullStack::reset()
     _bbCornerNear = (~_bbCornerFar)&7;
 
     _currentReuseMatrixIndex=0;
+    _numMatrixAllocations=0;
 }
 
 
@@ -104,6 +104,7 @@ void DisplaySettings::setDisplaySettings(const DisplaySettings& vs)
 
     _numDatabaseThreadsHint = vs._numDatabaseThreadsHint;
     _numHttpDatabaseThreadsHint = vs._numHttpDatabaseThreadsHint;
+    _numTaskSchedulerThreadsHint = vs._numTaskSchedulerThreadsHint;
 
     _application = vs._application;
 
@@ -151,6 +152,7 @@ void DisplaySettings::merge(const DisplaySettings& vs)
 
     if (vs._numDatabaseThreadsHint>_numDatabaseThreadsHint) _numDatabaseThreadsHint = vs._numDatabaseThreadsHint;
     if (vs._numHttpDatabaseThreadsHint>_numHttpDatabaseThreadsHint) _numHttpDatabaseThreadsHint = vs._numHttpDatabaseThreadsHint;
+    if (vs._numTaskSchedulerThreadsHint>_numTaskSchedulerThreadsHint) _numTaskSchedulerThreadsHint = vs._numTaskSchedulerThreadsHint;
 
     if (_application.empty()) _application = vs._application;
 
@@ -236,6 +238,7 @@ void DisplaySettings::setDefaults()
 
     _numDatabaseThreadsHint = 2;
     _numHttpDatabaseThreadsHint = 1;
+    _numTaskSchedulerThreadsHint = 0;
 
     _maxTexturePoolSize = 0;
     _maxBufferObjectPoolSize = 0;
@@ -405,6 +408,9 @@ static ApplicationUsageProxy DisplaySetting_e35(ApplicationUsage::ENVIRONMENTAL_
 static ApplicationUsageProxy DisplaySetting_e36(ApplicationUsage::ENVIRONMENTAL_VARIABLE,
         "OSG_TEXT_SHADER_TECHNIQUE <value>",
         "Set the defafult osgText::ShaderTechnique. ALL_FEATURES | ALL | GREYSCALE | SIGNED_DISTANCE_FIELD | SDF | NO_TEXT_SHADER | NONE");
+static ApplicationUsageProxy DisplaySetting_e37(ApplicationUsage::ENVIRONMENTAL_VARIABLE,
+        "OSG_NUM_TASK_SCHEDULER_THREADS <int>",
+        "Set the hint for the number of worker threads of the shared osg::TaskScheduler, 0 for one fewer than the number of processors.");
 
 void DisplaySettings::readEnvironmentalVariables()
 {
@@ -579,6 +585,8 @@ void DisplaySettings::readEnvironmentalVariables()
 
     getEnvVar("OSG_NUM_HTTP_DATABASE_THREADS", _numHttpDatabaseThreadsHint);
 
+    getEnvVar("OSG_NUM_TASK_SCHEDULER_THREADS", _numTaskSchedulerThreadsHint);
+
     getEnvVar("OSG_MULTI_SAMPLES", _numMultiSamples);
 
     getEnvVar("OSG_TEXTURE_POOL_SIZE", _maxTexturePoolSize);
@@ -955,6 +963,7 @@ void DisplaySettings::readCommandLine(ArgumentParser& arguments)
 
     while(arguments.read("--num-db-threads",_numDatabaseThreadsHint)) {}
     while(arguments.read("--num-http-threads",_numHttpDatabaseThreadsHint)) {}
+    while(arguments.read("--num-task-threads",_numTaskSchedulerThreadsHint)) {}
 
     while(arguments.read("--texture-pool-size",_maxTexturePoolSize)) {}
     while(arguments.read("--buffer-object-pool-size",_maxBufferObjectPoolSize)) {}
@@ -96,6 +96,35 @@ CostPair GeometryCostEstimator::estimateDrawCost(const osg::Geometry* /*geometry
     return CostPair(0.0,0.0);
 }
 
+CostPair GeometryCostEstimator::estimateMemoryCost(const osg::Geometry* geometry) const
+{
+    double size = 0.0;
+    if (geometry->getVertexArray()) { size += geometry->getVertexArray()->getTotalDataSize(); }
+    if (geometry->getNormalArray()) { size += geometry->getNormalArray()->getTotalDataSize(); }
+    if (geometry->getColorArray()) { size += geometry->getColorArray()->getTotalDataSize(); }
+    if (geometry->getSecondaryColorArray()) { size += geometry->getSecondaryColorArray()->getTotalDataSize(); }
+    if (geometry->getFogCoordArray()) { size += geometry->getFogCoordArray()->getTotalDataSize(); }
+    for(unsigned i=0; i<geometry->getNumTexCoordArrays(); ++i)
+    {
+        if (geometry->getTexCoordArray(i)) { size += geometry->getTexCoordArray(i)->getTotalDataSize(); }
+    }
+    for(unsigned i=0; i<geometry->getNumVertexAttribArrays(); ++i)
+    {
+        if (geometry->getVertexAttribArray(i)) { size += geometry->getVertexAttribArray(i)->getTotalDataSize(); }
+    }
+    for(unsigned i=0; i<geometry->getNumPrimitiveSets(); ++i)
+    {
+        const osg::PrimitiveSet* primSet = geometry->getPrimitiveSet(i);
+        const osg::DrawElements* drawElements = primSet ? primSet->getDrawElements() : 0;
+        if (drawElements) { size += drawElements->getTotalDataSize(); }
+    }
+
+    // the data is held on the GPU when it's uploaded as vertex buffer objects or compiled into display lists.
+    bool onGPU = geometry->getUseVertexBufferObjects() || (geometry->getUseDisplayList() && geometry->getSupportsDisplayList());
+
+    return CostPair(size, onGPU ? size : 0.0);
+}
+
 /////////////////////////////////////////////////////////////////////////////////////////////
 //
 // TextureCostEstimator
@@ -135,6 +164,32 @@ CostPair TextureCostEstimator::estimateDrawCost(const osg::Texture* /*texture*/)
     return CostPair(0.0,0.0);
 }
 
+CostPair TextureCostEstimator::estimateMemoryCost(const osg::Texture* texture) const
+{
+    osg::Texture::FilterMode minFilter = texture->getFilter(osg::Texture::MIN_FILTER);
+    bool usesMipmaps = minFilter!=osg::Texture::LINEAR && minFilter!=osg::Texture::NEAREST;
+
+    CostPair cost(0.0, 0.0);
+    for(unsigned int i=0; i<texture->getNumImages(); ++i)
+    {
+        const osg::Image* image = texture->getImage(i);
+        if (!image) continue;
+
+        double size = image->getTotalSizeInBytesIncludingMipmaps();
+        cost.first += size;
+        cost.second += (usesMipmaps && !image->isMipmap()) ? size*4.0/3.0 : size;
+    }
+
+    if (cost.second==0.0 && texture->getTextureWidth()>0)
+    {
+        // images have been released after apply so fall back to the texture dimensions, assuming 4 bytes per texel.
+        double size = 4.0 * double(texture->getTextureWidth()) * double(osg::maximum(texture->getTextureHeight(),1)) * double(osg::maximum(texture->getTextureDepth(),1));
+        cost.second = usesMipmaps ? size*4.0/3.0 : size;
+    }
+
+    return cost;
+}
+
 /////////////////////////////////////////////////////////////////////////////////////////////
 //
 // ProgramCostEstimator
@@ -317,6 +372,69 @@ public:
     CostPair    _costs;
 };
 
+class CollectMemoryCosts : public osg::NodeVisitor
+{
+public:
+    CollectMemoryCosts(const GraphicsCostEstimator* gce):
+        osg::NodeVisitor(osg::NodeVisitor::TRAVERSE_ALL_CHILDREN),
+        _gce(gce),
+        _costs(0.0,0.0)
+        {}
+
+    virtual void apply(osg::Node& node)
+    {
+        apply(node.getStateSet());
+        traverse(node);
+    }
+
+    virtual void apply(osg::Geometry& geom)
+    {
+        apply(geom.getStateSet());
+        apply(&geom);
+    }
+
+    void apply(osg::StateSet* stateset)
+    {
+        if (!stateset) return;
+        if (_statesets.count(stateset)) return;
+        _statesets.insert(stateset);
+
+        for(unsigned int i=0; i<stateset->getNumTextureAttributeLists(); ++i)
+        {
+            const osg::Texture* texture = dynamic_cast<const osg::Texture*>(stateset->getTextureAttribute(i, osg::StateAttribute::TEXTURE));
+            if (texture && _textures.insert(texture).second)
+            {
+                CostPair cost = _gce->estimateMemoryCost(texture);
+                _costs.first += cost.first;
+                _costs.second += cost.second;
+            }
+        }
+    }
+
+    void apply(osg::Geometry* geometry)
+    {
+        if (!geometry) return;
+        if (_geometries.count(geometry)) return;
+        _geometries.insert(geometry);
+
+        CostPair cost = _gce->estimateMemoryCost(geometry);
+
+        _costs.first += cost.first;
+        _costs.second += cost.second;
+    }
+
+
+    typedef std::set<osg::StateSet*> StateSets;
+    typedef std::set<const osg::Texture*> Textures;
+    typedef std::set<osg::Geometry*> Geometries;
+
+    const GraphicsCostEstimator* _gce;
+    StateSets   _statesets;
+    Textures    _textures;
+    Geometries  _geometries;
+    CostPair    _costs;
+};
+
 CostPair GraphicsCostEstimator::estimateCompileCost(const osg::Node* node) const
 {
     if (!node) return CostPair(0.0,0.0);
@@ -333,4 +451,12 @@ CostPair GraphicsCostEstimator::estimateDrawCost(const osg::Node* node) const
     return cdc._costs;
 }
 
+CostPair GraphicsCostEstimator::estimateMemoryCost(const osg::Node* node) const
+{
+    if (!node) return CostPair(0.0,0.0);
+    CollectMemoryCosts cmc(this);
+    const_cast<osg::Node*>(node)->accept(cmc);
+    return cmc._costs;
+}
+
 }
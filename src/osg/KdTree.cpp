@@ -19,6 +19,12 @@
 
 #include <osg/io_utils>
 
+#include <OpenThreads/Thread>
+#include <OpenThreads/Atomic>
+
+#include <algorithm>
+#include <float.h>
+
 using namespace osg;
 
 //#define VERBOSE_OUTPUT
@@ -31,24 +37,46 @@ using namespace osg;
 struct BuildKdTree
 {
     BuildKdTree(KdTree& kdTree):
-        _kdTree(kdTree) {}
+        _kdTree(kdTree),
+        _collectBounds(false) {}
 
     typedef std::vector< osg::Vec3 >            CenterList;
+    typedef std::vector< osg::BoundingBox >     BoundsList;
     typedef std::vector< unsigned int >           Indices;
     typedef std::vector< unsigned int >         AxisStack;
 
+    // subtree below the top levels of an SAH build, built into its own node list so it can be done on a separate thread.
+    struct SubtreeTask
+    {
+        SubtreeTask(int nodeIndex, int istart, int iend, unsigned int level):
+            _nodeIndex(nodeIndex), _istart(istart), _iend(iend), _level(level) {}
+
+        int                 _nodeIndex;
+        int                 _istart;
+        int                 _iend;
+        unsigned int        _level;
+        KdTree::KdNodeList  _nodes;
+    };
+    typedef std::vector< SubtreeTask >          SubtreeTasks;
+
     bool build(KdTree::BuildOptions& options, osg::Geometry* geometry);
 
     void computeDivisions(KdTree::BuildOptions& options);
 
     int divide(KdTree::BuildOptions& options, osg::BoundingBox& bb, int nodeIndex, unsigned int level);
 
+    void buildSAH(const KdTree::BuildOptions& options);
+
+    int divideSAH(const KdTree::BuildOptions& options, KdTree::KdNodeList& nodes, int istart, int iend, unsigned int level, SubtreeTasks* tasks, unsigned int taskLevel);
+
     KdTree&             _kdTree;
 
     osg::BoundingBox    _bb;
     AxisStack           _axisStack;
     Indices             _primitiveIndices;
     CenterList          _centers;
+    BoundsList          _bounds;
+    bool                _collectBounds;
 
 protected:
 
@@ -74,6 +102,7 @@ struct PrimitiveIndicesCollector
 
         _buildKdTree->_primitiveIndices.push_back(_buildKdTree->_centers.size());
         _buildKdTree->_centers.push_back(bb.center());
+        if (_buildKdTree->_collectBounds) _buildKdTree->_bounds.push_back(bb);
     }
 
     inline void operator () (unsigned int p0, unsigned int p1)
@@ -98,6 +127,7 @@ struct PrimitiveIndicesCollector
 
         _buildKdTree->_primitiveIndices.push_back(_buildKdTree->_centers.size());
         _buildKdTree->_centers.push_back(bb.center());
+        if (_buildKdTree->_collectBounds) _buildKdTree->_bounds.push_back(bb);
     }
 
     inline void operator () (unsigned int p0, unsigned int p1, unsigned int p2)
@@ -125,6 +155,7 @@ struct PrimitiveIndicesCollector
 
         _buildKdTree->_primitiveIndices.push_back(_buildKdTree->_centers.size());
         _buildKdTree->_centers.push_back(bb.center());
+        if (_buildKdTree->_collectBounds) _buildKdTree->_bounds.push_back(bb);
     }
 
     inline void operator () (unsigned int p0, unsigned int p1, unsigned int p2, unsigned int p3)
@@ -154,6 +185,7 @@ struct PrimitiveIndicesCollector
 
         _buildKdTree->_primitiveIndices.push_back(_buildKdTree->_centers.size());
         _buildKdTree->_centers.push_back(bb.center());
+        if (_buildKdTree->_collectBounds) _buildKdTree->_bounds.push_back(bb);
     }
 
     BuildKdTree* _buildKdTree;
@@ -196,19 +228,33 @@ bool BuildKdTree::build(KdTree::BuildOptions& options, osg::Geometry* geometry)
     _primitiveIndices.reserve(estimatedNumTriangles);
     _centers.reserve(estimatedNumTriangles);
 
+    _collectBounds = (options._splitMethod==KdTree::BuildOptions::SAH_SPLIT);
+    if (_collectBounds) _bounds.reserve(estimatedNumTriangles);
+
     osg::TemplatePrimitiveIndexFunctor<PrimitiveIndicesCollector> collectIndices;
     collectIndices._buildKdTree = this;
     geometry->accept(collectIndices);
 
     _primitiveIndices.reserve(vertices->size());
 
-    KdTree::KdNode node(-1, _primitiveIndices.size());
-    node.bb = _bb;
+    if (options._splitMethod==KdTree::BuildOptions::SAH_SPLIT)
+    {
+        buildSAH(options);
+    }
+    else
+    {
+        KdTree::KdNode node(-1, _primitiveIndices.size());
+        node.bb = _bb;
 
-    int nodeNum = _kdTree.addNode(node);
+        int nodeNum = _kdTree.addNode(node);
 
-    osg::BoundingBox bb = _bb;
-    nodeNum = divide(options, bb, nodeNum, 0);
+        osg::BoundingBox bb = _bb;
+        nodeNum = divide(options, bb, nodeNum, 0);
+
+#ifdef VERBOSE_OUTPUT
+        OSG_NOTICE<<"Root nodeNum="<<nodeNum<<std::endl;
+#endif
+    }
 
     osg::KdTree::Indices& primitiveIndices = _kdTree.getPrimitiveIndices();
 
@@ -223,11 +269,6 @@ bool BuildKdTree::build(KdTree::BuildOptions& options, osg::Geometry* geometry)
     primitiveIndices.swap(new_indices);
 
 
-#ifdef VERBOSE_OUTPUT
-    OSG_NOTICE<<"Root nodeNum="<<nodeNum<<std::endl;
-#endif
-
-
 //    OSG_NOTICE<<"_kdNodes.size()="<<k_kdNodes.size()<<"  estimated size = "<<estimatedSize<<std::endl;
 //    OSG_NOTICE<<"_kdLeaves.size()="<<_kdLeaves.size()<<"  estimated size = "<<estimatedSize<<std::endl<<std::endl;
 
@@ -469,6 +510,262 @@ int BuildKdTree::divide(KdTree::BuildOptions& options, osg::BoundingBox& bb, int
 
 }
 
+////////////////////////////////////////////////////////////////////////////////
+//
+// Surface area heuristic build
+
+namespace
+{
+
+const unsigned int MAX_NUM_BINS = 64;
+const float TRAVERSAL_COST = 1.0f;
+const float INTERSECTION_COST = 1.5f;
+
+inline float surfaceArea(const osg::BoundingBox& bb)
+{
+    if (!bb.valid()) return 0.0f;
+    float dx = bb.xMax()-bb.xMin();
+    float dy = bb.yMax()-bb.yMin();
+    float dz = bb.zMax()-bb.zMin();
+    return 2.0f*(dx*dy + dy*dz + dz*dx);
+}
+
+inline unsigned int binIndex(float value, float minValue, float scale, unsigned int numBins)
+{
+    unsigned int bin = static_cast<unsigned int>((value-minValue)*scale);
+    return bin<numBins ? bin : numBins-1;
+}
+
+struct InBinRange
+{
+    InBinRange(const BuildKdTree::CenterList& centers, int axis, float minValue, float scale, unsigned int numBins, unsigned int maxBin):
+        _centers(centers), _axis(axis), _minValue(minValue), _scale(scale), _numBins(numBins), _maxBin(maxBin) {}
+
+    bool operator() (unsigned int index) const { return binIndex(_centers[index][_axis], _minValue, _scale, _numBins)<=_maxBin; }
+
+    const BuildKdTree::CenterList& _centers;
+    int             _axis;
+    float           _minValue;
+    float           _scale;
+    unsigned int    _numBins;
+    unsigned int    _maxBin;
+
+protected:
+
+    InBinRange& operator = (const InBinRange&) { return *this; }
+};
+
+class SubtreeBuildThread : public OpenThreads::Thread
+{
+public:
+    SubtreeBuildThread(BuildKdTree& buildKdTree, const KdTree::BuildOptions& options, BuildKdTree::SubtreeTasks& tasks, OpenThreads::Atomic& nextTask):
+        _buildKdTree(buildKdTree),
+        _options(options),
+        _tasks(tasks),
+        _nextTask(nextTask) {}
+
+    virtual void run()
+    {
+        unsigned int numTasks = static_cast<unsigned int>(_tasks.size());
+        for(unsigned int t = (++_nextTask)-1; t<numTasks; t = (++_nextTask)-1)
+        {
+            BuildKdTree::SubtreeTask& task = _tasks[t];
+            _buildKdTree.divideSAH(_options, task._nodes, task._istart, task._iend, task._level, 0, 0);
+        }
+    }
+
+protected:
+
+    SubtreeBuildThread& operator = (const SubtreeBuildThread&) { return *this; }
+
+    BuildKdTree&                    _buildKdTree;
+    const KdTree::BuildOptions&     _options;
+    BuildKdTree::SubtreeTasks&      _tasks;
+    OpenThreads::Atomic&            _nextTask;
+};
+
+}
+
+void BuildKdTree::buildSAH(const KdTree::BuildOptions& options)
+{
+    KdTree::KdNodeList& nodes = _kdTree.getNodes();
+    int numPrimitives = static_cast<int>(_primitiveIndices.size());
+
+    // only worth farming out subtrees when there is plenty of work for each thread.
+    unsigned int numThreads = options._numThreads;
+    if (numThreads<=1 || numPrimitives<4096)
+    {
+        divideSAH(options, nodes, 0, numPrimitives, 0, 0, 0);
+        return;
+    }
+
+    // split the top levels serially until there are around four subtrees for each thread.
+    unsigned int taskLevel = 0;
+    while((1u<<taskLevel) < numThreads*4) ++taskLevel;
+
+    SubtreeTasks tasks;
+    divideSAH(options, nodes, 0, numPrimitives, 0, &tasks, taskLevel);
+
+    if (tasks.empty()) return;
+
+    // build the subtrees, the subtrees cover disjoint ranges of _primitiveIndices so can be partitioned concurrently.
+    OpenThreads::Atomic nextTask;
+    std::vector<SubtreeBuildThread*> threads;
+    for(unsigned int t=1; t<numThreads && t<tasks.size(); ++t)
+    {
+        threads.push_back(new SubtreeBuildThread(*this, options, tasks, nextTask));
+        threads.back()->start();
+    }
+
+    SubtreeBuildThread(*this, options, tasks, nextTask).run();
+
+    for(std::vector<SubtreeBuildThread*>::iterator itr = threads.begin(); itr != threads.end(); ++itr)
+    {
+        (*itr)->join();
+        delete *itr;
+    }
+
+    // splice the subtrees into the main node list, the subtree root replaces the placeholder leaf.
+    for(SubtreeTasks::iterator itr = tasks.begin(); itr != tasks.end(); ++itr)
+    {
+        KdTree::KdNodeList& subtreeNodes = itr->_nodes;
+        int offset = static_cast<int>(nodes.size()) - 1;
+        for(KdTree::KdNodeList::iterator nitr = subtreeNodes.begin(); nitr != subtreeNodes.end(); ++nitr)
+        {
+            if (nitr->first>0)
+            {
+                nitr->first += offset;
+                if (nitr->second>0) nitr->second += offset;
+            }
+        }
+
+        nodes[itr->_nodeIndex] = subtreeNodes.front();
+        nodes.insert(nodes.end(), subtreeNodes.begin()+1, subtreeNodes.end());
+    }
+}
+
+int BuildKdTree::divideSAH(const KdTree::BuildOptions& options, KdTree::KdNodeList& nodes, int istart, int iend, unsigned int level, SubtreeTasks* tasks, unsigned int taskLevel)
+{
+    int numPrimitives = iend-istart;
+
+    osg::BoundingBox bb;
+    osg::BoundingBox centerBB;
+    for(int i=istart; i<iend; ++i)
+    {
+        unsigned int index = _primitiveIndices[i];
+        bb.expandBy(_bounds[index]);
+        centerBB.expandBy(_centers[index]);
+    }
+
+    // add as a leaf, converted to an internal node below if it is worth splitting.
+    int nodeIndex = static_cast<int>(nodes.size());
+    nodes.push_back(KdTree::KdNode(-istart-1, numPrimitives));
+    if (bb.valid())
+    {
+        float epsilon = 1e-6f;
+        nodes.back().bb.set(bb._min - osg::Vec3(epsilon, epsilon, epsilon), bb._max + osg::Vec3(epsilon, epsilon, epsilon));
+    }
+
+    if (numPrimitives<=static_cast<int>(options._targetNumTrianglesPerLeaf) || level>=options._maxNumLevels) return nodeIndex;
+
+    if (tasks && level==taskLevel)
+    {
+        tasks->push_back(SubtreeTask(nodeIndex, istart, iend, level));
+        return nodeIndex;
+    }
+
+    unsigned int numBins = osg::clampBetween(options._numBins, 2u, MAX_NUM_BINS);
+
+    unsigned int binCounts[MAX_NUM_BINS];
+    osg::BoundingBox binBounds[MAX_NUM_BINS];
+    float rightAreas[MAX_NUM_BINS];
+    unsigned int rightCounts[MAX_NUM_BINS];
+
+    int bestAxis = -1;
+    unsigned int bestBin = 0;
+    float bestCost = FLT_MAX;
+
+    for(int axis=0; axis<3; ++axis)
+    {
+        float minValue = centerBB._min[axis];
+        float extent = centerBB._max[axis]-minValue;
+        if (extent<=0.0f) continue;
+
+        float scale = float(numBins)/extent;
+
+        for(unsigned int b=0; b<numBins; ++b)
+        {
+            binCounts[b] = 0;
+            binBounds[b].init();
+        }
+
+        for(int i=istart; i<iend; ++i)
+        {
+            unsigned int index = _primitiveIndices[i];
+            unsigned int b = binIndex(_centers[index][axis], minValue, scale, numBins);
+            ++binCounts[b];
+            binBounds[b].expandBy(_bounds[index]);
+        }
+
+        // sweep from the right to get the area and count of everything to the right of each split.
+        osg::BoundingBox rightBB;
+        unsigned int rightCount = 0;
+        for(unsigned int b=numBins-1; b>0; --b)
+        {
+            rightBB.expandBy(binBounds[b]);
+            rightCount += binCounts[b];
+            rightAreas[b] = surfaceArea(rightBB);
+            rightCounts[b] = rightCount;
+        }
+
+        // sweep from the left evaluating the cost of splitting after each bin.
+        osg::BoundingBox leftBB;
+        unsigned int leftCount = 0;
+        for(unsigned int b=0; b<numBins-1; ++b)
+        {
+            leftBB.expandBy(binBounds[b]);
+            leftCount += binCounts[b];
+            if (leftCount==0 || rightCounts[b+1]==0) continue;
+
+            float cost = surfaceArea(leftBB)*float(leftCount) + rightAreas[b+1]*float(rightCounts[b+1]);
+            if (cost<bestCost)
+            {
+                bestCost = cost;
+                bestAxis = axis;
+                bestBin = b;
+            }
+        }
+    }
+
+    // all the primitive centers coincide so there is no way to split them.
+    if (bestAxis<0) return nodeIndex;
+
+    float parentArea = surfaceArea(bb);
+    float splitCost = TRAVERSAL_COST + INTERSECTION_COST*(parentArea>0.0f ? bestCost/parentArea : 0.0f);
+    float leafCost = INTERSECTION_COST*float(numPrimitives);
+
+    // keep small leaves when splitting doesn't pay off, larger ones are split regardless to keep leaves bounded.
+    if (splitCost>=leafCost && numPrimitives<=static_cast<int>(options._targetNumTrianglesPerLeaf*4)) return nodeIndex;
+
+    float minValue = centerBB._min[bestAxis];
+    float scale = float(numBins)/(centerBB._max[bestAxis]-minValue);
+    Indices::iterator middle = std::partition(_primitiveIndices.begin()+istart, _primitiveIndices.begin()+iend,
+                                              InBinRange(_centers, bestAxis, minValue, scale, numBins, bestBin));
+    int imid = static_cast<int>(middle - _primitiveIndices.begin());
+    if (imid==istart || imid==iend) return nodeIndex;
+
+    // children are laid out depth first so the left child immediately follows its parent.
+    int leftChildIndex = divideSAH(options, nodes, istart, imid, level+1, tasks, taskLevel);
+    int rightChildIndex = divideSAH(options, nodes, imid, iend, level+1, tasks, taskLevel);
+
+    // the node list may have been reallocated so look the node up again.
+    KdTree::KdNode& node = nodes[nodeIndex];
+    node.first = leftChildIndex;
+    node.second = rightChildIndex;
+
+    return nodeIndex;
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 //
 // KdTree::BuildOptions
@@ -476,7 +773,10 @@ int BuildKdTree::divide(KdTree::BuildOptions& options, osg::BoundingBox& bb, int
 KdTree::BuildOptions::BuildOptions():
         _numVerticesProcessed(0),
         _targetNumTrianglesPerLeaf(4),
-        _maxNumLevels(32)
+        _maxNumLevels(32),
+        _splitMethod(MIDPOINT_SPLIT),
+        _numBins(16),
+        _numThreads(1)
 {
 }
 
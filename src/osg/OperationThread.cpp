@@ -46,7 +46,16 @@ struct BlockOperation : public Operation, public Block
 //
 
 OperationQueue::OperationQueue():
-    osg::Referenced(true)
+    osg::Referenced(true),
+    _lockFreeOperations(0)
+{
+    _currentOperationIterator = _operations.begin();
+    _operationsBlock = new RefBlock;
+}
+
+OperationQueue::OperationQueue(unsigned int lockFreeQueueSize):
+    osg::Referenced(true),
+    _lockFreeOperations(lockFreeQueueSize>0 ? new LockFreeOperations(lockFreeQueueSize) : 0)
 {
     _currentOperationIterator = _operations.begin();
     _operationsBlock = new RefBlock;
@@ -54,31 +63,92 @@ OperationQueue::OperationQueue():
 
 OperationQueue::~OperationQueue()
 {
+    delete _lockFreeOperations;
 }
 
 bool OperationQueue::empty()
 {
 
   OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_operationsMutex);
-  return _operations.empty();
+  return _operations.empty() && static_cast<unsigned int>(_numLockFreeOperations)==0;
 }
 
 unsigned int OperationQueue::getNumOperationsInQueue()
 {
   OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_operationsMutex);
-  return static_cast<unsigned int>(_operations.size());
+  return static_cast<unsigned int>(_operations.size()) + static_cast<unsigned int>(_numLockFreeOperations);
+}
+
+bool OperationQueue::popLockFreeOperation(osg::ref_ptr<Operation>& operation)
+{
+    if (!_lockFreeOperations || !_lockFreeOperations->pop(operation)) return false;
+
+    --_numLockFreeOperations;
+    return true;
+}
+
+void OperationQueue::moveLockFreeOperationsToList()
+{
+    if (!_lockFreeOperations) return;
+
+    // an add() that has claimed its place in the queue but not yet written its operation would stop a plain pop, letting
+    // the operations queued behind it fall behind ones added after, so wait for all the operations queued so far.
+    unsigned int numToMove = _lockFreeOperations->size();
+    osg::ref_ptr<Operation> operation;
+    while(numToMove>0)
+    {
+        if (popLockFreeOperation(operation))
+        {
+            _operations.push_back(operation);
+            --numToMove;
+        }
+        else
+        {
+            OpenThreads::Thread::YieldCurrentThread();
+        }
+    }
+}
+
+void OperationQueue::updateOperationsBlock()
+{
+    if (_operations.empty() && static_cast<unsigned int>(_numLockFreeOperations)==0)
+    {
+        _operationsBlock->set(false);
+
+        // add() sets the block without taking the operations mutex, so check that no operation slipped in before it was cleared.
+        if (static_cast<unsigned int>(_numLockFreeOperations)!=0) _operationsBlock->set(true);
+    }
 }
 
 ref_ptr<Operation> OperationQueue::getNextOperation(bool blockIfEmpty)
 {
-    if (blockIfEmpty && _operations.empty())
+    if (blockIfEmpty && _operations.empty() && static_cast<unsigned int>(_numLockFreeOperations)==0)
     {
         _operationsBlock->block();
     }
 
     OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_operationsMutex);
 
-    if (_operations.empty()) return osg::ref_ptr<Operation>();
+    if (_operations.empty())
+    {
+        // with no kept operations in the list the next operation comes straight from the lock free queue.
+        ref_ptr<Operation> operation;
+        if (!popLockFreeOperation(operation)) return osg::ref_ptr<Operation>();
+
+        if (operation->getKeep())
+        {
+            // the list was empty so the current iterator is left at its end, as if the operation had been run from the list.
+            _operations.push_back(operation);
+        }
+        else
+        {
+            updateOperationsBlock();
+        }
+        return operation;
+    }
+
+    // operations added through the lock free queue follow on from the kept operations.
+    moveLockFreeOperationsToList();
 
     if (_currentOperationIterator == _operations.end())
     {
@@ -97,11 +167,7 @@ ref_ptr<Operation> OperationQueue::getNextOperation(bool blockIfEmpty)
 
         // OSG_INFO<<"size "<<_operations.size()<<std::endl;
 
-        if (_operations.empty())
-        {
-           // OSG_INFO<<"setting block "<<_operations.size()<<std::endl;
-           _operationsBlock->set(false);
-        }
+        updateOperationsBlock();
     }
     else
     {
@@ -116,11 +182,24 @@ ref_ptr<Operation> OperationQueue::getNextOperation(bool blockIfEmpty)
 
 void OperationQueue::add(Operation* operation)
 {
+    if (_lockFreeOperations)
+    {
+        // count the operation before it becomes visible so that taking it can never drop the count below zero.
+        if (++_numLockFreeOperations==1) _operationsBlock->set(true);
+
+        if (_lockFreeOperations->push(operation)) return;
+
+        --_numLockFreeOperations;
+    }
+
     OSG_INFO<<"Doing add"<<std::endl;
 
     // acquire the lock on the operations queue to prevent anyone else for modifying it at the same time
     OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_operationsMutex);
 
+    // keep the operations already in the lock free queue ahead of this one.
+    moveLockFreeOperationsToList();
+
     // add the operation to the end of the list
     _operations.push_back(operation);
 
@@ -134,6 +213,8 @@ void OperationQueue::remove(Operation* operation)
     // acquire the lock on the operations queue to prevent anyone else for modifying it at the same time
     OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_operationsMutex);
 
+    moveLockFreeOperationsToList();
+
     for(Operations::iterator itr = _operations.begin();
         itr!=_operations.end();)
     {
@@ -160,6 +241,8 @@ void OperationQueue::remove(const std::string& name)
     // acquire the lock on the operations queue to prevent anyone else for modifying it at the same time
     OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_operationsMutex);
 
+    moveLockFreeOperationsToList();
+
     // find the remove all operations with specified name
     for(Operations::iterator itr = _operations.begin();
         itr!=_operations.end();)
@@ -178,10 +261,7 @@ void OperationQueue::remove(const std::string& name)
         else ++itr;
     }
 
-    if (_operations.empty())
-    {
-        _operationsBlock->set(false);
-    }
+    updateOperationsBlock();
 }
 
 void OperationQueue::removeAllOperations()
@@ -190,21 +270,22 @@ void OperationQueue::removeAllOperations()
 
     OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_operationsMutex);
 
+    moveLockFreeOperationsToList();
+
     _operations.clear();
 
     // reset current operator.
     _currentOperationIterator = _operations.begin();
 
-    if (_operations.empty())
-    {
-        _operationsBlock->set(false);
-    }
+    updateOperationsBlock();
 }
 
 void OperationQueue::runOperations(Object* callingObject)
 {
     OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_operationsMutex);
 
+    if (!_operations.empty()) moveLockFreeOperationsToList();
+
     // reset current operation iterator to beginning if at end.
     if (_currentOperationIterator==_operations.end()) _currentOperationIterator = _operations.begin();
 
@@ -229,10 +310,16 @@ void OperationQueue::runOperations(Object* callingObject)
         (*operation)(callingObject);
     }
 
-    if (_operations.empty())
+    // then the operations added through the lock free queue since, which follow on from the end of the list.
+    ref_ptr<Operation> operation;
+    while(popLockFreeOperation(operation))
     {
-        _operationsBlock->set(false);
+        if (operation->getKeep()) _operations.push_back(operation);
+
+        (*operation)(callingObject);
     }
+
+    updateOperationsBlock();
 }
 
 void OperationQueue::releaseOperationsBlock()
@@ -244,6 +331,8 @@ void OperationQueue::releaseOperationsBlock()
 {
     OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_operationsMutex);
 
+    moveLockFreeOperationsToList();
+
     for(Operations::iterator itr = _operations.begin();
         itr!=_operations.end();
         ++itr)
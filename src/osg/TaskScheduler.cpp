@@ -0,0 +1,212 @@
+/* -*-c++-*- OpenSceneGraph - Copyright (C) 1998-2006 Robert Osfield
+ *
+ * This library is open source and may be redistributed and/or modified under
+ * the terms of the OpenSceneGraph Public License (OSGPL) version 0.0 or
+ * (at your option) any later version.  The full license is in LICENSE file
+ * included with this distribution, and on the openscenegraph.org website.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * OpenSceneGraph Public License for more details.
+*/
+
+#include <osg/TaskScheduler>
+#include <osg/DisplaySettings>
+#include <osg/Notify>
+
+#include <OpenThreads/ScopedLock>
+#include <OpenThreads/Thread>
+
+using namespace osg;
+
+class TaskScheduler::Worker : public OpenThreads::Thread
+{
+    public:
+
+        Worker(TaskScheduler* scheduler, unsigned int index):
+            _scheduler(scheduler),
+            _index(index) {}
+
+        virtual void run()
+        {
+            while(static_cast<unsigned int>(_scheduler->_done)==0)
+            {
+                if (_scheduler->runQueuedTask(_index)) continue;
+
+                // the count is checked with the mutex held and run() signals with it held, so a queued task can't be missed.
+                OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_scheduler->_sleepMutex);
+                if (static_cast<unsigned int>(_scheduler->_numQueued)==0 && static_cast<unsigned int>(_scheduler->_done)==0)
+                {
+                    _scheduler->_sleepCondition.wait(&_scheduler->_sleepMutex);
+                }
+            }
+        }
+
+        TaskScheduler*  _scheduler;
+        unsigned int    _index;
+};
+
+TaskScheduler::TaskScheduler(unsigned int numThreads):
+    Referenced(true),
+    _done(0)
+{
+    // one queue per worker thread, plus a shared queue for threads outside the pool.
+    for(unsigned int i=0; i<=numThreads; ++i)
+    {
+        _queues.push_back(new TaskQueue);
+    }
+
+    for(unsigned int i=0; i<numThreads; ++i)
+    {
+        _workers.push_back(new Worker(this, i));
+    }
+
+    for(std::vector<Worker*>::iterator itr = _workers.begin(); itr != _workers.end(); ++itr)
+    {
+        (*itr)->start();
+    }
+
+    OSG_INFO<<"TaskScheduler::TaskScheduler() started "<<numThreads<<" worker threads"<<std::endl;
+}
+
+TaskScheduler::~TaskScheduler()
+{
+    stop();
+
+    for(std::vector<TaskQueue*>::iterator itr = _queues.begin(); itr != _queues.end(); ++itr)
+    {
+        delete *itr;
+    }
+}
+
+ref_ptr<TaskScheduler>& TaskScheduler::instance()
+{
+    static ref_ptr<TaskScheduler> s_taskScheduler;
+    static OpenThreads::Mutex s_mutex;
+
+    OpenThreads::ScopedLock<OpenThreads::Mutex> lock(s_mutex);
+    if (!s_taskScheduler)
+    {
+        unsigned int numThreads = DisplaySettings::instance()->getNumOfTaskSchedulerThreadsHint();
+        if (numThreads==0)
+        {
+            int numProcessors = OpenThreads::GetNumberOfProcessors();
+            numThreads = numProcessors>1 ? static_cast<unsigned int>(numProcessors-1) : 0;
+        }
+        s_taskScheduler = new TaskScheduler(numThreads);
+    }
+    return s_taskScheduler;
+}
+
+void TaskScheduler::stop()
+{
+    {
+        OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_sleepMutex);
+        _done.exchange(1);
+        _sleepCondition.broadcast();
+    }
+
+    for(std::vector<Worker*>::iterator itr = _workers.begin(); itr != _workers.end(); ++itr)
+    {
+        (*itr)->join();
+        delete *itr;
+    }
+    _workers.clear();
+}
+
+unsigned int TaskScheduler::getQueueIndex() const
+{
+    OpenThreads::Thread* thread = OpenThreads::Thread::CurrentThread();
+    if (thread)
+    {
+        for(unsigned int i=0; i<_workers.size(); ++i)
+        {
+            if (_workers[i]==thread) return i;
+        }
+    }
+    return static_cast<unsigned int>(_queues.size()-1);
+}
+
+void TaskScheduler::run(TaskGroup* group, Task* task)
+{
+    task->_group = group;
+    ++(group->_numPending);
+
+    // count the task before it becomes visible so that taking it can never drop the count below zero.
+    ++_numQueued;
+
+    TaskQueue* queue = _queues[getQueueIndex()];
+    {
+        OpenThreads::ScopedLock<OpenThreads::Mutex> lock(queue->_mutex);
+        queue->_tasks.push_back(task);
+    }
+
+    OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_sleepMutex);
+    _sleepCondition.signal();
+}
+
+void TaskScheduler::wait(TaskGroup* group)
+{
+    unsigned int index = getQueueIndex();
+    while(!group->done())
+    {
+        if (runQueuedTask(index)) continue;
+
+        // the remaining tasks are running on other threads, sleep until they complete, checking back for tasks they queue.
+        OpenThreads::ScopedLock<OpenThreads::Mutex> lock(group->_mutex);
+        if (!group->done()) group->_condition.wait(&group->_mutex, 1);
+    }
+}
+
+bool TaskScheduler::runQueuedTask(unsigned int index)
+{
+    if (static_cast<unsigned int>(_numQueued)==0) return false;
+
+    ref_ptr<Task> task;
+
+    // newest task from our own queue first, as its data is most likely to still be in cache.
+    {
+        TaskQueue* queue = _queues[index];
+        OpenThreads::ScopedLock<OpenThreads::Mutex> lock(queue->_mutex);
+        if (!queue->_tasks.empty())
+        {
+            task = queue->_tasks.back();
+            queue->_tasks.pop_back();
+        }
+    }
+
+    // then steal the oldest task from the other queues, starting with the shared queue.
+    for(unsigned int i=0; !task && i<_queues.size(); ++i)
+    {
+        TaskQueue* queue = _queues[_queues.size()-1-i];
+        if (queue==_queues[index]) continue;
+
+        OpenThreads::ScopedLock<OpenThreads::Mutex> lock(queue->_mutex);
+        if (!queue->_tasks.empty())
+        {
+            task = queue->_tasks.front();
+            queue->_tasks.pop_front();
+        }
+    }
+
+    if (!task) return false;
+
+    --_numQueued;
+    runTask(task.get());
+    return true;
+}
+
+void TaskScheduler::runTask(Task* task)
+{
+    task->run();
+
+    ref_ptr<TaskGroup> group;
+    group.swap(task->_group);
+
+    if (--(group->_numPending)==0)
+    {
+        OpenThreads::ScopedLock<OpenThreads::Mutex> lock(group->_mutex);
+        group->_condition.broadcast();
+    }
+}
@@ -19,10 +19,84 @@
 #include <osgAnimation/BoneMapVisitor>
 #include <osgAnimation/RigGeometry>
 
+#include <osg/TaskScheduler>
+
 #include <algorithm>
 
 using namespace osgAnimation;
 
+namespace
+{
+
+// minimum number of vertices skinned by each task, so small rigs aren't swamped by the scheduling cost.
+const unsigned int MIN_VERTICES_PER_SKINNING_TASK = 2048;
+
+/** Skins the positions and normals of a range of vertex groups. Each vertex belongs to exactly one group,
+  * so ranges of groups write disjoint vertices and can be skinned concurrently.*/
+class SkinVertexGroups
+{
+public:
+    SkinVertexGroups(RigTransformSoftware::VertexGroup* groups,
+                     const osg::Matrix& transform, const osg::Matrix& invTransform,
+                     const osg::Vec3* positionSrc, osg::Vec3* positionDst,
+                     const osg::Vec3* normalSrc, osg::Vec3* normalDst):
+        _groups(groups),
+        _transform(transform),
+        _invTransform(invTransform),
+        _positionSrc(positionSrc),
+        _positionDst(positionDst),
+        _normalSrc(normalSrc),
+        _normalDst(normalDst) {}
+
+    void operator() (unsigned int first, unsigned int last)
+    {
+        for(unsigned int g=first; g<last; ++g)
+        {
+            RigTransformSoftware::VertexGroup& group = _groups[g];
+            group.computeMatrixForVertexSet();
+
+            // the group matrix is computed once for both positions and normals, then applied in float as the affine
+            // transform it is, so the loops below are straight multiply-adds the compiler can vectorize.
+            osg::Matrixf matrix(_transform * group.getMatrix() * _invTransform);
+            const float* m = matrix.ptr();
+
+            const IndexList& vertices = group.getVertices();
+            const unsigned int* indices = vertices.empty() ? 0 : &vertices.front();
+            unsigned int numVertices = static_cast<unsigned int>(vertices.size());
+
+            for(unsigned int i=0; i<numVertices; ++i)
+            {
+                const osg::Vec3& v = _positionSrc[indices[i]];
+                _positionDst[indices[i]].set(v.x()*m[0] + v.y()*m[4] + v.z()*m[8] + m[12],
+                                             v.x()*m[1] + v.y()*m[5] + v.z()*m[9] + m[13],
+                                             v.x()*m[2] + v.y()*m[6] + v.z()*m[10] + m[14]);
+            }
+
+            if (_normalSrc)
+            {
+                for(unsigned int i=0; i<numVertices; ++i)
+                {
+                    const osg::Vec3& n = _normalSrc[indices[i]];
+                    _normalDst[indices[i]].set(n.x()*m[0] + n.y()*m[4] + n.z()*m[8],
+                                               n.x()*m[1] + n.y()*m[5] + n.z()*m[9],
+                                               n.x()*m[2] + n.y()*m[6] + n.z()*m[10]);
+                }
+            }
+        }
+    }
+
+protected:
+    RigTransformSoftware::VertexGroup*  _groups;
+    const osg::Matrix&                  _transform;
+    const osg::Matrix&                  _invTransform;
+    const osg::Vec3*                    _positionSrc;
+    osg::Vec3*                          _positionDst;
+    const osg::Vec3*                    _normalSrc;
+    osg::Vec3*                          _normalDst;
+};
+
+}
+
 RigTransformSoftware::RigTransformSoftware()
 {
     _needInit = true;
@@ -247,20 +321,23 @@ void RigTransformSoftware::operator()(RigGeometry& geom)
     osg::Vec3Array* normalSrc = dynamic_cast<osg::Vec3Array*>(source.getNormalArray());
     osg::Vec3Array* normalDst = static_cast<osg::Vec3Array*>(destination.getNormalArray());
 
+    if (_uniqVertexGroupList.empty() || positionSrc->empty()) return;
 
-    compute<osg::Vec3>(geom.getMatrixFromSkeletonToGeometry(),
-                       geom.getInvMatrixFromSkeletonToGeometry(),
-                       &positionSrc->front(),
-                       &positionDst->front());    
-    positionDst->dirty();
+    SkinVertexGroups skinVertexGroups(&_uniqVertexGroupList.front(),
+                                      geom.getMatrixFromSkeletonToGeometry(),
+                                      geom.getInvMatrixFromSkeletonToGeometry(),
+                                      &positionSrc->front(),
+                                      &positionDst->front(),
+                                      normalSrc ? &normalSrc->front() : 0,
+                                      normalSrc ? &normalDst->front() : 0);
 
-    if (normalSrc )
-    {
-        computeNormal<osg::Vec3>(geom.getMatrixFromSkeletonToGeometry(),
-                                 geom.getInvMatrixFromSkeletonToGeometry(),
-                                 &normalSrc->front(),
-                                 &normalDst->front());
-        normalDst->dirty();
-    }
+    // split the groups into tasks of roughly MIN_VERTICES_PER_SKINNING_TASK vertices.
+    unsigned int numGroups = static_cast<unsigned int>(_uniqVertexGroupList.size());
+    unsigned int numVertices = static_cast<unsigned int>(positionSrc->size());
+    unsigned int grainSize = static_cast<unsigned int>((static_cast<unsigned long long>(numGroups)*MIN_VERTICES_PER_SKINNING_TASK)/numVertices);
+
+    osg::TaskScheduler::instance()->parallelFor(0, numGroups, skinVertexGroups, grainSize);
 
+    positionDst->dirty();
+    if (normalSrc) normalDst->dirty();
 }
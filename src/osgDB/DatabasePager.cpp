@@ -48,6 +48,9 @@ static osg::ApplicationUsageProxy DatabasePager_e3(osg::ApplicationUsage::ENVIRO
 static osg::ApplicationUsageProxy DatabasePager_e4(osg::ApplicationUsage::ENVIRONMENTAL_VARIABLE,"OSG_DATABASE_PAGER_PRIORITY <mode>", "Set the thread priority to DEFAULT, MIN, LOW, NOMINAL, HIGH or MAX.");
 static osg::ApplicationUsageProxy DatabasePager_e11(osg::ApplicationUsage::ENVIRONMENTAL_VARIABLE,"OSG_MAX_PAGEDLOD <num>","Set the target maximum number of PagedLOD to maintain.");
 static osg::ApplicationUsageProxy DatabasePager_e12(osg::ApplicationUsage::ENVIRONMENTAL_VARIABLE,"OSG_ASSIGN_PBO_TO_IMAGES <ON/OFF>","Set whether PixelBufferObjects should be assigned to Images to aid download to the GPU.");
+static osg::ApplicationUsageProxy DatabasePager_e14(osg::ApplicationUsage::ENVIRONMENTAL_VARIABLE,"OSG_DATABASE_PAGER_MAX_CPU_MEMORY <megabytes>","Set the target maximum CPU memory to be used by paged subgraphs.");
+static osg::ApplicationUsageProxy DatabasePager_e15(osg::ApplicationUsage::ENVIRONMENTAL_VARIABLE,"OSG_DATABASE_PAGER_MAX_GPU_MEMORY <megabytes>","Set the target maximum GPU memory to be used by paged subgraphs.");
+static osg::ApplicationUsageProxy DatabasePager_e13(osg::ApplicationUsage::ENVIRONMENTAL_VARIABLE,"OSG_DATABASE_PAGER_WORK_STEALING <ON/OFF>","Set whether the file reading threads keep local request queues and steal requests from each other.");
 
 
 /////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -130,6 +133,34 @@ private:
     }
 };
 
+// Helper for removing the memory accounted to loaded subgraphs, including those nested within a removed subgraph.
+class DatabasePager::ReleaseMemoryVisitor : public osg::NodeVisitor
+{
+public:
+    ReleaseMemoryVisitor(DatabasePager* pager):
+        osg::NodeVisitor(osg::NodeVisitor::TRAVERSE_ALL_CHILDREN),
+        _pager(pager)
+    {
+    }
+
+    META_NodeVisitor("osgDB","ReleaseMemoryVisitor")
+
+    virtual void apply(osg::Node& node)
+    {
+        DatabasePager::LoadedSubgraphMap::iterator itr = _pager->_loadedSubgraphs.find(&node);
+        if (itr != _pager->_loadedSubgraphs.end())
+        {
+            _pager->_estimatedMemoryUsage.first -= itr->second._memoryCost.first;
+            _pager->_estimatedMemoryUsage.second -= itr->second._memoryCost.second;
+            _pager->_loadedSubgraphs.erase(itr);
+        }
+
+        traverse(node);
+    }
+
+    DatabasePager* _pager;
+};
+
 /////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 //
 //  SetBasedPagedLODList
@@ -344,22 +375,6 @@ protected:
 };
 
 
-/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
-//
-//  SortFileRequestFunctor
-//
-struct DatabasePager::SortFileRequestFunctor
-{
-    bool operator() (const osg::ref_ptr<DatabasePager::DatabaseRequest>& lhs,const osg::ref_ptr<DatabasePager::DatabaseRequest>& rhs) const
-    {
-        if (lhs->_timestampLastRequest>rhs->_timestampLastRequest) return true;
-        else if (lhs->_timestampLastRequest<rhs->_timestampLastRequest) return false;
-        else return (lhs->_priorityLastRequest>rhs->_priorityLastRequest);
-    }
-};
-
-
-
 /////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 //
 //  DatabaseRequest
@@ -386,10 +401,11 @@ DatabasePager::RequestQueue::RequestQueue(DatabasePager* pager):
 DatabasePager::RequestQueue::~RequestQueue()
 {
     OSG_INFO<<"DatabasePager::RequestQueue::~RequestQueue() Destructing queue."<<std::endl;
-    for(RequestList::iterator itr = _requestList.begin();
-        itr != _requestList.end();
+    for(RequestHeap::iterator itr = _requestHeap.begin();
+        itr != _requestHeap.end();
         ++itr)
     {
+        (*itr)->_requestQueue = 0;
         invalidate(itr->get());
     }
 }
@@ -408,6 +424,76 @@ void DatabasePager::RequestQueue::invalidate(DatabaseRequest* dr)
     dr->invalidate();
 }
 
+void DatabasePager::RequestQueue::heapSiftUp(unsigned int index)
+{
+    while(index>0)
+    {
+        unsigned int parent = (index-1)/2;
+        if (!higherPriority(_requestHeap[index].get(), _requestHeap[parent].get())) break;
+
+        heapSwap(index, parent);
+        index = parent;
+    }
+}
+
+void DatabasePager::RequestQueue::heapSiftDown(unsigned int index)
+{
+    unsigned int size = _requestHeap.size();
+    for(;;)
+    {
+        unsigned int selected = index;
+        unsigned int left = index*2+1;
+        unsigned int right = left+1;
+
+        if (left<size && higherPriority(_requestHeap[left].get(), _requestHeap[selected].get())) selected = left;
+        if (right<size && higherPriority(_requestHeap[right].get(), _requestHeap[selected].get())) selected = right;
+        if (selected==index) break;
+
+        heapSwap(index, selected);
+        index = selected;
+    }
+}
+
+void DatabasePager::RequestQueue::heapUpdate(unsigned int index)
+{
+    if (index>0 && higherPriority(_requestHeap[index].get(), _requestHeap[(index-1)/2].get())) heapSiftUp(index);
+    else heapSiftDown(index);
+}
+
+void DatabasePager::RequestQueue::heapPush(DatabaseRequest* databaseRequest)
+{
+    databaseRequest->_requestQueue = this;
+    databaseRequest->_requestQueueIndex = _requestHeap.size();
+    databaseRequest->_requestQueueTimestamp = databaseRequest->_timestampLastRequest;
+    databaseRequest->_requestQueuePriority = databaseRequest->_priorityLastRequest;
+
+    _requestHeap.push_back(databaseRequest);
+    heapSiftUp(databaseRequest->_requestQueueIndex);
+}
+
+void DatabasePager::RequestQueue::heapErase(unsigned int index)
+{
+    unsigned int last = _requestHeap.size()-1;
+    if (index!=last) heapSwap(index, last);
+
+    _requestHeap.back()->_requestQueue = 0;
+    _requestHeap.pop_back();
+
+    if (index<_requestHeap.size()) heapUpdate(index);
+}
+
+void DatabasePager::RequestQueue::heapMake()
+{
+    for(unsigned int i=0; i<_requestHeap.size(); ++i)
+    {
+        _requestHeap[i]->_requestQueueIndex = i;
+    }
+
+    for(unsigned int i=_requestHeap.size()/2; i>0; --i)
+    {
+        heapSiftDown(i-1);
+    }
+}
 
 bool DatabasePager::RequestQueue::pruneOldRequestsAndCheckIfEmpty()
 {
@@ -416,57 +502,69 @@ bool DatabasePager::RequestQueue::pruneOldRequestsAndCheckIfEmpty()
     unsigned int frameNumber = _pager->_frameNumber;
     if (_frameNumberLastPruned != frameNumber)
     {
-        for(RequestQueue::RequestList::iterator citr = _requestList.begin();
-            citr != _requestList.end();
-            )
+        OpenThreads::ScopedLock<OpenThreads::Mutex> drLock(_pager->_dr_mutex);
+
+        RequestHeap::iterator last = _requestHeap.begin();
+        for(RequestHeap::iterator citr = _requestHeap.begin();
+            citr != _requestHeap.end();
+            ++citr)
         {
-            OpenThreads::ScopedLock<OpenThreads::Mutex> drLock(_pager->_dr_mutex);
             if ((*citr)->isRequestCurrent(frameNumber))
             {
-                ++citr;
+                if (last!=citr) last->swap(*citr);
+                ++last;
             }
             else
             {
+                (*citr)->_requestQueue = 0;
                 invalidate(citr->get());
 
                 OSG_INFO<<"DatabasePager::RequestQueue::pruneOldRequestsAndCheckIfEmpty(): Pruning "<<(*citr)<<std::endl;
-                citr = _requestList.erase(citr);
             }
         }
 
+        if (last!=_requestHeap.end())
+        {
+            _requestHeap.erase(last, _requestHeap.end());
+            heapMake();
+        }
+
         _frameNumberLastPruned = frameNumber;
 
         updateBlock();
     }
 
-    return _requestList.empty();
+    return _requestHeap.empty();
 }
 
 bool DatabasePager::RequestQueue::empty()
 {
     OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_requestMutex);
-    return _requestList.empty();
+    return _requestHeap.empty();
 }
 
 unsigned int DatabasePager::RequestQueue::size()
 {
     OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_requestMutex);
-    return _requestList.size();
+    return _requestHeap.size();
 }
 
 void DatabasePager::RequestQueue::clear()
 {
     OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_requestMutex);
 
-    for(RequestList::iterator citr = _requestList.begin();
-        citr != _requestList.end();
-        ++citr)
     {
         OpenThreads::ScopedLock<OpenThreads::Mutex> drLock(_pager->_dr_mutex);
-        invalidate(citr->get());
+        for(RequestHeap::iterator citr = _requestHeap.begin();
+            citr != _requestHeap.end();
+            ++citr)
+        {
+            (*citr)->_requestQueue = 0;
+            invalidate(citr->get());
+        }
     }
 
-    _requestList.clear();
+    _requestHeap.clear();
 
     _frameNumberLastPruned = _pager->_frameNumber;
 
@@ -485,79 +583,116 @@ void DatabasePager::RequestQueue::remove(DatabasePager::DatabaseRequest* databas
 {
     // OSG_NOTICE<<"DatabasePager::RequestQueue::remove(DatabaseRequest* databaseRequest)"<<std::endl;
     OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_requestMutex);
-    for(RequestList::iterator citr = _requestList.begin();
-        citr != _requestList.end();
-        ++citr)
+    OpenThreads::ScopedLock<OpenThreads::Mutex> drLock(_pager->_dr_mutex);
+    if (databaseRequest->_requestQueue==this)
     {
-        if (citr->get()==databaseRequest)
-        {
-            // OSG_NOTICE<<"  done remove(DatabaseRequest* databaseRequest)"<<std::endl;
-            _requestList.erase(citr);
-            return;
-        }
+        // OSG_NOTICE<<"  done remove(DatabaseRequest* databaseRequest)"<<std::endl;
+        heapErase(databaseRequest->_requestQueueIndex);
     }
 }
 
 
 void DatabasePager::RequestQueue::addNoLock(DatabasePager::DatabaseRequest* databaseRequest)
 {
-    _requestList.push_back(databaseRequest);
+    {
+        OpenThreads::ScopedLock<OpenThreads::Mutex> drLock(_pager->_dr_mutex);
+        if (databaseRequest->_requestQueue==this)
+        {
+            // already queued so just reflect any change in the request's priority.
+            databaseRequest->_requestQueueTimestamp = databaseRequest->_timestampLastRequest;
+            databaseRequest->_requestQueuePriority = databaseRequest->_priorityLastRequest;
+            heapUpdate(databaseRequest->_requestQueueIndex);
+        }
+        else
+        {
+            heapPush(databaseRequest);
+        }
+    }
     updateBlock();
 }
 
-void DatabasePager::RequestQueue::swap(RequestList& requestList)
+void DatabasePager::RequestQueue::updatePriority(DatabasePager::DatabaseRequest* databaseRequest)
 {
     OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_requestMutex);
-    _requestList.swap(requestList);
+    OpenThreads::ScopedLock<OpenThreads::Mutex> drLock(_pager->_dr_mutex);
+    if (databaseRequest->_requestQueue==this)
+    {
+        databaseRequest->_requestQueueTimestamp = databaseRequest->_timestampLastRequest;
+        databaseRequest->_requestQueuePriority = databaseRequest->_priorityLastRequest;
+        heapUpdate(databaseRequest->_requestQueueIndex);
+    }
 }
 
-void DatabasePager::RequestQueue::takeFirst(osg::ref_ptr<DatabaseRequest>& databaseRequest)
+void DatabasePager::RequestQueue::swap(RequestList& requestList)
 {
     OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_requestMutex);
+    OpenThreads::ScopedLock<OpenThreads::Mutex> drLock(_pager->_dr_mutex);
 
-    if (!_requestList.empty())
+    // hand back the queued requests highest priority first, as the front of the list would have been taken first.
+    RequestHeap previousRequests;
+    previousRequests.swap(_requestHeap);
+    std::sort(previousRequests.begin(), previousRequests.end(), HigherPriority());
+
+    for(RequestList::iterator citr = requestList.begin();
+        citr != requestList.end();
+        ++citr)
     {
-        DatabasePager::SortFileRequestFunctor highPriority;
+        (*citr)->_requestQueueTimestamp = (*citr)->_timestampLastRequest;
+        (*citr)->_requestQueuePriority = (*citr)->_priorityLastRequest;
+        (*citr)->_requestQueue = this;
+        _requestHeap.push_back(*citr);
+    }
+    heapMake();
 
-        RequestQueue::RequestList::iterator selected_itr = _requestList.end();
+    requestList.clear();
+    for(RequestHeap::iterator citr = previousRequests.begin();
+        citr != previousRequests.end();
+        ++citr)
+    {
+        (*citr)->_requestQueue = 0;
+        requestList.push_back(*citr);
+    }
+}
 
+void DatabasePager::RequestQueue::takeFirst(osg::ref_ptr<DatabaseRequest>& databaseRequest)
+{
+    OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_requestMutex);
+
+    if (!_requestHeap.empty())
+    {
         int frameNumber = _pager->_frameNumber;
 
-        for(RequestQueue::RequestList::iterator citr = _requestList.begin();
-            citr != _requestList.end();
-            )
         {
             OpenThreads::ScopedLock<OpenThreads::Mutex> drLock(_pager->_dr_mutex);
-            if ((*citr)->isRequestCurrent(frameNumber))
+
+            // requests are ordered on the time stamp of their last request so stale requests sink to the
+            // bottom of the heap, prune them as they reach the top rather than walking the whole queue.
+            while(!_requestHeap.empty())
             {
-                if (selected_itr==_requestList.end() || highPriority(*citr, *selected_itr))
+                osg::ref_ptr<DatabaseRequest> front = _requestHeap.front();
+                heapErase(0);
+
+                if (front->isRequestCurrent(frameNumber))
                 {
-                    selected_itr = citr;
+                    databaseRequest.swap(front);
+                    break;
                 }
 
-                ++citr;
-            }
-            else
-            {
-                invalidate(citr->get());
+                invalidate(front.get());
 
-                OSG_INFO<<"DatabasePager::RequestQueue::takeFirst(): Pruning "<<(*citr)<<std::endl;
-                citr = _requestList.erase(citr);
+                OSG_INFO<<"DatabasePager::RequestQueue::takeFirst(): Pruning "<<front.get()<<std::endl;
             }
-
         }
 
-        _frameNumberLastPruned = frameNumber;
-
-        if (selected_itr != _requestList.end())
+        if (databaseRequest.valid())
         {
-            databaseRequest = *selected_itr;
-            _requestList.erase(selected_itr);
-            OSG_INFO<<" DatabasePager::RequestQueue::takeFirst() Found DatabaseRequest size()="<<_requestList.size()<<std::endl;
+            OSG_INFO<<" DatabasePager::RequestQueue::takeFirst() Found DatabaseRequest size()="<<_requestHeap.size()<<std::endl;
         }
         else
         {
-            OSG_INFO<<" DatabasePager::RequestQueue::takeFirst() No suitable DatabaseRequest found size()="<<_requestList.size()<<std::endl;
+            _frameNumberLastPruned = frameNumber;
+
+            OSG_INFO<<" DatabasePager::RequestQueue::takeFirst() No suitable DatabaseRequest found size()="<<_requestHeap.size()<<std::endl;
         }
 
         updateBlock();
@@ -568,17 +703,26 @@ void DatabasePager::RequestQueue::takeFirst(osg::ref_ptr<DatabaseRequest>& datab
 //
 //  ReadQueue
 //
-DatabasePager::ReadQueue::ReadQueue(DatabasePager* pager, const std::string& name):
+DatabasePager::ReadQueue::ReadQueue(DatabasePager* pager, const std::string& name, osg::RefBlock* sharedBlock):
     RequestQueue(pager),
-    _name(name)
+    _name(name),
+    _pooled(sharedBlock!=0),
+    _hasWork(false)
 {
-    _block = new osg::RefBlock;
+    _block = sharedBlock ? sharedBlock : new osg::RefBlock;
 }
 
 void DatabasePager::ReadQueue::updateBlock()
 {
-    _block->set((!_requestList.empty() || !_childrenToDeleteList.empty()) &&
-                !_pager->_databasePagerThreadPaused);
+    bool hasWork = !_requestHeap.empty() || !_childrenToDeleteList.empty();
+    if (_pooled)
+    {
+        _pager->updatePooledReadQueueBlock(this, hasWork);
+    }
+    else
+    {
+        _block->set(hasWork && !_pager->_databasePagerThreadPaused);
+    }
 }
 
 /////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -590,7 +734,8 @@ DatabasePager::DatabaseThread::DatabaseThread(DatabasePager* pager, Mode mode, c
     _active(false),
     _pager(pager),
     _mode(mode),
-    _name(name)
+    _name(name),
+    _localQueueIndex(-1)
 {
 }
 
@@ -599,7 +744,8 @@ DatabasePager::DatabaseThread::DatabaseThread(const DatabaseThread& dt, Database
     _active(false),
     _pager(pager),
     _mode(dt._mode),
-    _name(dt._name)
+    _name(dt._name),
+    _localQueueIndex(-1)
 {
 }
 
@@ -648,6 +794,7 @@ void DatabasePager::DatabaseThread::run()
 
     osg::ref_ptr<DatabasePager::ReadQueue> read_queue;
     osg::ref_ptr<DatabasePager::ReadQueue> out_queue;
+    osg::ref_ptr<DatabasePager::ReadQueue> delete_queue;
 
     switch(_mode)
     {
@@ -663,6 +810,14 @@ void DatabasePager::DatabaseThread::run()
             break;
     }
 
+    // removed subgraphs are always passed to the _fileRequestQueue, even when reading from a local queue.
+    delete_queue = read_queue;
+
+    if (_localQueueIndex>=0)
+    {
+        read_queue = _pager->getLocalFileRequestQueues()->_queues[_localQueueIndex];
+    }
+
 
     do
     {
@@ -677,7 +832,7 @@ void DatabasePager::DatabaseThread::run()
 
         _active = true;
 
-        OSG_INFO<<_name<<": _pager->size()= "<<read_queue->size()<<" to delete = "<<read_queue->_childrenToDeleteList.size()<<std::endl;
+        OSG_INFO<<_name<<": _pager->size()= "<<read_queue->size()<<" to delete = "<<delete_queue->_childrenToDeleteList.size()<<std::endl;
 
 
 
@@ -689,11 +844,11 @@ void DatabasePager::DatabaseThread::run()
             ObjectList deleteList;
             {
                 // Don't hold lock during destruction of deleteList
-                OpenThreads::ScopedLock<OpenThreads::Mutex> lock(read_queue->_requestMutex);
-                if (!read_queue->_childrenToDeleteList.empty())
+                OpenThreads::ScopedLock<OpenThreads::Mutex> lock(delete_queue->_requestMutex);
+                if (!delete_queue->_childrenToDeleteList.empty())
                 {
-                    deleteList.swap(read_queue->_childrenToDeleteList);
-                    read_queue->updateBlock();
+                    deleteList.swap(delete_queue->_childrenToDeleteList);
+                    delete_queue->updateBlock();
                 }
             }
         }
@@ -702,7 +857,8 @@ void DatabasePager::DatabaseThread::run()
         // load any subgraphs that are required.
         //
         osg::ref_ptr<DatabaseRequest> databaseRequest;
-        read_queue->takeFirst(databaseRequest);
+        if (_localQueueIndex>=0) _pager->takeFirstLocalFileRequest(_localQueueIndex, databaseRequest);
+        else read_queue->takeFirst(databaseRequest);
 
         bool readFromFileCache = false;
 
@@ -871,6 +1027,8 @@ void DatabasePager::DatabaseThread::run()
                 fileCache->writeNode(*(loadedModel), fileName, dr_loadOptions.get());
             }
 
+            // the cull traversal updates the request's priority, so take a copy of it while the request is locked.
+            float priorityLastRequest = 0.0f;
             {
                 OpenThreads::ScopedLock<OpenThreads::Mutex> drLock(_pager->_dr_mutex);
                 if ((_pager->_frameNumber-databaseRequest->_frameNumberLastRequest)>1)
@@ -878,6 +1036,7 @@ void DatabasePager::DatabaseThread::run()
                     OSG_INFO<<_name<<": Warning DatabaseRquest no longer required."<<std::endl;
                     loadedModel = 0;
                 }
+                priorityLastRequest = databaseRequest->_priorityLastRequest;
             }
 
             //OSG_NOTICE<<"     node read in "<<osg::Timer::instance()->delta_m(before,osg::Timer::instance()->tick())<<" ms"<<std::endl;
@@ -886,6 +1045,13 @@ void DatabasePager::DatabaseThread::run()
             {
                 loadedModel->getBound();
 
+                osg::CostPair memoryCost(0.0, 0.0);
+                osg::ref_ptr<osg::GraphicsCostEstimator> gce = _pager->_graphicsCostEstimator;
+                if (_pager->memoryTargetSet() && gce.valid())
+                {
+                    memoryCost = gce->estimateMemoryCost(loadedModel.get());
+                }
+
                 bool loadedObjectsNeedToBeCompiled = false;
                 osg::ref_ptr<osgUtil::IncrementalCompileOperation::CompileSet> compileSet = 0;
                 if (!rr.loadedFromCache())
@@ -907,6 +1073,7 @@ void DatabasePager::DatabaseThread::run()
                         compileSet = new osgUtil::IncrementalCompileOperation::CompileSet(loadedModel.get());
                         compileSet->buildCompileMap(_pager->_incrementalCompileOperation->getContextSet(), stateToCompile);
                         compileSet->_compileCompletedCallback = new DatabasePagerCompileCompletedCallback(_pager, databaseRequest.get());
+                        compileSet->_priority = priorityLastRequest;
                         _pager->_incrementalCompileOperation->add(compileSet.get(), false);
                     }
                 }
@@ -920,6 +1087,7 @@ void DatabasePager::DatabaseThread::run()
                     OpenThreads::ScopedLock<OpenThreads::Mutex> drLock(_pager->_dr_mutex);
                     databaseRequest->_loadedModel = loadedModel;
                     databaseRequest->_compileSet = compileSet;
+                    databaseRequest->_memoryCost = memoryCost;
                 }
                 // Dereference the databaseRequest while the queue is
                 // locked. This prevents the request from being
@@ -1039,6 +1207,20 @@ DatabasePager::DatabasePager()
         OSG_NOTICE<<"_targetMaximumNumberOfPageLOD = "<<_targetMaximumNumberOfPageLOD<<std::endl;
     }
 
+    _targetMaximumMemoryUsage = osg::CostPair(0.0, 0.0);
+    _estimatedMemoryUsage = osg::CostPair(0.0, 0.0);
+    if( (str = getenv("OSG_DATABASE_PAGER_MAX_CPU_MEMORY")) != 0)
+    {
+        _targetMaximumMemoryUsage.first = osg::asciiToDouble(str)*1024.0*1024.0;
+        OSG_NOTICE<<"_targetMaximumMemoryUsage.first = "<<_targetMaximumMemoryUsage.first<<std::endl;
+    }
+    if( (str = getenv("OSG_DATABASE_PAGER_MAX_GPU_MEMORY")) != 0)
+    {
+        _targetMaximumMemoryUsage.second = osg::asciiToDouble(str)*1024.0*1024.0;
+        OSG_NOTICE<<"_targetMaximumMemoryUsage.second = "<<_targetMaximumMemoryUsage.second<<std::endl;
+    }
+    _graphicsCostEstimator = new osg::GraphicsCostEstimator;
+
 
     _doPreCompile = true;
     if( (str = getenv("OSG_DO_PRE_COMPILE")) != 0)
@@ -1047,10 +1229,18 @@ DatabasePager::DatabasePager()
                         strcmp(str,"on")==0 || strcmp(str,"ON")==0;
     }
 
+    _workStealing = false;
+    if( (str = getenv("OSG_DATABASE_PAGER_WORK_STEALING")) != 0)
+    {
+        _workStealing = strcmp(str,"yes")==0 || strcmp(str,"YES")==0 ||
+                        strcmp(str,"on")==0 || strcmp(str,"ON")==0;
+    }
+
     // initialize the stats variables
     resetStats();
 
     _fileRequestQueue = new ReadQueue(this,"fileRequestQueue");
+    _localFileRequestQueues = new LocalFileRequestQueues;
     _httpRequestQueue = new ReadQueue(this,"httpRequestQueue");
 
     _dataToCompileList = new RequestQueue(this);
@@ -1120,9 +1310,16 @@ DatabasePager::DatabasePager(const DatabasePager& rhs)
 
     _targetMaximumNumberOfPageLOD = rhs._targetMaximumNumberOfPageLOD;
 
+    _targetMaximumMemoryUsage = rhs._targetMaximumMemoryUsage;
+    _estimatedMemoryUsage = osg::CostPair(0.0, 0.0);
+    _graphicsCostEstimator = rhs._graphicsCostEstimator;
+
     _doPreCompile = rhs._doPreCompile;
 
+    _workStealing = rhs._workStealing;
+
     _fileRequestQueue = new ReadQueue(this,"fileRequestQueue");
+    _localFileRequestQueues = new LocalFileRequestQueues;
     _httpRequestQueue = new ReadQueue(this,"httpRequestQueue");
 
     _dataToCompileList = new RequestQueue(this);
@@ -1132,7 +1329,9 @@ DatabasePager::DatabasePager(const DatabasePager& rhs)
         dt_itr != rhs._databaseThreads.end();
         ++dt_itr)
     {
-        _databaseThreads.push_back(new DatabaseThread(**dt_itr,this));
+        DatabaseThread* thread = new DatabaseThread(**dt_itr,this);
+        assignLocalFileRequestQueue(thread);
+        _databaseThreads.push_back(thread);
     }
 
     setProcessorAffinity(rhs.getProcessorAffinity());
@@ -1167,6 +1366,7 @@ DatabasePager::~DatabasePager()
     _databaseThreads.clear();
 
     // destruct all the queues
+    setLocalFileRequestQueues(new LocalFileRequestQueues);
     _fileRequestQueue = 0;
     _httpRequestQueue = 0;
     _dataToCompileList = 0;
@@ -1210,6 +1410,15 @@ void DatabasePager::setUpThreads(unsigned int totalNumThreads, unsigned int numH
 {
     _databaseThreads.clear();
 
+    osg::ref_ptr<LocalFileRequestQueues> localQueues = getLocalFileRequestQueues();
+    for(ReadQueueList::iterator itr = localQueues->_queues.begin();
+        itr != localQueues->_queues.end();
+        ++itr)
+    {
+        (*itr)->clear();
+    }
+    setLocalFileRequestQueues(new LocalFileRequestQueues);
+
     unsigned int numGeneralThreads = numHttpThreads < totalNumThreads ?
         totalNumThreads - numHttpThreads :
         1;
@@ -1245,6 +1454,8 @@ unsigned int DatabasePager::addDatabaseThread(DatabaseThread::Mode mode, const s
 
     thread->setProcessorAffinity(_affinity);
 
+    assignLocalFileRequestQueue(thread);
+
     _databaseThreads.push_back(thread);
 
     if (_startThreadCalled)
@@ -1313,16 +1524,128 @@ void DatabasePager::clear()
     _fileRequestQueue->clear();
     _httpRequestQueue->clear();
 
+    osg::ref_ptr<LocalFileRequestQueues> localQueues = getLocalFileRequestQueues();
+    for(ReadQueueList::iterator itr = localQueues->_queues.begin();
+        itr != localQueues->_queues.end();
+        ++itr)
+    {
+        (*itr)->clear();
+    }
+
     _dataToCompileList->clear();
     _dataToMergeList->clear();
 
     // note, no need to use a mutex as the list is only accessed from the update thread.
     _activePagedLODList->clear();
 
+    _loadedSubgraphs.clear();
+    _estimatedMemoryUsage = osg::CostPair(0.0, 0.0);
+
     // ??
     // _activeGraphicsContexts
 }
 
+void DatabasePager::assignLocalFileRequestQueue(DatabaseThread* thread)
+{
+    if (!_workStealing || thread->_mode==DatabaseThread::HANDLE_ONLY_HTTP) return;
+
+    {
+        // the _fileRequestQueue joins the pool, sharing its block with the local queues
+        OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_fileRequestQueue->_requestMutex);
+        _fileRequestQueue->_pooled = true;
+        _fileRequestQueue->updateBlock();
+    }
+
+    // copy the list rather than adding to it, as other threads may be reading it.
+    osg::ref_ptr<LocalFileRequestQueues> localQueues = new LocalFileRequestQueues(*getLocalFileRequestQueues());
+    thread->_localQueueIndex = static_cast<int>(localQueues->_queues.size());
+    localQueues->_queues.push_back(new ReadQueue(this, thread->getName()+"_localFileRequestQueue", _fileRequestQueue->_block.get()));
+    setLocalFileRequestQueues(localQueues.get());
+}
+
+osg::ref_ptr<DatabasePager::LocalFileRequestQueues> DatabasePager::getLocalFileRequestQueues() const
+{
+    OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_localFileRequestQueuesMutex);
+    return _localFileRequestQueues;
+}
+
+void DatabasePager::setLocalFileRequestQueues(LocalFileRequestQueues* queues)
+{
+    osg::ref_ptr<LocalFileRequestQueues> previous;
+    OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_localFileRequestQueuesMutex);
+    previous.swap(_localFileRequestQueues);
+    _localFileRequestQueues = queues;
+}
+
+osg::ref_ptr<DatabasePager::ReadQueue> DatabasePager::selectFileRequestQueue(const osg::NodePath& nodePath)
+{
+    osg::ref_ptr<LocalFileRequestQueues> localQueues = getLocalFileRequestQueues();
+    if (localQueues->_queues.empty()) return _fileRequestQueue;
+
+    // key on the parent of the requesting PagedLOD so that sibling tiles are read by the same thread.
+    const osg::Node* parent = nodePath.size()>=2 ? nodePath[nodePath.size()-2] : nodePath.back();
+
+    std::size_t key = reinterpret_cast<std::size_t>(parent);
+    key ^= (key>>17);
+    key *= 0x9E3779B1u;
+    key ^= (key>>15);
+
+    return localQueues->_queues[key % localQueues->_queues.size()];
+}
+
+void DatabasePager::takeFirstLocalFileRequest(int localQueueIndex, osg::ref_ptr<DatabaseRequest>& databaseRequest)
+{
+    osg::ref_ptr<LocalFileRequestQueues> localQueues = getLocalFileRequestQueues();
+    localQueues->_queues[localQueueIndex]->takeFirst(databaseRequest);
+    if (databaseRequest.valid()) return;
+
+    // requests resubmitted or added before the pool was set up are held in the shared queue
+    _fileRequestQueue->takeFirst(databaseRequest);
+    if (databaseRequest.valid()) return;
+
+    unsigned int numQueues = localQueues->_queues.size();
+    for(unsigned int i=1; i<numQueues; ++i)
+    {
+        localQueues->_queues[(localQueueIndex+i)%numQueues]->takeFirst(databaseRequest);
+        if (databaseRequest.valid())
+        {
+            OSG_INFO<<"DatabasePager: thread "<<localQueueIndex<<" stole request from queue "<<(localQueueIndex+i)%numQueues<<std::endl;
+            return;
+        }
+    }
+}
+
+void DatabasePager::updatePooledReadQueueBlock(ReadQueue* queue, bool hasWork)
+{
+    OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_pooledReadQueueBlockMutex);
+
+    queue->_hasWork = hasWork;
+
+    osg::ref_ptr<LocalFileRequestQueues> localQueues = getLocalFileRequestQueues();
+    bool poolHasWork = _fileRequestQueue->_hasWork;
+    for(ReadQueueList::iterator itr = localQueues->_queues.begin();
+        itr != localQueues->_queues.end() && !poolHasWork;
+        ++itr)
+    {
+        poolHasWork = (*itr)->_hasWork;
+    }
+
+    _fileRequestQueue->_block->set(poolHasWork && !_databasePagerThreadPaused);
+}
+
+unsigned int DatabasePager::getFileRequestListSize() const
+{
+    unsigned int size = _fileRequestQueue->size() + _httpRequestQueue->size();
+    osg::ref_ptr<LocalFileRequestQueues> localQueues = getLocalFileRequestQueues();
+    for(ReadQueueList::const_iterator itr = localQueues->_queues.begin();
+        itr != localQueues->_queues.end();
+        ++itr)
+    {
+        size += (*itr)->size();
+    }
+    return size;
+}
+
 void DatabasePager::resetStats()
 {
     // initialize the stats variables
@@ -1415,6 +1738,7 @@ void DatabasePager::requestNodeFile(const std::string& fileName, osg::NodePath&
     {
         DatabaseRequest* databaseRequest = dynamic_cast<DatabaseRequest*>(databaseRequestRef.get());
         bool requeue = false;
+        osg::ref_ptr<RequestQueue> requestQueue;
         if (databaseRequest)
         {
             OpenThreads::ScopedLock<OpenThreads::Mutex> drLock(_dr_mutex);
@@ -1436,6 +1760,20 @@ void DatabasePager::requestNodeFile(const std::string& fileName, osg::NodePath&
 
                 foundEntry = true;
 
+                // keep the priority of a subgraph waiting to be compiled in step with the requests for it.
+                osg::ref_ptr<osgUtil::IncrementalCompileOperation::CompileSet> compileSet;
+                if (databaseRequest->_compileSet.lock(compileSet) && _incrementalCompileOperation.valid())
+                {
+                    _incrementalCompileOperation->setPriority(compileSet.get(), priority);
+                }
+
+                // if the sort key has changed the queue holding the request will need to reposition it.
+                if (databaseRequest->_requestQueue &&
+                    (databaseRequest->_requestQueueTimestamp!=timestamp || databaseRequest->_requestQueuePriority!=priority))
+                {
+                    requestQueue = databaseRequest->_requestQueue;
+                }
+
                 if (databaseRequestRef->referenceCount()==1)
                 {
                     OSG_INFO<<"DatabasePager::requestNodeFile("<<fileName<<") orphaned, resubmitting."<<std::endl;
@@ -1453,14 +1791,17 @@ void DatabasePager::requestNodeFile(const std::string& fileName, osg::NodePath&
             }
         }
         if (requeue)
-            _fileRequestQueue->add(databaseRequest);
+            selectFileRequestQueue(nodePath)->add(databaseRequest);
+        else if (requestQueue)
+            requestQueue->updatePriority(databaseRequest);
     }
 
     if (!foundEntry)
     {
         OSG_INFO<<"In DatabasePager::requestNodeFile("<<fileName<<")"<<std::endl;
 
-        OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_fileRequestQueue->_requestMutex);
+        osg::ref_ptr<ReadQueue> requestQueue = selectFileRequestQueue(nodePath);
+        OpenThreads::ScopedLock<OpenThreads::Mutex> lock(requestQueue->_requestMutex);
 
         if (!databaseRequestRef.valid() || databaseRequestRef->referenceCount()==1)
         {
@@ -1481,7 +1822,7 @@ void DatabasePager::requestNodeFile(const std::string& fileName, osg::NodePath&
             databaseRequest->_loadOptions = loadOptions;
             databaseRequest->_objectCache = 0;
 
-            _fileRequestQueue->addNoLock(databaseRequest.get());
+            requestQueue->addNoLock(databaseRequest.get());
         }
     }
 
@@ -1553,6 +1894,14 @@ void DatabasePager::setDatabasePagerThreadPause(bool pause)
         OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_httpRequestQueue->_requestMutex);
         _httpRequestQueue->updateBlock();
     }
+    osg::ref_ptr<LocalFileRequestQueues> localQueues = getLocalFileRequestQueues();
+    for(ReadQueueList::iterator itr = localQueues->_queues.begin();
+        itr != localQueues->_queues.end();
+        ++itr)
+    {
+        OpenThreads::ScopedLock<OpenThreads::Mutex> lock((*itr)->_requestMutex);
+        (*itr)->updateBlock();
+    }
 }
 
 
@@ -1561,6 +1910,80 @@ bool DatabasePager::requiresUpdateSceneGraph() const
     return (getDataToMergeListSize()>0);
 }
 
+void DatabasePager::releaseMemoryOfRemovedSubgraphs(const osg::NodeList& childrenRemoved)
+{
+    ReleaseMemoryVisitor rmv(this);
+    for(osg::NodeList::const_iterator itr = childrenRemoved.begin();
+        itr != childrenRemoved.end();
+        ++itr)
+    {
+        (*itr)->accept(rmv);
+    }
+}
+
+void DatabasePager::removeSubgraphsOverMemoryTarget(const osg::FrameStamp& frameStamp, ObjectList& childrenRemoved)
+{
+    double expiryTime = frameStamp.getReferenceTime() - 0.1;
+    unsigned int expiryFrame = frameStamp.getFrameNumber() - 1;
+
+    // collect the loaded subgraphs that are the last child of their PagedLOD, as only those can be expired.
+    typedef std::pair<unsigned int, osg::ref_ptr<osg::PagedLOD> > FramePagedLODPair;
+    typedef std::vector<FramePagedLODPair> Candidates;
+    Candidates candidates;
+
+    for(LoadedSubgraphMap::iterator itr = _loadedSubgraphs.begin();
+        itr != _loadedSubgraphs.end();
+        )
+    {
+        osg::ref_ptr<osg::Node> node;
+        osg::ref_ptr<osg::PagedLOD> plod;
+        if (!itr->second._node.lock(node) || !itr->second._pagedLOD.lock(plod) || node->getNumParents()==0)
+        {
+            // subgraph has been removed from the scene graph by other means than the pager.
+            _estimatedMemoryUsage.first -= itr->second._memoryCost.first;
+            _estimatedMemoryUsage.second -= itr->second._memoryCost.second;
+            _loadedSubgraphs.erase(itr++);
+            continue;
+        }
+
+        unsigned int numChildren = plod->getNumChildren();
+        if (numChildren>plod->getNumChildrenThatCannotBeExpired() &&
+            plod->getChild(numChildren-1)==node.get() &&
+            plod->getFrameNumber(numChildren-1)<expiryFrame)
+        {
+            candidates.push_back(FramePagedLODPair(plod->getFrameNumber(numChildren-1), plod));
+        }
+
+        ++itr;
+    }
+
+    // least recently traversed first
+    std::sort(candidates.begin(), candidates.end());
+
+    unsigned int numRemoved = 0;
+    for(Candidates::iterator itr = candidates.begin();
+        itr != candidates.end() && memoryTargetExceeded();
+        ++itr)
+    {
+        osg::PagedLOD* plod = itr->second.get();
+
+        ExpirePagedLODsVisitor expirePagedLODsVisitor;
+        osg::NodeList expiredChildren;
+        if (expirePagedLODsVisitor.removeExpiredChildrenAndFindPagedLODs(plod, expiryTime, expiryFrame, expiredChildren))
+        {
+            osg::NodeList childPagedLODs(expirePagedLODsVisitor._childPagedLODs.begin(), expirePagedLODsVisitor._childPagedLODs.end());
+            _activePagedLODList->removeNodes(childPagedLODs);
+
+            releaseMemoryOfRemovedSubgraphs(expiredChildren);
+
+            std::copy(expiredChildren.begin(), expiredChildren.end(), std::back_inserter(childrenRemoved));
+            ++numRemoved;
+        }
+    }
+
+    OSG_INFO<<"DatabasePager::removeSubgraphsOverMemoryTarget() removed "<<numRemoved<<" subgraphs, estimated memory usage CPU="<<_estimatedMemoryUsage.first<<" GPU="<<_estimatedMemoryUsage.second<<std::endl;
+}
+
 void DatabasePager::updateSceneGraph(const osg::FrameStamp& frameStamp)
 {
 
@@ -1657,6 +2080,16 @@ void DatabasePager::addLoadedDataToSceneGraph(const osg::FrameStamp &frameStamp)
 
             group->addChild(databaseRequest->_loadedModel.get());
 
+            if (plod && memoryTargetSet())
+            {
+                LoadedSubgraph& loadedSubgraph = _loadedSubgraphs[databaseRequest->_loadedModel.get()];
+                _estimatedMemoryUsage.first += databaseRequest->_memoryCost.first - loadedSubgraph._memoryCost.first;
+                _estimatedMemoryUsage.second += databaseRequest->_memoryCost.second - loadedSubgraph._memoryCost.second;
+                loadedSubgraph._node = databaseRequest->_loadedModel.get();
+                loadedSubgraph._pagedLOD = plod;
+                loadedSubgraph._memoryCost = databaseRequest->_memoryCost;
+            }
+
             // Check if parent plod was already registered if not start visitor from parent
             if( plod &&
                 !_activePagedLODList->containsPagedLOD( plod ) )
@@ -1746,7 +2179,9 @@ void DatabasePager::removeExpiredSubgraphs(const osg::FrameStamp& frameStamp)
     if (s_total_max_stage_a<time_a) s_total_max_stage_a = time_a;
 
 
-    if (numPagedLODs <= _targetMaximumNumberOfPageLOD)
+    bool overMemoryTarget = memoryTargetExceeded();
+
+    if (numPagedLODs <= _targetMaximumNumberOfPageLOD && !overMemoryTarget)
     {
         // nothing to do
         return;
@@ -1771,6 +2206,27 @@ void DatabasePager::removeExpiredSubgraphs(const osg::FrameStamp& frameStamp)
         _activePagedLODList->removeExpiredChildren(
             numToPrune, expiryTime, expiryFrame, childrenRemoved, true);
 
+    if (memoryTargetSet())
+    {
+        if (!childrenRemoved.empty())
+        {
+            osg::NodeList nodesRemoved;
+            for(ObjectList::iterator itr = childrenRemoved.begin();
+                itr != childrenRemoved.end();
+                ++itr)
+            {
+                osg::Node* node = dynamic_cast<osg::Node*>(itr->get());
+                if (node) nodesRemoved.push_back(node);
+            }
+            releaseMemoryOfRemovedSubgraphs(nodesRemoved);
+        }
+
+        if (memoryTargetExceeded())
+        {
+            removeSubgraphsOverMemoryTarget(frameStamp, childrenRemoved);
+        }
+    }
+
     osg::Timer_t end_b_Tick = osg::Timer::instance()->tick();
     double time_b = osg::Timer::instance()->delta_m(end_a_Tick,end_b_Tick);
 
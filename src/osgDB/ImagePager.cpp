@@ -16,9 +16,48 @@
 
 #include <osg/Notify>
 #include <osg/ImageSequence>
+#include <osg/ApplicationUsage>
+
+#include <stdlib.h>
 
 using namespace osgDB;
 
+static osg::ApplicationUsageProxy ImagePager_e0(osg::ApplicationUsage::ENVIRONMENTAL_VARIABLE,"OSG_IMAGE_PAGER_MAX_MEMORY <megabytes>","Set the target maximum memory of decoded images the image pager keeps resident for reuse.");
+
+/** Create a copy of a mipmapped 2D image holding just the mipmap levels no larger than maxSize in width and height,
+  * or return 0 if the image can't be reduced.*/
+static osg::Image* createReducedImage(const osg::Image* image, unsigned int maxSize)
+{
+    if (maxSize==0 || !image->isMipmap() || image->r()!=1 || !image->data()) return 0;
+
+    unsigned int level = 0;
+    unsigned int numLevels = image->getNumMipmapLevels();
+    while(level<numLevels && static_cast<unsigned int>(osg::maximum(image->s()>>level, image->t()>>level))>maxSize) ++level;
+    if (level==0 || level>=numLevels) return 0;
+
+    unsigned int offset = image->getMipmapOffset(level);
+    unsigned int totalSize = image->getTotalSizeInBytesIncludingMipmaps();
+    if (offset>=totalSize) return 0;
+
+    unsigned char* data = new unsigned char[totalSize-offset];
+    memcpy(data, image->data()+offset, totalSize-offset);
+
+    osg::Image::MipmapDataType mipmapData;
+    for(unsigned int i=level+1; i<numLevels; ++i)
+    {
+        mipmapData.push_back(image->getMipmapOffset(i)-offset);
+    }
+
+    osg::Image* reduced = new osg::Image;
+    reduced->setFileName(image->getFileName());
+    reduced->setOrigin(image->getOrigin());
+    reduced->setImage(osg::maximum(image->s()>>level, 1), osg::maximum(image->t()>>level, 1), 1,
+                      image->getInternalTextureFormat(), image->getPixelFormat(), image->getDataType(),
+                      data, osg::Image::USE_NEW_DELETE, image->getPacking());
+    reduced->setMipmapLevels(mipmapData);
+    return reduced;
+}
+
 
 /////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 //
@@ -210,31 +249,21 @@ void ImagePager::ImageThread::run()
 
         if (imageRequest.valid())
         {
-            // OSG_NOTICE<<"doing readImageFile("<<imageRequest->_fileName<<") index to assign = "<<imageRequest->_attachmentIndex<<std::endl;
-            osg::ref_ptr<osg::Image> image = osgDB::readRefImageFile(imageRequest->_fileName, imageRequest->_readOptions.get());
+            osg::ref_ptr<osg::Image> image;
+            if (!_pager->getResidentImage(imageRequest->_fileName, image))
+            {
+                // answer straight away with the resident lower mipmap levels while the full resolution image is read.
+                if (image.valid()) _pager->assignImage(imageRequest.get(), image.get());
+
+                // OSG_NOTICE<<"doing readImageFile("<<imageRequest->_fileName<<") index to assign = "<<imageRequest->_attachmentIndex<<std::endl;
+                image = osgDB::readRefImageFile(imageRequest->_fileName, imageRequest->_readOptions.get());
+                if (image.valid()) _pager->addResidentImage(imageRequest->_fileName, image.get());
+            }
+
             if (image.valid())
             {
                 // OSG_NOTICE<<"   successful readImageFile("<<imageRequest->_fileName<<") index to assign = "<<imageRequest->_attachmentIndex<<std::endl;
-
-                osg::ImageSequence* is = dynamic_cast<osg::ImageSequence*>(imageRequest->_attachmentPoint.get());
-                if (is)
-                {
-                    if (imageRequest->_attachmentIndex >= 0)
-                    {
-                        is->setImage(imageRequest->_attachmentIndex, image.get());
-                    }
-                    else
-                    {
-                        is->addImage(image.get());
-                    }
-                }
-                else
-                {
-                    imageRequest->_loadedImage = image;
-
-                    OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_pager->_completedQueue->_requestMutex);
-                    _pager->_completedQueue->_requestList.push_back(imageRequest);
-                }
+                _pager->assignImage(imageRequest.get(), image.get());
             }
 
         }
@@ -265,7 +294,16 @@ void ImagePager::ImageThread::run()
 // ImagePager
 //
 ImagePager::ImagePager():
-    _done(false)
+    _done(false),
+    _residentImageSize(0.0),
+    _targetMaximumResidentImageSize(0.0),
+    _maximumReducedImageSize(256),
+    _numHits(0),
+    _numReducedHits(0),
+    _numMisses(0),
+    _numHitsReported(0),
+    _numReducedHitsReported(0),
+    _numMissesReported(0)
 {
     _startThreadCalled = false;
     _databasePagerThreadPaused = false;
@@ -282,6 +320,12 @@ ImagePager::ImagePager():
 #endif
     // 1 second
     _preLoadTime = 1.0;
+
+    const char* ptr = 0;
+    if ((ptr = getenv("OSG_IMAGE_PAGER_MAX_MEMORY")) != 0)
+    {
+        _targetMaximumResidentImageSize = osg::asciiToDouble(ptr)*1024.0*1024.0;
+    }
 }
 
 ImagePager::~ImagePager()
@@ -319,8 +363,207 @@ int ImagePager::cancel()
 
 osg::ref_ptr<osg::Image> ImagePager::readRefImageFile(const std::string& fileName, const osg::Referenced* options)
 {
+    osg::ref_ptr<osg::Image> image;
+    if (getResidentImage(fileName, image)) return image;
+
     osgDB::Options* readOptions = dynamic_cast<osgDB::Options*>(const_cast<osg::Referenced*>(options));
-    return osgDB::readRefImageFile(fileName, readOptions);
+    image = osgDB::readRefImageFile(fileName, readOptions);
+    if (image.valid()) addResidentImage(fileName, image.get());
+    return image;
+}
+
+void ImagePager::assignImage(ImageRequest* imageRequest, osg::Image* image)
+{
+    osg::ImageSequence* is = dynamic_cast<osg::ImageSequence*>(imageRequest->_attachmentPoint.get());
+    if (is)
+    {
+        if (imageRequest->_attachmentIndex >= 0)
+        {
+            is->setImage(imageRequest->_attachmentIndex, image);
+        }
+        else
+        {
+            is->addImage(image);
+        }
+    }
+    else
+    {
+        // each delivery needs its own completed request as a reduced image may be followed by the full resolution one.
+        osg::ref_ptr<ImageRequest> completedRequest = imageRequest;
+        if (imageRequest->_loadedImage.valid())
+        {
+            completedRequest = new ImageRequest;
+            completedRequest->_fileName = imageRequest->_fileName;
+            completedRequest->_attachmentPoint = imageRequest->_attachmentPoint;
+            completedRequest->_attachmentIndex = imageRequest->_attachmentIndex;
+        }
+        completedRequest->_loadedImage = image;
+
+        OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_completedQueue->_requestMutex);
+        _completedQueue->_requestList.push_back(completedRequest);
+    }
+}
+
+void ImagePager::setTargetMaximumResidentImageSize(double bytes)
+{
+    OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_residentMutex);
+    _targetMaximumResidentImageSize = bytes;
+    if (_targetMaximumResidentImageSize<=0.0)
+    {
+        _residentImages.clear();
+        _residentImageIndex.clear();
+        _residentImageSize = 0.0;
+    }
+    else
+    {
+        evictResidentImages();
+    }
+}
+
+double ImagePager::getTargetMaximumResidentImageSize() const
+{
+    OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_residentMutex);
+    return _targetMaximumResidentImageSize;
+}
+
+void ImagePager::setMaximumReducedImageSize(unsigned int size)
+{
+    OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_residentMutex);
+    _maximumReducedImageSize = size;
+}
+
+unsigned int ImagePager::getMaximumReducedImageSize() const
+{
+    OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_residentMutex);
+    return _maximumReducedImageSize;
+}
+
+unsigned int ImagePager::getNumResidentImages() const
+{
+    OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_residentMutex);
+    return static_cast<unsigned int>(_residentImages.size());
+}
+
+double ImagePager::getResidentImageSize() const
+{
+    OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_residentMutex);
+    return _residentImageSize;
+}
+
+void ImagePager::getResidencyCounts(unsigned int& numHits, unsigned int& numReducedHits, unsigned int& numMisses) const
+{
+    OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_residentMutex);
+    numHits = _numHits;
+    numReducedHits = _numReducedHits;
+    numMisses = _numMisses;
+}
+
+void ImagePager::reportStats(osg::Stats* stats, unsigned int frameNumber)
+{
+    if (!stats) return;
+
+    unsigned int numHits, numReducedHits, numMisses;
+    getResidencyCounts(numHits, numReducedHits, numMisses);
+
+    stats->setAttribute(frameNumber, "ImagePager hits", static_cast<double>(numHits-_numHitsReported));
+    stats->setAttribute(frameNumber, "ImagePager reduced hits", static_cast<double>(numReducedHits-_numReducedHitsReported));
+    stats->setAttribute(frameNumber, "ImagePager misses", static_cast<double>(numMisses-_numMissesReported));
+    stats->setAttribute(frameNumber, "ImagePager resident images", static_cast<double>(getNumResidentImages()));
+    stats->setAttribute(frameNumber, "ImagePager resident size", getResidentImageSize());
+
+    _numHitsReported = numHits;
+    _numReducedHitsReported = numReducedHits;
+    _numMissesReported = numMisses;
+}
+
+bool ImagePager::getResidentImage(const std::string& fileName, osg::ref_ptr<osg::Image>& image)
+{
+    OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_residentMutex);
+    if (_targetMaximumResidentImageSize<=0.0) return false;
+
+    ResidentImageIndex::iterator itr = _residentImageIndex.find(fileName);
+    if (itr==_residentImageIndex.end())
+    {
+        ++_numMisses;
+        return false;
+    }
+
+    // move to the front of the least recently used list.
+    _residentImages.splice(_residentImages.begin(), _residentImages, itr->second);
+
+    image = itr->second->_image;
+    if (itr->second->_reduced)
+    {
+        ++_numReducedHits;
+        return false;
+    }
+
+    ++_numHits;
+    return true;
+}
+
+void ImagePager::addResidentImage(const std::string& fileName, osg::Image* image)
+{
+    OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_residentMutex);
+    if (_targetMaximumResidentImageSize<=0.0) return;
+
+    ResidentImageIndex::iterator itr = _residentImageIndex.find(fileName);
+    if (itr!=_residentImageIndex.end())
+    {
+        _residentImageSize -= itr->second->_size;
+        _residentImages.erase(itr->second);
+        _residentImageIndex.erase(itr);
+    }
+
+    ResidentImage residentImage;
+    residentImage._fileName = fileName;
+    residentImage._image = image;
+    residentImage._size = static_cast<double>(image->getTotalSizeInBytesIncludingMipmaps());
+
+    _residentImages.push_front(residentImage);
+    _residentImageIndex[fileName] = _residentImages.begin();
+    _residentImageSize += residentImage._size;
+
+    evictResidentImages();
+}
+
+void ImagePager::evictResidentImages()
+{
+    // the most recently used image is left at full resolution, as an image larger than the target on its own would
+    // otherwise be reduced as soon as it is added and then read again at full resolution on every request.
+    ResidentImageList::iterator mostRecentlyUsed = _residentImages.begin();
+
+    // first pass from the least recently used image, reducing mipmapped images to their lower levels and evicting the rest.
+    ResidentImageList::iterator itr = _residentImages.end();
+    while(_residentImageSize>_targetMaximumResidentImageSize && itr!=_residentImages.begin())
+    {
+        --itr;
+        if (itr==mostRecentlyUsed) break;
+
+        osg::ref_ptr<osg::Image> reduced = itr->_reduced ? 0 : createReducedImage(itr->_image.get(), _maximumReducedImageSize);
+        if (reduced.valid())
+        {
+            _residentImageSize -= itr->_size;
+            itr->_image = reduced;
+            itr->_reduced = true;
+            itr->_size = static_cast<double>(reduced->getTotalSizeInBytesIncludingMipmaps());
+            _residentImageSize += itr->_size;
+        }
+        else
+        {
+            _residentImageSize -= itr->_size;
+            _residentImageIndex.erase(itr->_fileName);
+            itr = _residentImages.erase(itr);
+        }
+    }
+
+    // then evict the reduced images, least recently used first.
+    while(_residentImageSize>_targetMaximumResidentImageSize && _residentImages.size()>1)
+    {
+        _residentImageSize -= _residentImages.back()._size;
+        _residentImageIndex.erase(_residentImages.back()._fileName);
+        _residentImages.pop_back();
+    }
 }
 
 void ImagePager::requestImageFile(const std::string& fileName, osg::Object* attachmentPoint, int attachmentIndex, double timeToMergeBy, const osg::FrameStamp* /*framestamp*/, osg::ref_ptr<osg::Referenced>& imageRequest, const osg::Referenced* options)
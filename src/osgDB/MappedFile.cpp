@@ -0,0 +1,195 @@
+/* -*-c++-*- OpenSceneGraph - Copyright (C) 1998-2008 Robert Osfield
+ *
+ * This library is open source and may be redistributed and/or modified under
+ * the terms of the OpenSceneGraph Public License (OSGPL) version 0.0 or
+ * (at your option) any later version.  The full license is in LICENSE file
+ * included with this distribution, and on the openscenegraph.org website.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * OpenSceneGraph Public License for more details.
+*/
+
+#include <osgDB/MappedFile>
+#include <osgDB/ConvertUTF>
+#include <osg/Config>
+
+#include <string.h>
+
+#if defined(WIN32) && !defined(__CYGWIN__)
+    #define WIN32_LEAN_AND_MEAN
+    #ifndef NOMINMAX
+        #define NOMINMAX
+    #endif
+    #include <windows.h>
+#else
+    #include <sys/types.h>
+    #include <sys/stat.h>
+    #include <sys/mman.h>
+    #include <fcntl.h>
+    #include <unistd.h>
+#endif
+
+using namespace osgDB;
+
+MappedFile::MappedFile(const std::string& filename):
+    _data(0),
+    _size(0)
+{
+#if defined(WIN32) && !defined(__CYGWIN__)
+    _mappingHandle = 0;
+
+#ifdef OSG_USE_UTF8_FILENAME
+    _fileHandle = CreateFileW(convertUTF8toUTF16(filename).c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+#else
+    _fileHandle = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+#endif
+    if (_fileHandle==INVALID_HANDLE_VALUE)
+    {
+        _fileHandle = 0;
+        return;
+    }
+
+    LARGE_INTEGER fileSize;
+    if (!GetFileSizeEx(_fileHandle, &fileSize) || fileSize.QuadPart<=0 ||
+        static_cast<unsigned long long>(fileSize.QuadPart)>static_cast<unsigned long long>(~std::size_t(0)))
+    {
+        return;
+    }
+
+    _mappingHandle = CreateFileMapping(_fileHandle, NULL, PAGE_READONLY, 0, 0, NULL);
+    if (!_mappingHandle) return;
+
+    void* ptr = MapViewOfFile(_mappingHandle, FILE_MAP_READ, 0, 0, 0);
+    if (!ptr) return;
+
+    _data = static_cast<const char*>(ptr);
+    _size = static_cast<std::size_t>(fileSize.QuadPart);
+#else
+    int fd = ::open(filename.c_str(), O_RDONLY);
+    if (fd<0) return;
+
+    struct stat fileStat;
+    if (fstat(fd, &fileStat)==0 && fileStat.st_size>0)
+    {
+        void* ptr = mmap(0, static_cast<std::size_t>(fileStat.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+        if (ptr!=MAP_FAILED)
+        {
+            _data = static_cast<const char*>(ptr);
+            _size = static_cast<std::size_t>(fileStat.st_size);
+
+        #if defined(MADV_SEQUENTIAL)
+            // the file is usually read from front to back so encourage read ahead.
+            madvise(ptr, _size, MADV_SEQUENTIAL);
+        #endif
+        }
+    }
+
+    // the mapping remains valid after the file descriptor is closed.
+    ::close(fd);
+#endif
+}
+
+MappedFile::~MappedFile()
+{
+#if defined(WIN32) && !defined(__CYGWIN__)
+    if (_data) UnmapViewOfFile(_data);
+    if (_mappingHandle) CloseHandle(_mappingHandle);
+    if (_fileHandle) CloseHandle(_fileHandle);
+#else
+    if (_data) munmap(const_cast<char*>(_data), _size);
+#endif
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////
+//
+// MemoryStreamBuffer
+//
+MemoryStreamBuffer::MemoryStreamBuffer(const char* data, std::size_t size)
+{
+    set(data, size);
+}
+
+void MemoryStreamBuffer::set(const char* data, std::size_t size)
+{
+    // the get area is never written to, so casting away the const of the memory is safe.
+    char* begin = const_cast<char*>(data);
+    setg(begin, begin, begin + (data ? size : 0));
+}
+
+std::streamsize MemoryStreamBuffer::showmanyc()
+{
+    std::streamsize available = egptr() - gptr();
+    return available>0 ? available : -1;
+}
+
+std::streamsize MemoryStreamBuffer::xsgetn(char_type* s, std::streamsize n)
+{
+    std::streamsize available = egptr() - gptr();
+    if (n>available) n = available;
+    if (n>0)
+    {
+        memcpy(s, gptr(), static_cast<std::size_t>(n));
+        setg(eback(), gptr() + n, egptr());
+    }
+    return n;
+}
+
+MemoryStreamBuffer::pos_type MemoryStreamBuffer::seekoff(off_type off, std::ios_base::seekdir dir, std::ios_base::openmode which)
+{
+    if (!(which & std::ios_base::in)) return pos_type(off_type(-1));
+
+    off_type position = 0;
+    if (dir==std::ios_base::beg) position = off;
+    else if (dir==std::ios_base::cur) position = (gptr() - eback()) + off;
+    else position = (egptr() - eback()) + off;
+
+    if (position<0 || position>(egptr() - eback())) return pos_type(off_type(-1));
+
+    setg(eback(), eback() + position, egptr());
+    return pos_type(position);
+}
+
+MemoryStreamBuffer::pos_type MemoryStreamBuffer::seekpos(pos_type pos, std::ios_base::openmode which)
+{
+    return seekoff(off_type(pos), std::ios_base::beg, which);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////
+//
+// MappedFileStreamBuffer
+//
+MappedFileStreamBuffer::MappedFileStreamBuffer(MappedFile* mappedFile):
+    _mappedFile(mappedFile)
+{
+    if (_mappedFile.valid() && _mappedFile->valid())
+    {
+        set(_mappedFile->data(), _mappedFile->size());
+    }
+}
+
+MappedFileStreamBuffer::MappedFileStreamBuffer(MappedFile* mappedFile, std::size_t offset, std::size_t size):
+    _mappedFile(mappedFile)
+{
+    if (_mappedFile.valid() && _mappedFile->valid() && offset<=_mappedFile->size() && size<=_mappedFile->size()-offset)
+    {
+        set(_mappedFile->data() + offset, size);
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////
+//
+// imappedstream
+//
+imappedstream::imappedstream(const char* filename):
+    std::istream(0),
+    _buffer(new MappedFile(filename))
+{
+    rdbuf(&_buffer);
+    if (!_buffer.getMappedFile()->valid()) setstate(std::ios_base::failbit);
+}
+
+imappedstream::~imappedstream()
+{
+}
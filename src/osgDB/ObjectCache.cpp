@@ -13,6 +13,7 @@
 
 #include <osg/Texture>
 #include <osgDB/ObjectCache>
+#include <osgDB/FileNameHashIndex>
 #include <osgDB/Options>
 
 using namespace osgDB;
@@ -41,10 +42,21 @@ bool ObjectCache::ClassComp::operator() (const ObjectCache::FileNameOptionsPair&
 //
 // ObjectCache
 //
-ObjectCache::ObjectCache():
-    osg::Referenced(true)
+ObjectCache::ObjectCache(unsigned int numStripes):
+    osg::Referenced(true),
+    _maximumNumberOfObjects(0),
+    _maximumSize(0.0),
+    _numHitsReported(0),
+    _numMissesReported(0),
+    _numEvictionsReported(0)
 {
 //    OSG_NOTICE<<"Constructed ObjectCache"<<std::endl;
+    if (numStripes==0) numStripes = 1;
+    _stripes.resize(numStripes);
+    for(Stripes::iterator itr = _stripes.begin(); itr != _stripes.end(); ++itr)
+    {
+        *itr = new Stripe;
+    }
 }
 
 ObjectCache::~ObjectCache()
@@ -52,141 +64,411 @@ ObjectCache::~ObjectCache()
 //    OSG_NOTICE<<"Destructed ObjectCache"<<std::endl;
 }
 
-void ObjectCache::addObjectCache(ObjectCache* objectCache)
+ObjectCache::Stripe& ObjectCache::getStripe(const std::string& fileName)
 {
-    // don't allow a cache to be added to itself.
-    if (objectCache==this) return;
+    if (_stripes.size()==1) return *_stripes.front();
 
-    // lock both ObjectCache to prevent their contents from being modified by other threads while we merge.
-    OpenThreads::ScopedLock<OpenThreads::Mutex> lock1(_objectCacheMutex);
-    OpenThreads::ScopedLock<OpenThreads::Mutex> lock2(objectCache->_objectCacheMutex);
+    return *_stripes[hashFileName(fileName) % _stripes.size()];
+}
+
+ObjectCache::EntryList::iterator ObjectCache::find(Stripe& stripe, const std::string& fileName, const osgDB::Options* options)
+{
+    if (stripe._index.empty()) return stripe._entries.end();
 
-    OSG_DEBUG<<"Inserting objects to main ObjectCache "<<objectCache->_objectCache.size()<<std::endl;
+    unsigned int hash = hashFileName(fileName);
+    EntryBucket& bucket = stripe._index[hash & (stripe._index.size()-1)];
+    for(EntryBucket::iterator itr = bucket.begin(); itr != bucket.end(); ++itr)
+    {
+        EntryList::iterator entry = *itr;
+        if (entry->_hash!=hash || entry->_fileName!=fileName) continue;
 
-    _objectCache.insert(objectCache->_objectCache.begin(), objectCache->_objectCache.end());
+        bool match = entry->_options.valid() ? (options && *(entry->_options)==*options) : (options==0);
+        if (match)
+        {
+            // move to the front of the least recently used list
+            stripe._entries.splice(stripe._entries.begin(), stripe._entries, entry);
+            return entry;
+        }
+    }
+    return stripe._entries.end();
 }
 
+void ObjectCache::addToIndex(Stripe& stripe)
+{
+    EntryList::iterator entry = stripe._entries.begin();
+    entry->_hash = hashFileName(entry->_fileName);
 
-void ObjectCache::addEntryToObjectCache(const std::string& filename, osg::Object* object, double timestamp, const Options *options)
+    if (stripe._entries.size()>stripe._index.size())
+    {
+        // grow the table to keep the chains short, rehashing all the entries including the new one.
+        std::size_t size = 16;
+        while(size<stripe._entries.size()*2) size <<= 1;
+
+        stripe._index.clear();
+        stripe._index.resize(size);
+
+        for(EntryList::iterator itr = stripe._entries.begin(); itr != stripe._entries.end(); ++itr)
+        {
+            stripe._index[itr->_hash & (stripe._index.size()-1)].push_back(itr);
+        }
+        return;
+    }
+
+    stripe._index[entry->_hash & (stripe._index.size()-1)].push_back(entry);
+}
+
+void ObjectCache::erase(Stripe& stripe, EntryList::iterator entry)
 {
-    if (!object) return;
+    EntryBucket& bucket = stripe._index[entry->_hash & (stripe._index.size()-1)];
+    for(EntryBucket::iterator itr = bucket.begin(); itr != bucket.end(); ++itr)
+    {
+        if (*itr==entry)
+        {
+            *itr = bucket.back();
+            bucket.pop_back();
+            break;
+        }
+    }
+    stripe._size -= entry->_size;
+    stripe._entries.erase(entry);
+    if (stripe._entries.empty()) stripe._size = 0.0;
+}
 
-    OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_objectCacheMutex);
-    _objectCache[FileNameOptionsPair(filename, options ? osg::clone(options) : 0)] = ObjectTimeStampPair(object,timestamp);
-    OSG_DEBUG<<"Adding "<<filename<<" with options '"<<(options ? options->getOptionString() : "")<<"' to ObjectCache "<<this<<std::endl;
+void ObjectCache::evict(Stripe& stripe, unsigned int maximumNumberOfObjects, double maximumSize)
+{
+    unsigned int numStripes = static_cast<unsigned int>(_stripes.size());
+    unsigned int maxNumObjects = maximumNumberOfObjects>0 ? (maximumNumberOfObjects+numStripes-1)/numStripes : 0;
+    double maxSize = maximumSize/static_cast<double>(numStripes);
+
+    // never evict the most recently used entry, so an object larger than the limit can still be cached.
+    while(stripe._entries.size()>1 &&
+          ((maxNumObjects>0 && stripe._entries.size()>maxNumObjects) ||
+           (maxSize>0.0 && stripe._size>maxSize)))
+    {
+        OSG_DEBUG<<"Evicting "<<stripe._entries.back()._fileName<<" from ObjectCache "<<this<<std::endl;
+        erase(stripe, --stripe._entries.end());
+        ++stripe._numEvictions;
+    }
 }
 
-ObjectCache::ObjectCacheMap::iterator ObjectCache::find(const std::string& fileName, const osgDB::Options* options)
+double ObjectCache::estimateSize(osg::Object* object) const
 {
-    for(ObjectCacheMap::iterator itr = _objectCache.begin();
-        itr != _objectCache.end();
-        ++itr)
+    // the estimator is created before a maximum size is first set and never removed, so only needs locking to read once
+    // a caller has read a maximum size under the _limitsMutex.
+    if (!_graphicsCostEstimator) return 0.0;
+
+    if (object->asNode()) return _graphicsCostEstimator->estimateMemoryCost(object->asNode()).first;
+
+    const osg::Image* image = dynamic_cast<const osg::Image*>(object);
+    if (image) return static_cast<double>(image->getTotalDataSize());
+
+    const osg::Texture* texture = dynamic_cast<const osg::Texture*>(object);
+    if (texture) return _graphicsCostEstimator->estimateMemoryCost(texture).first;
+
+    return 0.0;
+}
+
+void ObjectCache::setMaximumNumberOfObjects(unsigned int maxNum)
+{
+    double maxSize = 0.0;
+    {
+        OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_limitsMutex);
+        _maximumNumberOfObjects = maxNum;
+        maxSize = _maximumSize;
+    }
+
+    for(Stripes::iterator itr = _stripes.begin(); itr != _stripes.end(); ++itr)
+    {
+        OpenThreads::ScopedLock<OpenThreads::Mutex> lock((*itr)->_mutex);
+        evict(**itr, maxNum, maxSize);
+    }
+}
+
+unsigned int ObjectCache::getMaximumNumberOfObjects() const
+{
+    OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_limitsMutex);
+    return _maximumNumberOfObjects;
+}
+
+void ObjectCache::setMaximumSize(double maxSize)
+{
+    bool computeSizes = false;
+    unsigned int maxNum = 0;
+    {
+        OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_limitsMutex);
+        if (maxSize>0.0 && !_graphicsCostEstimator) _graphicsCostEstimator = new osg::GraphicsCostEstimator;
+
+        computeSizes = maxSize>0.0 && _maximumSize<=0.0;
+        _maximumSize = maxSize;
+        maxNum = _maximumNumberOfObjects;
+    }
+
+    for(Stripes::iterator itr = _stripes.begin(); itr != _stripes.end(); ++itr)
     {
-        if (itr->first.first==fileName)
+        Stripe& stripe = **itr;
+        OpenThreads::ScopedLock<OpenThreads::Mutex> lock(stripe._mutex);
+        if (computeSizes)
         {
-            if (itr->first.second.valid())
+            // sizes aren't computed while there is no size limit so compute them now.
+            stripe._size = 0.0;
+            for(EntryList::iterator eitr = stripe._entries.begin(); eitr != stripe._entries.end(); ++eitr)
             {
-                if (options && *(itr->first.second)==*options) return itr;
+                eitr->_size = estimateSize(eitr->_object.get());
+                stripe._size += eitr->_size;
             }
-            else if (!options) return itr;
         }
+        evict(stripe, maxNum, maxSize);
+    }
+}
+
+double ObjectCache::getMaximumSize() const
+{
+    OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_limitsMutex);
+    return _maximumSize;
+}
+
+unsigned int ObjectCache::getNumObjects() const
+{
+    unsigned int numObjects = 0;
+    for(Stripes::const_iterator itr = _stripes.begin(); itr != _stripes.end(); ++itr)
+    {
+        OpenThreads::ScopedLock<OpenThreads::Mutex> lock((*itr)->_mutex);
+        numObjects += static_cast<unsigned int>((*itr)->_entries.size());
+    }
+    return numObjects;
+}
+
+double ObjectCache::getSize() const
+{
+    double size = 0.0;
+    for(Stripes::const_iterator itr = _stripes.begin(); itr != _stripes.end(); ++itr)
+    {
+        OpenThreads::ScopedLock<OpenThreads::Mutex> lock((*itr)->_mutex);
+        size += (*itr)->_size;
+    }
+    return size;
+}
+
+void ObjectCache::getCounts(unsigned int& numHits, unsigned int& numMisses, unsigned int& numEvictions) const
+{
+    numHits = 0;
+    numMisses = 0;
+    numEvictions = 0;
+    for(Stripes::const_iterator itr = _stripes.begin(); itr != _stripes.end(); ++itr)
+    {
+        OpenThreads::ScopedLock<OpenThreads::Mutex> lock((*itr)->_mutex);
+        numHits += (*itr)->_numHits;
+        numMisses += (*itr)->_numMisses;
+        numEvictions += (*itr)->_numEvictions;
     }
-    return _objectCache.end();
 }
 
+void ObjectCache::reportStats(osg::Stats* stats, unsigned int frameNumber)
+{
+    if (!stats) return;
+
+    unsigned int numHits, numMisses, numEvictions;
+    getCounts(numHits, numMisses, numEvictions);
+
+    stats->setAttribute(frameNumber, "ObjectCache hits", static_cast<double>(numHits-_numHitsReported));
+    stats->setAttribute(frameNumber, "ObjectCache misses", static_cast<double>(numMisses-_numMissesReported));
+    stats->setAttribute(frameNumber, "ObjectCache evictions", static_cast<double>(numEvictions-_numEvictionsReported));
+    stats->setAttribute(frameNumber, "ObjectCache objects", static_cast<double>(getNumObjects()));
+    stats->setAttribute(frameNumber, "ObjectCache size", getSize());
+
+    _numHitsReported = numHits;
+    _numMissesReported = numMisses;
+    _numEvictionsReported = numEvictions;
+}
+
+void ObjectCache::addObjectCache(ObjectCache* objectCache)
+{
+    // don't allow a cache to be added to itself.
+    if (objectCache==this) return;
+
+    // copy the entries out one stripe at a time so that the two caches are never locked at the same time.
+    EntryList entries;
+    for(Stripes::iterator itr = objectCache->_stripes.begin(); itr != objectCache->_stripes.end(); ++itr)
+    {
+        OpenThreads::ScopedLock<OpenThreads::Mutex> lock((*itr)->_mutex);
+        entries.insert(entries.end(), (*itr)->_entries.begin(), (*itr)->_entries.end());
+    }
+
+    OSG_DEBUG<<"Inserting objects to main ObjectCache "<<entries.size()<<std::endl;
+
+    unsigned int maxNum = 0;
+    double maxSize = 0.0;
+    {
+        OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_limitsMutex);
+        maxNum = _maximumNumberOfObjects;
+        maxSize = _maximumSize;
+    }
+
+    for(EntryList::iterator eitr = entries.begin(); eitr != entries.end(); ++eitr)
+    {
+        Stripe& stripe = getStripe(eitr->_fileName);
+        OpenThreads::ScopedLock<OpenThreads::Mutex> lock(stripe._mutex);
+
+        // existing entries take precedence over those being added.
+        if (find(stripe, eitr->_fileName, eitr->_options.get())!=stripe._entries.end()) continue;
+
+        eitr->_size = maxSize>0.0 ? estimateSize(eitr->_object.get()) : 0.0;
+        stripe._entries.push_front(*eitr);
+        addToIndex(stripe);
+        stripe._size += eitr->_size;
+
+        evict(stripe, maxNum, maxSize);
+    }
+}
+
+
+void ObjectCache::addEntryToObjectCache(const std::string& filename, osg::Object* object, double timestamp, const Options *options)
+{
+    if (!object) return;
+
+    unsigned int maxNum = 0;
+    double maxSize = 0.0;
+    {
+        OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_limitsMutex);
+        maxNum = _maximumNumberOfObjects;
+        maxSize = _maximumSize;
+    }
+
+    double size = maxSize>0.0 ? estimateSize(object) : 0.0;
+
+    Stripe& stripe = getStripe(filename);
+    OpenThreads::ScopedLock<OpenThreads::Mutex> lock(stripe._mutex);
+
+    EntryList::iterator itr = find(stripe, filename, options);
+    if (itr==stripe._entries.end())
+    {
+        stripe._entries.push_front(Entry());
+        itr = stripe._entries.begin();
+        itr->_fileName = filename;
+        itr->_options = options ? osg::clone(options) : 0;
+        addToIndex(stripe);
+    }
+
+    stripe._size += size - itr->_size;
+    itr->_object = object;
+    itr->_timestamp = timestamp;
+    itr->_size = size;
+
+    evict(stripe, maxNum, maxSize);
+
+    OSG_DEBUG<<"Adding "<<filename<<" with options '"<<(options ? options->getOptionString() : "")<<"' to ObjectCache "<<this<<std::endl;
+}
 
 osg::Object* ObjectCache::getFromObjectCache(const std::string& fileName, const Options *options)
 {
-    OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_objectCacheMutex);
-    ObjectCacheMap::iterator itr = find(fileName, options);
-    if (itr!=_objectCache.end())
+    Stripe& stripe = getStripe(fileName);
+    OpenThreads::ScopedLock<OpenThreads::Mutex> lock(stripe._mutex);
+    EntryList::iterator itr = find(stripe, fileName, options);
+    if (itr!=stripe._entries.end())
     {
-        osg::ref_ptr<const osgDB::Options> o = itr->first.second;
-        if (o.valid())
+        ++stripe._numHits;
+        if (itr->_options.valid())
         {
-            OSG_DEBUG<<"Found "<<fileName<<" with options '"<< o->getOptionString()<< "' in ObjectCache "<<this<<std::endl;
+            OSG_DEBUG<<"Found "<<fileName<<" with options '"<< itr->_options->getOptionString()<< "' in ObjectCache "<<this<<std::endl;
         }
         else
         {
             OSG_DEBUG<<"Found "<<fileName<<" in ObjectCache "<<this<<std::endl;
         }
-        return itr->second.first.get();
+        return itr->_object.get();
+    }
+    else
+    {
+        ++stripe._numMisses;
+        return 0;
     }
-    else return 0;
 }
 
 osg::ref_ptr<osg::Object> ObjectCache::getRefFromObjectCache(const std::string& fileName, const Options *options)
 {
-    OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_objectCacheMutex);
-    ObjectCacheMap::iterator itr = find(fileName, options);
-    if (itr!=_objectCache.end())
+    Stripe& stripe = getStripe(fileName);
+    OpenThreads::ScopedLock<OpenThreads::Mutex> lock(stripe._mutex);
+    EntryList::iterator itr = find(stripe, fileName, options);
+    if (itr!=stripe._entries.end())
     {
-        osg::ref_ptr<const osgDB::Options> o = itr->first.second;
-        if (o.valid())
+        ++stripe._numHits;
+        if (itr->_options.valid())
         {
-            OSG_DEBUG<<"Found "<<fileName<<" with options '"<< o->getOptionString()<< "' in ObjectCache "<<this<<std::endl;
+            OSG_DEBUG<<"Found "<<fileName<<" with options '"<< itr->_options->getOptionString()<< "' in ObjectCache "<<this<<std::endl;
         }
         else
         {
             OSG_DEBUG<<"Found "<<fileName<<" in ObjectCache "<<this<<std::endl;
         }
-        return itr->second.first.get();
+        return itr->_object.get();
+    }
+    else
+    {
+        ++stripe._numMisses;
+        return 0;
     }
-    else return 0;
 }
 
 void ObjectCache::updateTimeStampOfObjectsInCacheWithExternalReferences(double referenceTime)
 {
-    OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_objectCacheMutex);
-
-    // look for objects with external references and update their time stamp.
-    for(ObjectCacheMap::iterator itr=_objectCache.begin();
-        itr!=_objectCache.end();
-        ++itr)
+    for(Stripes::iterator sitr = _stripes.begin(); sitr != _stripes.end(); ++sitr)
     {
-        // if ref count is greater the 1 the object has an external reference.
-        if (itr->second.first->referenceCount()>1)
+        Stripe& stripe = **sitr;
+        OpenThreads::ScopedLock<OpenThreads::Mutex> lock(stripe._mutex);
+
+        // look for objects with external references and update their time stamp.
+        for(EntryList::iterator itr = stripe._entries.begin();
+            itr != stripe._entries.end();
+            ++itr)
         {
-            // so update it time stamp.
-            itr->second.second = referenceTime;
+            // if ref count is greater the 1 the object has an external reference.
+            if (itr->_object->referenceCount()>1)
+            {
+                // so update it time stamp.
+                itr->_timestamp = referenceTime;
+            }
         }
     }
 }
 
 void ObjectCache::removeExpiredObjectsInCache(double expiryTime)
 {
-    OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_objectCacheMutex);
-
-    // Remove expired entries from object cache
-    ObjectCacheMap::iterator oitr = _objectCache.begin();
-    while(oitr != _objectCache.end())
+    for(Stripes::iterator sitr = _stripes.begin(); sitr != _stripes.end(); ++sitr)
     {
-        if (oitr->second.second<=expiryTime)
-        {
-#if __cplusplus > 199711L
-            oitr = _objectCache.erase(oitr);
-#else
-            _objectCache.erase(oitr++);
-#endif
-        }
-        else
+        Stripe& stripe = **sitr;
+        OpenThreads::ScopedLock<OpenThreads::Mutex> lock(stripe._mutex);
+
+        // Remove expired entries from object cache
+        EntryList::iterator itr = stripe._entries.begin();
+        while(itr != stripe._entries.end())
         {
-            ++oitr;
+            EntryList::iterator curr_itr = itr++;
+            if (curr_itr->_timestamp<=expiryTime)
+            {
+                erase(stripe, curr_itr);
+            }
         }
     }
 }
 
 void ObjectCache::removeFromObjectCache(const std::string& fileName, const Options *options)
 {
-    OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_objectCacheMutex);
-    ObjectCacheMap::iterator itr = find(fileName, options);
-    if (itr!=_objectCache.end()) _objectCache.erase(itr);
+    Stripe& stripe = getStripe(fileName);
+    OpenThreads::ScopedLock<OpenThreads::Mutex> lock(stripe._mutex);
+    EntryList::iterator itr = find(stripe, fileName, options);
+    if (itr!=stripe._entries.end()) erase(stripe, itr);
 }
 
 void ObjectCache::clear()
 {
-    OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_objectCacheMutex);
-    _objectCache.clear();
+    for(Stripes::iterator sitr = _stripes.begin(); sitr != _stripes.end(); ++sitr)
+    {
+        Stripe& stripe = **sitr;
+        OpenThreads::ScopedLock<OpenThreads::Mutex> lock(stripe._mutex);
+        stripe._index.clear();
+        stripe._entries.clear();
+        stripe._size = 0.0;
+    }
 }
 
 namespace ObjectCacheUtils
@@ -256,28 +538,32 @@ struct ContainsUnreffedTextures : public osg::NodeVisitor
 
 void ObjectCache::releaseGLObjects(osg::State* state)
 {
-    OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_objectCacheMutex);
-
     ObjectCacheUtils::ContainsUnreffedTextures cut;
 
-    for(ObjectCacheMap::iterator itr = _objectCache.begin();
-        itr != _objectCache.end();
-        )
+    for(Stripes::iterator sitr = _stripes.begin(); sitr != _stripes.end(); ++sitr)
     {
-        ObjectCacheMap::iterator curr_itr = itr;
+        Stripe& stripe = **sitr;
+        OpenThreads::ScopedLock<OpenThreads::Mutex> lock(stripe._mutex);
+
+        for(EntryList::iterator itr = stripe._entries.begin();
+            itr != stripe._entries.end();
+            )
+        {
+            EntryList::iterator curr_itr = itr;
 
-        // get object and advance iterator to next item
-        osg::Object* object = itr->second.first.get();
+            // get object and advance iterator to next item
+            osg::Object* object = itr->_object.get();
 
-        bool needToRemoveEntry = cut.check(itr->second.first.get());
+            bool needToRemoveEntry = cut.check(object);
 
-        object->releaseGLObjects(state);
+            object->releaseGLObjects(state);
 
-        ++itr;
+            ++itr;
 
-        if (needToRemoveEntry)
-        {
-            _objectCache.erase(curr_itr);
+            if (needToRemoveEntry)
+            {
+                erase(stripe, curr_itr);
+            }
         }
     }
 }
@@ -250,8 +250,8 @@ Registry::Registry()
         _fileCache = new FileCache(fileCachePath);
     }
 
-    // assign ObjectCache.
-    _objectCache = new ObjectCache;
+    // assign ObjectCache, striped so that concurrent reads from the DatabasePager threads don't contend on a single lock.
+    _objectCache = new ObjectCache(16);
 
     _createNodeFromImage = false;
     _openingLibrary = false;
@@ -54,3 +54,28 @@ void osgParticle::FluidFrictionOperator::operate(Particle* P, double dt)
 
     P->addVelocity(dv);
 }
+
+void osgParticle::FluidFrictionOperator::operateArrays(ParticleArrays& arrays, unsigned int first, unsigned int last, double dt)
+{
+    for (unsigned int i=first; i<last; ++i)
+    {
+        float r = (_ovr_rad > 0)? _ovr_rad : arrays.radius[i];
+        osg::Vec3 v = osg::Vec3(arrays.velocityX[i], arrays.velocityY[i], arrays.velocityZ[i])-_wind;
+
+        float vm = v.normalize();
+        float R = _coeff_A * r * vm + _coeff_B * r * r * vm * vm;
+
+        osg::Vec3 Fr(-R * v.x(), -R * v.y(), -R * v.z());
+
+        // correct unwanted velocity increments
+        osg::Vec3 dv = Fr * arrays.massInv[i] * dt;
+        float dvl = dv.length();
+        if (dvl > vm) {
+            dv *= vm / dvl;
+        }
+
+        arrays.velocityX[i] += dv.x();
+        arrays.velocityY[i] += dv.y();
+        arrays.velocityZ[i] += dv.z();
+    }
+}
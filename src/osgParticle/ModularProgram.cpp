@@ -17,6 +17,26 @@ osgParticle::ModularProgram::ModularProgram(const ModularProgram& copy, const os
     }
 }
 
+namespace
+{
+
+struct OperateArrays
+{
+    OperateArrays(osgParticle::Operator* op, osgParticle::ParticleArrays& arrays, double dt):
+        _op(op), _arrays(arrays), _dt(dt) {}
+
+    void operator() (unsigned int first, unsigned int last)
+    {
+        _op->operateArrays(_arrays, first, last, _dt);
+    }
+
+    osgParticle::Operator*          _op;
+    osgParticle::ParticleArrays&    _arrays;
+    double                          _dt;
+};
+
+}
+
 void osgParticle::ModularProgram::execute(double dt)
 {
     Operator_vector::iterator ci;
@@ -25,7 +45,21 @@ void osgParticle::ModularProgram::execute(double dt)
     ParticleSystem* ps = getParticleSystem();
     for (ci=_operators.begin(); ci!=ci_end; ++ci) {
         (*ci)->beginOperate(this);
-        (*ci)->operateParticles(ps, dt);
+
+        unsigned int fields = (*ci)->isEnabled() ? (*ci)->getArrayFields() : 0;
+        if (fields != 0) {
+            // run the operator's kernel over the arrays, in parallel for large particle systems.
+            _arrays.gather(ps, fields);
+            OperateArrays operateArrays(ci->get(), _arrays, dt);
+            osg::TaskScheduler::instance()->parallelFor(0, _arrays.size(), operateArrays, 4096);
+        } else {
+            // the operator works on the particles themselves, so write back what earlier operators did to the arrays.
+            _arrays.scatter(ps);
+            (*ci)->operateParticles(ps, dt);
+        }
+
         (*ci)->endOperate();
     }
+
+    _arrays.scatter(ps);
 }
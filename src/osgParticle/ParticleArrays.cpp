@@ -0,0 +1,122 @@
+#include <osgParticle/ParticleArrays>
+#include <osgParticle/ParticleSystem>
+#include <osgParticle/Particle>
+
+#include <osg/TaskScheduler>
+
+namespace
+{
+
+// the particles of a large system are copied to and from the arrays in parallel, each range of indices by one task.
+const unsigned int s_particlesPerTask = 4096;
+
+struct GatherParticles
+{
+    GatherParticles(osgParticle::ParticleArrays& arrays, osgParticle::ParticleSystem* ps, unsigned int fields):
+        _arrays(arrays), _ps(ps), _fields(fields) {}
+
+    void operator() (unsigned int first, unsigned int last)
+    {
+        osgParticle::ParticleArrays& a = _arrays;
+        for(unsigned int i=first; i<last; ++i)
+        {
+            const osgParticle::Particle* P = _ps->getParticle(a.indices[i]);
+            if (_fields & osgParticle::ParticleArrays::POSITION)
+            {
+                const osg::Vec3& p = P->getPosition();
+                a.positionX[i] = p.x(); a.positionY[i] = p.y(); a.positionZ[i] = p.z();
+            }
+            if (_fields & osgParticle::ParticleArrays::VELOCITY)
+            {
+                const osg::Vec3& v = P->getVelocity();
+                a.velocityX[i] = v.x(); a.velocityY[i] = v.y(); a.velocityZ[i] = v.z();
+            }
+            if (_fields & osgParticle::ParticleArrays::ANGULAR_VELOCITY)
+            {
+                const osg::Vec3& v = P->getAngularVelocity();
+                a.angularVelocityX[i] = v.x(); a.angularVelocityY[i] = v.y(); a.angularVelocityZ[i] = v.z();
+            }
+            if (_fields & osgParticle::ParticleArrays::RADIUS) a.radius[i] = P->getRadius();
+            if (_fields & osgParticle::ParticleArrays::MASS_INV) a.massInv[i] = P->getMassInv();
+        }
+    }
+
+    osgParticle::ParticleArrays&    _arrays;
+    osgParticle::ParticleSystem*    _ps;
+    unsigned int                    _fields;
+};
+
+struct ScatterParticles
+{
+    ScatterParticles(const osgParticle::ParticleArrays& arrays, osgParticle::ParticleSystem* ps, unsigned int fields):
+        _arrays(arrays), _ps(ps), _fields(fields) {}
+
+    void operator() (unsigned int first, unsigned int last)
+    {
+        const osgParticle::ParticleArrays& a = _arrays;
+        for(unsigned int i=first; i<last; ++i)
+        {
+            osgParticle::Particle* P = _ps->getParticle(a.indices[i]);
+            if (_fields & osgParticle::ParticleArrays::VELOCITY)
+            {
+                P->setVelocity(osg::Vec3(a.velocityX[i], a.velocityY[i], a.velocityZ[i]));
+            }
+            if (_fields & osgParticle::ParticleArrays::ANGULAR_VELOCITY)
+            {
+                P->setAngularVelocity(osg::Vec3(a.angularVelocityX[i], a.angularVelocityY[i], a.angularVelocityZ[i]));
+            }
+        }
+    }
+
+    const osgParticle::ParticleArrays&  _arrays;
+    osgParticle::ParticleSystem*        _ps;
+    unsigned int                        _fields;
+};
+
+}
+
+osgParticle::ParticleArrays::ParticleArrays():
+    _fields(0)
+{
+}
+
+void osgParticle::ParticleArrays::gather(ParticleSystem* ps, unsigned int fields)
+{
+    if (_fields==0)
+    {
+        indices.clear();
+        int n = ps->numParticles();
+        for(int i=0; i<n; ++i)
+        {
+            if (ps->getParticle(i)->isAlive()) indices.push_back(static_cast<unsigned int>(i));
+        }
+    }
+
+    unsigned int newFields = fields & ~_fields;
+    if (newFields==0) return;
+
+    unsigned int n = size();
+    if (newFields & POSITION) { positionX.resize(n); positionY.resize(n); positionZ.resize(n); }
+    if (newFields & VELOCITY) { velocityX.resize(n); velocityY.resize(n); velocityZ.resize(n); }
+    if (newFields & ANGULAR_VELOCITY) { angularVelocityX.resize(n); angularVelocityY.resize(n); angularVelocityZ.resize(n); }
+    if (newFields & RADIUS) radius.resize(n);
+    if (newFields & MASS_INV) massInv.resize(n);
+
+    GatherParticles gatherParticles(*this, ps, newFields);
+    osg::TaskScheduler::instance()->parallelFor(0, n, gatherParticles, s_particlesPerTask);
+
+    _fields |= newFields;
+}
+
+void osgParticle::ParticleArrays::scatter(ParticleSystem* ps)
+{
+    unsigned int modifiedFields = _fields & (VELOCITY|ANGULAR_VELOCITY);
+    if (modifiedFields!=0)
+    {
+        ScatterParticles scatterParticles(*this, ps, modifiedFields);
+        osg::TaskScheduler::instance()->parallelFor(0, size(), scatterParticles, s_particlesPerTask);
+    }
+
+    indices.clear();
+    _fields = 0;
+}
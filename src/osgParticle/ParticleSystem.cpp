@@ -16,6 +16,7 @@
 #include <osg/Program>
 #include <osg/Notify>
 #include <osg/io_utils>
+#include <osg/TaskScheduler>
 
 #include <osgDB/FileUtils>
 #include <osgDB/ReadFile>
@@ -30,6 +31,81 @@ static double distance(const osg::Vec3& coord, const osg::Matrix& matrix)
     return -(coord[0]*matrix(0,2)+coord[1]*matrix(1,2)+coord[2]*matrix(2,2)+matrix(3,2));
 }
 
+namespace
+{
+
+// minimum number of particles updated by each task, below which the update stays on the calling thread.
+const unsigned int MIN_PARTICLES_PER_UPDATE_TASK = 4096;
+
+// results of particles already updated on the calling thread, recorded for UpdateParticleRanges.
+enum PreUpdateResult
+{
+    NOT_UPDATED = 0,
+    UPDATED_ALIVE,
+    UPDATED_DEAD
+};
+
+/** Returns true if the next update of a particle picks its size, alpha and color from their ranges with std::rand(),
+  * which is the case on the first update of a particle that lives forever.*/
+inline bool updateDrawsRandomValues(const osgParticle::Particle& particle, double dt)
+{
+    return particle.isAlive() && particle.getLifeTime()<=0 && particle.getAge()+dt==dt;
+}
+
+/** Updates fixed ranges of particles, recording the bounds of the live particles and the indices of the dead ones
+  * in each range, so that ranges can be updated concurrently and their results merged back in index order.*/
+struct UpdateParticleRanges
+{
+    struct Range
+    {
+        Range(): first(0), last(0) {}
+
+        unsigned int                first;
+        unsigned int                last;
+        osg::BoundingBox            bounds;
+        std::vector<unsigned int>   dead;
+    };
+
+    typedef std::vector<Range> Ranges;
+
+    UpdateParticleRanges(std::vector<osgParticle::Particle>& particles, const std::vector<unsigned char>& preUpdated, Ranges& ranges, double dt, bool onlyTimeStamp):
+        _particles(particles), _preUpdated(preUpdated), _ranges(ranges), _dt(dt), _onlyTimeStamp(onlyTimeStamp) {}
+
+    void operator() (unsigned int firstRange, unsigned int lastRange)
+    {
+        for(unsigned int r=firstRange; r<lastRange; ++r)
+        {
+            Range& range = _ranges[r];
+            for(unsigned int i=range.first; i<range.last; ++i)
+            {
+                osgParticle::Particle& particle = _particles[i];
+                unsigned char preUpdated = _preUpdated.empty() ? static_cast<unsigned char>(NOT_UPDATED) : _preUpdated[i];
+                if (preUpdated==NOT_UPDATED && !particle.isAlive()) continue;
+
+                if (preUpdated!=NOT_UPDATED ? preUpdated==UPDATED_ALIVE : particle.update(_dt, _onlyTimeStamp))
+                {
+                    const osg::Vec3& p = particle.getPosition();
+                    float radius = particle.getCurrentSize();
+                    range.bounds.expandBy(p - osg::Vec3(radius,radius,radius));
+                    range.bounds.expandBy(p + osg::Vec3(radius,radius,radius));
+                }
+                else
+                {
+                    range.dead.push_back(i);
+                }
+            }
+        }
+    }
+
+    std::vector<osgParticle::Particle>& _particles;
+    const std::vector<unsigned char>&   _preUpdated;
+    Ranges&                             _ranges;
+    double                              _dt;
+    bool                                _onlyTimeStamp;
+};
+
+}
+
 osgParticle::ParticleSystem::ParticleSystem()
 :    osg::Drawable(),
     _def_bbox(osg::Vec3(-10, -10, -10), osg::Vec3(10, 10, 10)),
@@ -152,18 +228,65 @@ void osgParticle::ParticleSystem::update(double dt, osg::NodeVisitor& nv)
         }
     }
 
-    for(unsigned int i=0; i<_particles.size(); ++i)
+    osg::TaskScheduler* scheduler = osg::TaskScheduler::instance().get();
+    unsigned int numParticles = static_cast<unsigned int>(_particles.size());
+    unsigned int numRanges = osg::minimum(numParticles/MIN_PARTICLES_PER_UPDATE_TASK, (scheduler->getNumThreads()+1)*4);
+
+    if (numRanges>1 && scheduler->getNumThreads()>0)
     {
-        Particle& particle = _particles[i];
-        if (particle.isAlive())
+        // update the particles in parallel, then merge the bounds and reuse the dead particles in the same order as the serial loop.
+        UpdateParticleRanges::Ranges ranges(numRanges);
+        for(unsigned int r=0; r<numRanges; ++r)
         {
-            if (particle.update(dt, _useShaders))
+            ranges[r].first = (numParticles*r)/numRanges;
+            ranges[r].last = (numParticles*(r+1))/numRanges;
+        }
+
+        // std::rand() is neither thread safe nor reproducible across threads, so the particles whose update draws
+        // random values are updated here first, in index order, leaving the same random sequence as the serial loop.
+        std::vector<unsigned char> preUpdated;
+        for(unsigned int i=0; i<numParticles; ++i)
+        {
+            Particle& particle = _particles[i];
+            if (updateDrawsRandomValues(particle, dt))
             {
-                update_bounds(particle.getPosition(), particle.getCurrentSize());
+                if (preUpdated.empty()) preUpdated.resize(numParticles, NOT_UPDATED);
+                preUpdated[i] = particle.update(dt, _useShaders) ? UPDATED_ALIVE : UPDATED_DEAD;
             }
-            else
+        }
+
+        UpdateParticleRanges updateParticleRanges(_particles, preUpdated, ranges, dt, _useShaders);
+        scheduler->parallelFor(0, numRanges, updateParticleRanges);
+
+        for(UpdateParticleRanges::Ranges::iterator itr = ranges.begin(); itr != ranges.end(); ++itr)
+        {
+            if (itr->bounds.valid())
+            {
+                update_bounds(itr->bounds._min, 0.0f);
+                update_bounds(itr->bounds._max, 0.0f);
+            }
+
+            for(std::vector<unsigned int>::iterator ditr = itr->dead.begin(); ditr != itr->dead.end(); ++ditr)
             {
-                reuseParticle(i);
+                reuseParticle(*ditr);
+            }
+        }
+    }
+    else
+    {
+        for(unsigned int i=0; i<_particles.size(); ++i)
+        {
+            Particle& particle = _particles[i];
+            if (particle.isAlive())
+            {
+                if (particle.update(dt, _useShaders))
+                {
+                    update_bounds(particle.getPosition(), particle.getCurrentSize());
+                }
+                else
+                {
+                    reuseParticle(i);
+                }
             }
         }
     }
@@ -36,11 +36,13 @@
 #include <osg/Texture2D>
 #include <osg/TexGen>
 #include <osg/TexMat>
+#include <osg/TaskScheduler>
 
 #include <osgDB/Registry>
 #include <osgDB/ReadFile>
 #include <osgDB/FileUtils>
 #include <osgDB/FileNameUtils>
+#include <osgDB/MappedFile>
 
 #include <osgUtil/MeshOptimizers>
 #include <osgUtil/SmoothingVisitor>
@@ -51,6 +53,7 @@
 
 #include <map>
 #include <set>
+#include <iterator>
 
 class ReaderWriterOBJ : public osgDB::ReaderWriter
 {
@@ -63,6 +66,7 @@ public:
         supportsOption("noTriStripPolygons","Do not do the default tri stripping of polygons");
         supportsOption("generateFacetNormals","generate facet normals for vertices without normals");
         supportsOption("noReverseFaces","avoid to reverse faces when normals and triangles orientation are reversed");
+        supportsOption("parallelRead","Memory map the file and parse it on multiple threads, building indexed geometry with shared vertices");
 
         supportsOption("DIFFUSE=<unit>", "Set texture unit for diffuse texture");
         supportsOption("AMBIENT=<unit>", "Set texture unit for ambient texture");
@@ -162,6 +166,7 @@ protected:
         bool generateFacetNormals;
         bool fixBlackMaterials;
         bool noReverseFaces;
+        bool parallelRead;
         // This is the order in which the materials will be assigned to texture maps, unless
         // otherwise overridden
         typedef std::vector< std::pair<int,obj::Material::Map::TextureMapType> > TextureAllocationMap;
@@ -179,6 +184,7 @@ protected:
             generateFacetNormals = false;
             fixBlackMaterials = true;
             noReverseFaces = false;
+            parallelRead = false;
             precision = std::numeric_limits<double>::digits10 + 2;
             outputTextureFiles = false;
             specularExponent = -1;
@@ -191,6 +197,12 @@ protected:
 
     osg::Geometry* convertElementListToGeometry(obj::Model& model, obj::Model::ElementList& elementList, ObjOptionsStruct& localOptions) const;
 
+    osg::Geometry* convertElementStreamToGeometry(obj::Model& model, obj::ElementStream& stream, ObjOptionsStruct& localOptions) const;
+
+    struct ConvertElementStreams;
+
+    void addGeometry(osg::Group* group, osg::Geometry* geometry, const obj::ElementState& es, MaterialToStateSetMap& materialToStateSetMap, ObjOptionsStruct& localOptions) const;
+
     osg::Node* convertModelToSceneGraph(obj::Model& model, ObjOptionsStruct& localOptions, const Options* options) const;
 
     inline osg::Vec3 transformVertex(const osg::Vec3& vec, const bool rotate) const ;
@@ -771,78 +783,342 @@ osg::Geometry* ReaderWriterOBJ::convertElementListToGeometry(obj::Model& model,
     return geometry;
 }
 
-osg::Node* ReaderWriterOBJ::convertModelToSceneGraph(obj::Model& model, ObjOptionsStruct& localOptions, const Options* options) const
+namespace
 {
 
-    if (model.elementStateMap.empty()) return 0;
+/** Add a facet normal to each polygon of a stream without normals, as convertElementListToGeometry() does for Elements.*/
+void generateFacetNormals(obj::Model& model, obj::ElementStream& stream)
+{
+    if (!stream.normalIndices.empty()) return;
 
-    osg::Group* group = new osg::Group;
+    // points and lines are left without normals, which would leave the normals incomplete, so only handle polygons.
+    for(obj::ElementStream::DataTypeList::const_iterator itr = stream.dataTypes.begin(); itr != stream.dataTypes.end(); ++itr)
+    {
+        if (*itr!=obj::Element::POLYGON) return;
+    }
 
-    // set up the materials
-    MaterialToStateSetMap materialToStateSetMap;
-    buildMaterialToStateSetMap(model, materialToStateSetMap, localOptions, options);
+    stream.normalIndices.reserve(stream.vertexIndices.size());
 
-    // go through the groups of related elements and build geometry from them.
-    for(obj::Model::ElementStateMap::iterator itr=model.elementStateMap.begin();
-        itr!=model.elementStateMap.end();
-        ++itr)
+    unsigned int offset = 0;
+    for(obj::ElementStream::SizeList::const_iterator itr = stream.elementSizes.begin(); itr != stream.elementSizes.end(); ++itr)
     {
+        unsigned int size = *itr;
+        osg::Vec3f normal;
+        if (size>=3)
+        {
+            const int* indices = &stream.vertexIndices[offset];
+            osg::Vec3f ab(model.vertices[indices[1]] - model.vertices[indices[0]]);
+            osg::Vec3f ac(model.vertices[indices[2]] - model.vertices[indices[0]]);
+            normal = ab ^ ac;
+            normal.normalize();
+        }
 
-        const obj::ElementState& es = itr->first;
-        obj::Model::ElementList& el = itr->second;
+        int normalIndex = static_cast<int>(model.normals.size());
+        model.normals.push_back(normal);
+        stream.normalIndices.insert(stream.normalIndices.end(), size, normalIndex);
+        offset += size;
+    }
+}
 
-        osg::Geometry* geometry = convertElementListToGeometry(model,el,localOptions);
+/** Copy the model's vertex data into the arrays of a geometry, one entry per distinct combination of indices.*/
+struct CopyVertexData
+{
+    CopyVertexData(const obj::Model& model, const obj::ElementStream& stream, const std::vector<unsigned int>& corners, bool rotate):
+        _model(model),
+        _stream(stream),
+        _corners(corners),
+        _rotate(rotate) {}
 
-        if (geometry)
+    inline osg::Vec3 transform(const osg::Vec3& vec) const
+    {
+        return _rotate ? osg::Vec3(vec.x(),-vec.z(),vec.y()) : vec;
+    }
+
+    void operator() (unsigned int first, unsigned int last)
+    {
+        for(unsigned int i=first; i<last; ++i)
         {
-            MaterialToStateSetMap::const_iterator it = materialToStateSetMap.find(es.materialName);
-            if (it == materialToStateSetMap.end())
-            {
-                OSG_WARN << "Obj unable to find material '" << es.materialName << "'" << std::endl;
-            }
+            unsigned int corner = _corners[i];
+            int vi = _stream.vertexIndices[corner];
+            (*_vertices)[i] = transform(_model.vertices[vi]);
+            if (_normals.valid()) (*_normals)[i] = transform(_model.normals[_stream.normalIndices[corner]]);
+            if (_texcoords.valid()) (*_texcoords)[i] = _model.texcoords[_stream.texCoordIndices[corner]];
+            if (_colors.valid()) (*_colors)[i] = (vi<static_cast<int>(_model.colors.size())) ? _model.colors[vi] : osg::Vec4(1.0f,1.0f,1.0f,1.0f);
+        }
+    }
 
-            osg::StateSet* stateset = materialToStateSetMap[es.materialName].get();
-            geometry->setStateSet(stateset);
+    const obj::Model&                   _model;
+    const obj::ElementStream&           _stream;
+    const std::vector<unsigned int>&    _corners;
+    bool                                _rotate;
 
-            // tesseleate any large polygons
-            if (!localOptions.noTesselateLargePolygons)
-            {
-                osgUtil::Tessellator tessellator;
-                tessellator.retessellatePolygons(*geometry);
-            }
+    osg::ref_ptr<osg::Vec3Array>        _vertices;
+    osg::ref_ptr<osg::Vec3Array>        _normals;
+    osg::ref_ptr<osg::Vec2Array>        _texcoords;
+    osg::ref_ptr<osg::Vec4Array>        _colors;
+};
+
+}
+
+osg::Geometry* ReaderWriterOBJ::convertElementStreamToGeometry(obj::Model& model, obj::ElementStream& stream, ObjOptionsStruct& localOptions) const
+{
+    unsigned int numCorners = static_cast<unsigned int>(stream.vertexIndices.size());
+    if (numCorners==0) return 0;
+
+    bool hasNormals = stream.normalIndices.size()==numCorners;
+    bool hasTexCoords = stream.texCoordIndices.size()==numCorners;
+
+    // give each distinct combination of vertex, texcoord and normal index a single vertex, using an open addressing hash table.
+    std::vector<unsigned int> cornerToVertex(numCorners);
+    std::vector<unsigned int> corners;
+
+    unsigned int tableSize = 16;
+    while(tableSize<numCorners*2) tableSize <<= 1;
+    std::vector<unsigned int> table(tableSize, 0);
 
-            // tri strip polygons to improve graphics performance
-            if (!localOptions.noTriStripPolygons)
+    for(unsigned int i=0; i<numCorners; ++i)
+    {
+        unsigned int vi = static_cast<unsigned int>(stream.vertexIndices[i]);
+        unsigned int ti = hasTexCoords ? static_cast<unsigned int>(stream.texCoordIndices[i]) : 0;
+        unsigned int ni = hasNormals ? static_cast<unsigned int>(stream.normalIndices[i]) : 0;
+
+        unsigned int slot = ((vi*73856093u) ^ (ti*19349663u) ^ (ni*83492791u)) & (tableSize-1);
+        for(;;)
+        {
+            unsigned int entry = table[slot];
+            if (entry==0)
             {
-                osgUtil::optimizeMesh(geometry);
+                corners.push_back(i);
+                table[slot] = static_cast<unsigned int>(corners.size());
+                cornerToVertex[i] = table[slot]-1;
+                break;
             }
 
-            // if no normals present add them.
-            if (localOptions.generateFacetNormals==false && (!geometry->getNormalArray() || geometry->getNormalArray()->getNumElements()==0))
+            unsigned int corner = corners[entry-1];
+            if (static_cast<unsigned int>(stream.vertexIndices[corner])==vi &&
+                (!hasTexCoords || static_cast<unsigned int>(stream.texCoordIndices[corner])==ti) &&
+                (!hasNormals || static_cast<unsigned int>(stream.normalIndices[corner])==ni))
             {
-                osgUtil::SmoothingVisitor sv;
-                sv.smooth(*geometry);
+                cornerToVertex[i] = entry-1;
+                break;
             }
 
+            slot = (slot+1) & (tableSize-1);
+        }
+    }
+
+    table.clear();
 
-            osg::Geode* geode = new osg::Geode;
-            geode->addDrawable(geometry);
+    unsigned int numVertices = static_cast<unsigned int>(corners.size());
+
+    CopyVertexData copyVertexData(model, stream, corners, localOptions.rotate);
+    copyVertexData._vertices = new osg::Vec3Array(numVertices);
+    if (hasNormals) copyVertexData._normals = new osg::Vec3Array(numVertices);
+    if (hasTexCoords) copyVertexData._texcoords = new osg::Vec2Array(numVertices);
+    if (!model.colors.empty()) copyVertexData._colors = new osg::Vec4Array(numVertices);
+
+    osg::TaskScheduler::instance()->parallelFor(0, numVertices, copyVertexData, 4096);
+
+    osg::Geometry* geometry = new osg::Geometry;
+    geometry->setVertexArray(copyVertexData._vertices.get());
+    if (hasNormals) geometry->setNormalArray(copyVertexData._normals.get(), osg::Array::BIND_PER_VERTEX);
+    if (hasTexCoords) geometry->setTexCoordArray(0, copyVertexData._texcoords.get());
+    if (copyVertexData._colors.valid()) geometry->setColorArray(copyVertexData._colors.get(), osg::Array::BIND_PER_VERTEX);
+
+    // triangles and quads are split into triangles, larger polygons are left for the Tessellator.
+    osg::ref_ptr<osg::DrawElementsUInt> points = new osg::DrawElementsUInt(GL_POINTS);
+    osg::ref_ptr<osg::DrawElementsUInt> lines = new osg::DrawElementsUInt(GL_LINES);
+    osg::ref_ptr<osg::DrawElementsUInt> triangles = new osg::DrawElementsUInt(GL_TRIANGLES);
+    triangles->reserve(numCorners*3/2);
+
+    std::vector<unsigned int> polygon;
+    bool hasReversedFaces = false;
+    unsigned int offset = 0;
+    for(unsigned int e=0; e<stream.elementSizes.size(); ++e)
+    {
+        unsigned int size = stream.elementSizes[e];
+        const unsigned int* indices = &cornerToVertex[offset];
 
-            if (es.objectName.empty())
+        if (stream.dataTypes[e]==obj::Element::POINTS)
+        {
+            points->insert(points->end(), indices, indices+size);
+        }
+        else if (stream.dataTypes[e]==obj::Element::POLYLINE)
+        {
+            for(unsigned int i=0; i+1<size; ++i)
             {
-                geode->setName(es.groupName);
+                lines->push_back(indices[i]);
+                lines->push_back(indices[i+1]);
             }
-            else if (es.groupName.empty())
+        }
+        else if (size>=3)
+        {
+            polygon.assign(indices, indices+size);
+
+            // need to reverse so add to OSG arrays in same order as in OBJ, as OSG assume anticlockwise ordering.
+            if (hasNormals && !localOptions.noReverseFaces &&
+                model.computeNormal(&stream.vertexIndices[offset], size)*model.averageNormal(&stream.normalIndices[offset], size) < 0.0f)
             {
-                geode->setName(es.objectName);
+                hasReversedFaces = true;
+                std::reverse(polygon.begin(), polygon.end());
+            }
+
+            if (size<=4)
+            {
+                for(unsigned int i=2; i<size; ++i)
+                {
+                    triangles->push_back(polygon[0]);
+                    triangles->push_back(polygon[i-1]);
+                    triangles->push_back(polygon[i]);
+                }
             }
             else
             {
-                geode->setName(es.groupName + std::string(":") + es.objectName);
+                geometry->addPrimitiveSet(new osg::DrawElementsUInt(GL_POLYGON, polygon.begin(), polygon.end()));
             }
+        }
+
+        offset += size;
+    }
+
+    if (!points->empty()) geometry->addPrimitiveSet(points.get());
+    if (!lines->empty()) geometry->addPrimitiveSet(lines.get());
+    if (!triangles->empty()) geometry->addPrimitiveSet(triangles.get());
+
+    if(hasReversedFaces)
+    {
+        OSG_WARN << "Warning: [ReaderWriterOBJ::convertElementStreamToGeometry] Some faces from geometry '" << geometry->getName() << "' were reversed by the plugin" << std::endl;
+    }
+
+    // the element stream is no longer needed, so free it to limit the peak memory of large files.
+    stream = obj::ElementStream();
+
+    return geometry;
+}
+
+void ReaderWriterOBJ::addGeometry(osg::Group* group, osg::Geometry* geometry, const obj::ElementState& es, MaterialToStateSetMap& materialToStateSetMap, ObjOptionsStruct& localOptions) const
+{
+    MaterialToStateSetMap::const_iterator it = materialToStateSetMap.find(es.materialName);
+    if (it == materialToStateSetMap.end())
+    {
+        OSG_WARN << "Obj unable to find material '" << es.materialName << "'" << std::endl;
+    }
+
+    osg::StateSet* stateset = materialToStateSetMap[es.materialName].get();
+    geometry->setStateSet(stateset);
+
+    // tesseleate any large polygons
+    if (!localOptions.noTesselateLargePolygons)
+    {
+        osgUtil::Tessellator tessellator;
+        tessellator.retessellatePolygons(*geometry);
+    }
+
+    // tri strip polygons to improve graphics performance
+    if (!localOptions.noTriStripPolygons)
+    {
+        osgUtil::optimizeMesh(geometry);
+    }
 
-            group->addChild(geode);
+    // if no normals present add them.
+    if (localOptions.generateFacetNormals==false && (!geometry->getNormalArray() || geometry->getNormalArray()->getNumElements()==0))
+    {
+        osgUtil::SmoothingVisitor sv;
+        sv.smooth(*geometry);
+    }
 
+
+    osg::Geode* geode = new osg::Geode;
+    geode->addDrawable(geometry);
+
+    if (es.objectName.empty())
+    {
+        geode->setName(es.groupName);
+    }
+    else if (es.groupName.empty())
+    {
+        geode->setName(es.objectName);
+    }
+    else
+    {
+        geode->setName(es.groupName + std::string(":") + es.objectName);
+    }
+
+    group->addChild(geode);
+}
+
+struct ReaderWriterOBJ::ConvertElementStreams
+{
+    ConvertElementStreams(const ReaderWriterOBJ* rw, obj::Model& model, ObjOptionsStruct& localOptions):
+        _rw(rw),
+        _model(model),
+        _localOptions(localOptions) {}
+
+    void operator() (unsigned int first, unsigned int last)
+    {
+        for(unsigned int i=first; i<last; ++i)
+        {
+            _geometries[i] = _rw->convertElementStreamToGeometry(_model, _streams[i]->second, _localOptions);
+        }
+    }
+
+    const ReaderWriterOBJ*                                      _rw;
+    obj::Model&                                                 _model;
+    ObjOptionsStruct&                                           _localOptions;
+    std::vector<obj::Model::ElementStreamMap::iterator>         _streams;
+    std::vector< osg::ref_ptr<osg::Geometry> >                  _geometries;
+};
+
+osg::Node* ReaderWriterOBJ::convertModelToSceneGraph(obj::Model& model, ObjOptionsStruct& localOptions, const Options* options) const
+{
+
+    if (model.elementStateMap.empty() && model.elementStreamMap.empty()) return 0;
+
+    osg::Group* group = new osg::Group;
+
+    // set up the materials
+    MaterialToStateSetMap materialToStateSetMap;
+    buildMaterialToStateSetMap(model, materialToStateSetMap, localOptions, options);
+
+    // go through the groups of related elements and build geometry from them.
+    for(obj::Model::ElementStateMap::iterator itr=model.elementStateMap.begin();
+        itr!=model.elementStateMap.end();
+        ++itr)
+    {
+
+        const obj::ElementState& es = itr->first;
+        obj::Model::ElementList& el = itr->second;
+
+        osg::Geometry* geometry = convertElementListToGeometry(model,el,localOptions);
+
+        if (geometry)
+        {
+            addGeometry(group, geometry, es, materialToStateSetMap, localOptions);
+        }
+    }
+
+    // element streams from a parallel read are converted on multiple threads, facet normals being generated up front as they extend the model's normals.
+    if (!model.elementStreamMap.empty())
+    {
+        ConvertElementStreams convertElementStreams(this, model, localOptions);
+        for(obj::Model::ElementStreamMap::iterator itr=model.elementStreamMap.begin();
+            itr!=model.elementStreamMap.end();
+            ++itr)
+        {
+            if (localOptions.generateFacetNormals) generateFacetNormals(model, itr->second);
+            convertElementStreams._streams.push_back(itr);
+        }
+        convertElementStreams._geometries.resize(convertElementStreams._streams.size());
+
+        osg::TaskScheduler::instance()->parallelFor(0, static_cast<unsigned int>(convertElementStreams._streams.size()), convertElementStreams);
+
+        for(unsigned int i=0; i<convertElementStreams._streams.size(); ++i)
+        {
+            osg::Geometry* geometry = convertElementStreams._geometries[i].get();
+            if (geometry)
+            {
+                addGeometry(group, geometry, convertElementStreams._streams[i]->first, materialToStateSetMap, localOptions);
+            }
         }
     }
 
@@ -894,6 +1170,10 @@ ReaderWriterOBJ::ObjOptionsStruct ReaderWriterOBJ::parseOptions(const osgDB::Rea
             {
                 localOptions.noReverseFaces = true;
             }
+            else if (pre_equals == "parallelRead")
+            {
+                localOptions.parallelRead = true;
+            }
             else if (pre_equals == "OutputTextureFiles")
             {
                 localOptions.outputTextureFiles = true;
@@ -948,6 +1228,28 @@ osgDB::ReaderWriter::ReadResult ReaderWriterOBJ::readNode(const std::string& fil
     std::string fileName = osgDB::findDataFile( file, options );
     if (fileName.empty()) return ReadResult::FILE_NOT_FOUND;
 
+    ObjOptionsStruct localOptions = parseOptions(options);
+    if (localOptions.parallelRead)
+    {
+        // empty files can't be mapped, so are left to the stream reader.
+        osg::ref_ptr<osgDB::MappedFile> mappedFile = new osgDB::MappedFile(fileName);
+        if (mappedFile->valid())
+        {
+            osg::ref_ptr<Options> local_opt = options ? static_cast<Options*>(options->clone(osg::CopyOp::SHALLOW_COPY)) : new Options;
+            local_opt->getDatabasePathList().push_front(osgDB::getFilePath(fileName));
+
+            obj::Model model;
+            model.setDatabasePath(osgDB::getFilePath(fileName.c_str()));
+            model.readOBJ(mappedFile->data(), mappedFile->size(), local_opt.get());
+
+            // release the mapping before building the scene graph, the model holds all that is needed.
+            mappedFile = 0;
+
+            osg::Node* node = convertModelToSceneGraph(model, localOptions, local_opt.get());
+            return node;
+        }
+    }
+
     osgDB::ifstream fin(fileName.c_str());
     if (fin)
     {
@@ -959,8 +1261,6 @@ osgDB::ReaderWriter::ReadResult ReaderWriterOBJ::readNode(const std::string& fil
         model.setDatabasePath(osgDB::getFilePath(fileName.c_str()));
         model.readOBJ(fin, local_opt.get());
 
-        ObjOptionsStruct localOptions = parseOptions(options);
-
         osg::Node* node = convertModelToSceneGraph(model, localOptions, local_opt.get());
         return node;
     }
@@ -972,11 +1272,19 @@ osgDB::ReaderWriter::ReadResult ReaderWriterOBJ::readNode(std::istream& fin, con
 {
     if (fin)
     {
-        obj::Model model;
-        model.readOBJ(fin, options);
-
         ObjOptionsStruct localOptions = parseOptions(options);
 
+        obj::Model model;
+        if (localOptions.parallelRead)
+        {
+            std::string buffer((std::istreambuf_iterator<char>(fin)), std::istreambuf_iterator<char>());
+            model.readOBJ(buffer.data(), buffer.size(), options);
+        }
+        else
+        {
+            model.readOBJ(fin, options);
+        }
+
         osg::Node* node = convertModelToSceneGraph(model, localOptions, options);
         return node;
     }
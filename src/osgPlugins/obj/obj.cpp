@@ -16,11 +16,15 @@
 #include <fstream>
 #include <string>
 #include <stdio.h>
+#include <stdlib.h>
 #include <functional>
+#include <algorithm>
+#include <list>
 
 #include "obj.h"
 
 #include <osg/Notify>
+#include <osg/TaskScheduler>
 
 #include <osgDB/FileUtils>
 #include <osgDB/FileNameUtils>
@@ -723,95 +727,9 @@ bool Model::readOBJ(std::istream& fin, const osgDB::ReaderWriter::Options* optio
                 }
 
             }
-            else if (strncmp(line,"usemtl ",7)==0)
-            {
-                std::string materialName( line+7 );
-                if (currentElementState.materialName != materialName)
-                {
-                    currentElementState.materialName = materialName;
-                    currentElementList = 0; // reset the element list to force a recompute of which ElementList to use
-                }
-            }
-            else if (strncmp(line,"mtllib ",7)==0)
-            {
-                std::string materialFileName = trim( line+7 );
-                std::string fullPathFileName = osgDB::findDataFile( materialFileName, options );
-                if (!fullPathFileName.empty())
-                {
-                    osgDB::ifstream mfin( fullPathFileName.c_str() );
-                    if (mfin)
-                    {
-                        OSG_INFO << "Obj reading mtllib '" << fullPathFileName << "'\n";
-                        readMTL(mfin);
-                    }
-                    else
-                    {
-                        OSG_WARN << "Obj unable to load mtllib '" << fullPathFileName << "'\n";
-                    }
-                }
-                else
-                {
-                    OSG_WARN << "Obj unable to find mtllib '" << materialFileName << "'\n";
-                }
-            }
-            else if (strncmp(line,"o ",2)==0)
-            {
-                std::string objectName(line+2);
-                if (currentElementState.objectName != objectName)
-                {
-                    currentElementState.objectName = objectName;
-                    currentElementList = 0; // reset the element list to force a recompute of which ElementList to use
-                }
-            }
-            else if (strcmp(line,"o")==0)
-            {
-                std::string objectName(""); // empty name
-                if (currentElementState.objectName != objectName)
-                {
-                    currentElementState.objectName = objectName;
-                    currentElementList = 0; // reset the element list to force a recompute of which ElementList to use
-                }
-            }
-            else if (strncmp(line,"g ",2)==0)
-            {
-                std::string groupName(line+2);
-                if (currentElementState.groupName != groupName)
-                {
-                    currentElementState.groupName = groupName;
-                    currentElementList = 0; // reset the element list to force a recompute of which ElementList to use
-                }
-            }
-            else if (strcmp(line,"g")==0)
-            {
-                std::string groupName(""); // empty name
-                if (currentElementState.groupName != groupName)
-                {
-                    currentElementState.groupName = groupName;
-                    currentElementList = 0; // reset the element list to force a recompute of which ElementList to use
-                }
-            }
-            else if (strncmp(line,"s ",2)==0)
-            {
-                int smoothingGroup=0;
-                if (strncmp(line+2,"off",3)==0) smoothingGroup = 0;
-                else
-                {
-                    int result = sscanf(line+2,"%d",&smoothingGroup);
-                    if (result!=1)
-                    {
-                        OSG_NOTICE <<"*** error reading smoothing group ***"<<std::endl;
-                    }
-                }
-
-                if (currentElementState.smoothingGroup != smoothingGroup)
-                {
-                    currentElementState.smoothingGroup = smoothingGroup;
-                    currentElementList = 0; // reset the element list to force a recompute of which ElementList to use
-                }
-            }
             else
             {
-                OSG_NOTICE <<"*** line not handled *** :"<<line<<std::endl;
+                readStateLine(line, options);
             }
 
         }
@@ -844,6 +762,690 @@ bool Model::readOBJ(std::istream& fin, const osgDB::ReaderWriter::Options* optio
 }
 
 
+//////////////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// Parallel reading of OBJ files held in memory
+//
+namespace
+{
+
+inline bool isSpace(char c) { return c==' ' || c=='\t'; }
+inline bool isLineEnd(char c) { return c=='\n' || c=='\r'; }
+inline bool isDigit(char c) { return c>='0' && c<='9'; }
+
+inline const char* skipSpace(const char* ptr, const char* end)
+{
+    while(ptr<end && isSpace(*ptr)) ++ptr;
+    return ptr;
+}
+
+inline const char* skipLineEnd(const char* ptr, const char* end)
+{
+    if (ptr<end && *ptr=='\r') ++ptr;
+    if (ptr<end && *ptr=='\n') ++ptr;
+    return ptr;
+}
+
+/** Return true if the line ending at ptr is continued on the next line by a backslash, as handled by Model::readline().*/
+inline bool isContinued(const char* ptr, const char* begin)
+{
+    return ptr>begin && *(ptr-1)=='\\';
+}
+
+/** Return the start of the first line beginning at or after ptr.*/
+const char* alignToLineStart(const char* ptr, const char* begin, const char* end)
+{
+    for(; ptr<end; ++ptr)
+    {
+        if (ptr==begin || !isLineEnd(*(ptr-1))) continue;
+
+        // don't split a \r\n pair.
+        if (*(ptr-1)=='\r' && *ptr=='\n') continue;
+
+        const char* lineEnd = ptr-1;
+        if (*lineEnd=='\n' && lineEnd>begin && *(lineEnd-1)=='\r') --lineEnd;
+        if (!isContinued(lineEnd, begin)) return ptr;
+    }
+    return end;
+}
+
+/** Iterate over the lines of a range of characters, lines are returned without their line ending and not null terminated.
+  * Lines continued by a backslash are joined into a scratch buffer.*/
+class LineReader
+{
+public:
+
+    LineReader(const char* begin, const char* end):
+        _begin(begin),
+        _ptr(begin),
+        _end(end) {}
+
+    bool read(const char*& lineBegin, const char*& lineEnd)
+    {
+        if (_ptr>=_end) return false;
+
+        const char* ptr = _ptr;
+        while(ptr<_end && !isLineEnd(*ptr)) ++ptr;
+
+        if (ptr<_end && isContinued(ptr, _begin))
+        {
+            _scratch.clear();
+            for(;;)
+            {
+                bool continued = ptr<_end && isContinued(ptr, _begin);
+                _scratch.append(_ptr, continued ? ptr-1 : ptr);
+                _ptr = skipLineEnd(ptr, _end);
+                if (!continued) break;
+
+                _scratch.push_back(' ');
+                ptr = _ptr;
+                while(ptr<_end && !isLineEnd(*ptr)) ++ptr;
+            }
+
+            lineBegin = _scratch.data();
+            lineEnd = lineBegin+_scratch.size();
+            return true;
+        }
+
+        lineBegin = _ptr;
+        lineEnd = ptr;
+        _ptr = skipLineEnd(ptr, _end);
+        return true;
+    }
+
+protected:
+
+    const char*     _begin;
+    const char*     _ptr;
+    const char*     _end;
+    std::string     _scratch;
+};
+
+/** Parse the float at ptr, advancing ptr past it, or return false if there is no number at ptr.
+  * Decimal numbers are parsed directly, anything else such as inf or nan is handed to strtod().*/
+bool parseFloat(const char*& ptr, const char* end, float& value)
+{
+    static const double s_powersOfTen[] = { 1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+                                            1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22 };
+
+    const char* p = ptr;
+    bool negative = false;
+    if (p<end && (*p=='-' || *p=='+'))
+    {
+        negative = (*p=='-');
+        ++p;
+    }
+
+    double mantissa = 0.0;
+    int numDigits = 0;
+    int exponent = 0;
+    for(; p<end && isDigit(*p); ++p, ++numDigits)
+    {
+        mantissa = mantissa*10.0 + static_cast<double>(*p-'0');
+    }
+    if (p<end && *p=='.')
+    {
+        for(++p; p<end && isDigit(*p); ++p, ++numDigits, --exponent)
+        {
+            mantissa = mantissa*10.0 + static_cast<double>(*p-'0');
+        }
+    }
+
+    if (numDigits==0)
+    {
+        char buffer[64];
+        unsigned int length = 0;
+        for(p=ptr; p<end && length<sizeof(buffer)-1 && !isSpace(*p) && !isLineEnd(*p); ++p) buffer[length++] = *p;
+        buffer[length] = 0;
+
+        char* bufferEnd = buffer;
+        double result = strtod(buffer, &bufferEnd);
+        if (bufferEnd==buffer) return false;
+
+        value = static_cast<float>(result);
+        ptr += (bufferEnd-buffer);
+        return true;
+    }
+
+    if (p<end && (*p=='e' || *p=='E'))
+    {
+        const char* e = p+1;
+        bool negativeExponent = false;
+        if (e<end && (*e=='-' || *e=='+'))
+        {
+            negativeExponent = (*e=='-');
+            ++e;
+        }
+        if (e<end && isDigit(*e))
+        {
+            int explicitExponent = 0;
+            for(; e<end && isDigit(*e); ++e)
+            {
+                if (explicitExponent<10000) explicitExponent = explicitExponent*10 + (*e-'0');
+            }
+            exponent += negativeExponent ? -explicitExponent : explicitExponent;
+            p = e;
+        }
+    }
+
+    // exact powers of ten keep the result correctly rounded in the common case of up to 15 significant digits.
+    if (exponent<0)
+    {
+        while(exponent<-22) { mantissa /= 1e22; exponent += 22; }
+        mantissa /= s_powersOfTen[-exponent];
+    }
+    else
+    {
+        while(exponent>22) { mantissa *= 1e22; exponent -= 22; }
+        mantissa *= s_powersOfTen[exponent];
+    }
+
+    value = static_cast<float>(negative ? -mantissa : mantissa);
+    ptr = p;
+    return true;
+}
+
+/** Parse up to maxValues white space separated floats, returning the number parsed.*/
+unsigned int parseFloats(const char* ptr, const char* end, float* values, unsigned int maxValues)
+{
+    unsigned int numValues = 0;
+    while(numValues<maxValues)
+    {
+        ptr = skipSpace(ptr, end);
+        if (!parseFloat(ptr, end, values[numValues])) break;
+        ++numValues;
+    }
+    return numValues;
+}
+
+bool parseInt(const char*& ptr, const char* end, int& value)
+{
+    const char* p = ptr;
+    bool negative = false;
+    if (p<end && (*p=='-' || *p=='+'))
+    {
+        negative = (*p=='-');
+        ++p;
+    }
+
+    if (p>=end || !isDigit(*p)) return false;
+
+    int result = 0;
+    for(; p<end && isDigit(*p); ++p)
+    {
+        result = result*10 + (*p-'0');
+    }
+
+    value = negative ? -result : result;
+    ptr = p;
+    return true;
+}
+
+inline int hexValue(char c)
+{
+    if (c>='0' && c<='9') return c-'0';
+    if (c>='a' && c<='f') return c-'a'+10;
+    if (c>='A' && c<='F') return c-'A'+10;
+    return 0;
+}
+
+/** Chunk of whole lines of the file, parsed independently of the other chunks.*/
+struct Chunk
+{
+    /** Elements of a chunk that follow a run of state lines, sorted into streams by Element::CoordinateCombination.*/
+    struct Segment
+    {
+        std::vector<std::string>    stateLines;
+        obj::ElementStream          streams[4];
+
+        bool empty() const { return streams[0].empty() && streams[1].empty() && streams[2].empty() && streams[3].empty(); }
+    };
+
+    typedef std::list<Segment> Segments;
+
+    Chunk():
+        begin(0),
+        end(0),
+        numVertices(0),
+        numNormals(0),
+        numTexCoords(0),
+        vertexBase(0),
+        normalBase(0),
+        texCoordBase(0) {}
+
+    const char*             begin;
+    const char*             end;
+
+    unsigned int            numVertices;
+    unsigned int            numNormals;
+    unsigned int            numTexCoords;
+
+    unsigned int            vertexBase;
+    unsigned int            normalBase;
+    unsigned int            texCoordBase;
+
+    obj::Model::Vec4Array   colors;
+    Segments                segments;
+};
+
+enum LineType
+{
+    VERTEX_LINE,
+    NORMAL_LINE,
+    TEXCOORD_LINE,
+    ELEMENT_LINE,
+    COMMENT_LINE,
+    COLOR_LINE,
+    STATE_LINE
+};
+
+/** Classify the line, returning ptr advanced past the keyword and leading white space.*/
+LineType getLineType(const char*& ptr, const char* end)
+{
+    ptr = skipSpace(ptr, end);
+    if (ptr>=end) return COMMENT_LINE;
+
+    unsigned int length = static_cast<unsigned int>(end-ptr);
+    if (ptr[0]=='v')
+    {
+        if (length>=2 && isSpace(ptr[1])) { ptr += 2; return VERTEX_LINE; }
+        if (length>=3 && ptr[1]=='n' && isSpace(ptr[2])) { ptr += 3; return NORMAL_LINE; }
+        if (length>=3 && ptr[1]=='t' && isSpace(ptr[2])) { ptr += 3; return TEXCOORD_LINE; }
+    }
+    else if (ptr[0]=='f' || ptr[0]=='l' || ptr[0]=='p')
+    {
+        if (length>=2 && isSpace(ptr[1])) return ELEMENT_LINE;
+    }
+    else if (ptr[0]=='#')
+    {
+        return (length>=5 && strncmp(ptr, "#MRGB", 5)==0) ? COLOR_LINE : COMMENT_LINE;
+    }
+    else if (ptr[0]=='$')
+    {
+        return COMMENT_LINE;
+    }
+    return STATE_LINE;
+}
+
+struct CountChunks
+{
+    CountChunks(std::vector<Chunk>& chunks):
+        _chunks(chunks) {}
+
+    void operator() (unsigned int first, unsigned int last)
+    {
+        for(unsigned int i=first; i<last; ++i)
+        {
+            Chunk& chunk = _chunks[i];
+            LineReader reader(chunk.begin, chunk.end);
+            const char* lineBegin = 0;
+            const char* lineEnd = 0;
+            while(reader.read(lineBegin, lineEnd))
+            {
+                switch(getLineType(lineBegin, lineEnd))
+                {
+                    case(VERTEX_LINE): ++chunk.numVertices; break;
+                    case(NORMAL_LINE): ++chunk.numNormals; break;
+                    case(TEXCOORD_LINE): ++chunk.numTexCoords; break;
+                    default: break;
+                }
+            }
+        }
+    }
+
+    std::vector<Chunk>& _chunks;
+};
+
+struct ParseChunks
+{
+    ParseChunks(obj::Model& model, std::vector<Chunk>& chunks):
+        _model(model),
+        _chunks(chunks) {}
+
+    void operator() (unsigned int first, unsigned int last)
+    {
+        for(unsigned int i=first; i<last; ++i)
+        {
+            parse(_chunks[i]);
+        }
+    }
+
+    void parse(Chunk& chunk)
+    {
+        unsigned int numVertices = 0;
+        unsigned int numNormals = 0;
+        unsigned int numTexCoords = 0;
+        unsigned int totalNumVertices = static_cast<unsigned int>(_model.vertices.size());
+
+        obj::Element::IndexList vertexIndices;
+        obj::Element::IndexList normalIndices;
+        obj::Element::IndexList texCoordIndices;
+
+        chunk.segments.push_back(Chunk::Segment());
+
+        LineReader reader(chunk.begin, chunk.end);
+        const char* ptr = 0;
+        const char* end = 0;
+        while(reader.read(ptr, end))
+        {
+            switch(getLineType(ptr, end))
+            {
+                case(VERTEX_LINE):
+                {
+                    float v[7];
+                    unsigned int fieldsRead = parseFloats(ptr, end, v, 7);
+
+                    osg::Vec3& vertex = _model.vertices[chunk.vertexBase + numVertices++];
+                    if (fieldsRead==0) vertex.set(0.0f, 0.0f, 0.0f);
+                    else if (fieldsRead==1) vertex.set(v[0], 0.0f, 0.0f);
+                    else if (fieldsRead==2) vertex.set(v[0], v[1], 0.0f);
+                    else if (fieldsRead==4) vertex.set(v[0]/v[3], v[1]/v[3], v[2]/v[3]);
+                    else vertex.set(v[0], v[1], v[2]);
+
+                    if (fieldsRead==6) chunk.colors.push_back(osg::Vec4(v[3], v[4], v[5], 1.0f));
+                    else if (fieldsRead==7) chunk.colors.push_back(osg::Vec4(v[3], v[4], v[5], v[6]));
+                    break;
+                }
+                case(NORMAL_LINE):
+                {
+                    float v[3] = { 0.0f, 0.0f, 0.0f };
+                    parseFloats(ptr, end, v, 3);
+                    _model.normals[chunk.normalBase + numNormals++].set(v[0], v[1], v[2]);
+                    break;
+                }
+                case(TEXCOORD_LINE):
+                {
+                    float v[2] = { 0.0f, 0.0f };
+                    parseFloats(ptr, end, v, 2);
+                    _model.texcoords[chunk.texCoordBase + numTexCoords++].set(v[0], v[1]);
+                    break;
+                }
+                case(ELEMENT_LINE):
+                {
+                    obj::Element::DataType dataType = (ptr[0]=='p') ? obj::Element::POINTS :
+                                                      (ptr[0]=='l') ? obj::Element::POLYLINE :
+                                                      obj::Element::POLYGON;
+
+                    int vertexCount = static_cast<int>(chunk.vertexBase + numVertices);
+                    int normalCount = static_cast<int>(chunk.normalBase + numNormals);
+                    int texCoordCount = static_cast<int>(chunk.texCoordBase + numTexCoords);
+
+                    vertexIndices.clear();
+                    normalIndices.clear();
+                    texCoordIndices.clear();
+
+                    bool valid = true;
+                    ptr += 2;
+                    while(ptr<end)
+                    {
+                        ptr = skipSpace(ptr, end);
+
+                        int vi = 0, ti = 0, ni = 0;
+                        if (parseInt(ptr, end, vi))
+                        {
+                            bool hasTexCoord = false, hasNormal = false;
+                            if (ptr<end && *ptr=='/')
+                            {
+                                ++ptr;
+                                hasTexCoord = parseInt(ptr, end, ti);
+                                if (ptr<end && *ptr=='/')
+                                {
+                                    ++ptr;
+                                    hasNormal = parseInt(ptr, end, ni);
+                                }
+                            }
+
+                            // indices are resolved against the vertices read so far, as Model::remapVertexIndex() does.
+                            int vertexIndex = (vi<0) ? vertexCount+vi : vi-1;
+                            if (vertexIndex<0 || vertexIndex>=static_cast<int>(totalNumVertices)) valid = false;
+                            vertexIndices.push_back(vertexIndex);
+
+                            if (hasNormal)
+                            {
+                                int normalIndex = (ni<0) ? normalCount+ni : ni-1;
+                                if (normalIndex>=0 && normalIndex<normalCount) normalIndices.push_back(normalIndex);
+                            }
+
+                            if (hasTexCoord)
+                            {
+                                int texCoordIndex = (ti<0) ? texCoordCount+ti : ti-1;
+                                if (texCoordIndex>=0 && texCoordIndex<texCoordCount) texCoordIndices.push_back(texCoordIndex);
+                            }
+                        }
+
+                        // skip to white space or end of line
+                        while(ptr<end && !isSpace(*ptr)) ++ptr;
+                    }
+
+                    if (!valid)
+                    {
+                        OSG_NOTICE<<"Obj element with vertex index out of range ignored"<<std::endl;
+                        break;
+                    }
+                    if (vertexIndices.empty()) break;
+
+                    if (normalIndices.size()!=vertexIndices.size()) normalIndices.clear();
+                    if (texCoordIndices.size()!=vertexIndices.size()) texCoordIndices.clear();
+
+                    obj::Element::CoordinateCombination coordinateCombination =
+                        normalIndices.empty() ? (texCoordIndices.empty() ? obj::Element::VERTICES : obj::Element::VERTICES_TEXCOORDS) :
+                                                (texCoordIndices.empty() ? obj::Element::VERTICES_NORMALS : obj::Element::VERTICES_NORMALS_TEXCOORDS);
+
+                    obj::ElementStream& stream = chunk.segments.back().streams[coordinateCombination];
+                    stream.vertexIndices.insert(stream.vertexIndices.end(), vertexIndices.begin(), vertexIndices.end());
+                    stream.normalIndices.insert(stream.normalIndices.end(), normalIndices.begin(), normalIndices.end());
+                    stream.texCoordIndices.insert(stream.texCoordIndices.end(), texCoordIndices.begin(), texCoordIndices.end());
+                    stream.elementSizes.push_back(static_cast<unsigned int>(vertexIndices.size()));
+                    stream.dataTypes.push_back(static_cast<unsigned char>(dataType));
+                    break;
+                }
+                case(COLOR_LINE):
+                {
+                    // ZBrush vertex colors, #MRGB MMRRGGBB MMRRGGBB ... as read by Model::readOBJ(std::istream&, ...)
+                    for(ptr += 6; ptr+8<=end; ptr += 8)
+                    {
+                        float r = static_cast<float>(hexValue(ptr[2])*16 + hexValue(ptr[3])) / 255.0f;
+                        float g = static_cast<float>(hexValue(ptr[4])*16 + hexValue(ptr[5])) / 255.0f;
+                        float b = static_cast<float>(hexValue(ptr[6])*16 + hexValue(ptr[7])) / 255.0f;
+                        chunk.colors.push_back(osg::Vec4(r, g, b, 1.0f));
+                    }
+                    break;
+                }
+                case(STATE_LINE):
+                {
+                    // normalize the line as Model::readline() does, the state is applied in file order once all the chunks are read.
+                    std::string stateLine(ptr, end);
+                    stateLine.erase(stateLine.find_last_not_of(' ')+1);
+                    std::replace(stateLine.begin(), stateLine.end(), '\t', ' ');
+
+                    if (!chunk.segments.back().empty()) chunk.segments.push_back(Chunk::Segment());
+                    chunk.segments.back().stateLines.push_back(stateLine);
+                    break;
+                }
+                default:
+                    break;
+            }
+        }
+    }
+
+    obj::Model&             _model;
+    std::vector<Chunk>&     _chunks;
+};
+
+}
+
+bool Model::readOBJ(const char* data, std::size_t size, const osgDB::ReaderWriter::Options* options)
+{
+    OSG_INFO<<"Reading OBJ file in parallel"<<std::endl;
+
+    osg::ref_ptr<osg::TaskScheduler> scheduler = osg::TaskScheduler::instance();
+
+    // split the file into chunks of whole lines, enough for the threads to balance the load.
+    const std::size_t minimumChunkSize = 1024*1024;
+    std::size_t numChunks = (scheduler->getNumThreads()+1)*8;
+    if (numChunks>size/minimumChunkSize) numChunks = size/minimumChunkSize;
+    if (numChunks<1) numChunks = 1;
+
+    const char* end = data+size;
+    std::vector<Chunk> chunks(numChunks);
+    const char* chunkBegin = data;
+    for(std::size_t i=0; i<numChunks; ++i)
+    {
+        chunks[i].begin = chunkBegin;
+        chunks[i].end = (i+1<numChunks) ? alignToLineStart(data+(size*(i+1))/numChunks, data, end) : end;
+        if (chunks[i].end<chunkBegin) chunks[i].end = chunkBegin;
+        chunkBegin = chunks[i].end;
+    }
+
+    // count the vertices of each chunk so that the chunks can write their vertices straight into place.
+    CountChunks countChunks(chunks);
+    scheduler->parallelFor(0, static_cast<unsigned int>(numChunks), countChunks);
+
+    unsigned int vertexBase = static_cast<unsigned int>(vertices.size());
+    unsigned int normalBase = static_cast<unsigned int>(normals.size());
+    unsigned int texCoordBase = static_cast<unsigned int>(texcoords.size());
+    for(std::vector<Chunk>::iterator itr = chunks.begin(); itr != chunks.end(); ++itr)
+    {
+        itr->vertexBase = vertexBase;
+        itr->normalBase = normalBase;
+        itr->texCoordBase = texCoordBase;
+        vertexBase += itr->numVertices;
+        normalBase += itr->numNormals;
+        texCoordBase += itr->numTexCoords;
+    }
+    vertices.resize(vertexBase);
+    normals.resize(normalBase);
+    texcoords.resize(texCoordBase);
+
+    ParseChunks parseChunks(*this, chunks);
+    scheduler->parallelFor(0, static_cast<unsigned int>(numChunks), parseChunks);
+
+    // merge the chunks in file order, applying the state lines to sort the elements into streams.
+    for(std::vector<Chunk>::iterator itr = chunks.begin(); itr != chunks.end(); ++itr)
+    {
+        colors.insert(colors.end(), itr->colors.begin(), itr->colors.end());
+
+        for(Chunk::Segments::iterator sitr = itr->segments.begin(); sitr != itr->segments.end(); ++sitr)
+        {
+            for(std::vector<std::string>::iterator litr = sitr->stateLines.begin(); litr != sitr->stateLines.end(); ++litr)
+            {
+                readStateLine(litr->c_str(), options);
+            }
+
+            for(unsigned int c=0; c<4; ++c)
+            {
+                ElementStream& stream = sitr->streams[c];
+                if (stream.empty()) continue;
+
+                ElementState elementState = currentElementState;
+                elementState.coordinateCombination = static_cast<Element::CoordinateCombination>(c);
+                elementStreamMap[elementState].append(stream);
+
+                // release the chunk's copy straight away to limit the peak memory of large files.
+                stream = ElementStream();
+            }
+        }
+    }
+
+    OSG_INFO<<"Read "<<vertices.size()<<" vertices in "<<numChunks<<" chunks into "<<elementStreamMap.size()<<" element streams"<<std::endl;
+
+    return true;
+}
+
+void Model::readStateLine(const char* line, const osgDB::ReaderWriter::Options* options)
+{
+    if (strncmp(line,"usemtl ",7)==0)
+    {
+        std::string materialName( line+7 );
+        if (currentElementState.materialName != materialName)
+        {
+            currentElementState.materialName = materialName;
+            currentElementList = 0; // reset the element list to force a recompute of which ElementList to use
+        }
+    }
+    else if (strncmp(line,"mtllib ",7)==0)
+    {
+        std::string materialFileName = trim( line+7 );
+        std::string fullPathFileName = osgDB::findDataFile( materialFileName, options );
+        if (!fullPathFileName.empty())
+        {
+            osgDB::ifstream mfin( fullPathFileName.c_str() );
+            if (mfin)
+            {
+                OSG_INFO << "Obj reading mtllib '" << fullPathFileName << "'\n";
+                readMTL(mfin);
+            }
+            else
+            {
+                OSG_WARN << "Obj unable to load mtllib '" << fullPathFileName << "'\n";
+            }
+        }
+        else
+        {
+            OSG_WARN << "Obj unable to find mtllib '" << materialFileName << "'\n";
+        }
+    }
+    else if (strncmp(line,"o ",2)==0)
+    {
+        std::string objectName(line+2);
+        if (currentElementState.objectName != objectName)
+        {
+            currentElementState.objectName = objectName;
+            currentElementList = 0; // reset the element list to force a recompute of which ElementList to use
+        }
+    }
+    else if (strcmp(line,"o")==0)
+    {
+        std::string objectName(""); // empty name
+        if (currentElementState.objectName != objectName)
+        {
+            currentElementState.objectName = objectName;
+            currentElementList = 0; // reset the element list to force a recompute of which ElementList to use
+        }
+    }
+    else if (strncmp(line,"g ",2)==0)
+    {
+        std::string groupName(line+2);
+        if (currentElementState.groupName != groupName)
+        {
+            currentElementState.groupName = groupName;
+            currentElementList = 0; // reset the element list to force a recompute of which ElementList to use
+        }
+    }
+    else if (strcmp(line,"g")==0)
+    {
+        std::string groupName(""); // empty name
+        if (currentElementState.groupName != groupName)
+        {
+            currentElementState.groupName = groupName;
+            currentElementList = 0; // reset the element list to force a recompute of which ElementList to use
+        }
+    }
+    else if (strncmp(line,"s ",2)==0)
+    {
+        int smoothingGroup=0;
+        if (strncmp(line+2,"off",3)==0) smoothingGroup = 0;
+        else
+        {
+            int result = sscanf(line+2,"%d",&smoothingGroup);
+            if (result!=1)
+            {
+                OSG_NOTICE <<"*** error reading smoothing group ***"<<std::endl;
+            }
+        }
+
+        if (currentElementState.smoothingGroup != smoothingGroup)
+        {
+            currentElementState.smoothingGroup = smoothingGroup;
+            currentElementList = 0; // reset the element list to force a recompute of which ElementList to use
+        }
+    }
+    else
+    {
+        OSG_NOTICE <<"*** line not handled *** :"<<line<<std::endl;
+    }
+}
+
 void Model::addElement(Element* element)
 {
     if (!currentElementList)
@@ -855,27 +1457,42 @@ void Model::addElement(Element* element)
 }
 
 osg::Vec3 Model::averageNormal(const Element& element) const
+{
+    return averageNormal(&element.normalIndices.front(), element.normalIndices.size());
+}
+
+osg::Vec3 Model::computeNormal(const Element& element) const
+{
+    return computeNormal(&element.vertexIndices.front(), element.vertexIndices.size());
+}
+
+bool Model::needReverse(const Element& element) const
+{
+    if (element.normalIndices.empty()) return false;
+
+    return computeNormal(element)*averageNormal(element) < 0.0f;
+}
+
+osg::Vec3 Model::averageNormal(const int* normalIndices, unsigned int size) const
 {
     osg::Vec3 normal;
-    for(Element::IndexList::const_iterator itr=element.normalIndices.begin();
-        itr!=element.normalIndices.end();
-        ++itr)
+    for(unsigned int i=0;i<size;++i)
     {
-        normal += normals[*itr];
+        normal += normals[normalIndices[i]];
     }
     normal.normalize();
 
     return normal;
 }
 
-osg::Vec3 Model::computeNormal(const Element& element) const
+osg::Vec3 Model::computeNormal(const int* vertexIndices, unsigned int size) const
 {
     osg::Vec3 normal;
-    for(unsigned int i=0;i<element.vertexIndices.size()-2;++i)
+    for(unsigned int i=0;i+2<size;++i)
     {
-        osg::Vec3 a = vertices[element.vertexIndices[i]];
-        osg::Vec3 b = vertices[element.vertexIndices[i+1]];
-        osg::Vec3 c = vertices[element.vertexIndices[i+2]];
+        osg::Vec3 a = vertices[vertexIndices[i]];
+        osg::Vec3 b = vertices[vertexIndices[i+1]];
+        osg::Vec3 c = vertices[vertexIndices[i+2]];
         osg::Vec3 localNormal = (b-a)   ^(c-b);
         normal += localNormal;
     }
@@ -883,10 +1500,3 @@ osg::Vec3 Model::computeNormal(const Element& element) const
 
     return normal;
 }
-
-bool Model::needReverse(const Element& element) const
-{
-    if (element.normalIndices.empty()) return false;
-
-    return computeNormal(element)*averageNormal(element) < 0.0f;
-}
@@ -185,6 +185,35 @@ public:
     int                             smoothingGroup;
 };
 
+/** Elements sharing an ElementState packed into flat arrays, as read by Model::readOBJ(const char*, std::size_t, ...),
+  * rather than allocating an Element per face. The normal and texcoord indices are either empty or hold an index
+  * for every vertex index, according to the coordinate combination of the ElementState.*/
+class ElementStream
+{
+public:
+
+    typedef std::vector<int>                IndexList;
+    typedef std::vector<unsigned int>       SizeList;
+    typedef std::vector<unsigned char>      DataTypeList;
+
+    void append(const ElementStream& rhs)
+    {
+        vertexIndices.insert(vertexIndices.end(), rhs.vertexIndices.begin(), rhs.vertexIndices.end());
+        normalIndices.insert(normalIndices.end(), rhs.normalIndices.begin(), rhs.normalIndices.end());
+        texCoordIndices.insert(texCoordIndices.end(), rhs.texCoordIndices.begin(), rhs.texCoordIndices.end());
+        elementSizes.insert(elementSizes.end(), rhs.elementSizes.begin(), rhs.elementSizes.end());
+        dataTypes.insert(dataTypes.end(), rhs.dataTypes.begin(), rhs.dataTypes.end());
+    }
+
+    bool empty() const { return elementSizes.empty(); }
+
+    IndexList       vertexIndices;
+    IndexList       normalIndices;
+    IndexList       texCoordIndices;
+    SizeList        elementSizes;
+    DataTypeList    dataTypes;
+};
+
 class Model
 {
 public:
@@ -198,6 +227,13 @@ public:
     bool readMTL(std::istream& fin);
     bool readOBJ(std::istream& fin, const osgDB::ReaderWriter::Options* options);
 
+    /** Read the OBJ file held in memory, such as a memory mapped file, splitting it into chunks of whole lines that are
+      * parsed in parallel on the osg::TaskScheduler. Elements are collected into elementStreamMap rather than elementStateMap.*/
+    bool readOBJ(const char* data, std::size_t size, const osgDB::ReaderWriter::Options* options);
+
+    /** Apply a usemtl, mtllib, o, g or s line to the current element state.*/
+    void readStateLine(const char* line, const osgDB::ReaderWriter::Options* options);
+
     bool readline(std::istream& fin, char* line, const int LINE_SIZE);
     void addElement(Element* element);
 
@@ -205,6 +241,9 @@ public:
     osg::Vec3 computeNormal(const Element& element) const;
     bool needReverse(const Element& element) const;
 
+    osg::Vec3 averageNormal(const int* normalIndices, unsigned int size) const;
+    osg::Vec3 computeNormal(const int* vertexIndices, unsigned int size) const;
+
     int remapVertexIndex(int vi) { return (vi<0) ? vertices.size()+vi : vi-1; }
     int remapNormalIndex(int vi) { return (vi<0) ? normals.size()+vi : vi-1; }
     int remapTexCoordIndex(int vi) { return (vi<0) ? texcoords.size()+vi : vi-1; }
@@ -215,6 +254,7 @@ public:
     typedef std::vector< osg::Vec4 >                Vec4Array;
     typedef std::vector< osg::ref_ptr<Element> >    ElementList;
     typedef std::map< ElementState,ElementList >    ElementStateMap;
+    typedef std::map< ElementState,ElementStream >  ElementStreamMap;
 
 
     std::string     databasePath;
@@ -230,6 +270,8 @@ public:
     ElementStateMap elementStateMap;
     ElementList*    currentElementList;
 
+    ElementStreamMap elementStreamMap;
+
 };
 
 }
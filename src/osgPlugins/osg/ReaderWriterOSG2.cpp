@@ -16,6 +16,7 @@
 #include <osgDB/FileUtils>
 #include <osgDB/Registry>
 #include <osgDB/ObjectWrapper>
+#include <osgDB/MappedFile>
 #include <stdlib.h>
 #include "AsciiStreamOperator.h"
 #include "BinaryStreamOperator.h"
@@ -128,6 +129,7 @@ public:
         supportsOption( "Ascii", "Import/Export option: Force reading/writing ascii file" );
         supportsOption( "XML", "Import/Export option: Force reading/writing XML file" );
         supportsOption( "ForceReadingImage", "Import option: Load an empty image instead if required file missed" );
+        supportsOption( "NoMemoryMapping", "Import option: Read binary files through a file stream rather than memory mapping them" );
         supportsOption( "SchemaData", "Export option: Record inbuilt schema data into a binary file" );
         supportsOption( "SchemaFile=<file>", "Import/Export option: Use/Record an ascii schema file" );
         supportsOption( "Compressor=<name>", "Export option: Use an inbuilt or user-defined compressor" );
@@ -174,6 +176,13 @@ public:
         return local_opt.release();
     }
 
+    bool useMemoryMapping( std::ios::openmode mode, const Options* options ) const
+    {
+        // reading binary files from a memory mapping lets large arrays and image data be copied in a single memcpy.
+        if ( !(mode & std::ios::binary) ) return false;
+        return !options || options->getOptionString().find("NoMemoryMapping")==std::string::npos;
+    }
+
     virtual ReadResult readObject( const std::string& file, const Options* options ) const
     {
         ReadResult result = ReadResult::FILE_LOADED;
@@ -182,6 +191,12 @@ public:
         Options* local_opt = prepareReading( result, fileName, mode, options );
         if ( !result.success() ) return result;
 
+        if ( useMemoryMapping(mode, local_opt) )
+        {
+            osgDB::imappedstream mappedstream( fileName.c_str() );
+            if ( mappedstream.good() ) return readObject( mappedstream, local_opt );
+        }
+
         osgDB::ifstream istream( fileName.c_str(), mode );
         return readObject( istream, local_opt );
     }
@@ -213,6 +228,12 @@ public:
         Options* local_opt = prepareReading( result, fileName, mode, options );
         if ( !result.success() ) return result;
 
+        if ( useMemoryMapping(mode, local_opt) )
+        {
+            osgDB::imappedstream mappedstream( fileName.c_str() );
+            if ( mappedstream.good() ) return readImage( mappedstream, local_opt );
+        }
+
         osgDB::ifstream istream( fileName.c_str(), mode );
         return readImage( istream, local_opt );
     }
@@ -244,6 +265,12 @@ public:
         Options* local_opt = prepareReading( result, fileName, mode, options );
         if ( !result.success() ) return result;
 
+        if ( useMemoryMapping(mode, local_opt) )
+        {
+            osgDB::imappedstream mappedstream( fileName.c_str() );
+            if ( mappedstream.good() ) return readNode( mappedstream, local_opt );
+        }
+
         osgDB::ifstream istream( fileName.c_str(), mode );
         return readNode( istream, local_opt );
     }
@@ -320,7 +320,8 @@ void OSGA_Archive::IndexBlock::setPositionNextIndexBlock(pos_type position)
 
 OSGA_Archive::OSGA_Archive():
     _version(0.0f),
-    _status(READ)
+    _status(READ),
+    _useMemoryMapping(true)
 {
 }
 
@@ -341,7 +342,18 @@ bool OSGA_Archive::open(const std::string& filename, ArchiveStatus status, unsig
         _status = status;
         _input.open(filename.c_str(), std::ios_base::binary | std::ios_base::in);
 
-        return _open(_input);
+        if (!_open(_input)) return false;
+
+        // map the archive so that reads need neither the shared stream nor the lock, falling back to the stream if it can't be mapped.
+        if (_useMemoryMapping)
+        {
+            _mappedFile = new osgDB::MappedFile(filename);
+            if (!_mappedFile->valid()) _mappedFile = 0;
+
+            OSG_INFO<<"OSGA_Archive::open("<<filename<<") memory mapped "<<_mappedFile.valid()<<std::endl;
+        }
+
+        return true;
     }
     else
     {
@@ -377,6 +389,10 @@ bool OSGA_Archive::open(const std::string& filename, ArchiveStatus status, unsig
             _input.close();
             _status = WRITE;
 
+            // the index changes as files are written, so look files up in the map rather than the hash index.
+            _mappedFile = 0;
+            _hashIndex.clear();
+
             osgDB::open(_output, filename.c_str(), std::ios_base::binary | std::ios_base::in | std::ios_base::out);
 
             OSG_INFO<<"File position after open = "<<ARCHIVE_POS( _output.tellp() )<<" is_open "<<_output.is_open()<<std::endl;
@@ -482,6 +498,8 @@ bool OSGA_Archive::_open(std::istream& input)
                 OSG_INFO<<"    filename "<<(mitr->first)<<" pos="<<(int)((mitr->second).first)<<" size="<<(int)((mitr->second).second)<<std::endl;
             }
 
+            _hashIndex.build(_indexMap);
+
 
             return true;
         }
@@ -494,6 +512,7 @@ void OSGA_Archive::close()
     SERIALIZER();
 
     _input.close();
+    _mappedFile = 0;
 
     if (_status==WRITE)
     {
@@ -509,7 +528,7 @@ std::string OSGA_Archive::getMasterFileName() const
 
 osgDB::FileType OSGA_Archive::getFileType(const std::string& filename) const
 {
-    if (_indexMap.count(filename)!=0) return osgDB::REGULAR_FILE;
+    if (findFileReference(filename)!=0) return osgDB::REGULAR_FILE;
     return osgDB::FILE_NOT_FOUND;
 }
 
@@ -548,7 +567,19 @@ void OSGA_Archive::writeIndexBlocks()
 
 bool OSGA_Archive::fileExists(const std::string& filename) const
 {
-    return (_indexMap.count(filename)!=0);
+    return findFileReference(filename)!=0;
+}
+
+const OSGA_Archive::PositionSizePair* OSGA_Archive::findFileReference(const std::string& filename) const
+{
+    if (!_hashIndex.empty())
+    {
+        const FileNamePositionMap::value_type* entry = _hashIndex.find(filename);
+        return entry ? &(entry->second) : 0;
+    }
+
+    FileNamePositionMap::const_iterator itr = _indexMap.find(filename);
+    return (itr!=_indexMap.end()) ? &(itr->second) : 0;
 }
 
 bool OSGA_Archive::addFileReference(pos_type position, size_type size, const std::string& fileName)
@@ -724,8 +755,49 @@ struct OSGA_Archive::ReadShaderFunctor : public OSGA_Archive::ReadFunctor
     virtual ReaderWriter::ReadResult doRead(ReaderWriter& rw, std::istream& input) const { return rw.readShader(input, _options); }
 };
 
+ReaderWriter::ReadResult OSGA_Archive::readMapped(osgDB::MappedFile* mappedFile, const ReadFunctor& readFunctor) const
+{
+    // the hash index isn't modified while the archive is open for reading and the caller holds a reference to the
+    // mapping, so no lock is required.
+    const PositionSizePair* positionSize = findFileReference(readFunctor._filename);
+    if (!positionSize)
+    {
+        OSG_INFO<<"OSGA_Archive::readObject(obj, "<<readFunctor._filename<<") failed, file not found in archive"<<std::endl;
+        return ReadResult(ReadResult::FILE_NOT_FOUND);
+    }
+
+    if (positionSize->first<0 || positionSize->second<0 ||
+        static_cast<unsigned long long>(positionSize->first + positionSize->second) > static_cast<unsigned long long>(mappedFile->size()))
+    {
+        OSG_NOTICE<<"OSGA_Archive::readObject(obj, "<<readFunctor._filename<<") failed, file extends past the end of the archive"<<std::endl;
+        return ReadResult(ReadResult::ERROR_IN_READING_FILE);
+    }
+
+    ReaderWriter* rw = osgDB::Registry::instance()->getReaderWriterForExtension(getLowerCaseFileExtension(readFunctor._filename));
+    if (!rw)
+    {
+        OSG_INFO<<"OSGA_Archive::readObject(obj, "<<readFunctor._filename<<") failed to find appropriate plugin to read file."<<std::endl;
+        return ReadResult(ReadResult::FILE_NOT_HANDLED);
+    }
+
+    OSG_INFO<<"OSGA_Archive::readObject(obj, "<<readFunctor._filename<<") from memory mapping"<<std::endl;
+
+    osgDB::MappedFileStreamBuffer buffer(mappedFile, static_cast<std::size_t>(positionSize->first), static_cast<std::size_t>(positionSize->second));
+    std::istream ins(&buffer);
+
+    return readFunctor.doRead(*rw, ins);
+}
+
 ReaderWriter::ReadResult OSGA_Archive::read(const ReadFunctor& readFunctor)
 {
+    // take a reference to the mapping under the lock, as close() may release it at any time.
+    osg::ref_ptr<osgDB::MappedFile> mappedFile;
+    {
+        SERIALIZER();
+        mappedFile = _mappedFile;
+    }
+    if (mappedFile.valid()) return readMapped(mappedFile.get(), readFunctor);
+
     SERIALIZER();
 
     if (_status!=READ)
@@ -734,8 +806,8 @@ ReaderWriter::ReadResult OSGA_Archive::read(const ReadFunctor& readFunctor)
         return ReadResult(ReadResult::FILE_NOT_HANDLED);
     }
 
-    FileNamePositionMap::const_iterator itr = _indexMap.find(readFunctor._filename);
-    if (itr==_indexMap.end())
+    const PositionSizePair* positionSize = findFileReference(readFunctor._filename);
+    if (!positionSize)
     {
         OSG_INFO<<"OSGA_Archive::readObject(obj, "<<readFunctor._filename<<") failed, file not found in archive"<<std::endl;
         return ReadResult(ReadResult::FILE_NOT_FOUND);
@@ -750,11 +822,11 @@ ReaderWriter::ReadResult OSGA_Archive::read(const ReadFunctor& readFunctor)
 
     OSG_INFO<<"OSGA_Archive::readObject(obj, "<<readFunctor._filename<<")"<<std::endl;
 
-    _input.seekg( STREAM_POS( itr->second.first ) );
+    _input.seekg( STREAM_POS( positionSize->first ) );
 
     // set up proxy stream buffer to provide the faked ending.
     std::istream& ins = _input;
-    proxy_streambuf mystreambuf(ins.rdbuf(),itr->second.second);
+    proxy_streambuf mystreambuf(ins.rdbuf(),positionSize->second);
     ins.rdbuf(&mystreambuf);
 
     ReaderWriter::ReadResult result = readFunctor.doRead(*rw, _input);
@@ -14,6 +14,8 @@
 #include <osg/Notify>
 #include <osgDB/Archive>
 #include <osgDB/FileNameUtils>
+#include <osgDB/MappedFile>
+#include <osgDB/FileNameHashIndex>
 
 #include <OpenThreads/ScopedLock>
 #include <OpenThreads/ReentrantMutex>
@@ -35,6 +37,14 @@ class OSGA_Archive : public osgDB::Archive
             return osgDB::equalCaseInsensitive(extension,"osga");
         }
 
+        /** Set whether an archive opened for reading from a file should be memory mapped, so that any number of
+          * threads can read files from it concurrently without locking. Defaults to true, must be set before open().*/
+        void setUseMemoryMapping(bool flag) { _useMemoryMapping = flag; }
+        bool getUseMemoryMapping() const { return _useMemoryMapping; }
+
+        /** Return true if the archive is memory mapped for concurrent reads.*/
+        bool isMemoryMapped() const { SERIALIZER(); return _mappedFile.valid(); }
+
         /** open the archive.*/
         virtual bool open(const std::string& filename, ArchiveStatus status, unsigned int indexBlockSizeHint=4096);
 
@@ -101,6 +111,10 @@ class OSGA_Archive : public osgDB::Archive
         typedef std::pair<pos_type, size_type> PositionSizePair;
         typedef std::map<std::string, PositionSizePair> FileNamePositionMap;
 
+        /** Hash index over the FileNamePositionMap, built once the index of an archive opened for reading has been loaded
+          * and only read from then on, so lookups need no locking.*/
+        typedef osgDB::FileNameHashIndex<FileNamePositionMap> FileNameHashIndex;
+
     protected:
 
         mutable OpenThreads::ReentrantMutex _serializerMutex;
@@ -203,6 +217,10 @@ class OSGA_Archive : public osgDB::Archive
 
 
         osgDB::ReaderWriter::ReadResult read(const ReadFunctor& readFunctor);
+        osgDB::ReaderWriter::ReadResult readMapped(osgDB::MappedFile* mappedFile, const ReadFunctor& readFunctor) const;
+
+        /** Find the position and size of filename, using the hash index when the archive is open for reading.*/
+        const PositionSizePair* findFileReference(const std::string& filename) const;
         osgDB::ReaderWriter::WriteResult write(const WriteFunctor& writeFunctor);
 
         typedef std::list< osg::ref_ptr<IndexBlock> >   IndexBlockList;
@@ -223,6 +241,10 @@ class OSGA_Archive : public osgDB::Archive
         std::string         _masterFileName;
         IndexBlockList      _indexBlockList;
         FileNamePositionMap _indexMap;
+        FileNameHashIndex   _hashIndex;
+
+        bool                                _useMemoryMapping;
+        osg::ref_ptr<osgDB::MappedFile>     _mappedFile;
 
 
         template <typename T>
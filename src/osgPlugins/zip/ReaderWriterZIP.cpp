@@ -14,6 +14,7 @@ class ReaderWriterZIP : public osgDB::ReaderWriter
         ReaderWriterZIP()
         {
             supportsExtension("zip","Zip archive format");
+            supportsOption("NoMemoryMapping","Import option: Read the archive through file handles rather than memory mapping it");
             osgDB::Registry::instance()->addArchiveExtension("zip");
         }
 
@@ -113,7 +114,7 @@ class ReaderWriterZIP : public osgDB::ReaderWriter
 
         virtual osgDB::ReaderWriter::ReadResult readNode(const std::string& file, const osgDB::ReaderWriter::Options* options) const
         {
-            osgDB::ReaderWriter::ReadResult result = openArchive(file, osgDB::Archive::READ);
+            osgDB::ReaderWriter::ReadResult result = openArchive(file, osgDB::Archive::READ, 4096, options);
 
             if (!result.validArchive()) return result;
 
@@ -184,7 +185,7 @@ class ReaderWriterZIP : public osgDB::ReaderWriter
 
         virtual ReadResult readImage(const std::string& file,const Options* options) const
         {
-            osgDB::ReaderWriter::ReadResult result = openArchive(file, osgDB::Archive::READ);
+            osgDB::ReaderWriter::ReadResult result = openArchive(file, osgDB::Archive::READ, 4096, options);
 
             if (!result.validArchive()) return result;
 
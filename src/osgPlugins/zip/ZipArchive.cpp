@@ -38,7 +38,10 @@
 
 
 ZipArchive::ZipArchive()  :
-_zipLoaded( false )
+_zipLoaded( false ),
+_zipData( NULL ),
+_zipSize( 0 ),
+_zipHandles( 64 )
 {
 }
 
@@ -55,15 +58,25 @@ void ZipArchive::close()
         OpenThreads::ScopedLock<OpenThreads::Mutex> exclusive(_zipMutex);
         if ( _zipLoaded )
         {
-            // close the file (on one thread since it's a shared file)
-            const PerThreadData& data = getDataNoLock();
-            CloseZip( data._zipHandle );
-
-            // clear out the file handles
-            _perThreadData.clear();
+            // close the queued handles, those still in use by reads are closed as the reads return them.
+            ++_zipGeneration;
+            HZIP handle = NULL;
+            while ( _zipHandles.pop(handle) )
+            {
+                CloseZip( handle );
+            }
 
             // clear out the index.
+            for ( ZipEntryMap::iterator itr = _zipIndex.begin(); itr != _zipIndex.end(); ++itr )
+            {
+                delete itr->second;
+            }
             _zipIndex.clear();
+            _zipHashIndex.clear();
+
+            _mappedFile = NULL;
+            _zipData = NULL;
+            _zipSize = 0;
 
             _zipLoaded = false;
         }
@@ -130,13 +143,32 @@ bool ZipArchive::open(const std::string& file, ArchiveStatus /*status*/, const o
 
             _password = ReadPassword(options);
 
-            // open the zip file in this thread:
-            const PerThreadData& data = getDataNoLock();
+            // map the file so that handles read it from memory, and stored files can be read in place.
+            bool useMemoryMapping = !options || options->getOptionString().find("NoMemoryMapping")==std::string::npos;
+            if ( useMemoryMapping )
+            {
+                _mappedFile = new osgDB::MappedFile( _filename );
+
+                // OpenZip() takes the size of a memory block as an unsigned int, so larger files are read through file handles.
+                if ( _mappedFile->valid() && _mappedFile->size()<=0xffffffffu )
+                {
+                    _zipData = _mappedFile->data();
+                    _zipSize = _mappedFile->size();
+                }
+                else
+                {
+                    _mappedFile = NULL;
+                }
+
+                OSG_INFO << "ZipArchive::open(" << _filename << ") memory mapped " << _mappedFile.valid() << std::endl;
+            }
 
             // establish a shared (read-only) index:
-            if ( data._zipHandle != NULL )
+            HZIP handle = acquireZipHandle( _zipData, _zipSize );
+            if ( handle != NULL )
             {
-                IndexZipFiles( data._zipHandle );
+                IndexZipFiles( handle );
+                releaseZipHandle( handle, _zipGeneration );
                 _zipLoaded = true;
             }
         }
@@ -163,15 +195,16 @@ bool ZipArchive::open(std::istream& fin, const osgDB::ReaderWriter::Options* opt
             std::stringstream buf;
             buf << fin.rdbuf();
             _membuffer = buf.str();
+            _zipData = _membuffer.c_str();
+            _zipSize = _membuffer.length();
 
             _password = ReadPassword(options);
 
-            // open on this thread:
-            const PerThreadData& data = getDataNoLock();
-
-            if ( data._zipHandle != NULL )
+            HZIP handle = acquireZipHandle( _zipData, _zipSize );
+            if ( handle != NULL )
             {
-                IndexZipFiles( data._zipHandle );
+                IndexZipFiles( handle );
+                releaseZipHandle( handle, _zipGeneration );
                 _zipLoaded = true;
             }
         }
@@ -190,7 +223,7 @@ osgDB::ReaderWriter::ReadResult ZipArchive::readObject(const std::string& file,
     const ZIPENTRY* ze = GetZipEntry(file);
     if(ze != NULL)
     {
-        std::stringstream buffer;
+        ZipEntryStream buffer;
 
         osgDB::ReaderWriter* rw = ReadFromZipEntry(ze, options, buffer);
         if (rw != NULL)
@@ -223,7 +256,7 @@ osgDB::ReaderWriter::ReadResult ZipArchive::readImage(const std::string& file,co
     const ZIPENTRY* ze = GetZipEntry(file);
     if(ze != NULL)
     {
-        std::stringstream buffer;
+        ZipEntryStream buffer;
 
         osgDB::ReaderWriter* rw = ReadFromZipEntry(ze, options, buffer);
         if (rw != NULL)
@@ -256,7 +289,7 @@ osgDB::ReaderWriter::ReadResult ZipArchive::readHeightField(const std::string& f
     const ZIPENTRY* ze = GetZipEntry(file);
     if(ze != NULL)
     {
-        std::stringstream buffer;
+        ZipEntryStream buffer;
 
         osgDB::ReaderWriter* rw = ReadFromZipEntry(ze, options, buffer);
         if (rw != NULL)
@@ -289,7 +322,7 @@ osgDB::ReaderWriter::ReadResult ZipArchive::readNode(const std::string& file,con
     const ZIPENTRY* ze = GetZipEntry(file);
     if(ze != NULL)
     {
-        std::stringstream buffer;
+        ZipEntryStream buffer;
 
         osgDB::ReaderWriter* rw = ReadFromZipEntry(ze, options, buffer);
         if (rw != NULL)
@@ -322,7 +355,7 @@ osgDB::ReaderWriter::ReadResult ZipArchive::readScript(const std::string& file,c
     const ZIPENTRY* ze = GetZipEntry(file);
     if (ze != NULL)
     {
-        std::stringstream buffer;
+        ZipEntryStream buffer;
 
         osgDB::ReaderWriter* rw = ReadFromZipEntry(ze, options, buffer);
         if (rw != NULL)
@@ -355,7 +388,7 @@ osgDB::ReaderWriter::ReadResult ZipArchive::readShader(const std::string& file,c
     const ZIPENTRY* ze = GetZipEntry(file);
     if(ze != NULL)
     {
-        std::stringstream buffer;
+        ZipEntryStream buffer;
 
         osgDB::ReaderWriter* rw = ReadFromZipEntry(ze, options, buffer);
         if (rw != NULL)
@@ -409,46 +442,49 @@ osgDB::ReaderWriter::WriteResult ZipArchive::writeShader(const osg::Shader& /*sh
 }
 
 
-osgDB::ReaderWriter* ZipArchive::ReadFromZipEntry(const ZIPENTRY* ze, const osgDB::ReaderWriter::Options* /*options*/, std::stringstream& buffer) const
+osgDB::ReaderWriter* ZipArchive::ReadFromZipEntry(const ZIPENTRY* ze, const osgDB::ReaderWriter::Options* /*options*/, ZipEntryStream& buffer) const
 {
-    if (ze != 0)
-    {
-        char* ibuf = new (std::nothrow) char[ze->unc_size];
-        if (ibuf)
-        {
-            // fetch the handle for the current thread:
-            const PerThreadData& data = getData();
-            if ( data._zipHandle != NULL )
-            {
-                ZRESULT result = UnzipItem(data._zipHandle, ze->index, ibuf, ze->unc_size);
-                bool unzipSuccesful = CheckZipErrorCode(result);
-                if(unzipSuccesful)
-                {
-                    buffer.write(ibuf,ze->unc_size);
-                }
+    if (ze == 0 || ze->unc_size < 0) return NULL;
 
-                delete[] ibuf;
+    std::string file_ext = osgDB::getFileExtension(ze->name);
 
-                std::string file_ext = osgDB::getFileExtension(ze->name);
+    osgDB::ReaderWriter* rw = osgDB::Registry::instance()->getReaderWriterForExtension(file_ext);
+    if (rw == NULL) return NULL;
 
-                osgDB::ReaderWriter* rw = osgDB::Registry::instance()->getReaderWriterForExtension(file_ext);
-                if (rw != NULL)
-                {
-                    return rw;
-                }
-            }
-            else
-            {
-                delete[] ibuf;
-            }
-        }
-        else
-        {
-            //std::cout << "Error- failed to allocate enough memory to unzip file '" << ze->name << ", with size '" << ze->unc_size << std::endl;
-        }
+    std::size_t size = static_cast<std::size_t>(ze->unc_size);
+
+    // take the archive's memory under the lock, holding a reference to the mapping so close() can't unmap it mid-read.
+    osg::ref_ptr<osgDB::MappedFile> mappedFile;
+    const char* zipData = NULL;
+    std::size_t zipSize = 0;
+    unsigned int generation = 0;
+    {
+        OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_zipMutex);
+        mappedFile = _mappedFile;
+        zipData = _zipData;
+        zipSize = _zipSize;
+        generation = _zipGeneration;
     }
 
-    return NULL;
+    // files stored uncompressed are read in place from the mapped zip rather than copied out of it.
+    if (mappedFile.valid() && ze->method == 0 && !ze->encrypted && ze->data_offset <= zipSize && size <= zipSize - ze->data_offset)
+    {
+        buffer.assign(mappedFile.get(), zipData + ze->data_offset, size);
+        return rw;
+    }
+
+    char* ibuf = buffer.allocate(size);
+    if (size == 0) return rw;
+
+    // take a handle that no other thread is using, so the file can be inflated without locking.
+    HZIP handle = acquireZipHandle(zipData, zipSize);
+    if (handle == NULL) return NULL;
+
+    ZRESULT result = UnzipItem(handle, ze, ibuf, static_cast<unsigned int>(size));
+
+    releaseZipHandle(handle, generation);
+
+    return CheckZipErrorCode(result) ? rw : NULL;
 }
 
 void CleanupFileString(std::string& strFileOrDir)
@@ -509,37 +545,31 @@ void ZipArchive::IndexZipFiles(HZIP hz)
                 delete ze;
             }
         }
+
+        _zipHashIndex.build(_zipIndex);
     }
 }
 
-ZIPENTRY* ZipArchive::GetZipEntry(const std::string& filename)
+const ZipArchive::ZipEntryMap::value_type* ZipArchive::findZipEntry(const std::string& filename) const
 {
-    ZIPENTRY* ze = NULL;
+    if (_zipHashIndex.empty()) return NULL;
+
     std::string fileToLoad = filename;
     CleanupFileString(fileToLoad);
 
-    ZipEntryMap::iterator iter = _zipIndex.find(fileToLoad);
-    if(iter != _zipIndex.end())
-    {
-        ze = (*iter).second;
-    }
+    return _zipHashIndex.find(fileToLoad);
+}
 
-    return ze;
+ZIPENTRY* ZipArchive::GetZipEntry(const std::string& filename)
+{
+    const ZipEntryMap::value_type* entry = findZipEntry(filename);
+    return entry != NULL ? entry->second : NULL;
 }
 
 const ZIPENTRY* ZipArchive::GetZipEntry(const std::string& filename) const
 {
-    ZIPENTRY* ze = NULL;
-    std::string fileToLoad = filename;
-    CleanupFileString(fileToLoad);
-
-    ZipEntryMap::const_iterator iter = _zipIndex.find(fileToLoad);
-    if(iter != _zipIndex.end())
-    {
-        ze = (*iter).second;
-    }
-
-    return ze;
+    const ZipEntryMap::value_type* entry = findZipEntry(filename);
+    return entry != NULL ? entry->second : NULL;
 }
 
 osgDB::FileType ZipArchive::getFileType(const std::string& filename) const
@@ -661,45 +691,41 @@ bool ZipArchive::CheckZipErrorCode(ZRESULT result) const
     }
 }
 
-const ZipArchive::PerThreadData&
-ZipArchive::getData() const
+HZIP ZipArchive::acquireZipHandle(const char* zipData, std::size_t zipSize) const
 {
-    OpenThreads::ScopedLock<OpenThreads::Mutex> exclusive( const_cast<ZipArchive*>(this)->_zipMutex );
-    return getDataNoLock();
-}
+    HZIP handle = NULL;
+    if ( _zipHandles.pop(handle) ) return handle;
 
+    // all the open handles are in use, so open another, reading from memory when the zip is held there.
+    if ( zipData != NULL )
+    {
+        return OpenZip( (void*)zipData, static_cast<unsigned int>(zipSize), _password.c_str() );
+    }
+    else if ( !_filename.empty() )
+    {
+        return OpenZip( _filename.c_str(), _password.c_str() );
+    }
 
-const ZipArchive::PerThreadData&
-ZipArchive::getDataNoLock() const
-{
-    // get/create data for the currently running thread:
-    size_t current = OpenThreads::Thread::CurrentThreadId();
+    return NULL;
+}
 
-    PerThreadDataMap::const_iterator i = _perThreadData.find( current );
+void ZipArchive::releaseZipHandle(HZIP handle, unsigned int generation) const
+{
+    if ( handle == NULL ) return;
 
-    if ( i == _perThreadData.end() || i->second._zipHandle == NULL )
+    // a handle taken before the archive was closed reads from the old file or mapping, so close it.
+    if ( generation != static_cast<unsigned int>(_zipGeneration) || !_zipHandles.push(handle) )
     {
-        // cache pattern: cast to const for caching purposes
-        ZipArchive* ncThis = const_cast<ZipArchive*>(this);
+        CloseZip( handle );
+        return;
+    }
 
-        // data does not already exist, so open the ZIP with a handle exclusively for this thread:
-        PerThreadData& data = ncThis->_perThreadData[current];
-        if ( !_filename.empty() )
-        {
-            data._zipHandle = OpenZip( _filename.c_str(), _password.c_str() );
-        }
-        else if ( !_membuffer.empty() )
-        {
-            data._zipHandle = OpenZip( (void*)_membuffer.c_str(), _membuffer.length(), _password.c_str() );
-        }
-        else
+    // close() may have drained the queue between the check and the push, so close what was pushed after it.
+    if ( generation != static_cast<unsigned int>(_zipGeneration) )
+    {
+        while ( _zipHandles.pop(handle) )
         {
-            data._zipHandle = NULL;
+            CloseZip( handle );
         }
-        return data;
-    }
-    else
-    {
-        return i->second;
     }
 }
@@ -5,10 +5,52 @@
 #include <osgDB/FileUtils>
 
 #include <osgDB/Archive>
+#include <osgDB/MappedFile>
+#include <osgDB/FileNameHashIndex>
+#include <osg/BoundedQueue>
 #include <OpenThreads/Mutex>
+#include <OpenThreads/Atomic>
+
+#include <vector>
 
 #include "unzip.h"
 
+/** Input stream over the uncompressed bytes of an archived file, either inflated into a buffer owned by the
+  * stream or, for files stored uncompressed, read in place from the memory holding the zip.*/
+class ZipEntryStream : public std::istream
+{
+    public:
+        ZipEntryStream():
+            std::istream(0)
+        {
+            rdbuf(&_streambuf);
+        }
+
+        /** Allocate a buffer of size bytes owned by the stream and return it for the file to be inflated into.*/
+        char* allocate(std::size_t size)
+        {
+            _buffer.resize(size);
+            char* data = size>0 ? &_buffer[0] : 0;
+            _streambuf.set(data, size);
+            return data;
+        }
+
+        /** Read size bytes in place from data within mappedFile, which the stream keeps a reference to so the
+          * mapping outlives the read even if the archive is closed meanwhile.*/
+        void assign(osgDB::MappedFile* mappedFile, const char* data, std::size_t size)
+        {
+            _buffer.clear();
+            _mappedFile = mappedFile;
+            _streambuf.set(data, size);
+        }
+
+    protected:
+
+        osgDB::MemoryStreamBuffer       _streambuf;
+        std::vector<char>               _buffer;
+        osg::ref_ptr<osgDB::MappedFile> _mappedFile;
+};
+
 
 class ZipArchive : public osgDB::Archive
 {
@@ -25,7 +67,7 @@ class ZipArchive : public osgDB::Archive
         /** close the archive.*/
         virtual void close();
 
-        /** open the archive.*/
+        /** open the archive, memory mapping it unless options contains "NoMemoryMapping".*/
         virtual bool open(const std::string& filename, ArchiveStatus status, const osgDB::ReaderWriter::Options* options);
 
         /** open the archive for reading.*/
@@ -66,7 +108,7 @@ class ZipArchive : public osgDB::Archive
 
     protected:
 
-        osgDB::ReaderWriter* ReadFromZipEntry(const ZIPENTRY* ze, const osgDB::ReaderWriter::Options* options, std::stringstream& streamIn) const;
+        osgDB::ReaderWriter* ReadFromZipEntry(const ZIPENTRY* ze, const osgDB::ReaderWriter::Options* options, ZipEntryStream& streamIn) const;
 
         void IndexZipFiles(HZIP hz);
         const ZIPENTRY* GetZipEntry(const std::string& filename) const;
@@ -83,20 +125,32 @@ class ZipArchive : public osgDB::Archive
 
         std::string _filename, _password, _membuffer;
 
-        OpenThreads::Mutex _zipMutex;
+        mutable OpenThreads::Mutex _zipMutex;
         bool               _zipLoaded;
         ZipEntryMap        _zipIndex;
         ZIPENTRY           _mainRecord;
 
-        struct PerThreadData {
-            HZIP _zipHandle;
-        };
+        // the memory mapped zip file, or the contents of the stream the archive was opened from, 0 if the file is read through file handles.
+        osg::ref_ptr<osgDB::MappedFile> _mappedFile;
+        const char*                     _zipData;
+        std::size_t                     _zipSize;
+
+        // hash index over the entries of _zipIndex, for lookups that don't walk the map.
+        osgDB::FileNameHashIndex<ZipEntryMap> _zipHashIndex;
+
+        const ZipEntryMap::value_type* findZipEntry(const std::string& filename) const;
+
+        // handles not currently in use by a read. Each read takes a handle from the queue, or opens a new one if
+        // all are in use, and returns it once done, so concurrent reads never share a handle or wait on a lock.
+        typedef osg::BoundedQueue<HZIP> ZipHandleQueue;
+        mutable ZipHandleQueue _zipHandles;
 
-        typedef std::map<size_t, PerThreadData> PerThreadDataMap;
-        PerThreadDataMap _perThreadData;
+        // incremented by close(), so handles still out with a read when the archive is closed are closed when
+        // they are returned rather than queued for a later open.
+        OpenThreads::Atomic _zipGeneration;
 
-        const PerThreadData& getData() const;
-        const PerThreadData& getDataNoLock() const;
+        HZIP acquireZipHandle(const char* zipData, std::size_t zipSize) const;
+        void releaseZipHandle(HZIP handle, unsigned int generation) const;
 };
 
 
@@ -3983,6 +3983,7 @@ class TUnzip
   ZRESULT Get(int index,ZIPENTRY *ze);
   ZRESULT Find(const TCHAR *name,bool ic,int *index,ZIPENTRY *ze);
   ZRESULT Unzip(int index,void *dst,unsigned int len,DWORD flags);
+  ZRESULT Goto(const ZIPENTRY *ze);
   ZRESULT SetUnzipBaseDir(const TCHAR *dir);
   ZRESULT Close();
 };
@@ -4059,6 +4060,10 @@ ZRESULT TUnzip::Get(int index,ZIPENTRY *ze)
   unsigned int extralen,iSizeVar; unsigned long offset;
   int res = unzlocal_CheckCurrentFileCoherencyHeader(uf,&iSizeVar,&offset,&extralen);
   if (res!=UNZ_OK) return ZR_CORRUPT;
+  ze->method = (int)ufi.compression_method;
+  ze->encrypted = (ufi.flag&1)!=0;
+  ze->dir_offset = uf->pos_in_central_dir;
+  ze->data_offset = uf->cur_file_info_internal.offset_curfile + uf->byte_before_the_zipfile + SIZEZIPLOCALHEADER + iSizeVar;
   if (lufseek(uf->file,offset,SEEK_SET)!=0) return ZR_READ;
   unsigned char *extra = new unsigned char[extralen];
   if (lufread(extra,1,(uInt)extralen,uf->file)!=extralen) {delete[] extra; return ZR_READ;}
@@ -4274,6 +4279,17 @@ void EnsureDirectory(const TCHAR *rootdir, const TCHAR *dir)
 
 
 
+ZRESULT TUnzip::Goto(const ZIPENTRY *ze)
+{ if (ze->index<0 || ze->index>=(int)uf->gi.number_entry) return ZR_ARGS;
+  if (currentfile!=-1) unzCloseCurrentFile(uf); currentfile=-1;
+  if ((int)uf->num_file==ze->index && uf->current_file_ok) return ZR_OK;
+  uf->num_file = ze->index;
+  uf->pos_in_central_dir = ze->dir_offset;
+  int err = unzlocal_GetCurrentFileInfoInternal(uf,&uf->cur_file_info,&uf->cur_file_info_internal,NULL,0,NULL,0,NULL,0);
+  uf->current_file_ok = (err==UNZ_OK);
+  return (err==UNZ_OK) ? ZR_OK : ZR_CORRUPT;
+}
+
 ZRESULT TUnzip::Unzip(int index,void *dst,unsigned int len,DWORD flags)
 { if (flags!=ZIP_MEMORY && flags!=ZIP_FILENAME && flags!=ZIP_HANDLE) return ZR_ARGS;
   if (flags==ZIP_MEMORY)
@@ -4519,6 +4535,18 @@ ZRESULT UnzipItemHandle(HZIP hz, int index, HANDLE h) {return UnzipItemInternal(
 ZRESULT UnzipItem(HZIP hz, int index, const TCHAR *fn) {return UnzipItemInternal(hz,index,(void*)fn,0,ZIP_FILENAME);}
 ZRESULT UnzipItem(HZIP hz, int index, void *z,unsigned int len) {return UnzipItemInternal(hz,index,z,len,ZIP_MEMORY);}
 
+ZRESULT UnzipItem(HZIP hz, const ZIPENTRY *ze, void *z,unsigned int len)
+{ if (hz==0 || ze==0) {lasterrorU=ZR_ARGS;return ZR_ARGS;}
+  TUnzipHandleData *han = (TUnzipHandleData*)hz;
+  if (han->flag!=1) {lasterrorU=ZR_ZMODE;return ZR_ZMODE;}
+  TUnzip *unz = han->unz;
+  // return the local result, as handles to the same zip may be in use on other threads that also set lasterrorU
+  ZRESULT res = unz->Goto(ze);
+  if (res==ZR_OK) res = unz->Unzip(ze->index,z,len,ZIP_MEMORY);
+  lasterrorU = res;
+  return res;
+}
+
 ZRESULT SetUnzipBaseDir(HZIP hz, const TCHAR *dir)
 { if (hz==0) {lasterrorU=ZR_ARGS;return ZR_ARGS;}
   TUnzipHandleData *han = (TUnzipHandleData*)hz;
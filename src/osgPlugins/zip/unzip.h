@@ -84,7 +84,11 @@ struct ZIPENTRY
     ctime(0),
     mtime(0),
     comp_size(0),
-    unc_size(0) {}
+    unc_size(0),
+    method(0),
+    encrypted(false),
+    dir_offset(0),
+    data_offset(0) {}
 
   int index;                 // index of this file within the zip
   TCHAR name[MAX_PATH];      // filename within the zip
@@ -92,6 +96,10 @@ struct ZIPENTRY
   FILETIME atime,ctime,mtime;// access, create, modify filetimes
   long comp_size;            // sizes of item, compressed and uncompressed. These
   long unc_size;             // may be -1 if not yet known (e.g. being streamed in)
+  int method;                // compression method, 0 if the item is stored uncompressed
+  bool encrypted;            // whether the item is encrypted
+  unsigned long dir_offset;  // offset of the item's record in the central directory
+  unsigned long data_offset; // offset of the item's (compressed) data within the zip
 };
 
 HZIP OpenZip(const TCHAR *fn, const char *password);
@@ -152,6 +160,12 @@ ZRESULT UnzipItemHandle(HZIP hz, int index, HANDLE h);
 // If you unzip a directory with ZIP_FILENAME, then the directory gets created.
 // If you unzip it to a handle or a memory block, then nothing gets created
 // and it emits 0 bytes.
+ZRESULT UnzipItem(HZIP hz, const ZIPENTRY *ze, void *z,unsigned int len);
+// UnzipItem - unzips the item described by ze, as returned by GetZipItem on
+// any handle to the same zip, to a memory block. Rather than stepping through
+// the central directory from the first item to reach it, the handle is moved
+// straight to the item's record at ze->dir_offset, so unzipping any item
+// takes the same time however many items precede it.
 ZRESULT SetUnzipBaseDir(HZIP hz, const TCHAR *dir);
 // if unzipping to a filename, and it's a relative filename, then it will be relative to here.
 // (defaults to current-directory).
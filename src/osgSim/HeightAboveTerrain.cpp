@@ -85,7 +85,7 @@ void HeightAboveTerrain::computeIntersections(osg::Node* scene, osg::Node::NodeM
     _intersectionVisitor.setTraversalMask(traversalMask);
     _intersectionVisitor.setIntersector( intersectorGroup.get() );
 
-    scene->accept(_intersectionVisitor);
+    _intersectionVisitor.computeIntersections(*scene);
 
     unsigned int index = 0;
     osgUtil::IntersectorGroup::Intersectors& intersectors = intersectorGroup->getIntersectors();
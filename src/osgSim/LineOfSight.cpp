@@ -120,7 +120,7 @@ void LineOfSight::computeIntersections(osg::Node* scene, osg::Node::NodeMask tra
     _intersectionVisitor.setTraversalMask(traversalMask);
     _intersectionVisitor.setIntersector( intersectorGroup.get() );
 
-    scene->accept(_intersectionVisitor);
+    _intersectionVisitor.computeIntersections(*scene);
 
     unsigned int index = 0;
     osgUtil::IntersectorGroup::Intersectors& intersectors = intersectorGroup->getIntersectors();
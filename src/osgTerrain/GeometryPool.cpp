@@ -15,7 +15,15 @@
 #include <osg/VertexArrayState>
 #include <osg/Texture1D>
 #include <osg/Texture2D>
+#include <osg/Texture2DArray>
+#include <osg/observer_ptr>
 #include <osgDB/ReadFile>
+#include <osgUtil/CullVisitor>
+
+#include <OpenThreads/Atomic>
+#include <OpenThreads/ScopedLock>
+
+#include <string.h>
 
 using namespace osgTerrain;
 
@@ -38,15 +46,772 @@ const osgTerrain::Locator* osgTerrain::computeMasterLocator(const osgTerrain::Te
 }
 
 
+/////////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  Instanced tile support
+//
+namespace
+{
+
+// maximum number of tiles drawn by each instanced draw call, must match MAX_TILE_INSTANCES in terrain_displacement_mapping.vert
+const unsigned int s_maxTileInstancesPerDraw = 32;
+
+// Texture2DArray with a fixed number of layers handed out to tiles, all layers holding images of the same size and format.
+// Layers not assigned to a tile hold a blank placeholder image, as Texture2DArray requires an image for every layer.
+// Assignments are queued and applied by commit() during the cull traversal, as the arrays are shared with tiles already
+// being drawn while new tiles are created by the DatabasePager threads.
+class TileTextureArray : public osg::Referenced
+{
+    public:
+
+        TileTextureArray(const osg::Image* prototype, unsigned int numLayers, osg::Texture::FilterMode minFilter, osg::Texture::FilterMode magFilter):
+            _numLayers(numLayers),
+            _numLayersUsed(0),
+            _numLayersReused(0)
+        {
+            _placeholder = new osg::Image;
+            _placeholder->allocateImage(prototype->s(), prototype->t(), 1, prototype->getPixelFormat(), prototype->getDataType(), prototype->getPacking());
+            _placeholder->setInternalTextureFormat(prototype->getInternalTextureFormat());
+            memset(_placeholder->data(), 0, _placeholder->getTotalSizeInBytes());
+
+            _texture = new osg::Texture2DArray;
+            _texture->setDataVariance(osg::Object::DYNAMIC);
+            _texture->setTextureSize(prototype->s(), prototype->t(), numLayers);
+            _texture->setInternalFormat(prototype->getInternalTextureFormat());
+            _texture->setSourceFormat(prototype->getPixelFormat());
+            _texture->setSourceType(prototype->getDataType());
+            _texture->setFilter(osg::Texture::MIN_FILTER, minFilter);
+            _texture->setFilter(osg::Texture::MAG_FILTER, magFilter);
+            _texture->setWrap(osg::Texture::WRAP_S, osg::Texture::CLAMP_TO_EDGE);
+            _texture->setWrap(osg::Texture::WRAP_T, osg::Texture::CLAMP_TO_EDGE);
+            _texture->setResizeNonPowerOfTwoHint(false);
+            if (minFilter!=osg::Texture::NEAREST) _texture->setMaxAnisotropy(16.0f);
+
+            _layerUsedBefore.resize(numLayers, false);
+            for(unsigned int i=0; i<numLayers; ++i)
+            {
+                _texture->setImage(i, _placeholder.get());
+
+                // hand out the lowest layers first.
+                _freeLayers.push_back(numLayers-1-i);
+            }
+        }
+
+        osg::Texture2DArray* getTexture() { return _texture.get(); }
+
+        /** Assign image to a free layer, returning the layer or -1 if the array is full.*/
+        int allocate(osg::Image* image)
+        {
+            OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_mutex);
+            if (_freeLayers.empty()) return -1;
+
+            unsigned int layer = _freeLayers.back();
+            _freeLayers.pop_back();
+
+            if (_layerUsedBefore[layer]) ++_numLayersReused;
+            _layerUsedBefore[layer] = true;
+            ++_numLayersUsed;
+
+            _pending.push_back(PendingImage(layer, image));
+            ++_numPending;
+            return static_cast<int>(layer);
+        }
+
+        /** Return layer to the free list, replacing its image with the placeholder so the tile's image can be deleted.*/
+        void release(int layer)
+        {
+            OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_mutex);
+            _freeLayers.push_back(static_cast<unsigned int>(layer));
+            --_numLayersUsed;
+
+            _pending.push_back(PendingImage(static_cast<unsigned int>(layer), _placeholder.get()));
+            ++_numPending;
+        }
+
+        /** Apply the queued layer assignments to the Texture2DArray.*/
+        void commit()
+        {
+            if (static_cast<unsigned int>(_numPending)==0) return;
+
+            OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_mutex);
+            for(PendingImages::iterator itr = _pending.begin();
+                itr != _pending.end();
+                ++itr)
+            {
+                // setImage() resets the layer's modified count to 0, so the image must differ from that for the layer to be subloaded.
+                if (itr->second->getModifiedCount()==0) itr->second->dirty();
+                _texture->setImage(itr->first, itr->second.get());
+            }
+            _pending.clear();
+            _numPending.exchange(0);
+
+            osg::Texture::FilterMode minFilter = _texture->getFilter(osg::Texture::MIN_FILTER);
+            if (minFilter!=osg::Texture::LINEAR && minFilter!=osg::Texture::NEAREST) _texture->allocateMipmapLevels();
+        }
+
+        void getStatistics(osgTerrain::GeometryPool::Statistics& stats)
+        {
+            OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_mutex);
+            ++stats.numTextureArrays;
+            stats.numTextureArrayLayers += _numLayers;
+            stats.numTextureArrayLayersUsed += _numLayersUsed;
+            stats.numTextureArrayLayersReused += _numLayersReused;
+            stats.textureArrayMemory += static_cast<std::size_t>(_placeholder->getTotalSizeInBytes())*_numLayers;
+        }
+
+    protected:
+
+        virtual ~TileTextureArray() {}
+
+        typedef std::pair< unsigned int, osg::ref_ptr<osg::Image> > PendingImage;
+        typedef std::vector<PendingImage> PendingImages;
+
+        OpenThreads::Mutex                  _mutex;
+        osg::ref_ptr<osg::Texture2DArray>   _texture;
+        osg::ref_ptr<osg::Image>            _placeholder;
+        unsigned int                        _numLayers;
+        std::vector<unsigned int>           _freeLayers;
+        std::vector<bool>                   _layerUsedBefore;
+        unsigned int                        _numLayersUsed;
+        unsigned int                        _numLayersReused;
+        PendingImages                       _pending;
+        OpenThreads::Atomic                 _numPending;
+};
+
+// Drawable recorded during cull that draws all the tiles sharing a SharedGeometry and texture arrays,
+// passing the modelview matrix, normal matrix and texture array layers of each tile as uniform arrays.
+class InstancedTileBatch : public osg::Drawable
+{
+    public:
+
+        InstancedTileBatch()
+        {
+            setSupportsDisplayList(false);
+            setCullingActive(false);
+            createUniforms();
+        }
+
+        InstancedTileBatch(osgTerrain::SharedGeometry* geometry):
+            _geometry(geometry)
+        {
+            setSupportsDisplayList(false);
+            setCullingActive(false);
+            createUniforms();
+        }
+
+        InstancedTileBatch(const InstancedTileBatch& rhs, const osg::CopyOp& copyop=osg::CopyOp::SHALLOW_COPY):
+            osg::Drawable(rhs, copyop),
+            _geometry(rhs._geometry),
+            _modelViewMatrices(rhs._modelViewMatrices),
+            _normalMatrices(rhs._normalMatrices)
+        {
+            createUniforms();
+        }
+
+        META_Node(osgTerrain, InstancedTileBatch);
+
+        void addInstance(const osg::Matrixf& modelView, const osg::Matrixf& normalMatrix)
+        {
+            _modelViewMatrices.push_back(modelView);
+            _normalMatrices.push_back(normalMatrix);
+        }
+
+        unsigned int getNumInstances() const { return static_cast<unsigned int>(_modelViewMatrices.size()); }
+
+        unsigned int getNumDrawCalls() const { return (getNumInstances()+s_maxTileInstancesPerDraw-1)/s_maxTileInstancesPerDraw; }
+
+        virtual void drawImplementation(osg::RenderInfo& renderInfo) const
+        {
+            if (!_geometry || _modelViewMatrices.empty()) return;
+
+            const osg::Program::PerContextProgram* pcp = renderInfo.getState()->getLastAppliedProgramObject();
+            if (!pcp)
+            {
+                OSG_INFO<<"InstancedTileBatch::drawImplementation() no Program applied, unable to draw instanced tiles."<<std::endl;
+                return;
+            }
+
+            unsigned int numInstances = getNumInstances();
+            for(unsigned int first=0; first<numInstances; first+=s_maxTileInstancesPerDraw)
+            {
+                unsigned int count = osg::minimum(s_maxTileInstancesPerDraw, numInstances-first);
+                for(unsigned int i=0; i<count; ++i)
+                {
+                    _modelViewUniform->setElement(i, _modelViewMatrices[first+i]);
+                    _normalUniform->setElement(i, _normalMatrices[first+i]);
+                }
+
+                pcp->apply(*_modelViewUniform);
+                pcp->apply(*_normalUniform);
+
+                _geometry->drawInstances(renderInfo, count);
+            }
+        }
+
+        virtual void compileGLObjects(osg::RenderInfo& renderInfo) const
+        {
+            if (_geometry.valid()) _geometry->compileGLObjects(renderInfo);
+        }
+
+    protected:
+
+        virtual ~InstancedTileBatch() {}
+
+        void createUniforms()
+        {
+            _modelViewUniform = new osg::Uniform(osg::Uniform::FLOAT_MAT4, "tileModelViewMatrix", s_maxTileInstancesPerDraw);
+            _normalUniform = new osg::Uniform(osg::Uniform::FLOAT_MAT4, "tileNormalMatrix", s_maxTileInstancesPerDraw);
+        }
+
+        typedef std::vector<osg::Matrixf> Matrices;
+
+        osg::ref_ptr<osgTerrain::SharedGeometry>    _geometry;
+        Matrices                                    _modelViewMatrices;
+        Matrices                                    _normalMatrices;
+
+        // the uniform arrays each draw call's tiles are written to before being applied to the program.
+        osg::ref_ptr<osg::Uniform>                  _modelViewUniform;
+        osg::ref_ptr<osg::Uniform>                  _normalUniform;
+};
+
+}
+
+// Texture arrays, batch StateSets and per cull traversal batches of the instanced tiles of a GeometryPool.
+class GeometryPool::TileBatcher : public osg::Referenced
+{
+    public:
+
+        TileBatcher():
+            _identityMatrix(new osg::RefMatrix) {}
+
+        TileTextureArray* allocateLayer(osg::Image* image, osg::Texture::FilterMode minFilter, osg::Texture::FilterMode magFilter, unsigned int numLayers, int& layer)
+        {
+            OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_mutex);
+
+            TextureArrayFormat format(image, minFilter, magFilter);
+            TextureArrays& textureArrays = _textureArrays[format];
+            for(TextureArrays::iterator itr = textureArrays.begin();
+                itr != textureArrays.end();
+                ++itr)
+            {
+                layer = (*itr)->allocate(image);
+                if (layer>=0) return itr->get();
+            }
+
+            OSG_INFO<<"GeometryPool::TileBatcher creating Texture2DArray of "<<numLayers<<" layers of "<<image->s()<<"x"<<image->t()<<std::endl;
+
+            osg::ref_ptr<TileTextureArray> textureArray = new TileTextureArray(image, osg::maximum(numLayers, 1u), minFilter, magFilter);
+            textureArrays.push_back(textureArray);
+
+            layer = textureArray->allocate(image);
+            return textureArray.get();
+        }
+
+        osg::StateSet* getOrCreateStateSet(TileTextureArray* heightFieldArray, TileTextureArray* colorArray)
+        {
+            OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_mutex);
+
+            osg::ref_ptr<osg::StateSet>& stateset = _stateSets[StateSetKey(heightFieldArray, colorArray)];
+            if (stateset.valid()) return stateset.get();
+
+            // the texture arrays are modified during cull, so the StateSet must be DYNAMIC to prevent the next frame's
+            // cull traversal overlapping with the draw traversal that applies them.
+            stateset = new osg::StateSet;
+            stateset->setDataVariance(osg::Object::DYNAMIC);
+
+            stateset->setAttribute(getOrCreateProgram());
+
+            stateset->setTextureAttributeAndModes(0, heightFieldArray->getTexture(), osg::StateAttribute::ON);
+            stateset->addUniform(new osg::Uniform("terrainTextureArray", 0));
+
+            stateset->setDefine("INSTANCED_TILES");
+            stateset->setDefine("HEIGHTFIELD_LAYER");
+
+            if (colorArray)
+            {
+                stateset->setTextureAttributeAndModes(1, colorArray->getTexture(), osg::StateAttribute::ON);
+                stateset->addUniform(new osg::Uniform("colorTextureArray0", 1));
+
+                stateset->setDefine("TEXTURE_2D");
+                stateset->setDefine("COLOR_LAYER0");
+            }
+            else
+            {
+                stateset->setDefine("TEXTURE_2D", osg::StateAttribute::OFF);
+                stateset->setDefine("COLOR_LAYER0", osg::StateAttribute::OFF);
+            }
+
+            // only the first colour layer is packed into the texture arrays.
+            stateset->setDefine("COLOR_LAYER1", osg::StateAttribute::OFF);
+            stateset->setDefine("COLOR_LAYER2", osg::StateAttribute::OFF);
+
+            return stateset.get();
+        }
+
+        /** Add a tile to the batch for its geometry and StateSet in the current state and render bin of the cull traversal,
+          * adding the batch to the render bin when it's the first tile of the batch to be culled.*/
+        void addInstance(osgUtil::CullVisitor* cv, SharedGeometry* geometry, osg::StateSet* stateset, const osg::Matrixf& modelView, const osg::Matrixf& normalMatrix, float depth)
+        {
+            BatchKey key;
+            key.stateGraph = cv->getCurrentStateGraph();
+            key.renderBin = cv->getCurrentRenderBin();
+            key.projection = cv->getProjectionMatrix();
+            key.stateset = stateset;
+            key.geometry = geometry;
+
+            osg::ref_ptr<InstancedTileBatch> newBatch;
+            {
+                OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_batchMutex);
+
+                CullVisitorBatchesMap::iterator cvb_itr = _cullVisitorBatches.find(cv);
+                if (cvb_itr==_cullVisitorBatches.end() ||
+                    cvb_itr->second.traversalNumber!=cv->getTraversalNumber() ||
+                    cvb_itr->second.cullVisitor.get()!=cv)
+                {
+                    // a new cull traversal, or a new CullVisitor allocated where a deleted one was, the batches of the
+                    // previous traversal are now only referenced by its render bins.
+                    pruneCullVisitorBatches(cv->getTraversalNumber());
+
+                    cvb_itr = _cullVisitorBatches.insert(CullVisitorBatchesMap::value_type(cv, CullVisitorBatches())).first;
+                    cvb_itr->second.cullVisitor = cv;
+                    cvb_itr->second.traversalNumber = cv->getTraversalNumber();
+                    cvb_itr->second.batches.clear();
+                }
+
+                CullVisitorBatches& cullVisitorBatches = cvb_itr->second;
+
+                osg::ref_ptr<InstancedTileBatch>& batch = cullVisitorBatches.batches[key];
+                if (!batch)
+                {
+                    batch = new InstancedTileBatch(geometry);
+                    newBatch = batch;
+                }
+                batch->addInstance(modelView, normalMatrix);
+            }
+
+            if (newBatch.valid())
+            {
+                cv->pushStateSet(stateset);
+                cv->addDrawableAndDepth(newBatch.get(), _identityMatrix.get(), depth);
+                cv->popStateSet();
+            }
+        }
+
+        void getStatistics(Statistics& stats)
+        {
+            {
+                OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_mutex);
+                for(TextureArraysMap::iterator itr = _textureArrays.begin();
+                    itr != _textureArrays.end();
+                    ++itr)
+                {
+                    for(TextureArrays::iterator ta_itr = itr->second.begin();
+                        ta_itr != itr->second.end();
+                        ++ta_itr)
+                    {
+                        (*ta_itr)->getStatistics(stats);
+                    }
+                }
+            }
+
+            stats.numInstancedTiles = static_cast<unsigned int>(_numInstancedTiles);
+            stats.numNonInstancedTiles = static_cast<unsigned int>(_numNonInstancedTiles);
+
+            OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_batchMutex);
+
+            // only count the batches of cull traversals of the most recent frame.
+            unsigned int latestTraversalNumber = 0;
+            for(CullVisitorBatchesMap::iterator itr = _cullVisitorBatches.begin();
+                itr != _cullVisitorBatches.end();
+                ++itr)
+            {
+                latestTraversalNumber = osg::maximum(latestTraversalNumber, itr->second.traversalNumber);
+            }
+
+            for(CullVisitorBatchesMap::iterator itr = _cullVisitorBatches.begin();
+                itr != _cullVisitorBatches.end();
+                ++itr)
+            {
+                if (itr->second.traversalNumber!=latestTraversalNumber || !itr->second.cullVisitor.valid()) continue;
+
+                for(BatchMap::iterator b_itr = itr->second.batches.begin();
+                    b_itr != itr->second.batches.end();
+                    ++b_itr)
+                {
+                    ++stats.numBatches;
+                    stats.numBatchedTiles += b_itr->second->getNumInstances();
+                    stats.numBatchDrawCalls += b_itr->second->getNumDrawCalls();
+                }
+            }
+        }
+
+        OpenThreads::Atomic     _numInstancedTiles;
+        OpenThreads::Atomic     _numNonInstancedTiles;
+
+    protected:
+
+        virtual ~TileBatcher() {}
+
+        /** Get the Program the batches are drawn with, built from the shaders compiled into the library rather than
+          * those found on OSG_FILE_PATH, which may predate INSTANCED_TILES. Called with _mutex held.*/
+        osg::Program* getOrCreateProgram()
+        {
+            if (_program.valid()) return _program.get();
+
+            _program = new osg::Program;
+
+            {
+                #include "shaders/lighting_vert.cpp"
+                _program->addShader(new osg::Shader(osg::Shader::VERTEX, lighting_vert));
+            }
+
+            {
+                #include "shaders/terrain_displacement_mapping_vert.cpp"
+                _program->addShader(new osg::Shader(osg::Shader::VERTEX, terrain_displacement_mapping_vert));
+            }
+
+            {
+                #include "shaders/terrain_displacement_mapping_geom.cpp"
+                _program->addShader(new osg::Shader(osg::Shader::GEOMETRY, terrain_displacement_mapping_geom));
+
+                _program->setParameter( GL_GEOMETRY_VERTICES_OUT, 4 );
+                _program->setParameter( GL_GEOMETRY_INPUT_TYPE, GL_LINES_ADJACENCY );
+                _program->setParameter( GL_GEOMETRY_OUTPUT_TYPE, GL_TRIANGLE_STRIP);
+            }
+
+            {
+                #include "shaders/terrain_displacement_mapping_frag.cpp"
+                _program->addShader(new osg::Shader(osg::Shader::FRAGMENT, terrain_displacement_mapping_frag));
+            }
+
+            return _program.get();
+        }
+
+        /** Remove the batches of CullVisitors that have been deleted or that haven't culled any instanced tiles since
+          * the frame before traversalNumber, so that the batches don't accumulate as cameras and views come and go.*/
+        void pruneCullVisitorBatches(unsigned int traversalNumber)
+        {
+            for(CullVisitorBatchesMap::iterator itr = _cullVisitorBatches.begin();
+                itr != _cullVisitorBatches.end();)
+            {
+                if (!itr->second.cullVisitor.valid() || itr->second.traversalNumber+1<traversalNumber)
+                {
+                    _cullVisitorBatches.erase(itr++);
+                }
+                else
+                {
+                    ++itr;
+                }
+            }
+        }
+
+        struct TextureArrayFormat
+        {
+            TextureArrayFormat(const osg::Image* image, osg::Texture::FilterMode min, osg::Texture::FilterMode mag):
+                s(image->s()),
+                t(image->t()),
+                internalFormat(image->getInternalTextureFormat()),
+                pixelFormat(image->getPixelFormat()),
+                dataType(image->getDataType()),
+                packing(image->getPacking()),
+                minFilter(min),
+                magFilter(mag) {}
+
+            bool operator < (const TextureArrayFormat& rhs) const
+            {
+                if (s<rhs.s) return true;
+                if (s>rhs.s) return false;
+                if (t<rhs.t) return true;
+                if (t>rhs.t) return false;
+                if (internalFormat<rhs.internalFormat) return true;
+                if (internalFormat>rhs.internalFormat) return false;
+                if (pixelFormat<rhs.pixelFormat) return true;
+                if (pixelFormat>rhs.pixelFormat) return false;
+                if (dataType<rhs.dataType) return true;
+                if (dataType>rhs.dataType) return false;
+                if (packing<rhs.packing) return true;
+                if (packing>rhs.packing) return false;
+                if (minFilter<rhs.minFilter) return true;
+                if (minFilter>rhs.minFilter) return false;
+                return magFilter<rhs.magFilter;
+            }
+
+            int             s;
+            int             t;
+            GLint           internalFormat;
+            GLenum          pixelFormat;
+            GLenum          dataType;
+            unsigned int    packing;
+            osg::Texture::FilterMode minFilter;
+            osg::Texture::FilterMode magFilter;
+        };
+
+        typedef std::vector< osg::ref_ptr<TileTextureArray> > TextureArrays;
+        typedef std::map<TextureArrayFormat, TextureArrays> TextureArraysMap;
+
+        typedef std::pair<TileTextureArray*, TileTextureArray*> StateSetKey;
+        typedef std::map< StateSetKey, osg::ref_ptr<osg::StateSet> > StateSetMap;
+
+        struct BatchKey
+        {
+            bool operator < (const BatchKey& rhs) const
+            {
+                if (stateGraph<rhs.stateGraph) return true;
+                if (stateGraph>rhs.stateGraph) return false;
+                if (renderBin<rhs.renderBin) return true;
+                if (renderBin>rhs.renderBin) return false;
+                if (projection<rhs.projection) return true;
+                if (projection>rhs.projection) return false;
+                if (stateset<rhs.stateset) return true;
+                if (stateset>rhs.stateset) return false;
+                return geometry<rhs.geometry;
+            }
+
+            const osgUtil::StateGraph*  stateGraph;
+            const osgUtil::RenderBin*   renderBin;
+            const osg::RefMatrix*       projection;
+            const osg::StateSet*        stateset;
+            const SharedGeometry*       geometry;
+        };
+
+        typedef std::map< BatchKey, osg::ref_ptr<InstancedTileBatch> > BatchMap;
+
+        struct CullVisitorBatches
+        {
+            CullVisitorBatches():
+                traversalNumber(0) {}
+
+            osg::observer_ptr<osgUtil::CullVisitor>     cullVisitor;
+            unsigned int                                traversalNumber;
+            BatchMap                                    batches;
+        };
+
+        typedef std::map<const osgUtil::CullVisitor*, CullVisitorBatches> CullVisitorBatchesMap;
+
+        OpenThreads::Mutex              _mutex;
+        TextureArraysMap                _textureArrays;
+        StateSetMap                     _stateSets;
+        osg::ref_ptr<osg::Program>      _program;
+
+        OpenThreads::Mutex              _batchMutex;
+        CullVisitorBatchesMap           _cullVisitorBatches;
+
+        osg::ref_ptr<osg::RefMatrix>    _identityMatrix;
+};
+
+namespace
+{
+
+// Texture array layers and batch StateSet of a tile drawn as part of an instanced batch, releasing the layers when the tile is deleted.
+class InstancedTile : public osg::Referenced
+{
+    public:
+
+        InstancedTile(GeometryPool::TileBatcher* batcher, osg::StateSet* stateset,
+                      TileTextureArray* heightFieldArray, int heightFieldLayer,
+                      TileTextureArray* colorArray, int colorLayer):
+            _batcher(batcher),
+            _stateset(stateset),
+            _heightFieldArray(heightFieldArray),
+            _heightFieldLayer(heightFieldLayer),
+            _colorArray(colorArray),
+            _colorLayer(colorLayer)
+        {
+            ++(_batcher->_numInstancedTiles);
+        }
+
+        bool cull(osgUtil::CullVisitor* cv, HeightFieldDrawable* drawable)
+        {
+            const osg::BoundingBox& bb = drawable->getBoundingBox();
+            if (drawable->isCullingActive() && cv->isCulled(bb)) return true;
+
+            osg::RefMatrix& modelView = *cv->getModelViewMatrix();
+            if (cv->getComputeNearFarMode()!=osg::CullSettings::DO_NOT_COMPUTE_NEAR_FAR && bb.valid())
+            {
+                if (!cv->updateCalculatedNearFar(modelView, *drawable, false)) return true;
+            }
+
+            _heightFieldArray->commit();
+            if (_colorArray.valid()) _colorArray->commit();
+
+            // the batch is drawn with an identity modelview matrix so the shader needs the inverse transpose for the normals,
+            // stored transposed as GLSL reads the matrix column major, with the texture array layers in the last row.
+            osg::Matrixd inverse;
+            inverse.invert(modelView);
+
+            osg::Matrixf normalMatrix(inverse(0,0), inverse(1,0), inverse(2,0), 0.0,
+                                      inverse(0,1), inverse(1,1), inverse(2,1), 0.0,
+                                      inverse(0,2), inverse(1,2), inverse(2,2), 0.0,
+                                      static_cast<float>(_heightFieldLayer), static_cast<float>(_colorLayer), 0.0, 1.0);
+
+            float depth = bb.valid() ? -(bb.center() * modelView).z() : 0.0f;
+
+            _batcher->addInstance(cv, drawable->getGeometry(), _stateset.get(), osg::Matrixf(modelView), normalMatrix, depth);
+
+            return true;
+        }
+
+    protected:
+
+        virtual ~InstancedTile()
+        {
+            _heightFieldArray->release(_heightFieldLayer);
+            if (_colorArray.valid()) _colorArray->release(_colorLayer);
+
+            --(_batcher->_numInstancedTiles);
+        }
+
+        osg::ref_ptr<GeometryPool::TileBatcher>     _batcher;
+        osg::ref_ptr<osg::StateSet>                 _stateset;
+        osg::ref_ptr<TileTextureArray>              _heightFieldArray;
+        int                                         _heightFieldLayer;
+        osg::ref_ptr<TileTextureArray>              _colorArray;
+        int                                         _colorLayer;
+};
+
+// Cull callback on the HeightFieldDrawable of an instanced tile, adding the tile to its batch in place of drawing it individually.
+class InstancedTileCullCallback : public osg::DrawableCullCallback
+{
+    public:
+
+        InstancedTileCullCallback() {}
+
+        InstancedTileCullCallback(InstancedTile* tile):
+            _tile(tile) {}
+
+        InstancedTileCullCallback(const InstancedTileCullCallback& rhs, const osg::CopyOp& copyop=osg::CopyOp::SHALLOW_COPY):
+            osg::Object(rhs, copyop),
+            osg::Callback(rhs, copyop),
+            osg::DrawableCullCallback(rhs, copyop),
+            _tile(rhs._tile) {}
+
+        META_Object(osgTerrain, InstancedTileCullCallback);
+
+        virtual bool cull(osg::NodeVisitor* nv, osg::Drawable* drawable, osg::RenderInfo* /*renderInfo*/) const
+        {
+            osgUtil::CullVisitor* cv = nv ? nv->asCullVisitor() : 0;
+            HeightFieldDrawable* hfDrawable = dynamic_cast<HeightFieldDrawable*>(drawable);
+            if (!cv || !hfDrawable || !hfDrawable->getGeometry() || !_tile) return false;
+
+            return _tile->cull(cv, hfDrawable);
+        }
+
+    protected:
+
+        virtual ~InstancedTileCullCallback() {}
+
+        osg::ref_ptr<InstancedTile> _tile;
+};
+
+// Get the layer a colour layer currently refers to, resolving the active layer of a SwitchLayer.
+osgTerrain::Layer* getActiveColorLayer(osgTerrain::Layer* colorLayer)
+{
+    osgTerrain::SwitchLayer* switchLayer = dynamic_cast<osgTerrain::SwitchLayer*>(colorLayer);
+    if (switchLayer)
+    {
+        if (switchLayer->getActiveLayer()<0 ||
+            static_cast<unsigned int>(switchLayer->getActiveLayer())>=switchLayer->getNumLayers())
+        {
+            return 0;
+        }
+
+        return switchLayer->getLayer(switchLayer->getActiveLayer());
+    }
+    return colorLayer;
+}
+
+// Allocate the texture array layers for an instanced tile and return the cull callback that adds it to its batch,
+// or return 0 if the tile's layers can't be packed into texture arrays.
+osg::ref_ptr<InstancedTileCullCallback> createInstancedTileCullCallback(GeometryPool::TileBatcher* batcher, osgTerrain::TerrainTile* tile, osg::HeightField* hf, unsigned int numLayers)
+{
+    if (!hf || !hf->getFloatArray() || hf->getNumColumns()==0 || hf->getNumRows()==0) return 0;
+
+    osgTerrain::Layer* colorLayer = 0;
+    for(unsigned int layerNum=0; layerNum<tile->getNumColorLayers(); ++layerNum)
+    {
+        osgTerrain::Layer* layer = getActiveColorLayer(tile->getColorLayer(layerNum));
+        if (!layer || !layer->getImage()) continue;
+
+        // only a single ImageLayer can be packed.
+        if (colorLayer || !dynamic_cast<osgTerrain::ImageLayer*>(layer)) return 0;
+
+        colorLayer = layer;
+    }
+
+    osg::Image* colorImage = colorLayer ? colorLayer->getImage() : 0;
+    if (colorImage)
+    {
+        // texture array layers are subloaded individually, which needs uncompressed images of a fixed size without precomputed mipmaps.
+        if (colorImage->isCompressed() || colorImage->isMipmap() || colorImage->requiresUpdateCall() || colorImage->r()!=1) return 0;
+    }
+
+    // copy the heights so the texture array layer doesn't depend on the lifetime of the tile's HeightField.
+    osg::ref_ptr<osg::Image> heightFieldImage = new osg::Image;
+    heightFieldImage->allocateImage(hf->getNumColumns(), hf->getNumRows(), 1, GL_LUMINANCE, GL_FLOAT);
+    heightFieldImage->setInternalTextureFormat(GL_LUMINANCE32F_ARB);
+    memcpy(heightFieldImage->data(), hf->getFloatArray()->getDataPointer(), sizeof(float)*hf->getNumColumns()*hf->getNumRows());
+
+    int heightFieldLayer = -1;
+    TileTextureArray* heightFieldArray = batcher->allocateLayer(heightFieldImage.get(), osg::Texture::NEAREST, osg::Texture::NEAREST, numLayers, heightFieldLayer);
+
+    int colorTextureLayer = -1;
+    TileTextureArray* colorArray = 0;
+    if (colorImage)
+    {
+        osg::Texture::FilterMode minFilter = colorLayer->getMinFilter();
+        osg::Texture::FilterMode magFilter = colorLayer->getMagFilter();
+
+        bool mipMapping = !(minFilter==osg::Texture::LINEAR || minFilter==osg::Texture::NEAREST);
+        bool s_NotPowerOfTwo = colorImage->s()==0 || (colorImage->s() & (colorImage->s() - 1));
+        bool t_NotPowerOfTwo = colorImage->t()==0 || (colorImage->t() & (colorImage->t() - 1));
+        if (mipMapping && (s_NotPowerOfTwo || t_NotPowerOfTwo))
+        {
+            OSG_INFO<<"Disabling mipmapping for non power of two tile size("<<colorImage->s()<<", "<<colorImage->t()<<")"<<std::endl;
+            minFilter = osg::Texture::LINEAR;
+        }
+
+        colorArray = batcher->allocateLayer(colorImage, minFilter, magFilter, numLayers, colorTextureLayer);
+    }
+
+    osg::StateSet* stateset = batcher->getOrCreateStateSet(heightFieldArray, colorArray);
+
+    return new InstancedTileCullCallback(new InstancedTile(batcher, stateset, heightFieldArray, heightFieldLayer, colorArray, colorTextureLayer));
+}
+
+}
+
 /////////////////////////////////////////////////////////////////////////////////////////////////////////
 //
 //  GeometryPool
 //
-GeometryPool::GeometryPool():
-    _rootStateSetAssigned(false)
+GeometryPool::Statistics::Statistics():
+    numGeometryRequests(0),
+    numGeometriesCreated(0),
+    numGeometries(0),
+    numGeometriesInUse(0),
+    geometryMemory(0),
+    numInstancedTiles(0),
+    numNonInstancedTiles(0),
+    numTextureArrays(0),
+    numTextureArrayLayers(0),
+    numTextureArrayLayersUsed(0),
+    numTextureArrayLayersReused(0),
+    textureArrayMemory(0),
+    numBatches(0),
+    numBatchedTiles(0),
+    numBatchDrawCalls(0)
+{
+}
 
+GeometryPool::GeometryPool():
+    _numGeometryRequests(0),
+    _numGeometriesCreated(0),
+    _rootStateSetAssigned(false),
+    _useInstancedTiles(false),
+    _numTextureArrayLayers(64)
 {
     _rootStateSet = new osg::StateSet;
+    _tileBatcher = new TileBatcher;
 }
 
 GeometryPool::~GeometryPool()
@@ -61,7 +826,7 @@ bool GeometryPool::createKeyForTile(TerrainTile* tile, GeometryKey& key)
         const osg::Matrixd& matrix = masterLocator->getTransform();
         osg::Vec3d bottom_left = osg::Vec3d(0.0,0.0,0.0) * matrix;
         osg::Vec3d bottom_right = osg::Vec3d(1.0,0.0,0.0) * matrix;
-        osg::Vec3d top_left = osg::Vec3d(1.0,1.0,0.0) * matrix;
+        osg::Vec3d top_left = osg::Vec3d(0.0,1.0,0.0) * matrix;
         key.sx = static_cast<float>((bottom_right-bottom_left).length());
         key.sy = static_cast<float>((top_left-bottom_left).length());
 
@@ -98,12 +863,17 @@ osg::ref_ptr<SharedGeometry> GeometryPool::getOrCreateGeometry(osgTerrain::Terra
     GeometryKey key;
     createKeyForTile(tile, key);
 
+    ++_numGeometryRequests;
+    ++_geometryRequests[key];
+
     GeometryMap::iterator itr = _geometryMap.find(key);
     if (itr != _geometryMap.end())
     {
         return itr->second.get();
     }
 
+    ++_numGeometriesCreated;
+
     osg::ref_ptr<SharedGeometry> geometry = new SharedGeometry;
     _geometryMap[key] = geometry;
 
@@ -132,7 +902,7 @@ osg::ref_ptr<SharedGeometry> GeometryPool::getOrCreateGeometry(osgTerrain::Terra
 
 
     int nx = key.nx;
-    int ny = key.nx;
+    int ny = key.ny;
 
     int numVerticesMainBody = nx * ny;
     int numVerticesSkirt = (nx)*2 + (ny)*2;
@@ -509,6 +1279,30 @@ osg::ref_ptr<osg::MatrixTransform> GeometryPool::getTileSubgraph(osgTerrain::Ter
         }
     }
 
+    if (_useInstancedTiles)
+    {
+        osg::ref_ptr<InstancedTileCullCallback> callback = createInstancedTileCullCallback(_tileBatcher.get(), tile, hf, _numTextureArrayLayers);
+        if (callback.valid())
+        {
+            // the textures are bound by the StateSet of the batch the tile is drawn in, so the tile itself needs no StateSet.
+            hfDrawable->setCullCallback(callback.get());
+
+            LayerTypes layerTypes;
+            layerTypes.push_back(HEIGHTFIELD_LAYER);
+            for(unsigned int layerNum=0; layerNum<tile->getNumColorLayers(); ++layerNum)
+            {
+                osgTerrain::Layer* colorLayer = getActiveColorLayer(tile->getColorLayer(layerNum));
+                if (colorLayer && colorLayer->getImage()) layerTypes.push_back(COLOR_LAYER);
+            }
+            assignRootStateSet(layerTypes);
+
+            return transform;
+        }
+
+        OSG_INFO<<"GeometryPool::getTileSubgraph() tile layers can't be packed into texture arrays, drawing tile individually."<<std::endl;
+        ++(_tileBatcher->_numNonInstancedTiles);
+    }
+
     osg::ref_ptr<osg::StateSet> stateset = transform->getOrCreateStateSet();
 
     // apply colour layers
@@ -725,41 +1519,46 @@ void GeometryPool::applyLayers(osgTerrain::TerrainTile* tile, osg::StateSet* sta
 
 
     //stateset->setDefine("GL_LIGHTING", osg::StateAttribute::ON);
+    assignRootStateSet(layerTypes);
+}
+
+void GeometryPool::assignRootStateSet(const LayerTypes& tileLayerTypes)
+{
+    OpenThreads::ScopedLock<OpenThreads::Mutex>  lock(_programMapMutex);
+    if (!_rootStateSetAssigned)
     {
-        OpenThreads::ScopedLock<OpenThreads::Mutex>  lock(_programMapMutex);
-        if (!_rootStateSetAssigned)
-        {
-            _rootStateSetAssigned = true;
+        _rootStateSetAssigned = true;
 
-            _rootStateSet->setDefine("LIGHTING");
+        _rootStateSet->setDefine("LIGHTING");
 
-            int num_Color = 0;
-            for(LayerTypes::iterator itr = layerTypes.begin();
-                itr != layerTypes.end();
-                ++itr)
-            {
-                switch(*itr)
-                {
-                    case(HEIGHTFIELD_LAYER): _rootStateSet->setDefine("HEIGHTFIELD_LAYER"); break;
-                    case(COLOR_LAYER): ++num_Color; break;
-                    case(CONTOUR_LAYER): break; // not supported right now
-                }
-            }
+        LayerTypes layerTypes(tileLayerTypes);
 
-            if (num_Color>=1)
+        int num_Color = 0;
+        for(LayerTypes::iterator itr = layerTypes.begin();
+            itr != layerTypes.end();
+            ++itr)
+        {
+            switch(*itr)
             {
-                _rootStateSet->setDefine("TEXTURE_2D");
-                _rootStateSet->setDefine("COLOR_LAYER0");
+                case(HEIGHTFIELD_LAYER): _rootStateSet->setDefine("HEIGHTFIELD_LAYER"); break;
+                case(COLOR_LAYER): ++num_Color; break;
+                case(CONTOUR_LAYER): break; // not supported right now
             }
+        }
 
-            if (num_Color>=2) _rootStateSet->setDefine("COLOR_LAYER1");
-            if (num_Color>=3) _rootStateSet->setDefine("COLOR_LAYER2");
+        if (num_Color>=1)
+        {
+            _rootStateSet->setDefine("TEXTURE_2D");
+            _rootStateSet->setDefine("COLOR_LAYER0");
+        }
 
-            osg::ref_ptr<osg::Program> program = getOrCreateProgram(layerTypes);
-            if (program.valid())
-            {
-                _rootStateSet->setAttribute(program.get());
-            }
+        if (num_Color>=2) _rootStateSet->setDefine("COLOR_LAYER1");
+        if (num_Color>=3) _rootStateSet->setDefine("COLOR_LAYER2");
+
+        osg::ref_ptr<osg::Program> program = getOrCreateProgram(layerTypes);
+        if (program.valid())
+        {
+            _rootStateSet->setAttribute(program.get());
         }
     }
 }
@@ -770,6 +1569,40 @@ osg::StateSet* GeometryPool::getRootStateSetForTerrain(Terrain* /*terrain*/)
     return _rootStateSet.get();
 }
 
+void GeometryPool::getStatistics(Statistics& stats) const
+{
+    stats = Statistics();
+
+    {
+        OpenThreads::ScopedLock<OpenThreads::Mutex>  lock(_geometryMapMutex);
+
+        stats.numGeometryRequests = _numGeometryRequests;
+        stats.numGeometriesCreated = _numGeometriesCreated;
+        stats.numGeometries = static_cast<unsigned int>(_geometryMap.size());
+        stats.requestsPerKey = _geometryRequests;
+
+        for(GeometryMap::const_iterator itr = _geometryMap.begin();
+            itr != _geometryMap.end();
+            ++itr)
+        {
+            const SharedGeometry* geometry = itr->second.get();
+
+            // the pool holds one reference, the rest are held by the tiles and instanced batches drawing the geometry.
+            unsigned int numTiles = geometry->referenceCount()-1;
+            stats.tilesPerKey[itr->first] = numTiles;
+            if (numTiles>0) ++stats.numGeometriesInUse;
+
+            if (geometry->getVertexArray()) stats.geometryMemory += geometry->getVertexArray()->getTotalDataSize();
+            if (geometry->getNormalArray()) stats.geometryMemory += geometry->getNormalArray()->getTotalDataSize();
+            if (geometry->getTexCoordArray()) stats.geometryMemory += geometry->getTexCoordArray()->getTotalDataSize();
+            if (geometry->getColorArray()) stats.geometryMemory += geometry->getColorArray()->getTotalDataSize();
+            if (geometry->getDrawElements()) stats.geometryMemory += geometry->getDrawElements()->getTotalDataSize();
+        }
+    }
+
+    _tileBatcher->getStatistics(stats);
+}
+
 /////////////////////////////////////////////////////////////////////////////////////////////////////////
 //
 //  SharedGeometry
@@ -902,6 +1735,41 @@ void SharedGeometry::releaseGLObjects(osg::State* state) const
 }
 
 void SharedGeometry::drawImplementation(osg::RenderInfo& renderInfo) const
+{
+    drawPrimitives(renderInfo, 1);
+}
+
+void SharedGeometry::drawInstances(osg::RenderInfo& renderInfo, unsigned int numInstances) const
+{
+    // mirror Drawable::draw(), binding this geometry's VertexArrayState before drawing.
+    osg::State& state = *renderInfo.getState();
+    if (state.useVertexArrayObject(_useVertexArrayObject))
+    {
+        osg::VertexArrayState* vas = _vertexArrayStateList[state.getStateID()].get();
+        if (!vas)
+        {
+            _vertexArrayStateList[state.getStateID()] = vas = createVertexArrayState(renderInfo);
+        }
+
+        osg::State::SetCurrentVertexArrayStateProxy setVASProxy(state, vas);
+
+        state.bindVertexArrayObject(vas);
+
+        drawPrimitives(renderInfo, numInstances);
+
+        vas->setRequiresSetArrays(getDataVariance()==osg::Object::DYNAMIC);
+        return;
+    }
+
+    if (state.getCurrentVertexArrayState())
+    {
+        state.bindVertexArrayObject(state.getCurrentVertexArrayState());
+    }
+
+    drawPrimitives(renderInfo, numInstances);
+}
+
+void SharedGeometry::drawPrimitives(osg::RenderInfo& renderInfo, unsigned int numInstances) const
 {
     bool computeDiagonals = renderInfo.getState()->supportsShaderRequirement("COMPUTE_DIAGONALS");
     // OSG_NOTICE<<"SharedGeometry::drawImplementation "<<computeDiagonals<<std::endl;
@@ -958,17 +1826,33 @@ void SharedGeometry::drawImplementation(osg::RenderInfo& renderInfo) const
 
     osg::GLBufferObject* ebo = _drawElements->getOrCreateGLBufferObject(state.getContextID());
 
+    const GLvoid* indices = ebo ? (const GLvoid *)(ebo->getOffset(_drawElements->getBufferIndex())) : _drawElements->getDataPointer();
+
     if (ebo)
     {
         /*if (request_bind_unbind)*/ state.bindElementBufferObject(ebo);
+    }
 
-        glDrawElements(primitiveType, _drawElements->getNumIndices(), _drawElements->getDataType(), (const GLvoid *)(ebo->getOffset(_drawElements->getBufferIndex())));
-
-        /*if (request_bind_unbind)*/ state.unbindElementBufferObject();
+    if (numInstances==1)
+    {
+        glDrawElements(primitiveType, _drawElements->getNumIndices(), _drawElements->getDataType(), indices);
     }
     else
     {
-        glDrawElements(primitiveType, _drawElements->getNumIndices(), _drawElements->getDataType(), _drawElements->getDataPointer());
+        const osg::GLExtensions* extensions = state.get<osg::GLExtensions>();
+        if (extensions->glDrawElementsInstanced)
+        {
+            extensions->glDrawElementsInstanced(primitiveType, _drawElements->getNumIndices(), _drawElements->getDataType(), indices, numInstances);
+        }
+        else
+        {
+            OSG_NOTICE<<"Warning: SharedGeometry::drawInstances() glDrawElementsInstanced not supported by OpenGL driver."<<std::endl;
+        }
+    }
+
+    if (ebo)
+    {
+        /*if (request_bind_unbind)*/ state.unbindElementBufferObject();
     }
 
     // unbind the VBO's if any are used.
@@ -1,7 +1,11 @@
-char terrain_displacement_mapping_frag[] = "#pragma import_defines ( TEXTURE_2D, TEXTURE_WEIGHTS, COLOR_LAYER0, COLOR_LAYER1, COLOR_LAYER2)\n"
+char terrain_displacement_mapping_frag[] = "#pragma import_defines ( TEXTURE_2D, TEXTURE_WEIGHTS, COLOR_LAYER0, COLOR_LAYER1, COLOR_LAYER2, INSTANCED_TILES)\n"
                                            "\n"
                                            "\n"
-                                           "#if defined(TEXTURE_2D) && defined(COLOR_LAYER0)\n"
+                                           "#if defined(TEXTURE_2D) && defined(COLOR_LAYER0) && defined(INSTANCED_TILES)\n"
+                                           "#extension GL_EXT_texture_array : enable\n"
+                                           "uniform sampler2DArray colorTextureArray0;\n"
+                                           "varying float colorLayer;\n"
+                                           "#elif defined(TEXTURE_2D) && defined(COLOR_LAYER0)\n"
                                            "uniform sampler2D colorTexture0;\n"
                                            "#endif\n"
                                            "\n"
@@ -30,7 +34,11 @@ char terrain_displacement_mapping_frag[] = "#pragma import_defines ( TEXTURE_2D,
                                            "    vec4 color = vec4(0.0, 0.0, 0.0, 0.0);\n"
                                            "\n"
                                            "    #ifdef COLOR_LAYER0\n"
+                                           "        #ifdef INSTANCED_TILES\n"
+                                           "        color = color + texture2DArray( colorTextureArray0, vec3(texcoord, colorLayer))*WEIGHTS_LOOKUP(0);\n"
+                                           "        #else\n"
                                            "        color = color + texture2D( colorTexture0, texcoord)*WEIGHTS_LOOKUP(0);\n"
+                                           "        #endif\n"
                                            "    #endif\n"
                                            "\n"
                                            "    #ifdef COLOR_LAYER1\n"
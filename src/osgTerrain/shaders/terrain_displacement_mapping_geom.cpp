@@ -1,6 +1,7 @@
 char terrain_displacement_mapping_geom[] = "#version 120\n"
                                            "\n"
                                            "#pragma requires(COMPUTE_DIAGONALS)\n"
+                                           "#pragma import_defines ( INSTANCED_TILES )\n"
                                            "\n"
                                            "#extension GL_EXT_geometry_shader4 : enable\n"
                                            "\n"
@@ -11,6 +12,15 @@ char terrain_displacement_mapping_geom[] = "#version 120\n"
                                            "varying out vec2 texcoord;\n"
                                            "varying out vec4 basecolor;\n"
                                            "\n"
+                                           "#ifdef INSTANCED_TILES\n"
+                                           "// all four vertices come from the same tile so share its colour texture array layer\n"
+                                           "varying in float colorLayer_in[4];\n"
+                                           "varying out float colorLayer;\n"
+                                           "#define SET_COLOR_LAYER colorLayer = colorLayer_in[0]\n"
+                                           "#else\n"
+                                           "#define SET_COLOR_LAYER\n"
+                                           "#endif\n"
+                                           "\n"
                                            "void main(void)\n"
                                            "{\n"
                                            "    float delta_02 = dot(normals_in[2],normals_in[0]);\n"
@@ -18,18 +28,18 @@ char terrain_displacement_mapping_geom[] = "#version 120\n"
                                            "\n"
                                            "    if (delta_02>delta_13)\n"
                                            "    {\n"
-                                           "        gl_Position = gl_PositionIn[3]; texcoord = texcoord_in[3]; basecolor = basecolor_in[3]; EmitVertex();\n"
-                                           "        gl_Position = gl_PositionIn[2]; texcoord = texcoord_in[2]; basecolor = basecolor_in[2]; EmitVertex();\n"
-                                           "        gl_Position = gl_PositionIn[0]; texcoord = texcoord_in[0]; basecolor = basecolor_in[0]; EmitVertex();\n"
-                                           "        gl_Position = gl_PositionIn[1]; texcoord = texcoord_in[1]; basecolor = basecolor_in[1]; EmitVertex();\n"
+                                           "        gl_Position = gl_PositionIn[3]; texcoord = texcoord_in[3]; basecolor = basecolor_in[3]; SET_COLOR_LAYER; EmitVertex();\n"
+                                           "        gl_Position = gl_PositionIn[2]; texcoord = texcoord_in[2]; basecolor = basecolor_in[2]; SET_COLOR_LAYER; EmitVertex();\n"
+                                           "        gl_Position = gl_PositionIn[0]; texcoord = texcoord_in[0]; basecolor = basecolor_in[0]; SET_COLOR_LAYER; EmitVertex();\n"
+                                           "        gl_Position = gl_PositionIn[1]; texcoord = texcoord_in[1]; basecolor = basecolor_in[1]; SET_COLOR_LAYER; EmitVertex();\n"
                                            "        EndPrimitive();\n"
                                            "    }\n"
                                            "    else\n"
                                            "    {\n"
-                                           "        gl_Position = gl_PositionIn[0]; texcoord = texcoord_in[0]; basecolor = basecolor_in[0]; EmitVertex();\n"
-                                           "        gl_Position = gl_PositionIn[3]; texcoord = texcoord_in[3]; basecolor = basecolor_in[3]; EmitVertex();\n"
-                                           "        gl_Position = gl_PositionIn[1]; texcoord = texcoord_in[1]; basecolor = basecolor_in[1]; EmitVertex();\n"
-                                           "        gl_Position = gl_PositionIn[2]; texcoord = texcoord_in[2]; basecolor = basecolor_in[2]; EmitVertex();\n"
+                                           "        gl_Position = gl_PositionIn[0]; texcoord = texcoord_in[0]; basecolor = basecolor_in[0]; SET_COLOR_LAYER; EmitVertex();\n"
+                                           "        gl_Position = gl_PositionIn[3]; texcoord = texcoord_in[3]; basecolor = basecolor_in[3]; SET_COLOR_LAYER; EmitVertex();\n"
+                                           "        gl_Position = gl_PositionIn[1]; texcoord = texcoord_in[1]; basecolor = basecolor_in[1]; SET_COLOR_LAYER; EmitVertex();\n"
+                                           "        gl_Position = gl_PositionIn[2]; texcoord = texcoord_in[2]; basecolor = basecolor_in[2]; SET_COLOR_LAYER; EmitVertex();\n"
                                            "        EndPrimitive();\n"
                                            "    }\n"
                                            "}\n"
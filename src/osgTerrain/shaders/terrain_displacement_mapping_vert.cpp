@@ -1,22 +1,44 @@
 char terrain_displacement_mapping_vert[] = "#version 120\n"
                                            "\n"
-                                           "#pragma import_defines ( HEIGHTFIELD_LAYER, COMPUTE_DIAGONALS, LIGHTING )\n"
+                                           "#pragma import_defines ( HEIGHTFIELD_LAYER, COMPUTE_DIAGONALS, LIGHTING, INSTANCED_TILES )\n"
                                            "\n"
                                            "#ifdef COMPUTE_DIAGONALS\n"
                                            "#extension GL_EXT_geometry_shader4 : enable\n"
                                            "#endif\n"
                                            "\n"
-                                           "#ifdef HEIGHTFIELD_LAYER\n"
+                                           "#ifdef INSTANCED_TILES\n"
+                                           "#extension GL_ARB_draw_instanced : enable\n"
+                                           "#extension GL_EXT_texture_array : enable\n"
+                                           "\n"
+                                           "// must match the number of tiles drawn by each instanced draw call in GeometryPool.cpp\n"
+                                           "#define MAX_TILE_INSTANCES 32\n"
+                                           "\n"
+                                           "// per tile modelview matrix, and inverse transpose modelview matrix with the texture array layers in the last column\n"
+                                           "uniform mat4 tileModelViewMatrix[MAX_TILE_INSTANCES];\n"
+                                           "uniform mat4 tileNormalMatrix[MAX_TILE_INSTANCES];\n"
+                                           "#endif\n"
+                                           "\n"
+                                           "#if defined(HEIGHTFIELD_LAYER) && defined(INSTANCED_TILES)\n"
+                                           "uniform sampler2DArray terrainTextureArray;\n"
+                                           "#define TERRAIN_HEIGHT(tc) texture2DArray(terrainTextureArray, vec3(tc, tileLayers.x)).r\n"
+                                           "#elif defined(HEIGHTFIELD_LAYER)\n"
                                            "uniform sampler2D terrainTexture;\n"
+                                           "#define TERRAIN_HEIGHT(tc) texture2D(terrainTexture, tc).r\n"
                                            "#endif\n"
                                            "\n"
                                            "#ifdef COMPUTE_DIAGONALS\n"
                                            "varying vec2 texcoord_in;\n"
                                            "varying vec3 normals_in;\n"
                                            "varying vec4 basecolor_in;\n"
+                                           "#ifdef INSTANCED_TILES\n"
+                                           "varying float colorLayer_in;\n"
+                                           "#endif\n"
                                            "#else\n"
                                            "varying vec2 texcoord;\n"
                                            "varying vec4 basecolor;\n"
+                                           "#ifdef INSTANCED_TILES\n"
+                                           "varying float colorLayer;\n"
+                                           "#endif\n"
                                            "#endif\n"
                                            "\n"
                                            "\n"
@@ -29,8 +51,12 @@ char terrain_displacement_mapping_vert[] = "#version 120\n"
                                            "{\n"
                                            "    vec2 texcoord_center = gl_MultiTexCoord0.xy;\n"
                                            "\n"
+                                           "#ifdef INSTANCED_TILES\n"
+                                           "    vec2 tileLayers = tileNormalMatrix[gl_InstanceIDARB][3].xy;\n"
+                                           "#endif\n"
+                                           "\n"
                                            "#ifdef HEIGHTFIELD_LAYER\n"
-                                           "    float height_center = texture2D(terrainTexture, texcoord_center).r;\n"
+                                           "    float height_center = TERRAIN_HEIGHT(texcoord_center);\n"
                                            "#else\n"
                                            "    float height_center = 0.0;\n"
                                            "#endif\n"
@@ -48,14 +74,14 @@ char terrain_displacement_mapping_vert[] = "#version 120\n"
                                            "    float dx = 0.0;\n"
                                            "    if (texcoord_left.x>=0.0)\n"
                                            "    {\n"
-                                           "        float height = texture2D(terrainTexture, texcoord_left).r;\n"
+                                           "        float height = TERRAIN_HEIGHT(texcoord_left);\n"
                                            "        dz_dx += (height_center-height)*texelWorldRatio.x;\n"
                                            "        dx += 1.0;\n"
                                            "    }\n"
                                            "\n"
                                            "    if (texcoord_right.x<=1.0)\n"
                                            "    {\n"
-                                           "        float height = texture2D(terrainTexture, texcoord_right).r;\n"
+                                           "        float height = TERRAIN_HEIGHT(texcoord_right);\n"
                                            "        dz_dx += (height-height_center)*texelWorldRatio.x;\n"
                                            "        dx += 1.0;\n"
                                            "    }\n"
@@ -75,14 +101,14 @@ char terrain_displacement_mapping_vert[] = "#version 120\n"
                                            "    float dy = 0.0;\n"
                                            "    if (texcoord_down.y>=0.0)\n"
                                            "    {\n"
-                                           "        float height = texture2D(terrainTexture, texcoord_down).r;\n"
+                                           "        float height = TERRAIN_HEIGHT(texcoord_down);\n"
                                            "        dz_dy += (height_center-height)*texelWorldRatio.y;\n"
                                            "        dy += 1.0;\n"
                                            "    }\n"
                                            "\n"
                                            "    if (texcoord_up.y<=1.0)\n"
                                            "    {\n"
-                                           "        float height = texture2D(terrainTexture, texcoord_up).r;\n"
+                                           "        float height = TERRAIN_HEIGHT(texcoord_up);\n"
                                            "        dz_dy += (height-height_center)*texelWorldRatio.y;\n"
                                            "        dy += 1.0;\n"
                                            "    }\n"
@@ -101,12 +127,20 @@ char terrain_displacement_mapping_vert[] = "#version 120\n"
                                            "    vec3 normal = normalize(rotate_x_mat * (rotate_y_mat * gl_Normal.xyz));\n"
                                            "    //vec3 normal = normalize(gl_Normal.xyz);\n"
                                            "    vec4 color = vec4(1.0,1.0,1.0,1.0);\n"
+                                           "#ifdef INSTANCED_TILES\n"
+                                           "    directionalLight( 0, mat3(tileNormalMatrix[gl_InstanceIDARB]) * normal, color);\n"
+                                           "#else\n"
                                            "    directionalLight( 0, normal, color);\n"
+                                           "#endif\n"
                                            "\n"
                                            "#elif defined(LIGHTING)\n"
                                            "    vec3 normal = gl_Normal.xyz;\n"
                                            "    vec4 color = vec4(1.0, 1.0, 1.0, 1.0);\n"
+                                           "#ifdef INSTANCED_TILES\n"
+                                           "    directionalLight( 0, mat3(tileNormalMatrix[gl_InstanceIDARB]) * normal, color);\n"
+                                           "#else\n"
                                            "    directionalLight( 0, normal, color);\n"
+                                           "#endif\n"
                                            "#else\n"
                                            "    vec3 normal = gl_Normal.xyz;\n"
                                            "    vec4 color = vec4(1.0, 1.0, 1.0, 1.0);\n"
@@ -117,13 +151,24 @@ char terrain_displacement_mapping_vert[] = "#version 120\n"
                                            "    normals_in = normal;\n"
                                            "    texcoord_in = texcoord_center;\n"
                                            "    basecolor_in = color;\n"
+                                           "#ifdef INSTANCED_TILES\n"
+                                           "    colorLayer_in = tileLayers.y;\n"
+                                           "#endif\n"
                                            "#else\n"
                                            "    texcoord = texcoord_center;\n"
                                            "    basecolor = color;\n"
+                                           "#ifdef INSTANCED_TILES\n"
+                                           "    colorLayer = tileLayers.y;\n"
+                                           "#endif\n"
                                            "#endif\n"
                                            "\n"
                                            "    vec3 position = gl_Vertex.xyz + gl_Normal.xyz * height_center;\n"
+                                           "#ifdef INSTANCED_TILES\n"
+                                           "    // the batch is drawn with an identity modelview matrix, so apply the tile's own.\n"
+                                           "    gl_Position   = gl_ProjectionMatrix * (tileModelViewMatrix[gl_InstanceIDARB] * vec4(position,1.0));\n"
+                                           "#else\n"
                                            "    gl_Position   = gl_ModelViewProjectionMatrix * vec4(position,1.0);\n"
+                                           "#endif\n"
                                            "\n"
                                            "}\n"
                                            "\n";
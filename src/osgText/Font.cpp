@@ -295,6 +295,8 @@ Font::Font(FontImplementation* implementation):
 Font::~Font()
 {
     if (_implementation.valid()) _implementation->_facade = 0;
+
+    if (_glyphAtlas.valid()) _glyphAtlas->releaseGlyphs(this);
 }
 
 void Font::setImplementation(FontImplementation* implementation)
@@ -446,6 +448,8 @@ void Font::resizeGLObjectBuffers(unsigned int maxSize)
     {
         (*itr)->resizeGLObjectBuffers(maxSize);
     }
+
+    if (_glyphAtlas.valid()) _glyphAtlas->resizeGLObjectBuffers(maxSize);
 }
 
 void Font::releaseGLObjects(osg::State* state) const
@@ -464,6 +468,8 @@ void Font::releaseGLObjects(osg::State* state) const
         (*itr)->releaseGLObjects(state);
     }
 
+    if (_glyphAtlas.valid()) _glyphAtlas->releaseGLObjects(state);
+
     // const_cast<Font*>(this)->_glyphTextureList.clear();
     // const_cast<Font*>(this)->_sizeGlyphMap.clear();
 }
@@ -492,8 +498,19 @@ void Font::addGlyph(const FontResolution& fontRes, unsigned int charcode, Glyph*
 
 void Font::assignGlyphToGlyphTexture(Glyph* glyph, ShaderTechnique shaderTechnique)
 {
+    // the atlas is called without holding the glyph map lock as it may wait for glyph tasks, which the waiting thread helps to run.
+    if (_glyphAtlas.valid())
+    {
+        if (_glyphAtlas->assignGlyph(glyph, shaderTechnique)) return;
+
+        OSG_INFO<<"Font::assignGlyphToGlyphTexture() no room in GlyphAtlas for glyph "<<glyph->getGlyphCode()<<", using the font's own textures."<<std::endl;
+    }
+
     OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_glyphMapMutex);
 
+    // another thread may have placed the glyph while this one waited for the lock.
+    if (glyph->getTextureInfo(shaderTechnique)) return;
+
     int posX=0,posY=0;
 
     GlyphTexture* glyphTexture = 0;
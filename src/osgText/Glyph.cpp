@@ -79,15 +79,25 @@ int GlyphTexture::compare(const osg::StateAttribute& rhs) const
 
 int GlyphTexture::getEffectMargin(const Glyph* glyph)
 {
-    if (_shaderTechnique==GREYSCALE) return 0;
-    else return osg::maximum(glyph->getFontResolution().second/6, 2u);
+    return computeEffectMargin(glyph, _shaderTechnique);
 }
 
 int GlyphTexture::getTexelMargin(const Glyph* glyph)
+{
+    return computeTexelMargin(glyph, _shaderTechnique);
+}
+
+int GlyphTexture::computeEffectMargin(const Glyph* glyph, ShaderTechnique shaderTechnique)
+{
+    if (shaderTechnique==GREYSCALE) return 0;
+    else return osg::maximum(glyph->getFontResolution().second/6, 2u);
+}
+
+int GlyphTexture::computeTexelMargin(const Glyph* glyph, ShaderTechnique shaderTechnique)
 {
     int width = glyph->s();
     int height = glyph->t();
-    int effect_margin = getEffectMargin(glyph);
+    int effect_margin = computeEffectMargin(glyph, shaderTechnique);
 
     int max_dimension = osg::maximum(width, height) + 2 * effect_margin;
     int margin = osg::maximum(max_dimension/4, 2) + effect_margin;
@@ -169,12 +179,11 @@ void GlyphTexture::addGlyph(Glyph* glyph, int posX, int posY)
     glyph->setTextureInfo(_shaderTechnique, info.get());
 
     copyGlyphImage(glyph, info.get());
+    _image->dirty();
 }
 
 void GlyphTexture::copyGlyphImage(Glyph* glyph, Glyph::TextureInfo* info)
 {
-    _image->dirty();
-
     if (_shaderTechnique<=GREYSCALE)
     {
         // OSG_NOTICE<<"GlyphTexture::copyGlyphImage() greyscale copying. glyphTexture="<<this<<", glyph="<<glyph->getGlyphCode()<<std::endl;
@@ -482,17 +491,23 @@ const Glyph::TextureInfo* Glyph::getTextureInfo(ShaderTechnique technique) const
 
 Glyph::TextureInfo* Glyph::getOrCreateTextureInfo(ShaderTechnique technique)
 {
-    OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_textureInfoListMutex);
-
-    if (technique>=_textureInfoList.size())
+    osg::ref_ptr<TextureInfo> info;
     {
-        _textureInfoList.resize(technique+1);
+        OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_textureInfoListMutex);
+        if (technique<_textureInfoList.size()) info = _textureInfoList[technique];
     }
-    if (!_textureInfoList[technique])
+
+    // the Font is called without holding the lock as a GlyphAtlas may lock other glyphs to evict them while placing this one.
+    if (info.valid())
     {
-        _font->assignGlyphToGlyphTexture(this, technique);
+        if (_font->getGlyphAtlas()) _font->getGlyphAtlas()->touchGlyph(info.get());
+        return info.get();
     }
-    return  _textureInfoList[technique].get();
+
+    _font->assignGlyphToGlyphTexture(this, technique);
+
+    OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_textureInfoListMutex);
+    return (technique<_textureInfoList.size()) ? _textureInfoList[technique].get() : 0;
 }
 
 //////////////////////////////////////////////////////////////////////////////////////////////////////////
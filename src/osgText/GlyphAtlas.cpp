@@ -0,0 +1,490 @@
+/* -*-c++-*- OpenSceneGraph - Copyright (C) 1998-2006 Robert Osfield
+ *
+ * This library is open source and may be redistributed and/or modified under
+ * the terms of the OpenSceneGraph Public License (OSGPL) version 0.0 or
+ * (at your option) any later version.  The full license is in LICENSE file
+ * included with this distribution, and on the openscenegraph.org website.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * OpenSceneGraph Public License for more details.
+*/
+
+#include <osgText/GlyphAtlas>
+#include <osgText/Font>
+
+#include <osg/Notify>
+
+#include <OpenThreads/ScopedLock>
+
+#include <stdlib.h>
+#include <string.h>
+
+using namespace osgText;
+
+class GlyphAtlas::ComputeGlyphTask : public osg::TaskScheduler::Task
+{
+    public:
+
+        ComputeGlyphTask(GlyphAtlas* atlas, GlyphTexture* texture, Glyph* glyph, Glyph::TextureInfo* info):
+            _atlas(atlas),
+            _texture(texture),
+            _glyph(glyph),
+            _info(info) {}
+
+        virtual void run()
+        {
+            _atlas->computeGlyph(_texture.get(), _glyph.get(), _info.get());
+        }
+
+    protected:
+
+        osg::ref_ptr<GlyphAtlas>            _atlas;
+        osg::ref_ptr<GlyphTexture>          _texture;
+        osg::ref_ptr<Glyph>                 _glyph;
+        osg::ref_ptr<Glyph::TextureInfo>    _info;
+};
+
+GlyphAtlas::Statistics::Statistics():
+    numTextures(0),
+    textureMemory(0),
+    numGlyphs(0),
+    usedArea(0),
+    totalArea(0),
+    numGlyphRequests(0),
+    numGlyphMisses(0),
+    numEvictions(0),
+    numAllocationFailures(0),
+    numPendingGlyphs(0)
+{
+}
+
+GlyphAtlas::GlyphAtlas():
+    osg::Referenced(true),
+    _textureWidth(1024),
+    _textureHeight(1024),
+    _minFilterHint(osg::Texture::LINEAR_MIPMAP_LINEAR),
+    _magFilterHint(osg::Texture::LINEAR),
+    _maxAnisotropy(16),
+    _maxNumTextures(4),
+    _computeInBackground(true),
+    _pendingGlyphs(new osg::TaskScheduler::TaskGroup),
+    _numGlyphRequests(0),
+    _numGlyphMisses(0),
+    _numEvictions(0),
+    _numAllocationFailures(0),
+    _numPendingGlyphs(0)
+{
+    char *ptr;
+    if ((ptr = getenv("OSG_MAX_TEXTURE_SIZE")) != 0)
+    {
+        unsigned int osg_max_size = atoi(ptr);
+
+        if (osg_max_size<_textureWidth) _textureWidth = osg_max_size;
+        if (osg_max_size<_textureHeight) _textureHeight = osg_max_size;
+    }
+}
+
+GlyphAtlas::~GlyphAtlas()
+{
+}
+
+osg::ref_ptr<GlyphAtlas>& GlyphAtlas::instance()
+{
+    static osg::ref_ptr<GlyphAtlas> s_glyphAtlas;
+    static OpenThreads::Mutex s_mutex;
+
+    OpenThreads::ScopedLock<OpenThreads::Mutex> lock(s_mutex);
+    if (!s_glyphAtlas) s_glyphAtlas = new GlyphAtlas;
+    return s_glyphAtlas;
+}
+
+void GlyphAtlas::setTextureSize(unsigned int width, unsigned int height)
+{
+    _textureWidth = width;
+    _textureHeight = height;
+
+    char *ptr;
+    if ((ptr = getenv("OSG_MAX_TEXTURE_SIZE")) != 0)
+    {
+        unsigned int osg_max_size = atoi(ptr);
+
+        if (osg_max_size<_textureWidth) _textureWidth = osg_max_size;
+        if (osg_max_size<_textureHeight) _textureHeight = osg_max_size;
+    }
+}
+
+bool GlyphAtlas::assignGlyph(Glyph* glyph, ShaderTechnique shaderTechnique)
+{
+    // slots are sized in steps so that the slots of evicted glyphs suit glyphs of a similar size.
+    int margin = GlyphTexture::computeTexelMargin(glyph, shaderTechnique);
+    int width = ((glyph->s()+2*margin+3)/4)*4;
+    int height = ((glyph->t()+2*margin+7)/8)*8;
+
+    bool waitedForPendingGlyphs = false;
+    for(;;)
+    {
+        {
+            OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_mutex);
+
+            // another thread may have placed the glyph while this one waited for the lock.
+            if (glyph->getTextureInfo(shaderTechnique)) return true;
+
+            if (!waitedForPendingGlyphs)
+            {
+                ++_numGlyphRequests;
+                ++_numGlyphMisses;
+            }
+
+            unsigned int pageIndex = 0, shelfIndex = 0;
+            int x = 0;
+            if (allocateSlot(shaderTechnique, width, height, pageIndex, shelfIndex, x) ||
+                allocateSlotByEviction(shaderTechnique, width, height, pageIndex, shelfIndex, x))
+            {
+                placeGlyph(glyph, shaderTechnique, margin, width, pageIndex, shelfIndex, x);
+                return true;
+            }
+
+            if (waitedForPendingGlyphs || _numPendingGlyphs==0)
+            {
+                ++_numAllocationFailures;
+                return false;
+            }
+        }
+
+        // glyphs whose fields are still being computed can't be evicted, so let them complete rather than overflowing into the font's own textures.
+        waitForPendingGlyphs();
+        waitedForPendingGlyphs = true;
+    }
+}
+
+void GlyphAtlas::placeGlyph(Glyph* glyph, ShaderTechnique shaderTechnique, int margin, int width, unsigned int pageIndex, unsigned int shelfIndex, int x)
+{
+    GlyphTexture* texture = _pages[pageIndex].texture.get();
+    const Shelf& shelf = _pages[pageIndex].shelves[shelfIndex];
+
+    // clear whatever the slot held before, the margins around the glyph are sampled when drawing.
+    osg::Image* image = texture->getImage();
+    unsigned int bytesPerPixel = image->getPixelSizeInBits()/8;
+    for(int r=shelf.y; r<shelf.y+shelf.height; ++r)
+    {
+        memset(image->data(x, r), 0, width*bytesPerPixel);
+    }
+
+    int posX = x+margin;
+    int posY = shelf.y+margin;
+
+    osg::ref_ptr<Glyph::TextureInfo> info = new Glyph::TextureInfo(
+                        texture,
+                        posX, posY,
+                        osg::Vec2( static_cast<float>(posX)/static_cast<float>(texture->getTextureWidth()), static_cast<float>(posY)/static_cast<float>(texture->getTextureHeight()) ), // minTexCoord
+                        osg::Vec2( static_cast<float>(posX+glyph->s())/static_cast<float>(texture->getTextureWidth()), static_cast<float>(posY+glyph->t())/static_cast<float>(texture->getTextureHeight()) ), // maxTexCoord
+                        float(margin)); // margin
+
+    ResidentGlyph& resident = _residentGlyphs[info.get()];
+    resident.glyph = glyph;
+    resident.info = info;
+    resident.shaderTechnique = shaderTechnique;
+    resident.page = pageIndex;
+    resident.shelf = shelfIndex;
+    resident.x = x;
+    resident.width = width;
+    resident.usage = _usageList.insert(_usageList.end(), info.get());
+
+    glyph->setTextureInfo(shaderTechnique, info.get());
+
+    osg::TaskScheduler* scheduler = osg::TaskScheduler::instance().get();
+    if (shaderTechnique>GREYSCALE && _computeInBackground && scheduler->getNumThreads()>0)
+    {
+        // the task holds a reference to the glyph, so it can't be evicted until its field has been written.
+        ++_numPendingGlyphs;
+        scheduler->run(_pendingGlyphs.get(), new ComputeGlyphTask(this, texture, glyph, info.get()));
+    }
+    else
+    {
+        texture->copyGlyphImage(glyph, info.get());
+        image->dirty();
+    }
+}
+
+void GlyphAtlas::computeGlyph(GlyphTexture* texture, Glyph* glyph, Glyph::TextureInfo* info)
+{
+    // glyphs are written to disjoint slots so only the completion is serialized.
+    texture->copyGlyphImage(glyph, info);
+
+    OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_mutex);
+    texture->getImage()->dirty();
+    --_numPendingGlyphs;
+}
+
+void GlyphAtlas::touchGlyph(const Glyph::TextureInfo* info)
+{
+    OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_mutex);
+
+    ResidentGlyphs::iterator itr = _residentGlyphs.find(info);
+    if (itr==_residentGlyphs.end()) return;
+
+    ++_numGlyphRequests;
+    _usageList.splice(_usageList.end(), _usageList, itr->second.usage);
+}
+
+void GlyphAtlas::releaseGlyphs(const Font* font)
+{
+    OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_mutex);
+
+    for(ResidentGlyphs::iterator itr = _residentGlyphs.begin();
+        itr != _residentGlyphs.end();)
+    {
+        ResidentGlyphs::iterator curr = itr++;
+        if (curr->second.glyph->getFont()==font && isEvictable(curr->second)) removeGlyph(curr);
+    }
+}
+
+void GlyphAtlas::waitForPendingGlyphs()
+{
+    osg::TaskScheduler::instance()->wait(_pendingGlyphs.get());
+}
+
+bool GlyphAtlas::allocateSlot(ShaderTechnique shaderTechnique, int width, int height, unsigned int& page, unsigned int& shelf, int& x)
+{
+    if (width>static_cast<int>(_textureWidth) || height>static_cast<int>(_textureHeight)) return false;
+
+    // best fit, the shortest shelf that is tall enough and has a free slot wide enough.
+    bool found = false;
+    int foundHeight = 0;
+    unsigned int numPages = 0;
+    for(unsigned int p=0; p<_pages.size(); ++p)
+    {
+        Page& currPage = _pages[p];
+        if (currPage.texture->getShaderTechnique()!=shaderTechnique) continue;
+
+        ++numPages;
+
+        for(unsigned int s=0; s<currPage.shelves.size(); ++s)
+        {
+            Shelf& currShelf = currPage.shelves[s];
+            if (currShelf.height<height || (found && currShelf.height>=foundHeight)) continue;
+
+            for(std::vector<Slot>::iterator itr = currShelf.slots.begin(); itr != currShelf.slots.end(); ++itr)
+            {
+                if (!itr->used && itr->width>=width)
+                {
+                    found = true;
+                    foundHeight = currShelf.height;
+                    page = p;
+                    shelf = s;
+                    break;
+                }
+            }
+        }
+    }
+
+    if (!found)
+    {
+        // start a new shelf below the existing shelves of a texture.
+        for(unsigned int p=0; p<_pages.size() && !found; ++p)
+        {
+            Page& currPage = _pages[p];
+            if (currPage.texture->getShaderTechnique()==shaderTechnique && static_cast<int>(_textureHeight)-currPage.usedHeight>=height)
+            {
+                currPage.shelves.push_back(Shelf(currPage.usedHeight, height, currPage.texture->getTextureWidth()));
+                currPage.usedHeight += height;
+
+                found = true;
+                page = p;
+                shelf = static_cast<unsigned int>(currPage.shelves.size()-1);
+            }
+        }
+    }
+
+    if (!found)
+    {
+        if (_maxNumTextures>0 && numPages>=_maxNumTextures) return false;
+
+        OSG_INFO<<"GlyphAtlas::allocateSlot() creating texture "<<_pages.size()<<" of "<<_textureWidth<<"x"<<_textureHeight<<std::endl;
+
+        Page newPage;
+        newPage.texture = new GlyphTexture;
+        newPage.texture->setShaderTechnique(shaderTechnique);
+        newPage.texture->setTextureSize(_textureWidth, _textureHeight);
+        newPage.texture->setFilter(osg::Texture::MIN_FILTER, _minFilterHint);
+        newPage.texture->setFilter(osg::Texture::MAG_FILTER, _magFilterHint);
+        newPage.texture->setMaxAnisotropy(_maxAnisotropy);
+        newPage.texture->createImage();
+
+        newPage.shelves.push_back(Shelf(0, height, _textureWidth));
+        newPage.usedHeight = height;
+
+        _pages.push_back(newPage);
+
+        page = static_cast<unsigned int>(_pages.size()-1);
+        shelf = 0;
+    }
+
+    // first fit within the shelf, splitting the remainder of the slot off as a free slot.
+    std::vector<Slot>& slots = _pages[page].shelves[shelf].slots;
+    for(unsigned int i=0; i<slots.size(); ++i)
+    {
+        if (!slots[i].used && slots[i].width>=width)
+        {
+            if (slots[i].width>width)
+            {
+                slots.insert(slots.begin()+i+1, Slot(slots[i].x+width, slots[i].width-width));
+            }
+
+            slots[i].width = width;
+            slots[i].used = true;
+            x = slots[i].x;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+bool GlyphAtlas::allocateSlotByEviction(ShaderTechnique shaderTechnique, int width, int height, unsigned int& page, unsigned int& shelf, int& x)
+{
+    // evict the least recently used glyph whose slot, with any free slots either side of it, can take the new glyph.
+    for(UsageList::iterator uitr = _usageList.begin(); uitr != _usageList.end(); ++uitr)
+    {
+        ResidentGlyphs::iterator ritr = _residentGlyphs.find(*uitr);
+        const ResidentGlyph& resident = ritr->second;
+        if (resident.shaderTechnique!=shaderTechnique || !isEvictable(resident)) continue;
+
+        const Shelf& candidateShelf = _pages[resident.page].shelves[resident.shelf];
+        if (candidateShelf.height<height) continue;
+
+        const std::vector<Slot>& slots = candidateShelf.slots;
+        unsigned int i = 0;
+        while(slots[i].x!=resident.x) ++i;
+
+        int available = slots[i].width;
+        if (i>0 && !slots[i-1].used) available += slots[i-1].width;
+        if (i+1<slots.size() && !slots[i+1].used) available += slots[i+1].width;
+
+        if (available>=width)
+        {
+            removeGlyph(ritr);
+            ++_numEvictions;
+            return allocateSlot(shaderTechnique, width, height, page, shelf, x);
+        }
+    }
+
+    // otherwise evict glyphs in order of use until enough adjacent slots or shelves have been freed.
+    for(UsageList::iterator uitr = _usageList.begin(); uitr != _usageList.end();)
+    {
+        ResidentGlyphs::iterator ritr = _residentGlyphs.find(*(uitr++));
+        if (ritr->second.shaderTechnique!=shaderTechnique || !isEvictable(ritr->second)) continue;
+
+        removeGlyph(ritr);
+        ++_numEvictions;
+
+        if (allocateSlot(shaderTechnique, width, height, page, shelf, x)) return true;
+    }
+
+    return false;
+}
+
+void GlyphAtlas::freeSlot(unsigned int page, unsigned int shelf, int x)
+{
+    Page& currPage = _pages[page];
+    std::vector<Slot>& slots = currPage.shelves[shelf].slots;
+
+    unsigned int i = 0;
+    while(slots[i].x!=x) ++i;
+
+    slots[i].used = false;
+
+    // merge with the free slots either side.
+    if (i+1<slots.size() && !slots[i+1].used)
+    {
+        slots[i].width += slots[i+1].width;
+        slots.erase(slots.begin()+i+1);
+    }
+
+    if (i>0 && !slots[i-1].used)
+    {
+        slots[i-1].width += slots[i].width;
+        slots.erase(slots.begin()+i);
+    }
+
+    // return empty shelves at the bottom of the texture so that their rows can be used by shelves of any height.
+    while(!currPage.shelves.empty() && currPage.shelves.back().empty())
+    {
+        currPage.usedHeight = currPage.shelves.back().y;
+        currPage.shelves.pop_back();
+    }
+}
+
+void GlyphAtlas::removeGlyph(ResidentGlyphs::iterator itr)
+{
+    ResidentGlyph& resident = itr->second;
+
+    freeSlot(resident.page, resident.shelf, resident.x);
+
+    if (resident.glyph->getTextureInfo(resident.shaderTechnique)==resident.info.get())
+    {
+        resident.glyph->setTextureInfo(resident.shaderTechnique, 0);
+    }
+
+    _usageList.erase(resident.usage);
+    _residentGlyphs.erase(itr);
+}
+
+void GlyphAtlas::getGlyphTextures(GlyphTextureList& textures) const
+{
+    OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_mutex);
+
+    for(Pages::const_iterator itr = _pages.begin(); itr != _pages.end(); ++itr)
+    {
+        textures.push_back(itr->texture);
+    }
+}
+
+void GlyphAtlas::getStatistics(Statistics& stats) const
+{
+    OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_mutex);
+
+    stats = Statistics();
+
+    for(Pages::const_iterator itr = _pages.begin(); itr != _pages.end(); ++itr)
+    {
+        ++stats.numTextures;
+        stats.totalArea += static_cast<std::size_t>(itr->texture->getTextureWidth())*static_cast<std::size_t>(itr->texture->getTextureHeight());
+        if (itr->texture->getImage()) stats.textureMemory += itr->texture->getImage()->getTotalSizeInBytes();
+    }
+
+    for(ResidentGlyphs::const_iterator itr = _residentGlyphs.begin(); itr != _residentGlyphs.end(); ++itr)
+    {
+        const ResidentGlyph& resident = itr->second;
+        stats.usedArea += static_cast<std::size_t>(resident.width)*static_cast<std::size_t>(_pages[resident.page].shelves[resident.shelf].height);
+    }
+
+    stats.numGlyphs = static_cast<unsigned int>(_residentGlyphs.size());
+    stats.numGlyphRequests = _numGlyphRequests;
+    stats.numGlyphMisses = _numGlyphMisses;
+    stats.numEvictions = _numEvictions;
+    stats.numAllocationFailures = _numAllocationFailures;
+    stats.numPendingGlyphs = _numPendingGlyphs;
+}
+
+void GlyphAtlas::resizeGLObjectBuffers(unsigned int maxSize)
+{
+    OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_mutex);
+
+    for(Pages::iterator itr = _pages.begin(); itr != _pages.end(); ++itr)
+    {
+        itr->texture->resizeGLObjectBuffers(maxSize);
+    }
+}
+
+void GlyphAtlas::releaseGLObjects(osg::State* state) const
+{
+    OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_mutex);
+
+    for(Pages::const_iterator itr = _pages.begin(); itr != _pages.end(); ++itr)
+    {
+        itr->texture->releaseGLObjects(state);
+    }
+}
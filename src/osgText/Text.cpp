@@ -606,8 +606,9 @@ void Text::computeGlyphRepresentation()
             {
                 unsigned int charcode = *itr;
 
-                Glyph* glyph = activefont->getGlyph(_fontSize, charcode);
-                if (glyph)
+                // hold a reference to the glyph so that a GlyphAtlas can't evict it while its TextureInfo is being used.
+                osg::ref_ptr<Glyph> glyph = activefont->getGlyph(_fontSize, charcode);
+                if (glyph.valid())
                 {
                     float width = (float)(glyph->getWidth()) * wr;
                     float height = (float)(glyph->getHeight()) * hr;
@@ -668,7 +669,7 @@ void Text::computeGlyphRepresentation()
                         osg::Vec2 minc = local+osg::Vec2(0.0f-fHorizQuadMargin,0.0f-fVertQuadMargin);
                         osg::Vec2 maxc = local+osg::Vec2(width+fHorizQuadMargin,height+fVertQuadMargin);
 
-                        addGlyphQuad(glyph, minc, maxc, mintc, maxtc);
+                        addGlyphQuad(glyph.get(), minc, maxc, mintc, maxtc);
 
                         // move the cursor onto the next character.
                         // also expand bounding box
@@ -32,9 +32,12 @@
 
 #include <float.h>
 #include <algorithm>
+#include <typeinfo>
 
 #include <osg/Timer>
 
+#include <osg/TaskScheduler>
+
 using namespace osg;
 using namespace osgUtil;
 
@@ -52,6 +55,9 @@ CullVisitor::CullVisitor():
     _computed_zfar(-FLT_MAX),
     _traversalOrderNumber(0),
     _currentReuseRenderLeafIndex(0),
+    _currentReuseStateGraphIndex(0),
+    _numRenderLeafAllocations(0),
+    _numStateGraphAllocations(0),
     _numberOfEncloseOverrideRenderBinDetails(0)
 {
     _identifier = new Identifier;
@@ -67,6 +73,9 @@ CullVisitor::CullVisitor(const CullVisitor& rhs):
     _computed_zfar(-FLT_MAX),
     _traversalOrderNumber(0),
     _currentReuseRenderLeafIndex(0),
+    _currentReuseStateGraphIndex(0),
+    _numRenderLeafAllocations(0),
+    _numStateGraphAllocations(0),
     _numberOfEncloseOverrideRenderBinDetails(0),
     _identifier(rhs._identifier)
 {
@@ -130,11 +139,43 @@ void CullVisitor::reset()
 
     // reset the resuse lists.
     _currentReuseRenderLeafIndex = 0;
+    _currentReuseStateGraphIndex = 0;
+
+    _numRenderLeafAllocations = 0;
+    _numStateGraphAllocations = 0;
 
     _nearPlaneCandidateMap.clear();
     _farPlaneCandidateMap.clear();
 }
 
+StateGraph* CullVisitor::createOrReuseStateGraph(const osg::StateSet* ss)
+{
+    // StateGraphs still referenced by a parent StateGraph are in use, only those released by StateGraph::prune() can be recycled.
+    while (_currentReuseStateGraphIndex<_reuseStateGraphList.size() &&
+           _reuseStateGraphList[_currentReuseStateGraphIndex]->referenceCount()>1)
+    {
+        ++_currentReuseStateGraphIndex;
+    }
+
+    StateGraph* sg = 0;
+    if (_currentReuseStateGraphIndex<_reuseStateGraphList.size())
+    {
+        sg = _reuseStateGraphList[_currentReuseStateGraphIndex++].get();
+        sg->reset();
+        sg->set(_currentStateGraph, ss);
+    }
+    else
+    {
+        ++_numStateGraphAllocations;
+        sg = new StateGraph(_currentStateGraph, ss);
+        _reuseStateGraphList.push_back(sg);
+        ++_currentReuseStateGraphIndex;
+    }
+
+    _currentStateGraph->_children[ss] = sg;
+    return sg;
+}
+
 float CullVisitor::getDistanceToEyePoint(const Vec3& pos, bool withLODScale) const
 {
     if (withLODScale) return (pos-getEyeLocal()).length()*getLODScale();
@@ -1145,7 +1186,17 @@ void CullVisitor::apply(Group& node)
     StateSet* node_state = node.getStateSet();
     if (node_state) pushStateSet(node_state);
 
-    handle_cull_callbacks_and_traverse(node);
+    // the children of the top level Group may be culled in parallel, a cull callback has to do its own traversal
+    // and subclasses such as Sequence, osgFX::Effect or osgShadow::ShadowedScene override traverse() to select children.
+    if (getNumCullThreads()>1 && _nodePath.size()==1 && node.getNumChildren()>1 && !node.getCullCallback() && typeid(node)==typeid(osg::Group) &&
+        !hasSharedChildren(node))
+    {
+        traverseInParallel(node);
+    }
+    else
+    {
+        handle_cull_callbacks_and_traverse(node);
+    }
 
     // pop the node's state off the render graph stack.
     if (node_state) popStateSet();
@@ -1154,6 +1205,178 @@ void CullVisitor::apply(Group& node)
     popCurrentMask();
 }
 
+namespace
+{
+
+class CullRangeTask : public osg::TaskScheduler::Task
+{
+public:
+    CullRangeTask(CullVisitor* cv, osg::Group* group, unsigned int first, unsigned int last):
+        _cv(cv),
+        _group(group),
+        _first(first),
+        _last(last) {}
+
+    virtual void run()
+    {
+        for(unsigned int i=_first; i<_last; ++i)
+        {
+            _group->getChild(i)->accept(*_cv);
+        }
+    }
+
+    osg::ref_ptr<CullVisitor>   _cv;
+    osg::ref_ptr<osg::Group>    _group;
+    unsigned int                _first;
+    unsigned int                _last;
+};
+
+}
+
+bool CullVisitor::hasSharedChildren(const osg::Group& group)
+{
+    for(unsigned int i=0; i<group.getNumChildren(); ++i)
+    {
+        if (group.getChild(i)->getNumParents()>1) return true;
+    }
+    return false;
+}
+
+void CullVisitor::traverseInParallel(osg::Group& group)
+{
+    // compute any dirty bounds before the children are culled concurrently, as getBound() computes them lazily.
+    group.getBound();
+
+    unsigned int numChildren = group.getNumChildren();
+    unsigned int numThreads = osg::minimum(getNumCullThreads(), numChildren);
+
+    // the StateSets from the root of the StateGraph to the current position, to be replayed on each thread.
+    std::vector<const osg::StateSet*> stateSets;
+    for(StateGraph* sg = _currentStateGraph; sg && sg->_parent; sg = sg->_parent)
+    {
+        stateSets.push_back(sg->getStateSet());
+    }
+    std::reverse(stateSets.begin(), stateSets.end());
+
+    RenderStage* renderStage = getCurrentRenderStage();
+
+    while(_parallelCullVisitors.size()<numThreads-1)
+    {
+        _parallelCullVisitors.push_back(clone());
+    }
+
+    // leaves culled by each thread are numbered from their own base so traversal order sorting still follows child order.
+    const unsigned int traversalOrderRange = 1<<24;
+
+    osg::TaskScheduler* scheduler = osg::TaskScheduler::instance().get();
+    osg::ref_ptr<osg::TaskScheduler::TaskGroup> tasks = new osg::TaskScheduler::TaskGroup;
+
+    for(unsigned int i=1; i<numThreads; ++i)
+    {
+        CullVisitor* cv = _parallelCullVisitors[i-1].get();
+
+        cv->reset();
+        cv->inheritCullSettings(*this);
+        cv->setNumCullThreads(1);
+        cv->setFrameStamp(_frameStamp.get());
+        cv->setTraversalNumber(getTraversalNumber());
+        cv->setTraversalMask(getTraversalMask());
+        cv->setNodeMaskOverride(getNodeMaskOverride());
+        cv->setDatabaseRequestHandler(getDatabaseRequestHandler());
+        cv->setImageRequestHandler(getImageRequestHandler());
+        cv->setRenderInfo(_renderInfo);
+        cv->setOccluderList(getOccluderList());
+        cv->_traversalOrderNumber = _traversalOrderNumber + i*traversalOrderRange;
+
+        if (!cv->getRootStateGraph()) cv->setStateGraph(new StateGraph);
+        cv->getRootStateGraph()->clean();
+        cv->getRootStateGraph()->prune();
+        cv->setStateGraph(cv->getRootStateGraph());
+
+        if (!cv->getRenderStage()) cv->setRenderStage(new RenderStage);
+        RenderStage* rs = cv->getRenderStage();
+        rs->reset();
+        rs->setCamera(renderStage->getCamera());
+        rs->setViewport(renderStage->getViewport());
+        rs->setInitialViewMatrix(renderStage->getInitialViewMatrix());
+        cv->setRenderStage(rs);
+
+        for(std::vector<const osg::StateSet*>::iterator itr = stateSets.begin();
+            itr != stateSets.end();
+            ++itr)
+        {
+            cv->pushStateSet(*itr);
+        }
+
+        cv->pushViewport(getViewport());
+        cv->pushProjectionMatrix(getProjectionMatrix());
+        cv->pushModelViewMatrix(getModelViewMatrix(), osg::Transform::ABSOLUTE_RF);
+        cv->pushOntoNodePath(&group);
+
+        scheduler->run(tasks.get(), new CullRangeTask(cv, &group, (numChildren*i)/numThreads, (numChildren*(i+1))/numThreads));
+    }
+
+    // cull the first range of children directly into this CullVisitor's StateGraph and RenderStage.
+    for(unsigned int i=0; i<numChildren/numThreads; ++i)
+    {
+        group.getChild(i)->accept(*this);
+    }
+
+    scheduler->wait(tasks.get());
+
+    // merge the results of each thread in child order.
+    for(unsigned int i=1; i<numThreads; ++i)
+    {
+        CullVisitor* cv = _parallelCullVisitors[i-1].get();
+
+        cv->popFromNodePath();
+        cv->popModelViewMatrix();
+        cv->popProjectionMatrix();
+        cv->popViewport();
+        for(unsigned int j=0; j<stateSets.size(); ++j)
+        {
+            cv->popStateSet();
+        }
+
+        RenderStage* rs = cv->getRenderStage();
+        renderStage->merge(rs, _rootStateGraph.get());
+
+        RenderStage::RenderStageList& preRenderList = rs->getPreRenderList();
+        for(RenderStage::RenderStageList::iterator itr = preRenderList.begin(); itr != preRenderList.end(); ++itr)
+        {
+            renderStage->addPreRenderStage(itr->second.get(), itr->first);
+        }
+        preRenderList.clear();
+
+        RenderStage::RenderStageList& postRenderList = rs->getPostRenderList();
+        for(RenderStage::RenderStageList::iterator itr = postRenderList.begin(); itr != postRenderList.end(); ++itr)
+        {
+            renderStage->addPostRenderStage(itr->second.get(), itr->first);
+        }
+        postRenderList.clear();
+
+        PositionalStateContainer* source = rs->getPositionalStateContainer();
+        PositionalStateContainer* target = renderStage->getPositionalStateContainer();
+        target->getAttrMatrixList().insert(target->getAttrMatrixList().end(), source->getAttrMatrixList().begin(), source->getAttrMatrixList().end());
+        PositionalStateContainer::TexUnitAttrMatrixListMap& texAttrListMap = source->getTexUnitAttrMatrixListMap();
+        for(PositionalStateContainer::TexUnitAttrMatrixListMap::iterator itr = texAttrListMap.begin(); itr != texAttrListMap.end(); ++itr)
+        {
+            PositionalStateContainer::AttrMatrixList& attrList = target->getTexUnitAttrMatrixListMap()[itr->first];
+            attrList.insert(attrList.end(), itr->second.begin(), itr->second.end());
+        }
+        source->reset();
+
+        _computed_znear = osg::minimum(_computed_znear, cv->_computed_znear);
+        _computed_zfar = osg::maximum(_computed_zfar, cv->_computed_zfar);
+        _nearPlaneCandidateMap.insert(cv->_nearPlaneCandidateMap.begin(), cv->_nearPlaneCandidateMap.end());
+        _farPlaneCandidateMap.insert(cv->_farPlaneCandidateMap.begin(), cv->_farPlaneCandidateMap.end());
+        cv->_nearPlaneCandidateMap.clear();
+        cv->_farPlaneCandidateMap.clear();
+
+        _traversalOrderNumber = osg::maximum(_traversalOrderNumber, cv->_traversalOrderNumber);
+    }
+}
+
 void CullVisitor::apply(Transform& node)
 {
     if (isCulled(node)) return;
@@ -48,6 +48,7 @@ namespace osgUtil
 static osg::ApplicationUsageProxy ICO_e1(osg::ApplicationUsage::ENVIRONMENTAL_VARIABLE,"OSG_MINIMUM_COMPILE_TIME_PER_FRAME <float>","minimum compile time allotted to compiling OpenGL objects per frame in database pager.");
 static osg::ApplicationUsageProxy UCO_e2(osg::ApplicationUsage::ENVIRONMENTAL_VARIABLE,"OSG_MAXIMUM_OBJECTS_TO_COMPILE_PER_FRAME <int>","maximum number of OpenGL objects to compile per frame in database pager.");
 static osg::ApplicationUsageProxy UCO_e3(osg::ApplicationUsage::ENVIRONMENTAL_VARIABLE,"OSG_FORCE_TEXTURE_DOWNLOAD <ON/OFF>","should the texture compiles be forced to download using a dummy Geometry.");
+static osg::ApplicationUsageProxy UCO_e4(osg::ApplicationUsage::ENVIRONMENTAL_VARIABLE,"OSG_MAXIMUM_COMPILE_MEGABYTES_PER_FRAME <float>","maximum megabytes of texture and vertex data to upload to OpenGL per frame in database pager.");
 
 /////////////////////////////////////////////////////////////////
 //
@@ -304,13 +305,26 @@ bool IncrementalCompileOperation::CompileProgramOp::compile(CompileInfo& compile
 IncrementalCompileOperation::CompileInfo::CompileInfo(osg::GraphicsContext* context, IncrementalCompileOperation* ico):
     compileAll(false),
     maxNumObjectsToCompile(0),
-    allocatedTime(0)
+    allocatedTime(0),
+    allocatedBytes(0),
+    compiledBytes(0)
 {
     setState(context->getState());
     incrementalCompileOperation = ico;
 }
 
 
+double IncrementalCompileOperation::CompileDrawableOp::estimatedBytesForCompile(const osg::GraphicsCostEstimator* gce) const
+{
+    const osg::Geometry* geometry = _drawable->asGeometry();
+    return (gce && geometry) ? gce->estimateMemoryCost(geometry).second : 0.0;
+}
+
+double IncrementalCompileOperation::CompileTextureOp::estimatedBytesForCompile(const osg::GraphicsCostEstimator* gce) const
+{
+    return gce ? gce->estimateMemoryCost(_texture.get()).second : 0.0;
+}
+
 /////////////////////////////////////////////////////////////////
 //
 // CompileList
@@ -340,10 +354,24 @@ double IncrementalCompileOperation::CompileList::estimatedTimeForCompile(Compile
     return estimateTime;
 }
 
+double IncrementalCompileOperation::CompileList::estimatedBytesForCompile(const osg::GraphicsCostEstimator* gce) const
+{
+    double estimatedBytes = 0.0;
+    for(CompileOps::const_iterator itr = _compileOps.begin();
+        itr != _compileOps.end();
+        ++itr)
+    {
+        estimatedBytes += (*itr)->estimatedBytesForCompile(gce);
+    }
+    return estimatedBytes;
+}
+
 bool IncrementalCompileOperation::CompileList::compile(CompileInfo& compileInfo)
 {
 //#define USE_TIME_ESTIMATES
 
+    const osg::GraphicsCostEstimator* gce = compileInfo.incrementalCompileOperation->getGraphicsCostEstimator();
+
     for(CompileOps::iterator itr = _compileOps.begin();
         itr != _compileOps.end() && compileInfo.okToCompile();
     )
@@ -352,7 +380,15 @@ bool IncrementalCompileOperation::CompileList::compile(CompileInfo& compileInfo)
         double estimatedCompileCost = (*itr)->estimatedTimeForCompile(compileInfo);
         #endif
 
+        double estimatedBytes = (*itr)->estimatedBytesForCompile(gce);
+        if (!compileInfo.okToCompileBytes(estimatedBytes))
+        {
+            // leave the compile till a following frame rather than exceed the upload budget.
+            break;
+        }
+
         --compileInfo.maxNumObjectsToCompile;
+        compileInfo.compiledBytes += estimatedBytes;
 
         #ifdef USE_TIME_ESTIMATES
         osg::ElapsedTime timer;
@@ -448,10 +484,12 @@ bool IncrementalCompileOperation::CompileSet::compile(CompileInfo& compileInfo)
 IncrementalCompileOperation::IncrementalCompileOperation():
     osg::Referenced(true),
     osg::GraphicsOperation("IncrementalCompileOperation",true),
+    _maximumNumOfBytesToCompilePerFrame(0.0),
     _flushTimeRatio(0.5),
     _conservativeTimeRatio(0.5),
     _currentFrameNumber(0),
-    _compileAllTillFrameNumber(0)
+    _compileAllTillFrameNumber(0),
+    _numBytesCompiledLastFrame(0.0)
 {
     _markerObject = new osg::DummyObject;
     _markerObject->setName("HasBeenProcessedByStateToCompile");
@@ -470,6 +508,13 @@ IncrementalCompileOperation::IncrementalCompileOperation():
         _maximumNumOfObjectsToCompilePerFrame = atoi(ptr);
     }
 
+    if( (ptr = getenv("OSG_MAXIMUM_COMPILE_MEGABYTES_PER_FRAME")) != 0)
+    {
+        _maximumNumOfBytesToCompilePerFrame = osg::asciiToDouble(ptr)*1024.0*1024.0;
+    }
+
+    _graphicsCostEstimator = new osg::GraphicsCostEstimator;
+
     bool useForceTextureDownload = false;
     if( (ptr = getenv("OSG_FORCE_TEXTURE_DOWNLOAD")) != 0)
     {
@@ -592,6 +637,12 @@ void IncrementalCompileOperation::add(CompileSet* compileSet, bool callBuildComp
 
     if (callBuildCompileMap) compileSet->buildCompileMap(_contexts);
 
+    // every context compiles the same objects, so the first CompileList gives the bytes to upload per context.
+    if (!compileSet->_compileMap.empty())
+    {
+        compileSet->_estimatedBytesToCompile = compileSet->_compileMap.begin()->second.estimatedBytesForCompile(_graphicsCostEstimator.get());
+    }
+
     OSG_INFO<<"IncrementalCompileOperation::add(CompileSet = "<<compileSet<<", "<<", "<<callBuildCompileMap<<")"<<std::endl;
 
     OpenThreads::ScopedLock<OpenThreads::Mutex>  lock(_toCompileMutex);
@@ -636,6 +687,46 @@ void IncrementalCompileOperation::remove(CompileSet* compileSet)
 }
 
 
+void IncrementalCompileOperation::setPriority(CompileSet* compileSet, float priority)
+{
+    OpenThreads::ScopedLock<OpenThreads::Mutex>  lock(_toCompileMutex);
+    compileSet->_priority = priority;
+}
+
+unsigned int IncrementalCompileOperation::getNumCompileSetsPending() const
+{
+    OpenThreads::ScopedLock<OpenThreads::Mutex>  lock(_toCompileMutex);
+    return static_cast<unsigned int>(_toCompile.size());
+}
+
+double IncrementalCompileOperation::getNumBytesPending() const
+{
+    OpenThreads::ScopedLock<OpenThreads::Mutex>  lock(_toCompileMutex);
+    double numBytes = 0.0;
+    for(CompileSets::const_iterator itr = _toCompile.begin();
+        itr != _toCompile.end();
+        ++itr)
+    {
+        numBytes += (*itr)->_estimatedBytesToCompile;
+    }
+    return numBytes;
+}
+
+double IncrementalCompileOperation::getNumBytesCompiledLastFrame() const
+{
+    OpenThreads::ScopedLock<OpenThreads::Mutex>  lock(_toCompileMutex);
+    return _numBytesCompiledLastFrame;
+}
+
+void IncrementalCompileOperation::reportStats(osg::Stats* stats, unsigned int frameNumber) const
+{
+    if (!stats) return;
+
+    stats->setAttribute(frameNumber, "Compile sets pending", static_cast<double>(getNumCompileSetsPending()));
+    stats->setAttribute(frameNumber, "Compile bytes pending", getNumBytesPending());
+    stats->setAttribute(frameNumber, "Compile bytes uploaded", getNumBytesCompiledLastFrame());
+}
+
 void IncrementalCompileOperation::mergeCompiledSubgraphs(const osg::FrameStamp* frameStamp)
 {
     // OSG_INFO<<"IncrementalCompileOperation::mergeCompiledSubgraphs()"<<std::endl;
@@ -660,6 +751,14 @@ void IncrementalCompileOperation::mergeCompiledSubgraphs(const osg::FrameStamp*
 }
 
 
+struct CompareCompileSetPriority
+{
+    bool operator() (const osg::ref_ptr<IncrementalCompileOperation::CompileSet>& lhs, const osg::ref_ptr<IncrementalCompileOperation::CompileSet>& rhs) const
+    {
+        return lhs->_priority > rhs->_priority;
+    }
+};
+
 void IncrementalCompileOperation::operator () (osg::GraphicsContext* context)
 {
     osg::NotifySeverity level = osg::INFO;
@@ -698,12 +797,16 @@ void IncrementalCompileOperation::operator () (osg::GraphicsContext* context)
     CompileInfo compileInfo(context, this);
     compileInfo.maxNumObjectsToCompile = _maximumNumOfObjectsToCompilePerFrame;
     compileInfo.allocatedTime = compileTime;
+    compileInfo.allocatedBytes = _maximumNumOfBytesToCompilePerFrame;
     compileInfo.compileAll = (_compileAllTillFrameNumber > _currentFrameNumber);
 
     CompileSets toCompileCopy;
     {
         OpenThreads::ScopedLock<OpenThreads::Mutex>  toCompile_lock(_toCompileMutex);
         std::copy(_toCompile.begin(),_toCompile.end(),std::back_inserter<CompileSets>(toCompileCopy));
+
+        // compile the highest priority sets first, the sort is stable so sets of equal priority are compiled in the order added.
+        toCompileCopy.sort(CompareCompileSetPriority());
     }
 
     if (!toCompileCopy.empty())
@@ -725,6 +828,12 @@ void IncrementalCompileOperation::operator () (osg::GraphicsContext* context)
         }
     }
 
+    {
+        // the update thread reads the compiled bytes for its stats while the graphics thread compiles.
+        OpenThreads::ScopedLock<OpenThreads::Mutex>  toCompile_lock(_toCompileMutex);
+        _numBytesCompiledLastFrame = compileInfo.compiledBytes;
+    }
+
     //glFush();
     //glFinish();
 }
@@ -25,6 +25,13 @@
 #include <osg/Notify>
 #include <osg/io_utils>
 
+#include <OpenThreads/Thread>
+#include <OpenThreads/Mutex>
+#include <OpenThreads/ScopedLock>
+
+#include <algorithm>
+#include <typeinfo>
+
 using namespace osgUtil;
 
 
@@ -33,35 +40,211 @@ using namespace osgUtil;
 //  IntersectorGroup
 //
 
-IntersectorGroup::IntersectorGroup()
+namespace
+{
+
+// interleave the lower 10 bits of x, y and z to give a 30 bit Morton code.
+unsigned int mortonCode(unsigned int x, unsigned int y, unsigned int z)
+{
+    unsigned int code = 0;
+    for(unsigned int i=0; i<10; ++i)
+    {
+        code |= ((x>>i)&1u)<<(3*i) | ((y>>i)&1u)<<(3*i+1) | ((z>>i)&1u)<<(3*i+2);
+    }
+    return code;
+}
+
+unsigned int quantize(double value, double minimum, double maximum)
+{
+    if (maximum<=minimum) return 0;
+    double r = (value-minimum)/(maximum-minimum);
+    return static_cast<unsigned int>(osg::clampBetween(r, 0.0, 1.0)*1023.0);
+}
+
+bool intersects(const osg::BoundingBoxd& bb, const osg::BoundingSphere& bs)
+{
+    // if bs not valid then return true based on the assumption that an invalid sphere is yet to be defined.
+    if (!bs.valid()) return true;
+
+    osg::Vec3d center(bs.center());
+    osg::Vec3d closest(osg::clampBetween(center.x(), bb.xMin(), bb.xMax()),
+                       osg::clampBetween(center.y(), bb.yMin(), bb.yMax()),
+                       osg::clampBetween(center.z(), bb.zMin(), bb.zMax()));
+    return (closest-center).length2() <= double(bs.radius())*double(bs.radius());
+}
+
+bool intersects(const osg::BoundingBoxd& lhs, const osg::BoundingBox& rhs)
+{
+    // if rhs not valid then return true based on the assumption that an invalid box is yet to be defined.
+    if (!rhs.valid()) return true;
+
+    return osg::maximum(lhs.xMin(),double(rhs.xMin())) <= osg::minimum(lhs.xMax(),double(rhs.xMax())) &&
+           osg::maximum(lhs.yMin(),double(rhs.yMin())) <= osg::minimum(lhs.yMax(),double(rhs.yMax())) &&
+           osg::maximum(lhs.zMin(),double(rhs.zMin())) <= osg::minimum(lhs.zMax(),double(rhs.zMax()));
+}
+
+struct LineSegmentIntersectorCode
+{
+    LineSegmentIntersectorCode(unsigned int code, unsigned int index, LineSegmentIntersector* lsi):
+        _code(code), _index(index), _lsi(lsi) {}
+
+    bool operator < (const LineSegmentIntersectorCode& rhs) const
+    {
+        if (_code<rhs._code) return true;
+        if (rhs._code<_code) return false;
+        return _index<rhs._index;
+    }
+
+    unsigned int            _code;
+    unsigned int            _index;
+    LineSegmentIntersector* _lsi;
+};
+
+}
+
+IntersectorGroup::IntersectorGroup():
+    _batchDirty(true)
 {
 }
 
 void IntersectorGroup::addIntersector(Intersector* intersector)
 {
     _intersectors.push_back(intersector);
+    _batchDirty = true;
 }
 
 void IntersectorGroup::clear()
 {
     _intersectors.clear();
+    _batchDirty = true;
 }
 
-Intersector* IntersectorGroup::clone(osgUtil::IntersectionVisitor& iv)
+void IntersectorGroup::updateBatch()
 {
-    IntersectorGroup* ig = new IntersectorGroup;
+    _batchDirty = false;
+    _lineSegmentIntersectors.clear();
+    _otherIntersectors.clear();
+    _batchBound.init();
 
-    // now copy across all intersectors that aren't disabled.
+    std::vector<LineSegmentIntersectorCode> codes;
+    osg::BoundingBoxd centers;
     for(Intersectors::iterator itr = _intersectors.begin();
         itr != _intersectors.end();
         ++itr)
+    {
+        // only plain LineSegmentIntersectors are batched, subclasses may override how they intersect.
+        LineSegmentIntersector* lsi = dynamic_cast<LineSegmentIntersector*>(itr->get());
+        if (lsi && typeid(*lsi)==typeid(LineSegmentIntersector))
+        {
+            codes.push_back(LineSegmentIntersectorCode(0, codes.size(), lsi));
+            centers.expandBy((lsi->getStart()+lsi->getEnd())*0.5);
+            _batchBound.expandBy(lsi->getStart());
+            _batchBound.expandBy(lsi->getEnd());
+        }
+        else
+        {
+            _otherIntersectors.push_back(itr->get());
+        }
+    }
+
+    // the combined bound can only be used to reject subgraphs when every intersector is a line segment.
+    if (!_otherIntersectors.empty()) _batchBound.init();
+
+    for(std::vector<LineSegmentIntersectorCode>::iterator itr = codes.begin();
+        itr != codes.end();
+        ++itr)
+    {
+        osg::Vec3d center = (itr->_lsi->getStart()+itr->_lsi->getEnd())*0.5;
+        itr->_code = mortonCode(quantize(center.x(), centers.xMin(), centers.xMax()),
+                                quantize(center.y(), centers.yMin(), centers.yMax()),
+                                quantize(center.z(), centers.zMin(), centers.zMax()));
+    }
+    std::sort(codes.begin(), codes.end());
+
+    _lineSegmentIntersectors.reserve(codes.size());
+    for(std::vector<LineSegmentIntersectorCode>::iterator itr = codes.begin();
+        itr != codes.end();
+        ++itr)
+    {
+        _lineSegmentIntersectors.push_back(itr->_lsi);
+    }
+}
+
+void IntersectorGroup::split(unsigned int numGroups, IntersectorGroups& groups)
+{
+    if (_batchDirty) updateBatch();
+
+    // gather the enabled intersectors with the line segments in their sorted order.
+    IntersectorList intersectors;
+    for(LineSegmentIntersectorList::iterator itr = _lineSegmentIntersectors.begin();
+        itr != _lineSegmentIntersectors.end();
+        ++itr)
+    {
+        if (!(*itr)->disabled()) intersectors.push_back(*itr);
+    }
+    for(IntersectorList::iterator itr = _otherIntersectors.begin();
+        itr != _otherIntersectors.end();
+        ++itr)
+    {
+        if (!(*itr)->disabled()) intersectors.push_back(*itr);
+    }
+
+    if (numGroups<1) numGroups = 1;
+    if (numGroups>intersectors.size()) numGroups = intersectors.size();
+
+    unsigned int first = 0;
+    for(unsigned int i=0; i<numGroups; ++i)
+    {
+        unsigned int last = (intersectors.size()*(i+1))/numGroups;
+
+        osg::ref_ptr<IntersectorGroup> group = new IntersectorGroup;
+        for(unsigned int j=first; j<last; ++j)
+        {
+            group->addIntersector(intersectors[j]);
+        }
+        groups.push_back(group);
+
+        first = last;
+    }
+}
+
+Intersector* IntersectorGroup::clone(osgUtil::IntersectionVisitor& iv)
+{
+    if (_batchDirty) updateBatch();
+
+    IntersectorGroup* ig = new IntersectorGroup;
+
+    // now copy across all intersectors that aren't disabled, keeping the sorted order of the line segments so
+    // the clone doesn't need to sort them again.
+    for(LineSegmentIntersectorList::iterator itr = _lineSegmentIntersectors.begin();
+        itr != _lineSegmentIntersectors.end();
+        ++itr)
     {
         if (!(*itr)->disabled())
         {
-            ig->addIntersector( (*itr)->clone(iv) );
+            LineSegmentIntersector* lsi = static_cast<LineSegmentIntersector*>((*itr)->clone(iv));
+            ig->_intersectors.push_back(lsi);
+            ig->_lineSegmentIntersectors.push_back(lsi);
+            ig->_batchBound.expandBy(lsi->getStart());
+            ig->_batchBound.expandBy(lsi->getEnd());
         }
     }
 
+    for(IntersectorList::iterator itr = _otherIntersectors.begin();
+        itr != _otherIntersectors.end();
+        ++itr)
+    {
+        if (!(*itr)->disabled())
+        {
+            Intersector* intersector = (*itr)->clone(iv);
+            ig->_intersectors.push_back(intersector);
+            ig->_otherIntersectors.push_back(intersector);
+        }
+    }
+
+    if (!ig->_otherIntersectors.empty()) ig->_batchBound.init();
+    ig->_batchDirty = false;
+
     return ig;
 }
 
@@ -69,6 +252,11 @@ bool IntersectorGroup::enter(const osg::Node& node)
 {
     if (disabled()) return false;
 
+    if (_batchDirty) updateBatch();
+
+    // reject the subgraph for the whole batch at once when it lies outside the bound of all the segments.
+    if (_batchBound.valid() && node.isCullingActive() && !intersects(_batchBound, node.getBound())) return false;
+
     bool foundIntersections = false;
 
     for(Intersectors::iterator itr = _intersectors.begin();
@@ -105,21 +293,36 @@ void IntersectorGroup::intersect(osgUtil::IntersectionVisitor& iv, osg::Drawable
 {
     if (disabled()) return;
 
-    unsigned int numTested = 0;
-    for(Intersectors::iterator itr = _intersectors.begin();
-        itr != _intersectors.end();
+    if (_batchDirty) updateBatch();
+
+    if (_batchBound.valid() && drawable->isCullingActive() && !intersects(_batchBound, drawable->getBoundingBox())) return;
+
+    // the enabled line segments are tested as a batch so they can share the KdTree traversal.
+    LineSegmentIntersectorList lineSegmentIntersectors;
+    lineSegmentIntersectors.reserve(_lineSegmentIntersectors.size());
+
+    for(LineSegmentIntersectorList::iterator itr = _lineSegmentIntersectors.begin();
+        itr != _lineSegmentIntersectors.end();
         ++itr)
     {
-        if (!(*itr)->disabled())
-        {
-            (*itr)->intersect(iv, drawable);
-
-            ++numTested;
-        }
+        if (!(*itr)->disabled()) lineSegmentIntersectors.push_back(*itr);
     }
 
-    // OSG_NOTICE<<"Number testing "<<numTested<<std::endl;
+    if (lineSegmentIntersectors.size()>1)
+    {
+        LineSegmentIntersector::intersectBatch(iv, drawable, &lineSegmentIntersectors.front(), lineSegmentIntersectors.size());
+    }
+    else if (!lineSegmentIntersectors.empty())
+    {
+        lineSegmentIntersectors.front()->intersect(iv, drawable);
+    }
 
+    for(IntersectorList::iterator itr = _otherIntersectors.begin();
+        itr != _otherIntersectors.end();
+        ++itr)
+    {
+        if (!(*itr)->disabled()) (*itr)->intersect(iv, drawable);
+    }
 }
 
 void IntersectorGroup::reset()
@@ -156,6 +359,7 @@ IntersectionVisitor::IntersectionVisitor(Intersector* intersector, ReadCallback*
 {
     _useKdTreesWhenAvailable = true;
     _dummyTraversal = false;
+    _numThreads = 1;
 
     _lodSelectionMode = USE_HIGHEST_LEVEL_OF_DETAIL;
     _eyePointDirty = true;
@@ -199,6 +403,104 @@ void IntersectionVisitor::reset()
     }
 }
 
+namespace
+{
+
+class IntersectionThread : public osg::Referenced, public OpenThreads::Thread
+{
+public:
+    IntersectionThread(IntersectionVisitor* iv, osg::Node* node):
+        _iv(iv),
+        _node(node) {}
+
+    virtual void run()
+    {
+        _node->accept(*_iv);
+    }
+
+    osg::ref_ptr<IntersectionVisitor>   _iv;
+    osg::ref_ptr<osg::Node>             _node;
+};
+
+// Serializes the reads of the ReadCallback shared by the intersection threads, computing the bound of each subgraph
+// read before returning it, so that threads handed the same cached subgraph only ever read its bounds.
+class SerializedReadCallback : public IntersectionVisitor::ReadCallback
+{
+public:
+    SerializedReadCallback(IntersectionVisitor::ReadCallback* readCallback):
+        _readCallback(readCallback) {}
+
+    virtual osg::ref_ptr<osg::Node> readNodeFile(const std::string& filename)
+    {
+        OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_mutex);
+
+        osg::ref_ptr<osg::Node> node = _readCallback->readNodeFile(filename);
+        if (node.valid()) node->getBound();
+        return node;
+    }
+
+protected:
+    osg::ref_ptr<IntersectionVisitor::ReadCallback>     _readCallback;
+    OpenThreads::Mutex                                  _mutex;
+};
+
+}
+
+void IntersectionVisitor::computeIntersections(osg::Node& node)
+{
+    IntersectorGroup* group = dynamic_cast<IntersectorGroup*>(getIntersector());
+    if (_numThreads<=1 || !group || _intersectorStack.size()!=1 || group->getIntersectors().size()<2)
+    {
+        node.accept(*this);
+        return;
+    }
+
+    IntersectorGroup::IntersectorGroups groups;
+    group->split(_numThreads, groups);
+
+    // compute any dirty bounds up front so the threads only ever read the shared subgraph, subgraphs read on demand
+    // have their bounds computed by the SerializedReadCallback before they are shared.
+    node.getBound();
+
+    osg::ref_ptr<ReadCallback> readCallback;
+    if (_readCallback.valid()) readCallback = new SerializedReadCallback(_readCallback.get());
+
+    typedef std::vector< osg::ref_ptr<IntersectionThread> > IntersectionThreads;
+    IntersectionThreads threads;
+    for(unsigned int i=0; i<groups.size(); ++i)
+    {
+        osg::ref_ptr<IntersectionVisitor> iv = new IntersectionVisitor(groups[i].get(), readCallback.get());
+        iv->setTraversalMode(getTraversalMode());
+        iv->setTraversalMask(getTraversalMask());
+        iv->setNodeMaskOverride(getNodeMaskOverride());
+        iv->setFrameStamp(_frameStamp.get());
+        iv->setUseKdTreeWhenAvailable(_useKdTreesWhenAvailable);
+        iv->setDoDummyTraversal(_dummyTraversal);
+        iv->setLODSelectionMode(_lodSelectionMode);
+        iv->setReferenceEyePoint(_referenceEyePoint);
+        iv->setReferenceEyePointCoordinateFrame(_referenceEyePointCoordinateFrame);
+        if (getWindowMatrix()) iv->pushWindowMatrix(getWindowMatrix());
+        if (getProjectionMatrix()) iv->pushProjectionMatrix(getProjectionMatrix());
+        if (getViewMatrix()) iv->pushViewMatrix(getViewMatrix());
+        if (getModelMatrix()) iv->pushModelMatrix(getModelMatrix());
+
+        threads.push_back(new IntersectionThread(iv.get(), &node));
+    }
+
+    // the calling thread handles the first group itself.
+    for(unsigned int i=1; i<threads.size(); ++i)
+    {
+        threads[i]->start();
+    }
+
+    if (!threads.empty()) threads[0]->run();
+
+    for(unsigned int i=1; i<threads.size(); ++i)
+    {
+        threads[i]->join();
+    }
+}
+
 void IntersectionVisitor::apply(osg::Node& node)
 {
     // OSG_NOTICE<<"apply(Node&)"<<std::endl;
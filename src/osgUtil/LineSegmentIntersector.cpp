@@ -23,6 +23,11 @@
 #include <osg/TexMat>
 #include <osg/TemplatePrimitiveFunctor>
 
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP>=1)
+    #include <xmmintrin.h>
+    #define OSG_USE_SSE_INTERSECTION
+#endif
+
 using namespace osgUtil;
 
 namespace LineSegmentIntersectorUtils
@@ -402,6 +407,326 @@ struct IntersectFunctor
     }
 };
 
+// Number of line segments traversed together through a KdTree by IntersectPacket.
+const unsigned int PACKET_SIZE = 4;
+
+/** Traverse a KdTree with a packet of up to PACKET_SIZE line segments at a time. The node bounding box
+  * tests and, for float precision, the triangle tests are done for the whole packet at once, with SSE
+  * when available. Both are conservative, each candidate triangle is passed to the segment's own
+  * IntersectFunctor for the final test, so the intersections found are identical to a scalar traversal.*/
+template<typename Vec3, typename value_type>
+struct IntersectPacket
+{
+    typedef IntersectFunctor<Vec3, value_type> RayFunctor;
+
+    IntersectPacket(osgUtil::IntersectionVisitor& iv, osg::Drawable* drawable, const osg::KdTree& kdTree):
+        _kdTree(kdTree),
+        _numRays(0),
+        _filterTriangles(sizeof(value_type)==sizeof(float))
+    {
+        osg::Geometry* geometry = drawable->asGeometry();
+        osg::Vec3Array* vertices = geometry ? dynamic_cast<osg::Vec3Array*>(geometry->getVertexArray()) : 0;
+
+        for(unsigned int i=0; i<PACKET_SIZE; ++i)
+        {
+            _settings[i]._iv = &iv;
+            _settings[i]._drawable = drawable;
+            _settings[i]._vertices = vertices;
+        }
+    }
+
+    bool full() const { return _numRays==PACKET_SIZE; }
+
+    void add(osgUtil::LineSegmentIntersector* lsi, const osg::Vec3d& s, const osg::Vec3d& e)
+    {
+        unsigned int i = _numRays++;
+
+        Settings& settings = _settings[i];
+        settings._lineSegIntersector = lsi;
+        settings._limitOneIntersection = (lsi->getIntersectionLimit() == osgUtil::Intersector::LIMIT_ONE_PER_DRAWABLE ||
+                                          lsi->getIntersectionLimit() == osgUtil::Intersector::LIMIT_ONE);
+
+        RayFunctor& ray = _rays[i];
+        ray = RayFunctor();
+        ray.set(s, e, &settings);
+
+        // segment start and reciprocal of its extent, used to test the segment parameter range [0,1] against node bounding boxes.
+        osg::Vec3d delta = e - s;
+        _sx[i] = s.x(); _sy[i] = s.y(); _sz[i] = s.z();
+        _ix[i] = reciprocal(delta.x()); _iy[i] = reciprocal(delta.y()); _iz[i] = reciprocal(delta.z());
+
+        // the values the RayFunctor uses for its triangle test.
+        _ox[i] = ray._start.x(); _oy[i] = ray._start.y(); _oz[i] = ray._start.z();
+        _dx[i] = ray._d.x(); _dy[i] = ray._d.y(); _dz[i] = ray._d.z();
+        _length[i] = ray._length;
+    }
+
+    void intersect()
+    {
+        if (_numRays==0) return;
+
+        // fill the unused lanes with a copy of the first so that the SIMD lanes always hold valid numbers.
+        for(unsigned int i=_numRays; i<PACKET_SIZE; ++i)
+        {
+            _sx[i] = _sx[0]; _sy[i] = _sy[0]; _sz[i] = _sz[0];
+            _ix[i] = _ix[0]; _iy[i] = _iy[0]; _iz[i] = _iz[0];
+            _ox[i] = _ox[0]; _oy[i] = _oy[0]; _oz[i] = _oz[0];
+            _dx[i] = _dx[0]; _dy[i] = _dy[0]; _dz[i] = _dz[0];
+            _length[i] = _length[0];
+        }
+
+        if (!_kdTree.getNodes().empty() && _kdTree.getVertices())
+        {
+            traverse(_kdTree.getNode(0), (1u<<_numRays)-1);
+        }
+
+        _numRays = 0;
+    }
+
+    static float reciprocal(double value)
+    {
+        // keep the reciprocal finite so that the slab tests never compute 0*inf.
+        const double maxValue = 1e30;
+        if (value==0.0) return static_cast<float>(maxValue);
+        double r = 1.0/value;
+        if (r>maxValue) r = maxValue;
+        else if (r<-maxValue) r = -maxValue;
+        return static_cast<float>(r);
+    }
+
+    unsigned int activeRays(unsigned int mask) const
+    {
+        for(unsigned int i=0; i<_numRays; ++i)
+        {
+            if ((mask & (1u<<i)) && _settings[i]._limitOneIntersection && _rays[i]._hit) mask &= ~(1u<<i);
+        }
+        return mask;
+    }
+
+    void traverse(const osg::KdTree::KdNode& node, unsigned int mask)
+    {
+        if (node.first<0)
+        {
+            const osg::Vec3Array& vertices = *_kdTree.getVertices();
+            const osg::KdTree::Indices& primitiveIndices = _kdTree.getPrimitiveIndices();
+            const osg::KdTree::Indices& vertexIndices = _kdTree.getVertexIndices();
+
+            // treat as a leaf
+            int istart = -node.first-1;
+            int iend = istart + node.second;
+
+            for(int i=istart; i<iend && mask!=0; ++i)
+            {
+                unsigned int primitiveIndex = primitiveIndices[i];
+                unsigned int originalPIndex = vertexIndices[primitiveIndex++];
+                unsigned int numVertices = vertexIndices[primitiveIndex++];
+                switch(numVertices)
+                {
+                    case(3):
+                        intersect(originalPIndex, vertices[vertexIndices[primitiveIndex]], vertices[vertexIndices[primitiveIndex+1]], vertices[vertexIndices[primitiveIndex+2]], mask);
+                        break;
+                    case(4):
+                        intersect(originalPIndex, vertices[vertexIndices[primitiveIndex]], vertices[vertexIndices[primitiveIndex+1]], vertices[vertexIndices[primitiveIndex+3]], mask);
+                        intersect(originalPIndex, vertices[vertexIndices[primitiveIndex+1]], vertices[vertexIndices[primitiveIndex+2]], vertices[vertexIndices[primitiveIndex+3]], mask);
+                        break;
+                    default:
+                        break;
+                }
+
+                mask = activeRays(mask);
+            }
+        }
+        else
+        {
+            mask = intersectBox(node.bb, mask);
+            if (mask==0) return;
+
+            if (node.first>0) traverse(_kdTree.getNode(node.first), mask);
+            mask = activeRays(mask);
+            if (node.second>0 && mask!=0) traverse(_kdTree.getNode(node.second), mask);
+        }
+    }
+
+    void intersect(unsigned int primitiveIndex, const osg::Vec3& v0, const osg::Vec3& v1, const osg::Vec3& v2, unsigned int mask)
+    {
+        if (_filterTriangles) mask &= intersectTriangle(v0, v1, v2);
+
+        for(unsigned int i=0; i<_numRays; ++i)
+        {
+            if (mask & (1u<<i))
+            {
+                _rays[i]._primitiveIndex = primitiveIndex;
+                _rays[i].intersect(v0, v1, v2);
+            }
+        }
+    }
+
+    /** Return the mask of the rays in mask whose segment overlaps the bounding box. The box is padded
+      * slightly so that rounding can only add nodes to those visited by a scalar traversal.*/
+    unsigned int intersectBox(const osg::BoundingBox& bb, unsigned int mask) const
+    {
+        float pad = ((bb.xMax()-bb.xMin()) + (bb.yMax()-bb.yMin()) + (bb.zMax()-bb.zMin()))*1e-5f;
+
+#if defined(OSG_USE_SSE_INTERSECTION)
+        __m128 tnear = _mm_setzero_ps();
+        __m128 tfar = _mm_set1_ps(1.0f);
+
+        __m128 s = _mm_loadu_ps(_sx);
+        __m128 r = _mm_loadu_ps(_ix);
+        __m128 t0 = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(bb.xMin()-pad), s), r);
+        __m128 t1 = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(bb.xMax()+pad), s), r);
+        tnear = _mm_max_ps(tnear, _mm_min_ps(t0, t1));
+        tfar = _mm_min_ps(tfar, _mm_max_ps(t0, t1));
+
+        s = _mm_loadu_ps(_sy);
+        r = _mm_loadu_ps(_iy);
+        t0 = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(bb.yMin()-pad), s), r);
+        t1 = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(bb.yMax()+pad), s), r);
+        tnear = _mm_max_ps(tnear, _mm_min_ps(t0, t1));
+        tfar = _mm_min_ps(tfar, _mm_max_ps(t0, t1));
+
+        s = _mm_loadu_ps(_sz);
+        r = _mm_loadu_ps(_iz);
+        t0 = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(bb.zMin()-pad), s), r);
+        t1 = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(bb.zMax()+pad), s), r);
+        tnear = _mm_max_ps(tnear, _mm_min_ps(t0, t1));
+        tfar = _mm_min_ps(tfar, _mm_max_ps(t0, t1));
+
+        return mask & static_cast<unsigned int>(_mm_movemask_ps(_mm_cmple_ps(tnear, tfar)));
+#else
+        unsigned int result = 0;
+        for(unsigned int i=0; i<_numRays; ++i)
+        {
+            if (!(mask & (1u<<i))) continue;
+
+            float tnear = 0.0f;
+            float tfar = 1.0f;
+
+            float t0 = (bb.xMin()-pad-_sx[i])*_ix[i];
+            float t1 = (bb.xMax()+pad-_sx[i])*_ix[i];
+            tnear = osg::maximum(tnear, osg::minimum(t0, t1));
+            tfar = osg::minimum(tfar, osg::maximum(t0, t1));
+
+            t0 = (bb.yMin()-pad-_sy[i])*_iy[i];
+            t1 = (bb.yMax()+pad-_sy[i])*_iy[i];
+            tnear = osg::maximum(tnear, osg::minimum(t0, t1));
+            tfar = osg::minimum(tfar, osg::maximum(t0, t1));
+
+            t0 = (bb.zMin()-pad-_sz[i])*_iz[i];
+            t1 = (bb.zMax()+pad-_sz[i])*_iz[i];
+            tnear = osg::maximum(tnear, osg::minimum(t0, t1));
+            tfar = osg::minimum(tfar, osg::maximum(t0, t1));
+
+            if (tnear<=tfar) result |= (1u<<i);
+        }
+        return result;
+#endif
+    }
+
+    /** Return the mask of the rays that may hit the triangle. Mirrors the float arithmetic of
+      * IntersectFunctor::intersect() with a small relative tolerance on each bound, so lanes are only
+      * ever accepted too eagerly, never rejected where the scalar test would pass.*/
+    unsigned int intersectTriangle(const osg::Vec3& v0, const osg::Vec3& v1, const osg::Vec3& v2) const
+    {
+        const float tolerance = 1.0f/1024.0f;
+        const float epsilon = 0.5e-10f;
+
+        osg::Vec3 E1 = v1 - v0;
+        osg::Vec3 E2 = v2 - v0;
+
+#if defined(OSG_USE_SSE_INTERSECTION)
+        __m128 dx = _mm_loadu_ps(_dx), dy = _mm_loadu_ps(_dy), dz = _mm_loadu_ps(_dz);
+        __m128 e1x = _mm_set1_ps(E1.x()), e1y = _mm_set1_ps(E1.y()), e1z = _mm_set1_ps(E1.z());
+        __m128 e2x = _mm_set1_ps(E2.x()), e2y = _mm_set1_ps(E2.y()), e2z = _mm_set1_ps(E2.z());
+
+        __m128 tx = _mm_sub_ps(_mm_loadu_ps(_ox), _mm_set1_ps(v0.x()));
+        __m128 ty = _mm_sub_ps(_mm_loadu_ps(_oy), _mm_set1_ps(v0.y()));
+        __m128 tz = _mm_sub_ps(_mm_loadu_ps(_oz), _mm_set1_ps(v0.z()));
+
+        // P = d ^ E2, det = P * E1, u = P * T
+        __m128 px = _mm_sub_ps(_mm_mul_ps(dy, e2z), _mm_mul_ps(dz, e2y));
+        __m128 py = _mm_sub_ps(_mm_mul_ps(dz, e2x), _mm_mul_ps(dx, e2z));
+        __m128 pz = _mm_sub_ps(_mm_mul_ps(dx, e2y), _mm_mul_ps(dy, e2x));
+        __m128 det = _mm_add_ps(_mm_add_ps(_mm_mul_ps(px, e1x), _mm_mul_ps(py, e1y)), _mm_mul_ps(pz, e1z));
+        __m128 u = _mm_add_ps(_mm_add_ps(_mm_mul_ps(px, tx), _mm_mul_ps(py, ty)), _mm_mul_ps(pz, tz));
+
+        // Q = T ^ E1, v = Q * d, t*det = Q * E2
+        __m128 qx = _mm_sub_ps(_mm_mul_ps(ty, e1z), _mm_mul_ps(tz, e1y));
+        __m128 qy = _mm_sub_ps(_mm_mul_ps(tz, e1x), _mm_mul_ps(tx, e1z));
+        __m128 qz = _mm_sub_ps(_mm_mul_ps(tx, e1y), _mm_mul_ps(ty, e1x));
+        __m128 v = _mm_add_ps(_mm_add_ps(_mm_mul_ps(qx, dx), _mm_mul_ps(qy, dy)), _mm_mul_ps(qz, dz));
+        __m128 t = _mm_add_ps(_mm_add_ps(_mm_mul_ps(qx, e2x), _mm_mul_ps(qy, e2y)), _mm_mul_ps(qz, e2z));
+
+        // flip the signs so that the tests below are those of the det>epsilon branch.
+        __m128 signMask = _mm_and_ps(det, _mm_set1_ps(-0.0f));
+        __m128 absDet = _mm_xor_ps(det, signMask);
+        u = _mm_xor_ps(u, signMask);
+        v = _mm_xor_ps(v, signMask);
+        t = _mm_xor_ps(t, signMask);
+
+        __m128 slack = _mm_mul_ps(absDet, _mm_set1_ps(tolerance));
+        __m128 tmax = _mm_mul_ps(_mm_loadu_ps(_length), absDet);
+        __m128 tslack = _mm_mul_ps(tmax, _mm_set1_ps(tolerance));
+        __m128 negSlack = _mm_sub_ps(_mm_setzero_ps(), slack);
+        __m128 limit = _mm_add_ps(absDet, slack);
+
+        __m128 result = _mm_cmpgt_ps(absDet, _mm_set1_ps(epsilon));
+        result = _mm_and_ps(result, _mm_cmpge_ps(u, negSlack));
+        result = _mm_and_ps(result, _mm_cmple_ps(u, limit));
+        result = _mm_and_ps(result, _mm_cmpge_ps(v, negSlack));
+        result = _mm_and_ps(result, _mm_cmple_ps(v, limit));
+        result = _mm_and_ps(result, _mm_cmple_ps(_mm_add_ps(u, v), limit));
+        result = _mm_and_ps(result, _mm_cmpge_ps(t, _mm_sub_ps(_mm_setzero_ps(), tslack)));
+        result = _mm_and_ps(result, _mm_cmple_ps(t, _mm_add_ps(tmax, tslack)));
+
+        return static_cast<unsigned int>(_mm_movemask_ps(result));
+#else
+        unsigned int result = 0;
+        for(unsigned int i=0; i<_numRays; ++i)
+        {
+            osg::Vec3 d(_dx[i], _dy[i], _dz[i]);
+            osg::Vec3 T = osg::Vec3(_ox[i], _oy[i], _oz[i]) - v0;
+            osg::Vec3 P = d ^ E2;
+
+            float det = P * E1;
+            float u = P * T;
+
+            osg::Vec3 Q = T ^ E1;
+            float v = Q * d;
+            float t = Q * E2;
+
+            if (det<0.0f) { det = -det; u = -u; v = -v; t = -t; }
+
+            float slack = det*tolerance;
+            float tmax = _length[i]*det;
+            float tslack = tmax*tolerance;
+
+            if (det<=epsilon) continue;
+            if (u<-slack || u>det+slack) continue;
+            if (v<-slack || v>det+slack) continue;
+            if ((u+v)>det+slack) continue;
+            if (t<-tslack || t>tmax+tslack) continue;
+
+            result |= (1u<<i);
+        }
+        return result;
+#endif
+    }
+
+    const osg::KdTree&  _kdTree;
+    unsigned int        _numRays;
+    bool                _filterTriangles;
+
+    Settings            _settings[PACKET_SIZE];
+    RayFunctor          _rays[PACKET_SIZE];
+
+    float               _sx[PACKET_SIZE], _sy[PACKET_SIZE], _sz[PACKET_SIZE];
+    float               _ix[PACKET_SIZE], _iy[PACKET_SIZE], _iz[PACKET_SIZE];
+    float               _ox[PACKET_SIZE], _oy[PACKET_SIZE], _oz[PACKET_SIZE];
+    float               _dx[PACKET_SIZE], _dy[PACKET_SIZE], _dz[PACKET_SIZE];
+    float               _length[PACKET_SIZE];
+};
+
 } // namespace LineSegmentIntersectorUtils
 
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -550,6 +875,47 @@ void LineSegmentIntersector::intersect(osgUtil::IntersectionVisitor& iv, osg::Dr
     }
 }
 
+void LineSegmentIntersector::intersectBatch(osgUtil::IntersectionVisitor& iv, osg::Drawable* drawable,
+                                            LineSegmentIntersector* const* intersectors, unsigned int numIntersectors)
+{
+    osg::KdTree* kdTree = iv.getUseKdTreeWhenAvailable() ? dynamic_cast<osg::KdTree*>(drawable->getShape()) : 0;
+    if (!kdTree || iv.getDoDummyTraversal())
+    {
+        // nothing to share between the segments so just test them in turn.
+        for(unsigned int i=0; i<numIntersectors; ++i)
+        {
+            intersectors[i]->intersect(iv, drawable);
+        }
+        return;
+    }
+
+    LineSegmentIntersectorUtils::IntersectPacket<osg::Vec3f, float> floatPacket(iv, drawable, *kdTree);
+    LineSegmentIntersectorUtils::IntersectPacket<osg::Vec3d, double> doublePacket(iv, drawable, *kdTree);
+
+    for(unsigned int i=0; i<numIntersectors; ++i)
+    {
+        LineSegmentIntersector* lsi = intersectors[i];
+        if (lsi->reachedLimit()) continue;
+
+        osg::Vec3d s(lsi->_start), e(lsi->_end);
+        if ( drawable->isCullingActive() && !lsi->intersectAndClip( s, e, drawable->getBoundingBox() ) ) continue;
+
+        if (lsi->getPrecisionHint()==USE_DOUBLE_CALCULATIONS)
+        {
+            doublePacket.add(lsi, s, e);
+            if (doublePacket.full()) doublePacket.intersect();
+        }
+        else
+        {
+            floatPacket.add(lsi, s, e);
+            if (floatPacket.full()) floatPacket.intersect();
+        }
+    }
+
+    floatPacket.intersect();
+    doublePacket.intersect();
+}
+
 void LineSegmentIntersector::reset()
 {
     Intersector::reset();
@@ -26,6 +26,9 @@
 #include <osg/TriangleIndexFunctor>
 #include <osg/TriangleLinePointIndexFunctor>
 
+#include <OpenThreads/Thread>
+#include <OpenThreads/Atomic>
+
 #include <osgUtil/MeshOptimizers>
 
 using namespace osg;
@@ -43,6 +46,154 @@ void GeometryCollector::apply(Geometry& geom)
     _geometryList.insert(&geom);
 }
 
+namespace
+{
+// Disjoint set of geometries, joined when they share any arrays, primitive sets or buffer objects.
+struct GeometryPartitioner
+{
+    typedef std::map<const osg::Object*, unsigned int> ObjectOwnerMap;
+
+    std::vector<unsigned int>   parents;
+    ObjectOwnerMap              owners;
+
+    unsigned int root(unsigned int i)
+    {
+        while(parents[i]!=i)
+        {
+            parents[i] = parents[parents[i]];
+            i = parents[i];
+        }
+        return i;
+    }
+
+    void join(unsigned int i, const osg::Object* object)
+    {
+        if (!object) return;
+
+        std::pair<ObjectOwnerMap::iterator, bool> result = owners.insert(ObjectOwnerMap::value_type(object, i));
+        if (result.second) return;
+
+        unsigned int lhs = root(i);
+        unsigned int rhs = root(result.first->second);
+        if (lhs!=rhs) parents[osg::maximum(lhs, rhs)] = osg::minimum(lhs, rhs);
+    }
+
+    void join(unsigned int i, const osg::BufferData* bufferData)
+    {
+        if (!bufferData) return;
+        join(i, static_cast<const osg::Object*>(bufferData));
+        join(i, bufferData->getBufferObject());
+    }
+
+    void join(unsigned int i, const osg::Geometry& geom)
+    {
+        join(i, geom.getVertexArray());
+        join(i, geom.getNormalArray());
+        join(i, geom.getColorArray());
+        join(i, geom.getSecondaryColorArray());
+        join(i, geom.getFogCoordArray());
+        for(unsigned int t=0; t<geom.getNumTexCoordArrays(); ++t) join(i, geom.getTexCoordArray(t));
+        for(unsigned int a=0; a<geom.getNumVertexAttribArrays(); ++a) join(i, geom.getVertexAttribArray(a));
+        for(unsigned int p=0; p<geom.getNumPrimitiveSets(); ++p)
+        {
+            const osg::PrimitiveSet* primitiveSet = geom.getPrimitiveSet(p);
+            join(i, static_cast<const osg::Object*>(primitiveSet));
+            const osg::DrawElements* drawElements = primitiveSet ? primitiveSet->getDrawElements() : 0;
+            if (drawElements) join(i, drawElements->getBufferObject());
+        }
+    }
+};
+
+typedef std::vector<osg::Geometry*> GeometryGroup;
+typedef std::vector<GeometryGroup> GeometryGroups;
+
+class GeometryProcessingThread : public OpenThreads::Thread
+{
+public:
+    GeometryProcessingThread(GeometryCollector* collector, GeometryGroups& groups, OpenThreads::Atomic& nextGroup):
+        _collector(collector),
+        _groups(groups),
+        _nextGroup(nextGroup) {}
+
+    virtual void run()
+    {
+        unsigned int numGroups = static_cast<unsigned int>(_groups.size());
+        for(unsigned int g = (++_nextGroup)-1; g<numGroups; g = (++_nextGroup)-1)
+        {
+            GeometryGroup& group = _groups[g];
+            for(GeometryGroup::iterator itr = group.begin(); itr != group.end(); ++itr)
+            {
+                _collector->processGeometry(**itr);
+            }
+        }
+    }
+
+protected:
+    GeometryCollector*      _collector;
+    GeometryGroups&         _groups;
+    OpenThreads::Atomic&    _nextGroup;
+};
+}
+
+void GeometryCollector::processGeometries()
+{
+    if (_numThreads<=1 || _geometryList.size()<2)
+    {
+        for(GeometryList::iterator itr=_geometryList.begin();
+            itr!=_geometryList.end();
+            ++itr)
+        {
+            processGeometry(*(*itr));
+        }
+        return;
+    }
+
+    std::vector<osg::Geometry*> geometries(_geometryList.begin(), _geometryList.end());
+
+    GeometryPartitioner partitioner;
+    partitioner.parents.resize(geometries.size());
+    for(unsigned int i=0; i<geometries.size(); ++i)
+    {
+        partitioner.parents[i] = i;
+        partitioner.join(i, *geometries[i]);
+    }
+
+    // build the groups, each in collection order.
+    GeometryGroups groups;
+    std::vector<unsigned int> groupIndices(geometries.size());
+    for(unsigned int i=0; i<geometries.size(); ++i)
+    {
+        unsigned int r = partitioner.root(i);
+        if (r==i)
+        {
+            groupIndices[i] = static_cast<unsigned int>(groups.size());
+            groups.push_back(GeometryGroup());
+        }
+        groups[groupIndices[r]].push_back(geometries[i]);
+    }
+
+    unsigned int numThreads = osg::minimum(_numThreads, static_cast<unsigned int>(groups.size()));
+
+    OSG_INFO<<"GeometryCollector::processGeometries() "<<geometries.size()<<" geometries in "<<groups.size()<<" independent groups on "<<numThreads<<" threads"<<std::endl;
+
+    OpenThreads::Atomic nextGroup;
+    std::vector<GeometryProcessingThread*> threads;
+    for(unsigned int t=1; t<numThreads; ++t)
+    {
+        threads.push_back(new GeometryProcessingThread(this, groups, nextGroup));
+        threads.back()->start();
+    }
+
+    // the calling thread processes groups as well.
+    GeometryProcessingThread(this, groups, nextGroup).run();
+
+    for(std::vector<GeometryProcessingThread*>::iterator itr = threads.begin(); itr != threads.end(); ++itr)
+    {
+        (*itr)->join();
+        delete *itr;
+    }
+}
+
 namespace
 {
 typedef std::vector<unsigned int> IndexList;
@@ -401,12 +552,7 @@ void IndexMeshVisitor::makeMesh(Geometry& geom)
 
 void IndexMeshVisitor::makeMesh()
 {
-    for(GeometryList::iterator itr=_geometryList.begin();
-        itr!=_geometryList.end();
-        ++itr)
-    {
-        makeMesh(*(*itr));
-    }
+    processGeometries();
 }
 
 namespace
@@ -878,12 +1024,7 @@ void VertexCacheVisitor::doVertexOptimization(Geometry& geom,
 
 void VertexCacheVisitor::optimizeVertices()
 {
-    for(GeometryList::iterator itr=_geometryList.begin();
-        itr!=_geometryList.end();
-        ++itr)
-    {
-        optimizeVertices(*(*itr));
-    }
+    processGeometries();
 }
 
 VertexCacheMissVisitor::VertexCacheMissVisitor(unsigned cacheSize)
@@ -1107,12 +1248,7 @@ struct VertexReorder : public TriangleLinePointIndexFunctor<osgUtil::VertexReord
 
 void VertexAccessOrderVisitor::optimizeOrder()
 {
-    for (GeometryList::iterator itr = _geometryList.begin(), end = _geometryList.end();
-         itr != end;
-         ++itr)
-    {
-        optimizeOrder(*(*itr));
-    }
+    processGeometries();
 }
 
 template<typename DE>
@@ -49,11 +49,23 @@
 
 using namespace osgUtil;
 
+Optimizer::Optimizer():
+    _numThreads(1)
+{
+    const char* str = getenv("OSG_OPTIMIZER_NUM_THREADS");
+    if (str)
+    {
+        int numThreads = atoi(str);
+        if (numThreads>0) _numThreads = numThreads;
+    }
+}
+
 void Optimizer::reset()
 {
 }
 
 static osg::ApplicationUsageProxy Optimizer_e0(osg::ApplicationUsage::ENVIRONMENTAL_VARIABLE,"OSG_OPTIMIZER \"<type> [<type>]\"","OFF | DEFAULT | FLATTEN_STATIC_TRANSFORMS | FLATTEN_STATIC_TRANSFORMS_DUPLICATING_SHARED_SUBGRAPHS | REMOVE_REDUNDANT_NODES | COMBINE_ADJACENT_LODS | SHARE_DUPLICATE_STATE | MERGE_GEOMETRY | MERGE_GEODES | SPATIALIZE_GROUPS  | COPY_SHARED_NODES | OPTIMIZE_TEXTURE_SETTINGS | REMOVE_LOADED_PROXY_NODES | TESSELLATE_GEOMETRY | CHECK_GEOMETRY |  FLATTEN_BILLBOARDS | TEXTURE_ATLAS_BUILDER | STATIC_OBJECT_DETECTION | INDEX_MESH | VERTEX_POSTTRANSFORM | VERTEX_PRETRANSFORM | BUFFER_OBJECT_SETTINGS");
+static osg::ApplicationUsageProxy Optimizer_e1(osg::ApplicationUsage::ENVIRONMENTAL_VARIABLE,"OSG_OPTIMIZER_NUM_THREADS <int>","Set the number of threads used by the INDEX_MESH, VERTEX_POSTTRANSFORM and VERTEX_PRETRANSFORM optimizations.");
 
 void Optimizer::optimize(osg::Node* node)
 {
@@ -342,6 +354,7 @@ void Optimizer::optimize(osg::Node* node, unsigned int options)
     {
         OSG_INFO<<"Optimizer::optimize() doing INDEX_MESH"<<std::endl;
         IndexMeshVisitor imv(this);
+        imv.setNumThreads(_numThreads);
         node->accept(imv);
         imv.makeMesh();
     }
@@ -350,6 +363,7 @@ void Optimizer::optimize(osg::Node* node, unsigned int options)
     {
         OSG_INFO<<"Optimizer::optimize() doing VERTEX_POSTTRANSFORM"<<std::endl;
         VertexCacheVisitor vcv;
+        vcv.setNumThreads(_numThreads);
         node->accept(vcv);
         vcv.optimizeVertices();
     }
@@ -358,6 +372,7 @@ void Optimizer::optimize(osg::Node* node, unsigned int options)
     {
         OSG_INFO<<"Optimizer::optimize() doing VERTEX_PRETRANSFORM"<<std::endl;
         VertexAccessOrderVisitor vaov;
+        vaov.setNumThreads(_numThreads);
         node->accept(vaov);
         vaov.optimizeOrder();
     }
@@ -20,8 +20,10 @@
 #include <osg/Notify>
 #include <osg/ApplicationUsage>
 #include <osg/AlphaFunc>
+#include <osg/Types>
 
 #include <algorithm>
+#include <map>
 
 using namespace osg;
 using namespace osgUtil;
@@ -113,7 +115,7 @@ void RenderBin::removeRenderBinPrototype(RenderBin* proto)
 
 static bool s_defaultBinSortModeInitialized = false;
 static RenderBin::SortMode s_defaultBinSortMode = RenderBin::SORT_BY_STATE;
-static osg::ApplicationUsageProxy RenderBin_e0(osg::ApplicationUsage::ENVIRONMENTAL_VARIABLE,"OSG_DEFAULT_BIN_SORT_MODE <type>","SORT_BY_STATE | SORT_BY_STATE_THEN_FRONT_TO_BACK | SORT_FRONT_TO_BACK | SORT_BACK_TO_FRONT");
+static osg::ApplicationUsageProxy RenderBin_e0(osg::ApplicationUsage::ENVIRONMENTAL_VARIABLE,"OSG_DEFAULT_BIN_SORT_MODE <type>","SORT_BY_STATE | SORT_BY_STATE_THEN_FRONT_TO_BACK | SORT_FRONT_TO_BACK | SORT_BACK_TO_FRONT | TRAVERSAL_ORDER | SORT_BY_PROGRAM_TEXTURE_DEPTH");
 
 void RenderBin::setDefaultRenderBinSortMode(RenderBin::SortMode mode)
 {
@@ -136,6 +138,7 @@ RenderBin::SortMode RenderBin::getDefaultRenderBinSortMode()
             else if (strcmp(str,"SORT_FRONT_TO_BACK")==0) s_defaultBinSortMode = RenderBin::SORT_FRONT_TO_BACK;
             else if (strcmp(str,"SORT_BACK_TO_FRONT")==0) s_defaultBinSortMode = RenderBin::SORT_BACK_TO_FRONT;
             else if (strcmp(str,"TRAVERSAL_ORDER")==0) s_defaultBinSortMode = RenderBin::TRAVERSAL_ORDER;
+            else if (strcmp(str,"SORT_BY_PROGRAM_TEXTURE_DEPTH")==0) s_defaultBinSortMode = RenderBin::SORT_BY_PROGRAM_TEXTURE_DEPTH;
         }
     }
 
@@ -250,6 +253,9 @@ void RenderBin::sortImplementation()
         case(TRAVERSAL_ORDER):
             sortTraversalOrder();
             break;
+        case(SORT_BY_PROGRAM_TEXTURE_DEPTH):
+            sortByProgramTextureDepth();
+            break;
     }
 }
 
@@ -292,6 +298,95 @@ void RenderBin::sortByStateThenFrontToBack()
     std::sort(_stateGraphList.begin(),_stateGraphList.end(),StateGraphFrontToBackSortFunctor());
 }
 
+// below this size std::sort on the RenderLeaf list is quicker than setting up the radix sort.
+static const unsigned int MIN_RADIX_SORT_SIZE = 256;
+
+// map a float depth onto an unsigned integer with the same ordering, so that it can be radix sorted.
+static inline unsigned int depthToSortKey(float depth)
+{
+    union { float f; unsigned int u; } value;
+    value.f = depth;
+    return (value.u & 0x80000000u) ? ~value.u : (value.u | 0x80000000u);
+}
+
+struct DepthKey
+{
+    DepthKey(bool backToFront): _mask(backToFront ? 0xffffffffu : 0u) {}
+    inline unsigned int operator() (const RenderLeaf* leaf) const { return depthToSortKey(leaf->_depth) ^ _mask; }
+    unsigned int _mask;
+};
+
+struct TraversalOrderKey
+{
+    inline unsigned int operator() (const RenderLeaf* leaf) const { return leaf->_traversalOrderNumber; }
+};
+
+/** Stable least significant digit radix sort of (key, value) pairs, 8 bits per pass, skipping passes where all keys share the digit.*/
+template<typename Key, typename T>
+static void radixSort(std::vector< std::pair<Key, T> >& items)
+{
+    typedef std::vector< std::pair<Key, T> > Items;
+    const unsigned int numPasses = sizeof(Key);
+    const std::size_t numItems = items.size();
+    if (numItems<2) return;
+
+    // histograms for all the passes are gathered in one sweep over the keys.
+    std::vector<std::size_t> counts(numPasses*256, 0);
+    for(typename Items::const_iterator itr = items.begin(); itr != items.end(); ++itr)
+    {
+        Key key = itr->first;
+        for(unsigned int pass=0; pass<numPasses; ++pass)
+        {
+            ++counts[pass*256 + static_cast<unsigned int>((key >> (pass*8)) & 0xff)];
+        }
+    }
+
+    Items buffer(numItems);
+    Items* source = &items;
+    Items* destination = &buffer;
+    for(unsigned int pass=0; pass<numPasses; ++pass)
+    {
+        std::size_t* count = &counts[pass*256];
+        if (count[static_cast<unsigned int>((items.front().first >> (pass*8)) & 0xff)]==numItems) continue;
+
+        std::size_t offsets[256];
+        std::size_t offset = 0;
+        for(unsigned int i=0; i<256; ++i)
+        {
+            offsets[i] = offset;
+            offset += count[i];
+        }
+
+        for(typename Items::const_iterator itr = source->begin(); itr != source->end(); ++itr)
+        {
+            (*destination)[offsets[static_cast<unsigned int>((itr->first >> (pass*8)) & 0xff)]++] = *itr;
+        }
+
+        std::swap(source, destination);
+    }
+
+    if (source!=&items) items.swap(buffer);
+}
+
+template<class KeyFunctor>
+static void radixSortRenderLeafList(RenderBin::RenderLeafList& leaves, const KeyFunctor& keyFunctor)
+{
+    typedef std::vector< std::pair<unsigned int, RenderLeaf*> > KeyedLeafList;
+    KeyedLeafList keyedLeaves;
+    keyedLeaves.reserve(leaves.size());
+    for(RenderBin::RenderLeafList::iterator itr = leaves.begin(); itr != leaves.end(); ++itr)
+    {
+        keyedLeaves.push_back(KeyedLeafList::value_type(keyFunctor(*itr), *itr));
+    }
+
+    radixSort(keyedLeaves);
+
+    for(std::size_t i=0; i<leaves.size(); ++i)
+    {
+        leaves[i] = keyedLeaves[i].second;
+    }
+}
+
 struct FrontToBackSortFunctor
 {
     bool operator() (const RenderLeaf* lhs,const RenderLeaf* rhs) const
@@ -306,7 +401,8 @@ void RenderBin::sortFrontToBack()
     copyLeavesFromStateGraphListToRenderLeafList();
 
     // now sort the list into ascending depth order.
-    std::sort(_renderLeafList.begin(),_renderLeafList.end(),FrontToBackSortFunctor());
+    if (_renderLeafList.size()>=MIN_RADIX_SORT_SIZE) radixSortRenderLeafList(_renderLeafList, DepthKey(false));
+    else std::sort(_renderLeafList.begin(),_renderLeafList.end(),FrontToBackSortFunctor());
 
 //    cout << "sort front to back"<<endl;
 }
@@ -323,8 +419,9 @@ void RenderBin::sortBackToFront()
 {
     copyLeavesFromStateGraphListToRenderLeafList();
 
-    // now sort the list into ascending depth order.
-    std::sort(_renderLeafList.begin(),_renderLeafList.end(),BackToFrontSortFunctor());
+    // now sort the list into descending depth order.
+    if (_renderLeafList.size()>=MIN_RADIX_SORT_SIZE) radixSortRenderLeafList(_renderLeafList, DepthKey(true));
+    else std::sort(_renderLeafList.begin(),_renderLeafList.end(),BackToFrontSortFunctor());
 
 //    cout << "sort back to front"<<endl;
 }
@@ -342,8 +439,63 @@ void RenderBin::sortTraversalOrder()
 {
     copyLeavesFromStateGraphListToRenderLeafList();
 
-    // now sort the list into ascending depth order.
-    std::sort(_renderLeafList.begin(),_renderLeafList.end(),TraversalOrderFunctor());
+    // now sort the list into ascending traversal order.
+    if (_renderLeafList.size()>=MIN_RADIX_SORT_SIZE) radixSortRenderLeafList(_renderLeafList, TraversalOrderKey());
+    else std::sort(_renderLeafList.begin(),_renderLeafList.end(),TraversalOrderFunctor());
+}
+
+void RenderBin::sortByProgramTextureDepth()
+{
+    // assign each distinct Program and Texture a small id, in order of first use so the key is independent of pointer values.
+    typedef std::map<const osg::StateAttribute*, unsigned int> AttributeIdMap;
+    AttributeIdMap programIds;
+    AttributeIdMap textureIds;
+    programIds[0] = 0;
+    textureIds[0] = 0;
+
+    typedef std::vector< std::pair<uint64_t, RenderLeaf*> > KeyedLeafList;
+    KeyedLeafList keyedLeaves;
+
+    for(StateGraphList::iterator itr = _stateGraphList.begin();
+        itr != _stateGraphList.end();
+        ++itr)
+    {
+        // the innermost Program and Texture on the StateGraph's path are the ones that will be applied.
+        const osg::StateAttribute* program = 0;
+        const osg::StateAttribute* texture = 0;
+        for(StateGraph* sg = *itr; sg && (!program || !texture); sg = sg->_parent)
+        {
+            const osg::StateSet* stateset = sg->getStateSet();
+            if (!stateset) continue;
+            if (!program) program = stateset->getAttribute(osg::StateAttribute::PROGRAM);
+            if (!texture) texture = stateset->getTextureAttribute(0, osg::StateAttribute::TEXTURE);
+        }
+
+        unsigned int programId = programIds.insert(AttributeIdMap::value_type(program, static_cast<unsigned int>(programIds.size()))).first->second;
+        unsigned int textureId = textureIds.insert(AttributeIdMap::value_type(texture, static_cast<unsigned int>(textureIds.size()))).first->second;
+        uint64_t stateKey = (uint64_t(osg::minimum(programId, 0xffffu))<<48) | (uint64_t(osg::minimum(textureId, 0xffffu))<<32);
+
+        for(StateGraph::LeafList::iterator litr = (*itr)->_leaves.begin();
+            litr != (*itr)->_leaves.end();
+            ++litr)
+        {
+            RenderLeaf* leaf = litr->get();
+            if (osg::isNaN(leaf->_depth)) continue;
+            keyedLeaves.push_back(KeyedLeafList::value_type(stateKey | depthToSortKey(leaf->_depth), leaf));
+        }
+    }
+
+    radixSort(keyedLeaves);
+
+    _renderLeafList.clear();
+    _renderLeafList.reserve(keyedLeaves.size());
+    for(KeyedLeafList::iterator itr = keyedLeaves.begin(); itr != keyedLeaves.end(); ++itr)
+    {
+        _renderLeafList.push_back(itr->second);
+    }
+
+    // empty the render graph list to prevent it being drawn along side the render leaf list (see drawImplementation.)
+    _stateGraphList.clear();
 }
 
 void RenderBin::copyLeavesFromStateGraphListToRenderLeafList()
@@ -419,6 +571,63 @@ RenderBin* RenderBin::find_or_insert(int binNum,const std::string& binName)
     return rb;
 }
 
+// find the StateGraph below rootStateGraph with the same path of StateSets as stateGraph.
+static StateGraph* findOrInsertEquivalent(StateGraph* rootStateGraph, StateGraph* stateGraph)
+{
+    if (!stateGraph->_parent) return rootStateGraph;
+    return findOrInsertEquivalent(rootStateGraph, stateGraph->_parent)->find_or_insert(stateGraph->getStateSet());
+}
+
+void RenderBin::merge(RenderBin* bin, StateGraph* rootStateGraph)
+{
+    for(StateGraphList::iterator itr = bin->_stateGraphList.begin();
+        itr != bin->_stateGraphList.end();
+        ++itr)
+    {
+        StateGraph* source = *itr;
+        StateGraph* target = findOrInsertEquivalent(rootStateGraph, source);
+        if (target==source) continue;
+
+        if (target->leaves_empty()) addStateGraph(target);
+
+        for(StateGraph::LeafList::iterator litr = source->_leaves.begin();
+            litr != source->_leaves.end();
+            ++litr)
+        {
+            target->addLeaf(litr->get());
+        }
+        source->_leaves.clear();
+    }
+    bin->_stateGraphList.clear();
+
+    for(RenderBinList::iterator itr = bin->_bins.begin();
+        itr != bin->_bins.end();
+        ++itr)
+    {
+        RenderBin* source = itr->second.get();
+
+        RenderBinList::iterator target_itr = _bins.find(itr->first);
+        if (target_itr==_bins.end())
+        {
+            RenderBin* rb = dynamic_cast<RenderBin*>(source->cloneType());
+            if (!rb) continue;
+
+            rb->_binNum = source->_binNum;
+            rb->_parent = this;
+            rb->_stage = _stage;
+            rb->_sortMode = source->_sortMode;
+            rb->_sortCallback = source->_sortCallback;
+            rb->_drawCallback = source->_drawCallback;
+            rb->_stateset = source->_stateset;
+            target_itr = _bins.insert(RenderBinList::value_type(itr->first, rb)).first;
+        }
+
+        target_itr->second->merge(source, rootStateGraph);
+    }
+
+    _sorted = false;
+}
+
 void RenderBin::draw(osg::RenderInfo& renderInfo,RenderLeaf*& previous)
 {
     renderInfo.pushRenderBin(this);
@@ -12,6 +12,7 @@
 */
 
 #include <osg/TriangleIndexFunctor>
+#include <osg/TaskScheduler>
 
 #include <osgUtil/Simplifier>
 
@@ -20,6 +21,7 @@
 
 #include <set>
 #include <list>
+#include <queue>
 #include <algorithm>
 
 #include <iterator>
@@ -1719,13 +1721,900 @@ void EdgeCollapse::copyBackToGeometry()
 }
 
 
+////////////////////////////////////////////////////////////////////////////
+//
+//  QuadricCollapse
+//
+
+// Copy a vertex array into float positions relative to the corner of its bounding box, scaled to fit the unit cube.
+class CopyVertexArrayToPositionsVisitor : public osg::ArrayVisitor
+{
+    public:
+        CopyVertexArrayToPositionsVisitor(std::vector<osg::Vec3f>& positions):
+            _positions(positions),
+            _scale(1.0) {}
+
+        template<class T>
+        void copy(const T& array, unsigned int numComponents)
+        {
+            osg::Vec3d minimum(DBL_MAX, DBL_MAX, DBL_MAX);
+            osg::Vec3d maximum(-DBL_MAX, -DBL_MAX, -DBL_MAX);
+            for(unsigned int i=0; i<array.size(); ++i)
+            {
+                osg::Vec3d v = position(array[i], numComponents);
+                for(unsigned int c=0; c<3; ++c)
+                {
+                    minimum[c] = osg::minimum(minimum[c], v[c]);
+                    maximum[c] = osg::maximum(maximum[c], v[c]);
+                }
+            }
+
+            double extent = osg::maximum(maximum.x()-minimum.x(), osg::maximum(maximum.y()-minimum.y(), maximum.z()-minimum.z()));
+            _scale = extent>0.0 ? extent : 1.0;
+
+            _positions.resize(array.size());
+            for(unsigned int i=0; i<array.size(); ++i)
+            {
+                _positions[i] = (position(array[i], numComponents)-minimum)/_scale;
+            }
+        }
+
+        template<class V>
+        static osg::Vec3d position(const V& v, unsigned int numComponents)
+        {
+            if (numComponents==2) return osg::Vec3d(v[0], v[1], 0.0);
+            if (numComponents==4) return osg::Vec3d(v[0]/v[3], v[1]/v[3], v[2]/v[3]);
+            return osg::Vec3d(v[0], v[1], v[2]);
+        }
+
+        virtual void apply(osg::Vec2Array& array) { copy(array, 2); }
+        virtual void apply(osg::Vec3Array& array) { copy(array, 3); }
+        virtual void apply(osg::Vec4Array& array) { copy(array, 4); }
+        virtual void apply(osg::Vec2dArray& array) { copy(array, 2); }
+        virtual void apply(osg::Vec3dArray& array) { copy(array, 3); }
+        virtual void apply(osg::Vec4dArray& array) { copy(array, 4); }
+
+        std::vector<osg::Vec3f>&    _positions;
+        double                      _scale;
+
+    protected:
+
+        CopyVertexArrayToPositionsVisitor& operator = (const CopyVertexArrayToPositionsVisitor&) { return *this; }
+};
+
+// Move the elements of an array to their new indices, which are never greater than the original ones, and drop the rest.
+class CompactArrayVisitor : public osg::ArrayVisitor
+{
+    public:
+        CompactArrayVisitor(const std::vector<unsigned int>& remapping, unsigned int newSize):
+            _remapping(remapping),
+            _newSize(newSize) {}
+
+        template<class T>
+        void compact(T& array)
+        {
+            for(unsigned int i=0; i<array.size() && i<_remapping.size(); ++i)
+            {
+                if (_remapping[i]!=invalidIndex) array[_remapping[i]] = array[i];
+            }
+            array.resize(_newSize);
+            array.dirty();
+        }
+
+        virtual void apply(osg::Array&) {}
+        virtual void apply(osg::ByteArray& array) { compact(array); }
+        virtual void apply(osg::ShortArray& array) { compact(array); }
+        virtual void apply(osg::IntArray& array) { compact(array); }
+        virtual void apply(osg::UByteArray& array) { compact(array); }
+        virtual void apply(osg::UShortArray& array) { compact(array); }
+        virtual void apply(osg::UIntArray& array) { compact(array); }
+        virtual void apply(osg::FloatArray& array) { compact(array); }
+        virtual void apply(osg::DoubleArray& array) { compact(array); }
+
+        virtual void apply(osg::Vec2Array& array) { compact(array); }
+        virtual void apply(osg::Vec3Array& array) { compact(array); }
+        virtual void apply(osg::Vec4Array& array) { compact(array); }
+
+        virtual void apply(osg::Vec4ubArray& array) { compact(array); }
+
+        virtual void apply(osg::Vec2bArray& array) { compact(array); }
+        virtual void apply(osg::Vec3bArray& array) { compact(array); }
+        virtual void apply(osg::Vec4bArray& array) { compact(array); }
+
+        virtual void apply(osg::Vec2sArray& array) { compact(array); }
+        virtual void apply(osg::Vec3sArray& array) { compact(array); }
+        virtual void apply(osg::Vec4sArray& array) { compact(array); }
+
+        virtual void apply(osg::Vec2dArray& array) { compact(array); }
+        virtual void apply(osg::Vec3dArray& array) { compact(array); }
+        virtual void apply(osg::Vec4dArray& array) { compact(array); }
+
+        static const unsigned int invalidIndex = 0xffffffff;
+
+        const std::vector<unsigned int>&    _remapping;
+        unsigned int                        _newSize;
+
+    protected:
+
+        CompactArrayVisitor& operator = (const CompactArrayVisitor&) { return *this; }
+};
+
+const unsigned int CompactArrayVisitor::invalidIndex;
+
+/** Edge collapse simplification ordered by quadric error metrics, run on spatial partitions of the mesh in parallel.
+  * The mesh is held in flat arrays: float positions scaled to the unit cube, a quadric per vertex, the triangle indices, and
+  * the triangles around each vertex in a compressed array rebuilt at the start of every pass. Collapsing vertex u onto its
+  * neighbour v rewrites u's triangles to use v and chains u's triangle list onto v's, with the chain length capped so that
+  * walking the triangles of a vertex stays cheap until the next rebuild.
+  * Each pass assigns the vertices to the cells of a grid, and each cell runs a greedy collapse from a priority queue of its own
+  * vertices. A collapse only touches the triangles around u, so it is only permitted when all the vertices of those triangles
+  * are in the cell, which locks the vertices on the cell borders. The grid is shifted by half a cell between passes, and made
+  * coarser when a pass makes little progress, so the borders are simplified in later passes.*/
+class QuadricCollapse
+{
+public:
+
+    struct Quadric
+    {
+        Quadric():
+            a00(0.0f), a01(0.0f), a02(0.0f), a11(0.0f), a12(0.0f), a22(0.0f), b0(0.0f), b1(0.0f), b2(0.0f), c(0.0f) {}
+
+        /** Add the weighted squared distance to the plane through point with unit normal n.*/
+        inline void addPlane(const osg::Vec3f& n, const osg::Vec3f& point, float weight)
+        {
+            float d = -(n*point);
+            a00 += weight*n.x()*n.x(); a01 += weight*n.x()*n.y(); a02 += weight*n.x()*n.z();
+            a11 += weight*n.y()*n.y(); a12 += weight*n.y()*n.z(); a22 += weight*n.z()*n.z();
+            b0 += weight*d*n.x(); b1 += weight*d*n.y(); b2 += weight*d*n.z();
+            c += weight*d*d;
+        }
+
+        inline void operator += (const Quadric& rhs)
+        {
+            a00 += rhs.a00; a01 += rhs.a01; a02 += rhs.a02;
+            a11 += rhs.a11; a12 += rhs.a12; a22 += rhs.a22;
+            b0 += rhs.b0; b1 += rhs.b1; b2 += rhs.b2;
+            c += rhs.c;
+        }
+
+        inline float evaluate(const osg::Vec3f& v) const
+        {
+            float x = v.x(), y = v.y(), z = v.z();
+            float e = a00*x*x + a11*y*y + a22*z*z + 2.0f*(a01*x*y + a02*x*z + a12*y*z) + 2.0f*(b0*x + b1*y + b2*z) + c;
+            return e>0.0f ? e : 0.0f;
+        }
+
+        float a00, a01, a02, a11, a12, a22, b0, b1, b2, c;
+    };
+
+    enum VertexFlags
+    {
+        LOCKED = 1,
+        BOUNDARY = 2,
+        REMOVED = 4
+    };
+
+    static const unsigned int INVALID = 0xffffffff;
+
+    // bounds the triangles walked per vertex between adjacency rebuilds.
+    static const unsigned int MAXIMUM_CHAIN_LENGTH = 16;
+
+    QuadricCollapse(const Simplifier& simplifier):
+        _simplifier(simplifier),
+        _geometry(0),
+        _scale(1.0),
+        _numOriginalTriangles(0),
+        _numTriangles(0) {}
+
+    bool setGeometry(osg::Geometry* geometry, const Simplifier::IndexList& protectedPoints);
+
+    void simplify();
+
+    void copyBackToGeometry();
+
+    unsigned int getNumOriginalTriangles() const { return _numOriginalTriangles; }
+    unsigned int getNumTriangles() const { return _numTriangles; }
+
+    struct Scratch
+    {
+        std::vector<unsigned int>   triangles;
+        std::vector<unsigned int>   ring;
+        std::vector<unsigned int>   otherTriangles;
+        std::vector<unsigned int>   otherRing;
+        std::vector< std::pair<float, unsigned int> > candidates;
+    };
+
+    inline unsigned int* triangle(unsigned int t) { return &_triangles[t*3]; }
+
+    inline bool contains(unsigned int t, unsigned int v) const
+    {
+        const unsigned int* tri = &_triangles[t*3];
+        return tri[0]==v || tri[1]==v || tri[2]==v;
+    }
+
+    /** Gather the live triangles around vertex v, following the chain of vertices collapsed onto it this pass.*/
+    void gatherTriangles(unsigned int v, std::vector<unsigned int>& triangles) const
+    {
+        triangles.clear();
+        for(unsigned int w=v; w!=INVALID; w=_next[w])
+        {
+            for(unsigned int i=_adjacencyOffsets[w]; i<_adjacencyOffsets[w+1]; ++i)
+            {
+                unsigned int t = _adjacency[i];
+                if (!_triangleRemoved[t]) triangles.push_back(t);
+            }
+        }
+    }
+
+    /** Gather the sorted, unique vertices of triangles, other than v.*/
+    void gatherRing(unsigned int v, const std::vector<unsigned int>& triangles, std::vector<unsigned int>& ring) const
+    {
+        ring.clear();
+        for(std::vector<unsigned int>::const_iterator itr = triangles.begin(); itr != triangles.end(); ++itr)
+        {
+            const unsigned int* tri = &_triangles[(*itr)*3];
+            for(unsigned int i=0; i<3; ++i)
+            {
+                if (tri[i]!=v) ring.push_back(tri[i]);
+            }
+        }
+        std::sort(ring.begin(), ring.end());
+        ring.erase(std::unique(ring.begin(), ring.end()), ring.end());
+    }
+
+    /** Return true if v may be collapsed onto a neighbour this pass, being unlocked and with triangles.*/
+    inline bool isCollapsible(unsigned int v) const
+    {
+        return !(_flags[v]&(LOCKED|REMOVED)) && _adjacencyOffsets[v]!=_adjacencyOffsets[v+1];
+    }
+
+    float collapseError(unsigned int u, unsigned int v) const
+    {
+        Quadric q = _quadrics[u];
+        q += _quadrics[v];
+        return q.evaluate(_positions[v]);
+    }
+
+    bool isCollapseValid(unsigned int u, unsigned int v, unsigned int cell, Scratch& scratch);
+
+    /** Find the neighbour of u with the least error to collapse onto, just checking the collapse is valid if validate is true.*/
+    bool computeBestCollapse(unsigned int u, unsigned int cell, Scratch& scratch, bool validate, unsigned int& target, float& error);
+
+    unsigned int collapse(unsigned int u, unsigned int v, Scratch& scratch);
+
+    void buildAdjacency();
+
+    void assignCells(unsigned int gridSize, float offset);
+
+    /** Collapse the vertices of a cell, returning the number of triangles removed.*/
+    unsigned int collapseCell(unsigned int cell, Scratch& scratch);
+
+    struct CollapseCells
+    {
+        CollapseCells(QuadricCollapse* qc, std::vector<unsigned int>& removed):
+            _qc(qc),
+            _removed(removed) {}
+
+        void operator() (unsigned int first, unsigned int last)
+        {
+            Scratch scratch;
+            for(unsigned int cell=first; cell<last; ++cell)
+            {
+                _removed[cell] = _qc->collapseCell(cell, scratch);
+            }
+        }
+
+        QuadricCollapse*            _qc;
+        std::vector<unsigned int>&  _removed;
+    };
+
+    struct ComputeQuadrics
+    {
+        ComputeQuadrics(QuadricCollapse* qc):
+            _qc(qc) {}
+
+        void operator() (unsigned int first, unsigned int last)
+        {
+            Scratch scratch;
+            for(unsigned int v=first; v<last; ++v)
+            {
+                _qc->computeQuadric(v, scratch);
+            }
+        }
+
+        QuadricCollapse* _qc;
+    };
+
+    void computeQuadric(unsigned int v, Scratch& scratch);
+
+    struct LessVertex
+    {
+        LessVertex(const std::vector<osg::Array*>& arrays):
+            _arrays(arrays) {}
+
+        bool operator() (unsigned int lhs, unsigned int rhs) const
+        {
+            for(std::vector<osg::Array*>::const_iterator itr = _arrays.begin(); itr != _arrays.end(); ++itr)
+            {
+                int result = (*itr)->compare(lhs, rhs);
+                if (result<0) return true;
+                if (result>0) return false;
+            }
+            return false;
+        }
+
+        const std::vector<osg::Array*>& _arrays;
+    };
+
+    struct CollectTriangles
+    {
+        std::vector<unsigned int>*  _triangles;
+        unsigned int                _numVertices;
+
+        void operator() (unsigned int p1, unsigned int p2, unsigned int p3)
+        {
+            if (p1==p2 || p2==p3 || p1==p3) return;
+            if (p1>=_numVertices || p2>=_numVertices || p3>=_numVertices) return;
+            _triangles->push_back(p1);
+            _triangles->push_back(p2);
+            _triangles->push_back(p3);
+        }
+    };
+
+    const Simplifier&               _simplifier;
+    osg::Geometry*                  _geometry;
+    std::vector<osg::Array*>        _perVertexArrays;
+
+    double                          _scale;
+    std::vector<osg::Vec3f>         _positions;
+    std::vector<Quadric>            _quadrics;
+    std::vector<unsigned char>      _flags;
+
+    std::vector<unsigned int>       _triangles;
+    std::vector<unsigned char>      _triangleRemoved;
+    unsigned int                    _numOriginalTriangles;
+    unsigned int                    _numTriangles;
+
+    std::vector<unsigned int>       _adjacencyOffsets;
+    std::vector<unsigned int>       _adjacency;
+    std::vector<unsigned int>       _next;
+    std::vector<unsigned int>       _chainLength;
+    std::vector<unsigned int>       _versions;
+
+    std::vector<unsigned int>       _cells;
+    std::vector<unsigned int>       _cellOffsets;
+    std::vector<unsigned int>       _cellVertices;
+    double                          _originalPerLiveTriangle;
+};
+
+const unsigned int QuadricCollapse::INVALID;
+const unsigned int QuadricCollapse::MAXIMUM_CHAIN_LENGTH;
+
+bool QuadricCollapse::setGeometry(osg::Geometry* geometry, const Simplifier::IndexList& protectedPoints)
+{
+    _geometry = geometry;
+
+    if (_geometry->containsSharedArrays())
+    {
+        OSG_INFO<<"QuadricCollapse::setGeometry(..): Duplicate shared arrays"<<std::endl;
+        _geometry->duplicateSharedArrays();
+    }
+
+    osg::Array* vertices = _geometry->getVertexArray();
+    if (!vertices || vertices->getNumElements()==0) return false;
+
+    unsigned int numVertices = vertices->getNumElements();
+
+    CopyVertexArrayToPositionsVisitor copyPositions(_positions);
+    vertices->accept(copyPositions);
+    if (_positions.size()!=numVertices) return false;
+    _scale = copyPositions._scale;
+
+    // the per vertex arrays are compacted once simplified, and together decide which vertices are duplicates.
+    _perVertexArrays.push_back(vertices);
+    osg::Geometry::ArrayList arrays;
+    _geometry->getArrayList(arrays);
+    for(osg::Geometry::ArrayList::iterator itr = arrays.begin(); itr != arrays.end(); ++itr)
+    {
+        osg::Array* array = itr->get();
+        if (array && array!=vertices && array->getBinding()==osg::Array::BIND_PER_VERTEX && array->getNumElements()==numVertices)
+        {
+            _perVertexArrays.push_back(array);
+        }
+    }
+
+    osg::TriangleIndexFunctor<CollectTriangles> collectTriangles;
+    collectTriangles._triangles = &_triangles;
+    collectTriangles._numVertices = numVertices;
+    _geometry->accept(collectTriangles);
+
+    _flags.resize(numVertices, 0);
+
+    // weld vertices that are identical in all their attributes, and lock those that share a position but not the other attributes.
+    std::vector<unsigned int> sorted(numVertices);
+    for(unsigned int i=0; i<numVertices; ++i) sorted[i] = i;
+    std::sort(sorted.begin(), sorted.end(), LessVertex(_perVertexArrays));
+
+    std::vector<unsigned int> remap(numVertices);
+    unsigned int positionStart = 0;
+    for(unsigned int i=0; i<numVertices; ++i)
+    {
+        bool samePosition = i>0 && vertices->compare(sorted[i-1], sorted[i])==0;
+        if (i>0 && samePosition && !LessVertex(_perVertexArrays)(sorted[i-1], sorted[i]))
+        {
+            remap[sorted[i]] = remap[sorted[i-1]];
+        }
+        else
+        {
+            remap[sorted[i]] = sorted[i];
+        }
+
+        if (!samePosition) positionStart = i;
+        else if (remap[sorted[i]]!=remap[sorted[positionStart]])
+        {
+            for(unsigned int j=positionStart; j<=i; ++j) _flags[remap[sorted[j]]] |= LOCKED;
+        }
+    }
+
+    std::vector<unsigned int> triangles;
+    triangles.reserve(_triangles.size());
+    for(unsigned int i=0; i+2<_triangles.size(); i+=3)
+    {
+        unsigned int p1 = remap[_triangles[i]], p2 = remap[_triangles[i+1]], p3 = remap[_triangles[i+2]];
+        if (p1==p2 || p2==p3 || p1==p3) continue;
+        triangles.push_back(p1);
+        triangles.push_back(p2);
+        triangles.push_back(p3);
+    }
+    _triangles.swap(triangles);
+
+    for(Simplifier::IndexList::const_iterator itr = protectedPoints.begin(); itr != protectedPoints.end(); ++itr)
+    {
+        if (*itr<numVertices) _flags[remap[*itr]] |= LOCKED;
+    }
+
+    _numOriginalTriangles = _numTriangles = static_cast<unsigned int>(_triangles.size()/3);
+    _triangleRemoved.resize(_numTriangles, 0);
+
+    _quadrics.resize(numVertices);
+    _versions.resize(numVertices, 0);
+    _cells.resize(numVertices, 0);
+
+    buildAdjacency();
+
+    ComputeQuadrics computeQuadrics(this);
+    osg::TaskScheduler::instance()->parallelFor(0, numVertices, computeQuadrics, 1024);
+
+    return _numTriangles>0;
+}
+
+void QuadricCollapse::computeQuadric(unsigned int v, Scratch& scratch)
+{
+    gatherTriangles(v, scratch.triangles);
+    if (scratch.triangles.empty()) return;
+
+    Quadric& q = _quadrics[v];
+
+    // count the triangles on each edge from v, an edge on only one triangle is on the boundary and on more than two is non manifold.
+    scratch.ring.clear();
+    for(std::vector<unsigned int>::iterator itr = scratch.triangles.begin(); itr != scratch.triangles.end(); ++itr)
+    {
+        const unsigned int* tri = triangle(*itr);
+        const osg::Vec3f& p1 = _positions[tri[0]];
+        osg::Vec3f n = (_positions[tri[1]]-p1)^(_positions[tri[2]]-p1);
+        float length = n.normalize();
+        q.addPlane(n, p1, length*0.5f);
+
+        for(unsigned int i=0; i<3; ++i)
+        {
+            if (tri[i]!=v) scratch.ring.push_back(tri[i]);
+        }
+    }
+    std::sort(scratch.ring.begin(), scratch.ring.end());
+
+    for(unsigned int i=0; i<scratch.ring.size();)
+    {
+        unsigned int w = scratch.ring[i];
+        unsigned int j = i+1;
+        while(j<scratch.ring.size() && scratch.ring[j]==w) ++j;
+
+        if (j-i>2)
+        {
+            _flags[v] |= LOCKED;
+        }
+        else if (j-i==1)
+        {
+            _flags[v] |= BOUNDARY;
+
+            // keep the boundary in place with a plane through the edge perpendicular to its triangle, weighted well above the surface.
+            for(std::vector<unsigned int>::iterator itr = scratch.triangles.begin(); itr != scratch.triangles.end(); ++itr)
+            {
+                if (!contains(*itr, w)) continue;
+
+                const unsigned int* tri = triangle(*itr);
+                const osg::Vec3f& p1 = _positions[tri[0]];
+                osg::Vec3f n = (_positions[tri[1]]-p1)^(_positions[tri[2]]-p1);
+                osg::Vec3f edge = _positions[w]-_positions[v];
+                osg::Vec3f m = edge^n;
+                m.normalize();
+                q.addPlane(m, _positions[v], edge.length2()*10.0f);
+                break;
+            }
+        }
+        i = j;
+    }
+}
+
+void QuadricCollapse::buildAdjacency()
+{
+    unsigned int numVertices = static_cast<unsigned int>(_positions.size());
+
+    _adjacencyOffsets.assign(numVertices+1, 0);
+    for(unsigned int t=0; t<_triangleRemoved.size(); ++t)
+    {
+        if (_triangleRemoved[t]) continue;
+        const unsigned int* tri = triangle(t);
+        ++_adjacencyOffsets[tri[0]+1];
+        ++_adjacencyOffsets[tri[1]+1];
+        ++_adjacencyOffsets[tri[2]+1];
+    }
+    for(unsigned int v=0; v<numVertices; ++v)
+    {
+        _adjacencyOffsets[v+1] += _adjacencyOffsets[v];
+    }
+
+    _adjacency.resize(_adjacencyOffsets[numVertices]);
+    std::vector<unsigned int> fill(_adjacencyOffsets.begin(), _adjacencyOffsets.end()-1);
+    for(unsigned int t=0; t<_triangleRemoved.size(); ++t)
+    {
+        if (_triangleRemoved[t]) continue;
+        const unsigned int* tri = triangle(t);
+        _adjacency[fill[tri[0]]++] = t;
+        _adjacency[fill[tri[1]]++] = t;
+        _adjacency[fill[tri[2]]++] = t;
+    }
+
+    _next.assign(numVertices, INVALID);
+    _chainLength.assign(numVertices, 1);
+}
+
+void QuadricCollapse::assignCells(unsigned int gridSize, float offset)
+{
+    unsigned int numVertices = static_cast<unsigned int>(_positions.size());
+    unsigned int cellsPerAxis = gridSize+1;
+    unsigned int numCells = cellsPerAxis*cellsPerAxis*cellsPerAxis;
+
+    _cellOffsets.assign(numCells+1, 0);
+    for(unsigned int v=0; v<numVertices; ++v)
+    {
+        const osg::Vec3f& p = _positions[v];
+        unsigned int index[3];
+        for(unsigned int c=0; c<3; ++c)
+        {
+            float f = p[c]*float(gridSize)+offset;
+            index[c] = f>0.0f ? osg::minimum(static_cast<unsigned int>(f), gridSize) : 0;
+        }
+        _cells[v] = index[0] + cellsPerAxis*(index[1] + cellsPerAxis*index[2]);
+        if (isCollapsible(v)) ++_cellOffsets[_cells[v]+1];
+    }
+    for(unsigned int c=0; c<numCells; ++c)
+    {
+        _cellOffsets[c+1] += _cellOffsets[c];
+    }
+
+    _cellVertices.resize(_cellOffsets[numCells]);
+    std::vector<unsigned int> fill(_cellOffsets.begin(), _cellOffsets.end()-1);
+    for(unsigned int v=0; v<numVertices; ++v)
+    {
+        if (isCollapsible(v)) _cellVertices[fill[_cells[v]]++] = v;
+    }
+}
+
+bool QuadricCollapse::isCollapseValid(unsigned int u, unsigned int v, unsigned int cell, Scratch& scratch)
+{
+    // check the cells first, other threads write the flags of vertices in their own cells.
+    if (_cells[u]!=cell || _cells[v]!=cell) return false;
+    if ((_flags[u]&(LOCKED|REMOVED)) || (_flags[v]&REMOVED)) return false;
+    if (_chainLength[u]+_chainLength[v]>MAXIMUM_CHAIN_LENGTH) return false;
+
+    gatherTriangles(u, scratch.triangles);
+
+    unsigned int numShared = 0;
+    for(std::vector<unsigned int>::iterator itr = scratch.triangles.begin(); itr != scratch.triangles.end(); ++itr)
+    {
+        if (contains(*itr, v)) ++numShared;
+    }
+
+    // an interior vertex collapses along edges between two triangles, a boundary vertex only along the boundary.
+    if (numShared != ((_flags[u]&BOUNDARY) ? 1u : 2u)) return false;
+
+    // the collapse rewrites all of u's triangles so all their vertices must belong to this cell.
+    gatherRing(u, scratch.triangles, scratch.ring);
+    for(std::vector<unsigned int>::iterator itr = scratch.ring.begin(); itr != scratch.ring.end(); ++itr)
+    {
+        if (_cells[*itr]!=cell) return false;
+    }
+
+    // link condition, the only vertices neighbouring both u and v may be those opposite the edge, otherwise the mesh would fold.
+    gatherTriangles(v, scratch.otherTriangles);
+    gatherRing(v, scratch.otherTriangles, scratch.otherRing);
+
+    unsigned int numCommon = 0;
+    std::vector<unsigned int>::iterator uitr = scratch.ring.begin();
+    std::vector<unsigned int>::iterator vitr = scratch.otherRing.begin();
+    while(uitr!=scratch.ring.end() && vitr!=scratch.otherRing.end())
+    {
+        if (*uitr<*vitr) ++uitr;
+        else if (*vitr<*uitr) ++vitr;
+        else { ++numCommon; ++uitr; ++vitr; }
+    }
+    if (numCommon!=numShared) return false;
+
+    // reject collapses that would flip or degenerate the remaining triangles.
+    const osg::Vec3f& pu = _positions[u];
+    const osg::Vec3f& pv = _positions[v];
+    for(std::vector<unsigned int>::iterator itr = scratch.triangles.begin(); itr != scratch.triangles.end(); ++itr)
+    {
+        if (contains(*itr, v)) continue;
+
+        const unsigned int* tri = triangle(*itr);
+        unsigned int i = tri[0]==u ? 0 : (tri[1]==u ? 1 : 2);
+        const osg::Vec3f& pa = _positions[tri[(i+1)%3]];
+        const osg::Vec3f& pb = _positions[tri[(i+2)%3]];
+
+        osg::Vec3f before = (pa-pu)^(pb-pu);
+        osg::Vec3f after = (pa-pv)^(pb-pv);
+        float dot = before*after;
+        if (dot<=0.0f || dot*dot < 0.04f*before.length2()*after.length2()) return false;
+    }
+
+    return true;
+}
+
+bool QuadricCollapse::computeBestCollapse(unsigned int u, unsigned int cell, Scratch& scratch, bool validate, unsigned int& target, float& error)
+{
+    if (_cells[u]!=cell || (_flags[u]&(LOCKED|REMOVED))) return false;
+
+    gatherTriangles(u, scratch.triangles);
+    gatherRing(u, scratch.triangles, scratch.ring);
+
+    scratch.candidates.clear();
+    for(std::vector<unsigned int>::iterator itr = scratch.ring.begin(); itr != scratch.ring.end(); ++itr)
+    {
+        // vertices outside the cell lock u for this pass.
+        if (_cells[*itr]!=cell) return false;
+        scratch.candidates.push_back(std::pair<float, unsigned int>(collapseError(u, *itr), *itr));
+    }
+    if (scratch.candidates.empty()) return false;
+
+    if (!validate)
+    {
+        std::vector< std::pair<float, unsigned int> >::iterator best = std::min_element(scratch.candidates.begin(), scratch.candidates.end());
+        target = best->second;
+        error = best->first;
+        return true;
+    }
+
+    std::sort(scratch.candidates.begin(), scratch.candidates.end());
+
+    for(unsigned int i=0; i<scratch.candidates.size(); ++i)
+    {
+        // isCollapseValid() reuses the scratch lists, though not the candidates.
+        if (isCollapseValid(u, scratch.candidates[i].second, cell, scratch))
+        {
+            target = scratch.candidates[i].second;
+            error = scratch.candidates[i].first;
+            return true;
+        }
+    }
+    return false;
+}
+
+unsigned int QuadricCollapse::collapse(unsigned int u, unsigned int v, Scratch& scratch)
+{
+    _quadrics[v] += _quadrics[u];
+
+    unsigned int numRemoved = 0;
+    gatherTriangles(u, scratch.triangles);
+    for(std::vector<unsigned int>::iterator itr = scratch.triangles.begin(); itr != scratch.triangles.end(); ++itr)
+    {
+        unsigned int* tri = triangle(*itr);
+        if (tri[0]==v || tri[1]==v || tri[2]==v)
+        {
+            _triangleRemoved[*itr] = 1;
+            ++numRemoved;
+        }
+        else
+        {
+            for(unsigned int i=0; i<3; ++i)
+            {
+                if (tri[i]==u) tri[i] = v;
+            }
+        }
+    }
+
+    // chain u's triangle lists onto v's.
+    unsigned int last = u;
+    while(_next[last]!=INVALID) last = _next[last];
+    _next[last] = _next[v];
+    _next[v] = u;
+    _chainLength[v] += _chainLength[u];
+
+    _flags[u] |= REMOVED;
+
+    return numRemoved;
+}
+
+struct CollapseEntry
+{
+    CollapseEntry(float error, unsigned int u, unsigned int v, unsigned int version):
+        _error(error), _u(u), _v(v), _version(version) {}
+
+    bool operator < (const CollapseEntry& rhs) const { return _error>rhs._error; }
+
+    float           _error;
+    unsigned int    _u;
+    unsigned int    _v;
+    unsigned int    _version;
+};
+
+unsigned int QuadricCollapse::collapseCell(unsigned int cell, Scratch& scratch)
+{
+    unsigned int begin = _cellOffsets[cell];
+    unsigned int end = _cellOffsets[cell+1];
+    if (begin==end) return 0;
+
+    // the cell's share of the triangles, counting each triangle a third for each of its vertices in the cell.
+    unsigned int numCorners = 0;
+    for(unsigned int i=begin; i<end; ++i)
+    {
+        gatherTriangles(_cellVertices[i], scratch.triangles);
+        numCorners += static_cast<unsigned int>(scratch.triangles.size());
+    }
+    unsigned int numCellTriangles = numCorners/3;
+    unsigned int numCellOriginalTriangles = static_cast<unsigned int>(double(numCellTriangles)*_originalPerLiveTriangle);
+
+    std::priority_queue<CollapseEntry> queue;
+    for(unsigned int i=begin; i<end; ++i)
+    {
+        unsigned int u = _cellVertices[i];
+        unsigned int v;
+        float error;
+        if (computeBestCollapse(u, cell, scratch, false, v, error)) queue.push(CollapseEntry(error, u, v, _versions[u]));
+    }
+
+    unsigned int numRemoved = 0;
+    std::vector<unsigned int> affected;
+    while(!queue.empty())
+    {
+        CollapseEntry entry = queue.top();
+        queue.pop();
+
+        unsigned int u = entry._u;
+        if ((_flags[u]&REMOVED) || entry._version!=_versions[u]) continue;
+
+        float error = static_cast<float>(sqrt(entry._error)*_scale);
+        if (!_simplifier.continueSimplification(error, numCellOriginalTriangles, numCellTriangles-numRemoved)) break;
+
+        // the queue holds the least error collapses unchecked, so when one turns out invalid queue the best valid alternative.
+        if (!isCollapseValid(u, entry._v, cell, scratch))
+        {
+            unsigned int v;
+            if (computeBestCollapse(u, cell, scratch, true, v, error)) queue.push(CollapseEntry(error, u, v, ++_versions[u]));
+            continue;
+        }
+
+        unsigned int v = entry._v;
+        numRemoved += collapse(u, v, scratch);
+
+        // the errors and validity of the collapses around v have changed.
+        gatherTriangles(v, scratch.triangles);
+        gatherRing(v, scratch.triangles, affected);
+        affected.push_back(v);
+        for(std::vector<unsigned int>::iterator itr = affected.begin(); itr != affected.end(); ++itr)
+        {
+            unsigned int w = *itr;
+            if (_cells[w]!=cell || (_flags[w]&(LOCKED|REMOVED))) continue;
+
+            ++_versions[w];
+            unsigned int target;
+            if (computeBestCollapse(w, cell, scratch, false, target, error)) queue.push(CollapseEntry(error, w, target, _versions[w]));
+        }
+    }
+
+    return numRemoved;
+}
+
+void QuadricCollapse::simplify()
+{
+    osg::TaskScheduler* scheduler = osg::TaskScheduler::instance().get();
+
+    unsigned int trianglesPerPartition = osg::maximum(_simplifier.getMaximumNumTrianglesPerPartition(), 1u);
+
+    // triangles lie on surfaces, so occupy roughly the square of the number of grid cells per axis.
+    unsigned int gridSize = static_cast<unsigned int>(sqrt(double(_numTriangles)/double(trianglesPerPartition)));
+    if (gridSize<1) gridSize = 1;
+
+    const unsigned int maximumNumPasses = 64;
+    for(unsigned int pass=0; pass<maximumNumPasses && _simplifier.continueSimplification(0.0f, _numOriginalTriangles, _numTriangles); ++pass)
+    {
+        if (pass>0) buildAdjacency();
+
+        _originalPerLiveTriangle = double(_numOriginalTriangles)/double(_numTriangles);
+
+        assignCells(gridSize, (pass%2)==0 ? 0.0f : 0.5f);
+
+        unsigned int numCells = static_cast<unsigned int>(_cellOffsets.size()-1);
+        std::vector<unsigned int> removed(numCells, 0);
+        CollapseCells collapseCells(this, removed);
+        if (gridSize>1) scheduler->parallelFor(0, numCells, collapseCells, 1);
+        else collapseCells(0, numCells);
+
+        unsigned int numRemoved = 0;
+        for(unsigned int c=0; c<numCells; ++c) numRemoved += removed[c];
+        _numTriangles -= numRemoved;
+
+        OSG_INFO<<"QuadricCollapse pass "<<pass<<" grid "<<gridSize<<" removed "<<numRemoved<<" triangles, "<<_numTriangles<<" remaining"<<std::endl;
+
+        // with little progress the cell borders are holding the collapses back, so move to larger cells.
+        if (numRemoved*100<_numTriangles)
+        {
+            if (gridSize==1) break;
+            gridSize /= 2;
+        }
+    }
+}
+
+void QuadricCollapse::copyBackToGeometry()
+{
+    unsigned int numVertices = static_cast<unsigned int>(_positions.size());
+
+    std::vector<unsigned int> remapping(numVertices, CompactArrayVisitor::invalidIndex);
+    for(unsigned int t=0; t<_triangleRemoved.size(); ++t)
+    {
+        if (_triangleRemoved[t]) continue;
+        const unsigned int* tri = triangle(t);
+        for(unsigned int i=0; i<3; ++i) remapping[tri[i]] = 0;
+    }
+
+    unsigned int numUsed = 0;
+    for(unsigned int v=0; v<numVertices; ++v)
+    {
+        if (remapping[v]!=CompactArrayVisitor::invalidIndex) remapping[v] = numUsed++;
+    }
+
+    CompactArrayVisitor compactArray(remapping, numUsed);
+    for(std::vector<osg::Array*>::iterator itr = _perVertexArrays.begin(); itr != _perVertexArrays.end(); ++itr)
+    {
+        (*itr)->accept(compactArray);
+    }
+
+    osg::DrawElementsUInt* primitives = new osg::DrawElementsUInt(GL_TRIANGLES, _numTriangles*3);
+    unsigned int pos = 0;
+    for(unsigned int t=0; t<_triangleRemoved.size(); ++t)
+    {
+        if (_triangleRemoved[t]) continue;
+        const unsigned int* tri = triangle(t);
+        (*primitives)[pos++] = remapping[tri[0]];
+        (*primitives)[pos++] = remapping[tri[1]];
+        (*primitives)[pos++] = remapping[tri[2]];
+    }
+
+    _geometry->getPrimitiveSetList().clear();
+    _geometry->addPrimitiveSet(primitives);
+    _geometry->dirtyBound();
+}
+
+
 Simplifier::Simplifier(double sampleRatio, double maximumError, double maximumLength):
             osg::NodeVisitor(osg::NodeVisitor::TRAVERSE_ALL_CHILDREN),
             _sampleRatio(sampleRatio),
             _maximumError(maximumError),
             _maximumLength(maximumLength),
             _triStrip(true),
-            _smoothing(true)
+            _smoothing(true),
+            _method(EDGE_COLLAPSE),
+            _maximumNumTrianglesPerPartition(65536)
 
 {
 }
@@ -1745,6 +2634,30 @@ void Simplifier::simplify(osg::Geometry& geometry, const IndexList& protectedPoi
 
     bool downSample = requiresDownSampling();
 
+    if (_method==QUADRIC_COLLAPSE && downSample)
+    {
+        QuadricCollapse qc(*this);
+        if (qc.setGeometry(&geometry, protectedPoints))
+        {
+            qc.simplify();
+
+            OSG_INFO<<"Simplifier, in = "<<qc.getNumOriginalTriangles()<<"\tout = "<<qc.getNumTriangles()<<std::endl;
+
+            qc.copyBackToGeometry();
+
+            if (_smoothing)
+            {
+                osgUtil::SmoothingVisitor::smooth(geometry);
+            }
+
+            if (_triStrip)
+            {
+                osgUtil::optimizeMesh(&geometry);
+            }
+        }
+        return;
+    }
+
     EdgeCollapse ec;
     ec.setComputeErrorMetricUsingLength(!downSample);
     ec.setGeometry(&geometry, protectedPoints);
@@ -57,6 +57,9 @@ void StateGraph::prune()
 
         if (citr->second->empty())
         {
+            // release the StateSet now as the StateGraph may be kept for reuse by the CullVisitor that created it.
+            citr->second->reset();
+
             ChildList::iterator ditr= citr++;
             _children.erase(ditr);
         }
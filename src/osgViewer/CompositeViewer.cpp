@@ -1485,6 +1485,23 @@ void CompositeViewer::updateTraversal()
         getViewerStats()->setAttribute(_frameStamp->getFrameNumber(), "Update traversal begin time", beginUpdateTraversal);
         getViewerStats()->setAttribute(_frameStamp->getFrameNumber(), "Update traversal end time", endUpdateTraversal);
         getViewerStats()->setAttribute(_frameStamp->getFrameNumber(), "Update traversal time taken", endUpdateTraversal-beginUpdateTraversal);
+
+        if (osgDB::Registry::instance()->getObjectCache())
+        {
+            osgDB::Registry::instance()->getObjectCache()->reportStats(getViewerStats(), _frameStamp->getFrameNumber());
+        }
+
+        if (_incrementalCompileOperation.valid())
+        {
+            _incrementalCompileOperation->reportStats(getViewerStats(), _frameStamp->getFrameNumber());
+        }
+
+        for(Scenes::iterator sitr = scenes.begin();
+            sitr != scenes.end();
+            ++sitr)
+        {
+            if ((*sitr)->getImagePager()) (*sitr)->getImagePager()->reportStats(getViewerStats(), _frameStamp->getFrameNumber());
+        }
     }
 
 }
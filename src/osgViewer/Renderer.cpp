@@ -632,6 +632,14 @@ static void collectSceneViewStats(unsigned int frameNumber, osgUtil::SceneView*
     stats->setAttribute(frameNumber, "Visible number of impostors", static_cast<double>(sceneStats.nimpostor));
     stats->setAttribute(frameNumber, "Number of ordered leaves", static_cast<double>(sceneStats.numOrderedLeaves));
 
+    osgUtil::CullVisitor* cullVisitor = sceneView->getCullVisitor();
+    if (cullVisitor)
+    {
+        stats->setAttribute(frameNumber, "Number of RenderLeaf allocations", static_cast<double>(cullVisitor->getNumRenderLeafAllocations()));
+        stats->setAttribute(frameNumber, "Number of StateGraph allocations", static_cast<double>(cullVisitor->getNumStateGraphAllocations()));
+        stats->setAttribute(frameNumber, "Number of RefMatrix allocations", static_cast<double>(cullVisitor->getNumMatrixAllocations()));
+    }
+
     unsigned int totalNumPrimitiveSets = 0;
     const osgUtil::Statistics::PrimitiveValueMap& pvm = sceneStats.getPrimitiveValueMap();
     for(osgUtil::Statistics::PrimitiveValueMap::const_iterator pvm_itr = pvm.begin();
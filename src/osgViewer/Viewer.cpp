@@ -1118,6 +1118,15 @@ void Viewer::updateTraversal()
     getViewerStats()->setAttribute(_frameStamp->getFrameNumber(), "Update traversal begin time", beginUpdateTraversal);
     getViewerStats()->setAttribute(_frameStamp->getFrameNumber(), "Update traversal end time", endUpdateTraversal);
     getViewerStats()->setAttribute(_frameStamp->getFrameNumber(), "Update traversal time taken", endUpdateTraversal - beginUpdateTraversal);
+
+    if (osgDB::Registry::instance()->getObjectCache())
+      osgDB::Registry::instance()->getObjectCache()->reportStats(getViewerStats(), _frameStamp->getFrameNumber());
+
+    if (_incrementalCompileOperation.valid())
+      _incrementalCompileOperation->reportStats(getViewerStats(), _frameStamp->getFrameNumber());
+
+    if (_scene.valid() && _scene->getImagePager())
+      _scene->getImagePager()->reportStats(getViewerStats(), _frameStamp->getFrameNumber());
   }
 }
 
@@ -125,7 +125,7 @@ void Input::_calculateCursorOffsets() {
         //coords.insert(coords.end(),gq.getTransformedCoords(0).begin(),gq.getTransformedCoords(0).end());
         for (unsigned int i=0; i<gq.getGlyphs().size(); ++i)
         {
-            glyphs.push_back(gq.getGlyphs().at(i));
+            glyphs.push_back(gq.getGlyphs().at(i).get());
         }
     }
 